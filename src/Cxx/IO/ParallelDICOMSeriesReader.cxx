@@ -0,0 +1,687 @@
+#include <vtkDICOMImageReader.h>
+#include <vtkDirectory.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+// What the loader needs to know about one file, from its header or from
+// the series index.
+struct SliceInfo
+{
+  std::string FileName;
+  unsigned long FileSize = 0;
+  long ModifiedTime = 0;
+  bool Supported = false;
+  std::string SeriesUID = "-";
+  int InstanceNumber = 0;
+  double Position[3] = {0.0, 0.0, 0.0};
+  double Orientation[6] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+  int Rows = 0;
+  int Columns = 0;
+  double PixelSpacing[2] = {1.0, 1.0};
+  int BitsAllocated = 0;
+  int SamplesPerPixel = 1;
+  int PixelRepresentation = 0;
+  double RescaleSlope = 1.0;
+  double RescaleIntercept = 0.0;
+  long long PixelOffset = -1;
+  long long PixelLength = 0;
+};
+
+struct LoadTimes
+{
+  double List = 0.0;
+  double Headers = 0.0;
+  double Decode = 0.0;
+  int Parsed = 0;
+};
+
+// Loads a DICOM series of uncompressed, little endian, 16-bit slices into
+// one vtkImageData, laid out like the output of vtkDICOMImageReader. The
+// headers are parsed in parallel, stopping at the pixel data, and the
+// result is kept in a series index file. Files whose name, size and time
+// match the index are not parsed again. The pixel data of each slice is
+// then read in parallel straight into its place in the volume.
+bool LoadSeries(std::string const& folder, std::string const& indexFile,
+                vtkImageData* volume, LoadTimes& times);
+
+void SynthesizeSeries(std::string const& folder, int numberOfSlices,
+                      int rows, int columns);
+std::vector<double> SliceSums(vtkImageData* volume);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [folder [indexFile]] or -synthesize numberOfSlices folder.
+  // Without arguments a series of 200 slices is synthesized.
+  std::string folder = "SyntheticSeries";
+  if (argc > 3 && std::string(argv[1]) == "-synthesize")
+  {
+    folder = argv[3];
+    SynthesizeSeries(folder, std::stoi(argv[2]), 512, 512);
+  }
+  else if (argc > 1)
+  {
+    folder = argv[1];
+  }
+  else
+  {
+    SynthesizeSeries(folder, 200, 256, 256);
+  }
+  std::string indexFile = argc > 2 && std::string(argv[1]) != "-synthesize"
+      ? std::string(argv[2])
+      : vtksys::SystemTools::GetFilenameName(folder) + ".seriesindex";
+
+  // The reference: vtkDICOMImageReader, one file after the other.
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  vtkNew<vtkDICOMImageReader> reader;
+  reader->SetDirectoryName(folder.c_str());
+  reader->Update();
+  timer->StopTimer();
+  int* referenceDimensions = reader->GetOutput()->GetDimensions();
+  std::cout << "vtkDICOMImageReader: " << referenceDimensions[0] << " x "
+            << referenceDimensions[1] << " x " << referenceDimensions[2]
+            << " in " << timer->GetElapsedTime() << " s" << std::endl;
+
+  // Cold: no index, every header is parsed. Warm: the index is reused.
+  vtksys::SystemTools::RemoveFile(indexFile);
+  vtkNew<vtkImageData> volume;
+  for (auto pass : {"Cold", "Warm"})
+  {
+    LoadTimes times;
+    timer->StartTimer();
+    if (!LoadSeries(folder, indexFile, volume, times))
+    {
+      std::cout << "Error: could not load " << folder << std::endl;
+      return EXIT_FAILURE;
+    }
+    timer->StopTimer();
+    std::cout << pass << " parallel load: " << timer->GetElapsedTime()
+              << " s (list " << times.List << " s, " << times.Parsed
+              << " headers parsed in " << times.Headers << " s, decode "
+              << times.Decode << " s)" << std::endl;
+  }
+
+  // The slices may be flipped or ordered differently, so compare the sums
+  // of the slices as sets.
+  int* dimensions = volume->GetDimensions();
+  std::vector<double> sums = SliceSums(volume);
+  std::vector<double> referenceSums = SliceSums(reader->GetOutput());
+  std::sort(sums.begin(), sums.end());
+  std::sort(referenceSums.begin(), referenceSums.end());
+  if (!std::equal(dimensions, dimensions + 3, referenceDimensions) ||
+      sums != referenceSums)
+  {
+    std::cout << "Error: the volume differs from vtkDICOMImageReader's."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+const std::uint32_t UndefinedLength = 0xffffffff;
+
+std::string Trim(std::string const& value)
+{
+  auto last = value.find_last_not_of(std::string(" \0", 2));
+  auto first = value.find_first_not_of(' ');
+  return last == std::string::npos ? "" : value.substr(first, last - first + 1);
+}
+
+// Parse the backslash separated numbers of a DS or IS value.
+void ParseNumbers(std::string const& value, double* numbers, int count)
+{
+  std::istringstream stream(value);
+  std::string number;
+  for (int i = 0; i < count && std::getline(stream, number, '\\'); ++i)
+  {
+    numbers[i] = std::atof(number.c_str());
+  }
+}
+
+template <typename T> bool Read(std::istream& in, T& value)
+{
+  // DICOM is little endian here, and so is the host.
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Reads the data elements up to the end position, a delimiter or the pixel
+// data. Only the top level elements are kept, sequences are skipped.
+bool ParseElements(std::istream& in, bool& explicitVR, long long end,
+                   SliceInfo* info)
+{
+  std::uint16_t group, element;
+  while (in.tellg() < end && Read(in, group) && Read(in, element))
+  {
+    std::uint32_t length;
+    if (group == 0xfffe)
+    {
+      if (!Read(in, length))
+      {
+        return false;
+      }
+      if (element != 0xe000)
+      {
+        return true; // Item or sequence delimiter.
+      }
+      if (length == UndefinedLength)
+      {
+        ParseElements(in, explicitVR, end, nullptr);
+      }
+      else
+      {
+        in.seekg(length, std::ios::cur);
+      }
+      continue;
+    }
+
+    // The meta information is always explicit VR.
+    std::string vr;
+    if (explicitVR || group == 0x0002)
+    {
+      char code[2];
+      if (!in.read(code, 2))
+      {
+        return false;
+      }
+      vr.assign(code, 2);
+      static const char* longForms[] = {"OB", "OD", "OF", "OL", "OV", "OW",
+                                        "SQ", "SV", "UC", "UN", "UR", "UT",
+                                        "UV"};
+      if (std::find(std::begin(longForms), std::end(longForms), vr) !=
+          std::end(longForms))
+      {
+        std::uint16_t reserved;
+        Read(in, reserved);
+        Read(in, length);
+      }
+      else
+      {
+        std::uint16_t shortLength;
+        Read(in, shortLength);
+        length = shortLength;
+      }
+    }
+    else
+    {
+      Read(in, length);
+    }
+    if (!in)
+    {
+      return false;
+    }
+
+    if (info && group == 0x7fe0 && element == 0x0010)
+    {
+      info->PixelOffset = in.tellg();
+      info->PixelLength = length;
+      return true;
+    }
+    if (length == UndefinedLength)
+    {
+      // A sequence, in items up to its delimiter.
+      ParseElements(in, explicitVR, end, nullptr);
+      continue;
+    }
+    std::uint32_t tag = (static_cast<std::uint32_t>(group) << 16) | element;
+    bool wanted = info &&
+        (tag == 0x00020010 || tag == 0x0020000e || tag == 0x00200013 ||
+         tag == 0x00200032 || tag == 0x00200037 || tag == 0x00280002 ||
+         tag == 0x00280010 || tag == 0x00280011 || tag == 0x00280030 ||
+         tag == 0x00280100 || tag == 0x00280103 || tag == 0x00281052 ||
+         tag == 0x00281053);
+    if (!wanted || length > 1024)
+    {
+      in.seekg(length, std::ios::cur);
+      continue;
+    }
+    std::string value(length, '\0');
+    if (!in.read(&value[0], length))
+    {
+      return false;
+    }
+    std::uint16_t number = 0;
+    if (length >= 2)
+    {
+      std::memcpy(&number, value.data(), 2);
+    }
+    switch (tag)
+    {
+    case 0x00020010: {
+      // Only uncompressed little endian transfer syntaxes are supported.
+      std::string syntax = Trim(value);
+      info->Supported = syntax == "1.2.840.10008.1.2" ||
+          syntax == "1.2.840.10008.1.2.1";
+      explicitVR = syntax != "1.2.840.10008.1.2";
+      break;
+    }
+    case 0x0020000e: {
+      // "-" is no series, as in the index, where a field can not be empty.
+      std::string uid = Trim(value);
+      info->SeriesUID = uid.empty() ? "-" : uid;
+      break;
+    }
+    case 0x00200013:
+      info->InstanceNumber = std::atoi(value.c_str());
+      break;
+    case 0x00200032:
+      ParseNumbers(value, info->Position, 3);
+      break;
+    case 0x00200037:
+      ParseNumbers(value, info->Orientation, 6);
+      break;
+    case 0x00280002:
+      info->SamplesPerPixel = number;
+      break;
+    case 0x00280010:
+      info->Rows = number;
+      break;
+    case 0x00280011:
+      info->Columns = number;
+      break;
+    case 0x00280030:
+      ParseNumbers(value, info->PixelSpacing, 2);
+      break;
+    case 0x00280100:
+      info->BitsAllocated = number;
+      break;
+    case 0x00280103:
+      info->PixelRepresentation = number;
+      break;
+    case 0x00281052:
+      info->RescaleIntercept = std::atof(value.c_str());
+      break;
+    case 0x00281053:
+      info->RescaleSlope = std::atof(value.c_str());
+      break;
+    }
+  }
+  return true;
+}
+
+bool ParseHeader(std::string const& path, SliceInfo& info)
+{
+  std::ifstream in(path, std::ios::binary);
+  char preamble[132];
+  if (!in.read(preamble, 132) || std::strncmp(preamble + 128, "DICM", 4) != 0)
+  {
+    return false; // Not a DICOM file, or one without a preamble.
+  }
+  bool explicitVR = true;
+  ParseElements(in, explicitVR, static_cast<long long>(info.FileSize),
+                &info);
+  info.Supported = info.Supported && info.PixelOffset > 0 &&
+      info.BitsAllocated == 16 && info.SamplesPerPixel == 1 &&
+      info.Rows > 0 && info.Columns > 0 &&
+      info.PixelLength >= 2LL * info.Rows * info.Columns;
+  return true;
+}
+
+// The series index is one line per file, with the file name last. Every
+// field before the name is one token, so an empty series UID is "-".
+void WriteIndex(std::string const& indexFile,
+                std::vector<SliceInfo> const& slices)
+{
+  std::ofstream out(indexFile);
+  out.precision(17);
+  out << "SeriesIndex 1 " << slices.size() << "\n";
+  for (auto const& s : slices)
+  {
+    out << s.FileSize << " " << s.ModifiedTime << " " << s.Supported << " "
+        << (s.SeriesUID.empty() ? "-" : s.SeriesUID) << " "
+        << s.InstanceNumber;
+    for (auto x : s.Position)
+    {
+      out << " " << x;
+    }
+    for (auto x : s.Orientation)
+    {
+      out << " " << x;
+    }
+    out << " " << s.Rows << " " << s.Columns << " " << s.PixelSpacing[0]
+        << " " << s.PixelSpacing[1] << " " << s.BitsAllocated << " "
+        << s.SamplesPerPixel << " " << s.PixelRepresentation << " "
+        << s.RescaleSlope << " " << s.RescaleIntercept << " "
+        << s.PixelOffset << " " << s.PixelLength << " " << s.FileName
+        << "\n";
+  }
+}
+
+std::map<std::string, SliceInfo> ReadIndex(std::string const& indexFile)
+{
+  std::map<std::string, SliceInfo> index;
+  std::ifstream in(indexFile);
+  std::string magic;
+  int version = 0;
+  std::size_t count = 0;
+  if (!(in >> magic >> version >> count) || magic != "SeriesIndex" ||
+      version != 1)
+  {
+    return index;
+  }
+  // A line that does not parse is left out, so its file is scanned again,
+  // and does not shift the fields of the lines after it.
+  std::string line;
+  std::getline(in, line);
+  for (std::size_t i = 0; i < count && std::getline(in, line); ++i)
+  {
+    std::istringstream fields(line);
+    SliceInfo s;
+    fields >> s.FileSize >> s.ModifiedTime >> s.Supported >> s.SeriesUID >>
+        s.InstanceNumber;
+    for (auto& x : s.Position)
+    {
+      fields >> x;
+    }
+    for (auto& x : s.Orientation)
+    {
+      fields >> x;
+    }
+    fields >> s.Rows >> s.Columns >> s.PixelSpacing[0] >>
+        s.PixelSpacing[1] >> s.BitsAllocated >> s.SamplesPerPixel >>
+        s.PixelRepresentation >> s.RescaleSlope >> s.RescaleIntercept >>
+        s.PixelOffset >> s.PixelLength;
+    if (!fields || fields.get() != ' ' || !std::getline(fields, s.FileName) ||
+        s.FileName.empty())
+    {
+      continue;
+    }
+    index[s.FileName] = s;
+  }
+  return index;
+}
+
+bool LoadSeries(std::string const& folder, std::string const& indexFile,
+                vtkImageData* volume, LoadTimes& times)
+{
+  // List the files. A stat is all it takes to know if the index is valid.
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  vtkNew<vtkDirectory> directory;
+  if (!directory->Open(folder.c_str()))
+  {
+    return false;
+  }
+  std::vector<SliceInfo> files;
+  for (vtkIdType i = 0; i < directory->GetNumberOfFiles(); ++i)
+  {
+    std::string name = directory->GetFile(i);
+    if (name[0] == '.' || directory->FileIsDirectory(name.c_str()))
+    {
+      continue;
+    }
+    SliceInfo info;
+    info.FileName = name;
+    std::string path = folder + "/" + name;
+    info.FileSize = vtksys::SystemTools::FileLength(path);
+    info.ModifiedTime = vtksys::SystemTools::ModifiedTime(path);
+    files.push_back(info);
+  }
+  timer->StopTimer();
+  times.List = timer->GetElapsedTime();
+
+  // Parse the headers that the index does not have, in parallel.
+  timer->StartTimer();
+  auto index = ReadIndex(indexFile);
+  std::vector<std::size_t> toParse;
+  for (std::size_t i = 0; i < files.size(); ++i)
+  {
+    auto cached = index.find(files[i].FileName);
+    if (cached != index.end() &&
+        cached->second.FileSize == files[i].FileSize &&
+        cached->second.ModifiedTime == files[i].ModifiedTime)
+    {
+      files[i] = cached->second;
+    }
+    else
+    {
+      toParse.push_back(i);
+    }
+  }
+  vtkSMPTools::For(0, static_cast<vtkIdType>(toParse.size()),
+                   [&](vtkIdType begin, vtkIdType end) {
+                     for (vtkIdType i = begin; i < end; ++i)
+                     {
+                       SliceInfo& info = files[toParse[i]];
+                       ParseHeader(folder + "/" + info.FileName, info);
+                     }
+                   });
+  times.Parsed = static_cast<int>(toParse.size());
+  if (!toParse.empty() || index.size() != files.size())
+  {
+    WriteIndex(indexFile, files);
+  }
+
+  // Keep the largest series of supported slices, in order along the
+  // normal of the slices.
+  std::map<std::string, std::vector<SliceInfo>> series;
+  for (auto const& info : files)
+  {
+    if (info.Supported)
+    {
+      series[info.SeriesUID].push_back(info);
+    }
+  }
+  if (series.empty())
+  {
+    return false;
+  }
+  auto largest = std::max_element(
+      series.begin(), series.end(),
+      [](std::pair<const std::string, std::vector<SliceInfo>> const& a,
+         std::pair<const std::string, std::vector<SliceInfo>> const& b) {
+        return a.second.size() < b.second.size();
+      });
+  std::vector<SliceInfo>& slices = largest->second;
+  const double* o = slices[0].Orientation;
+  double normal[3] = {o[1] * o[5] - o[2] * o[4], o[2] * o[3] - o[0] * o[5],
+                      o[0] * o[4] - o[1] * o[3]};
+  auto location = [&](SliceInfo const& s) {
+    return s.Position[0] * normal[0] + s.Position[1] * normal[1] +
+        s.Position[2] * normal[2];
+  };
+  std::sort(slices.begin(), slices.end(),
+            [&](SliceInfo const& a, SliceInfo const& b) {
+              double la = location(a);
+              double lb = location(b);
+              return la != lb ? la < lb : a.InstanceNumber < b.InstanceNumber;
+            });
+  timer->StopTimer();
+  times.Headers = timer->GetElapsedTime();
+
+  // Allocate the volume once and decode every slice into its place.
+  timer->StartTimer();
+  SliceInfo const& first = slices[0];
+  int columns = first.Columns;
+  int rows = first.Rows;
+  int numberOfSlices = static_cast<int>(slices.size());
+  double sliceSpacing = numberOfSlices > 1
+      ? std::abs(location(slices[1]) - location(slices[0]))
+      : 1.0;
+  volume->SetDimensions(columns, rows, numberOfSlices);
+  volume->SetSpacing(first.PixelSpacing[1], first.PixelSpacing[0],
+                     sliceSpacing > 0.0 ? sliceSpacing : 1.0);
+  volume->SetOrigin(first.Position);
+  // Stored values, like vtkDICOMImageReader: the rescale is left to the
+  // caller.
+  volume->AllocateScalars(
+      first.PixelRepresentation ? VTK_SHORT : VTK_UNSIGNED_SHORT, 1);
+  auto voxels = static_cast<std::uint16_t*>(volume->GetScalarPointer());
+  std::size_t sliceSize = static_cast<std::size_t>(columns) * rows;
+  std::atomic<bool> ok(true);
+  vtkSMPTools::For(0, numberOfSlices, [&](vtkIdType begin, vtkIdType end) {
+    std::vector<std::uint16_t> row(columns);
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      SliceInfo const& s = slices[k];
+      std::uint16_t* slice = voxels + k * sliceSize;
+      std::ifstream in(folder + "/" + s.FileName, std::ios::binary);
+      in.seekg(s.PixelOffset);
+      if (s.Rows != rows || s.Columns != columns ||
+          !in.read(reinterpret_cast<char*>(slice),
+                   static_cast<std::streamsize>(2 * sliceSize)))
+      {
+        ok = false;
+        continue;
+      }
+      // Bottom row first, like vtkDICOMImageReader.
+      for (int j = 0; j < rows / 2; ++j)
+      {
+        std::uint16_t* top = slice + static_cast<std::size_t>(j) * columns;
+        std::uint16_t* bottom =
+            slice + static_cast<std::size_t>(rows - 1 - j) * columns;
+        std::swap_ranges(top, top + columns, bottom);
+      }
+    }
+  });
+  timer->StopTimer();
+  times.Decode = timer->GetElapsedTime();
+  volume->Modified();
+  return ok;
+}
+
+// Synthetic series writer.
+void WriteElement(std::ostream& out, std::uint16_t group,
+                  std::uint16_t element, const char* vr,
+                  std::string const& value)
+{
+  std::string padded = value;
+  if (padded.size() % 2)
+  {
+    padded += std::strcmp(vr, "UI") == 0 ? '\0' : ' ';
+  }
+  out.write(reinterpret_cast<const char*>(&group), 2);
+  out.write(reinterpret_cast<const char*>(&element), 2);
+  out.write(vr, 2);
+  if (std::strcmp(vr, "OB") == 0 || std::strcmp(vr, "OW") == 0)
+  {
+    std::uint16_t reserved = 0;
+    auto length = static_cast<std::uint32_t>(padded.size());
+    out.write(reinterpret_cast<const char*>(&reserved), 2);
+    out.write(reinterpret_cast<const char*>(&length), 4);
+  }
+  else
+  {
+    auto length = static_cast<std::uint16_t>(padded.size());
+    out.write(reinterpret_cast<const char*>(&length), 2);
+  }
+  out.write(padded.data(), static_cast<std::streamsize>(padded.size()));
+}
+
+void WriteUS(std::ostream& out, std::uint16_t group, std::uint16_t element,
+             std::uint16_t value)
+{
+  WriteElement(out, group, element, "US",
+               std::string(reinterpret_cast<const char*>(&value), 2));
+}
+
+// A CT-like series of a cylinder whose radius changes along z. The slices
+// are written in a shuffled file order.
+void SynthesizeSeries(std::string const& folder, int numberOfSlices,
+                      int rows, int columns)
+{
+  vtksys::SystemTools::MakeDirectory(folder);
+  const std::string root = "1.2.826.0.1.3680043.2.1125.1";
+  vtkSMPTools::For(0, numberOfSlices, [&](vtkIdType begin, vtkIdType end) {
+    std::vector<std::int16_t> pixels(static_cast<std::size_t>(rows) *
+                                     columns);
+    for (vtkIdType file = begin; file < end; ++file)
+    {
+      int k = static_cast<int>((file * 7919) % numberOfSlices);
+      if (numberOfSlices % 7919 == 0)
+      {
+        k = static_cast<int>(file);
+      }
+      double radius =
+          0.3 * columns * (1.0 + 0.3 * std::sin(0.05 * k));
+      for (int j = 0; j < rows; ++j)
+      {
+        for (int i = 0; i < columns; ++i)
+        {
+          double x = i - 0.5 * columns;
+          double y = j - 0.5 * rows;
+          bool inside = x * x + y * y < radius * radius;
+          pixels[i + static_cast<std::size_t>(j) * columns] =
+              static_cast<std::int16_t>(inside ? 40 + (i + j + k) % 50
+                                               : -1000);
+        }
+      }
+
+      std::ostringstream meta;
+      WriteElement(meta, 0x0002, 0x0001, "OB", std::string("\0\1", 2));
+      WriteElement(meta, 0x0002, 0x0002, "UI", "1.2.840.10008.5.1.4.1.1.2");
+      WriteElement(meta, 0x0002, 0x0003, "UI",
+                   root + ".3." + std::to_string(k + 1));
+      WriteElement(meta, 0x0002, 0x0010, "UI", "1.2.840.10008.1.2.1");
+      std::string metaBytes = meta.str();
+      auto metaLength = static_cast<std::uint32_t>(metaBytes.size());
+
+      std::ofstream out(folder + "/IM" + std::to_string(file + 1) + ".dcm",
+                        std::ios::binary);
+      out << std::string(128, '\0') << "DICM";
+      WriteElement(out, 0x0002, 0x0000, "UL",
+                   std::string(reinterpret_cast<const char*>(&metaLength), 4));
+      out << metaBytes;
+      WriteElement(out, 0x0008, 0x0016, "UI", "1.2.840.10008.5.1.4.1.1.2");
+      WriteElement(out, 0x0008, 0x0018, "UI",
+                   root + ".3." + std::to_string(k + 1));
+      WriteElement(out, 0x0008, 0x0060, "CS", "CT");
+      WriteElement(out, 0x0010, 0x0010, "PN", "Synthetic^Phantom");
+      WriteElement(out, 0x0020, 0x000d, "UI", root + ".1");
+      WriteElement(out, 0x0020, 0x000e, "UI", root + ".2");
+      WriteElement(out, 0x0020, 0x0013, "IS", std::to_string(k + 1));
+      WriteElement(out, 0x0020, 0x0032, "DS",
+                   "0\\0\\" + std::to_string(0.5 * k));
+      WriteElement(out, 0x0020, 0x0037, "DS", "1\\0\\0\\0\\1\\0");
+      WriteUS(out, 0x0028, 0x0002, 1);
+      WriteElement(out, 0x0028, 0x0004, "CS", "MONOCHROME2");
+      WriteUS(out, 0x0028, 0x0010, static_cast<std::uint16_t>(rows));
+      WriteUS(out, 0x0028, 0x0011, static_cast<std::uint16_t>(columns));
+      WriteElement(out, 0x0028, 0x0030, "DS", "0.5\\0.5");
+      WriteUS(out, 0x0028, 0x0100, 16);
+      WriteUS(out, 0x0028, 0x0101, 16);
+      WriteUS(out, 0x0028, 0x0102, 15);
+      WriteUS(out, 0x0028, 0x0103, 1);
+      WriteElement(out, 0x7fe0, 0x0010, "OW",
+                   std::string(reinterpret_cast<const char*>(pixels.data()),
+                               2 * pixels.size()));
+    }
+  });
+}
+
+std::vector<double> SliceSums(vtkImageData* volume)
+{
+  int* dimensions = volume->GetDimensions();
+  std::size_t sliceSize = static_cast<std::size_t>(dimensions[0]) *
+      dimensions[1];
+  auto scalars = volume->GetPointData()->GetScalars();
+  std::vector<double> sums(dimensions[2], 0.0);
+  for (int k = 0; k < dimensions[2]; ++k)
+  {
+    for (std::size_t v = 0; v < sliceSize; ++v)
+    {
+      sums[k] += scalars->GetComponent(k * sliceSize + v, 0);
+    }
+  }
+  return sums;
+}
+} // namespace
@@ -3,6 +3,10 @@
 // and how to scroll with the mousewheel or the up/down keys
 // through all slices
 //
+// The slices are loaded in the background, the ones nearest to the
+// current slice first, so that the viewer comes up as soon as the first
+// slice is decoded. The window title shows the progress of the loading.
+//
 // some standard vtk headers
 #include <vtkActor.h>
 #include <vtkNamedColors.h>
@@ -14,11 +18,20 @@
 // headers needed for this example
 #include <vtkActor2D.h>
 #include <vtkDICOMImageReader.h>
+#include <vtkImageData.h>
 #include <vtkImageViewer2.h>
 #include <vtkInteractorStyleImage.h>
 #include <vtkTextMapper.h>
 #include <vtkTextProperty.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 // needed to easily convert int to std::string
 #include <sstream>
 
@@ -28,14 +41,81 @@ namespace {
 class StatusMessage
 {
 public:
-  static std::string Format(int slice, int maxSlice)
+  static std::string Format(int slice, int maxSlice, bool loaded = true)
   {
     std::stringstream tmp;
     tmp << "Slice Number  " << slice + 1 << "/" << maxSlice + 1;
+    if (!loaded)
+    {
+      tmp << " (loading)";
+    }
     return tmp.str();
   }
 };
 
+// Loads the slices of a series in the background. Open() reads the headers
+// with vtkDICOMImageReader, which also sorts the files, and allocates the
+// volume with the layout of the reader's output. The worker threads then
+// decode the slices, always taking the one nearest to the current slice,
+// each file with its own vtkDICOMImageReader, and Deliver() copies the
+// decoded slices into the volume on the main thread.
+class SeriesLoader
+{
+public:
+  ~SeriesLoader();
+
+  // Returns false if the folder has no DICOM files.
+  bool Open(std::string const& folder);
+  void Start();
+
+  vtkImageData* GetVolume()
+  {
+    return this->Volume;
+  }
+  int GetNumberOfSlices() const
+  {
+    return static_cast<int>(this->FileNames.size());
+  }
+  int GetNumberOfLoadedSlices() const
+  {
+    return this->NumberOfLoaded;
+  }
+  bool IsLoaded(int slice) const
+  {
+    return this->Loaded[slice] != 0;
+  }
+
+  void SetCurrentSlice(int slice)
+  {
+    this->CurrentSlice = slice;
+  }
+
+  // Copies the decoded slices into the volume. Returns true if any was.
+  bool Deliver();
+
+  // Blocks until the slice is decoded, then delivers it.
+  void WaitForSlice(int slice);
+
+private:
+  void Decode();
+
+  std::vector<std::string> FileNames;
+  vtkNew<vtkImageData> Volume;
+  int ScalarType = VTK_VOID;
+  std::size_t SliceSize = 0;
+  std::vector<char> Loaded;
+  int NumberOfLoaded = 0;
+  std::atomic<int> CurrentSlice{0};
+
+  // Shared with the workers.
+  std::mutex Mutex;
+  std::condition_variable Decoded;
+  std::vector<char> Claimed;
+  std::vector<std::pair<int, std::vector<char>>> Ready;
+  std::vector<std::thread> Workers;
+  bool Stop = false;
+};
+
 // Define own interaction style
 class myVtkInteractorStyleImage : public vtkInteractorStyleImage
 {
@@ -46,6 +126,8 @@ public:
 protected:
   vtkImageViewer2* _ImageViewer;
   vtkTextMapper* _StatusMapper;
+  SeriesLoader* _Loader = nullptr;
+  std::string _WindowName;
   int _Slice;
   int _MinSlice;
   int _MaxSlice;
@@ -66,17 +148,39 @@ public:
     _StatusMapper = statusMapper;
   }
 
+  // the loader of the slices, if they are loaded in the background
+  void SetLoader(SeriesLoader* loader, std::string const& windowName)
+  {
+    _Loader = loader;
+    _WindowName = windowName;
+  }
+
 protected:
+  bool IsLoaded(int slice)
+  {
+    return _Loader == nullptr || _Loader->IsLoaded(slice);
+  }
+
+  void ShowSlice()
+  {
+    if (_Loader)
+    {
+      _Loader->SetCurrentSlice(_Slice);
+    }
+    _ImageViewer->SetSlice(_Slice);
+    std::string msg =
+        StatusMessage::Format(_Slice, _MaxSlice, IsLoaded(_Slice));
+    _StatusMapper->SetInput(msg.c_str());
+    _ImageViewer->Render();
+  }
+
   void MoveSliceForward()
   {
     if (_Slice < _MaxSlice)
     {
       _Slice += 1;
       cout << "MoveSliceForward::Slice = " << _Slice << std::endl;
-      _ImageViewer->SetSlice(_Slice);
-      std::string msg = StatusMessage::Format(_Slice, _MaxSlice);
-      _StatusMapper->SetInput(msg.c_str());
-      _ImageViewer->Render();
+      ShowSlice();
     }
   }
 
@@ -86,10 +190,7 @@ protected:
     {
       _Slice -= 1;
       cout << "MoveSliceBackward::Slice = " << _Slice << std::endl;
-      _ImageViewer->SetSlice(_Slice);
-      std::string msg = StatusMessage::Format(_Slice, _MaxSlice);
-      _StatusMapper->SetInput(msg.c_str());
-      _ImageViewer->Render();
+      ShowSlice();
     }
   }
 
@@ -130,6 +231,26 @@ protected:
     // in case another interactorstyle is used (e.g. trackballstyle, ...)
     // vtkInteractorStyleImage::OnMouseWheelBackward();
   }
+
+  // the repeating timer brings in the slices loaded in the meantime
+  virtual void OnTimer()
+  {
+    if (_Loader && _Loader->Deliver())
+    {
+      int loaded = _Loader->GetNumberOfLoadedSlices();
+      int total = _Loader->GetNumberOfSlices();
+      std::stringstream title;
+      title << _WindowName;
+      if (loaded < total)
+      {
+        title << " - loading " << loaded << "/" << total;
+      }
+      _ImageViewer->GetRenderWindow()->SetWindowName(title.str().c_str());
+      ShowSlice();
+    }
+    // forward event
+    vtkInteractorStyleImage::OnTimer();
+  }
 };
 
 vtkStandardNewMacro(myVtkInteractorStyleImage);
@@ -150,14 +271,20 @@ int main(int argc, char* argv[])
   std::string folder = argv[1];
   // std::string folder = "C:\\VTK\\vtkdata-5.8.0\\Data\\DicomTestImages";
 
-  // Read all the DICOM files in the specified directory.
-  vtkNew<vtkDICOMImageReader> reader;
-  reader->SetDirectoryName(folder.c_str());
-  reader->Update();
-
   // Visualize
   vtkNew<vtkImageViewer2> imageViewer;
-  imageViewer->SetInputConnection(reader->GetOutputPort());
+
+  // Read the headers of the DICOM files in the specified directory and
+  // load the first slice, the others are loaded in the background.
+  SeriesLoader loader;
+  if (!loader.Open(folder))
+  {
+    std::cout << "Error: no DICOM files in " << folder << std::endl;
+    return EXIT_FAILURE;
+  }
+  loader.Start();
+  loader.WaitForSlice(0);
+  imageViewer->SetInputData(loader.GetVolume());
 
   // slice status message
   vtkNew<vtkTextProperty> sliceTextProp;
@@ -205,6 +332,7 @@ int main(int argc, char* argv[])
   // to enable slice status message updates when scrolling through the slices
   myInteractorStyle->SetImageViewer(imageViewer);
   myInteractorStyle->SetStatusMapper(sliceTextMapper);
+  myInteractorStyle->SetLoader(&loader, "ReadDICOMSeries");
 
   imageViewer->SetupInteractor(renderWindowInteractor);
   // make the interactor use our own interactorstyle
@@ -223,7 +351,156 @@ int main(int argc, char* argv[])
   imageViewer->GetRenderWindow()->SetSize(800, 800);
   imageViewer->GetRenderWindow()->SetWindowName("ReadDICOMSeries");
   imageViewer->Render();
+  // bring in the loaded slices every 50 ms
+  renderWindowInteractor->Initialize();
+  renderWindowInteractor->CreateRepeatingTimer(50);
   renderWindowInteractor->Start();
 
   return EXIT_SUCCESS;
 }
+
+namespace {
+bool SeriesLoader::Open(std::string const& folder)
+{
+  // Only the headers are read here.
+  vtkNew<vtkDICOMImageReader> reader;
+  reader->SetDirectoryName(folder.c_str());
+  reader->UpdateInformation();
+  for (int i = 0; i < reader->GetNumberOfDICOMFileNames(); ++i)
+  {
+    this->FileNames.push_back(reader->GetDICOMFileName(i));
+  }
+  if (this->FileNames.empty())
+  {
+    return false;
+  }
+
+  // The slices not loaded yet are zero.
+  this->ScalarType = reader->GetDataScalarType();
+  this->Volume->SetExtent(reader->GetDataExtent());
+  this->Volume->SetSpacing(reader->GetDataSpacing());
+  this->Volume->SetOrigin(reader->GetDataOrigin());
+  this->Volume->AllocateScalars(this->ScalarType,
+                                reader->GetNumberOfScalarComponents());
+  int* dims = this->Volume->GetDimensions();
+  this->SliceSize = static_cast<std::size_t>(dims[0]) * dims[1] *
+      this->Volume->GetScalarSize() *
+      this->Volume->GetNumberOfScalarComponents();
+  std::memset(this->Volume->GetScalarPointer(), 0,
+              this->SliceSize * this->GetNumberOfSlices());
+  this->Loaded.assign(this->GetNumberOfSlices(), 0);
+  this->Claimed.assign(this->GetNumberOfSlices(), 0);
+  return true;
+}
+
+void SeriesLoader::Start()
+{
+  unsigned numberOfThreads =
+      std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned t = 0; t < numberOfThreads; ++t)
+  {
+    this->Workers.emplace_back(&SeriesLoader::Decode, this);
+  }
+}
+
+SeriesLoader::~SeriesLoader()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Stop = true;
+  }
+  for (auto& worker : this->Workers)
+  {
+    worker.join();
+  }
+}
+
+void SeriesLoader::Decode()
+{
+  int numberOfSlices = this->GetNumberOfSlices();
+  for (;;)
+  {
+    // Take the slice nearest to the one on display.
+    int slice = -1;
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (this->Stop)
+      {
+        return;
+      }
+      int current = this->CurrentSlice;
+      for (int d = 0; d < numberOfSlices && slice < 0; ++d)
+      {
+        for (int k : {current + d, current - d})
+        {
+          if (k >= 0 && k < numberOfSlices && !this->Claimed[k])
+          {
+            slice = k;
+            break;
+          }
+        }
+      }
+      if (slice < 0)
+      {
+        return;
+      }
+      this->Claimed[slice] = 1;
+    }
+
+    // A reader of one file puts the bottom row first, like the reader of
+    // the whole series. A slice that cannot be read stays zero.
+    vtkNew<vtkDICOMImageReader> reader;
+    reader->SetFileName(this->FileNames[slice].c_str());
+    reader->Update();
+    vtkImageData* image = reader->GetOutput();
+    std::vector<char> pixels(this->SliceSize, 0);
+    if (image->GetScalarType() == this->ScalarType &&
+        image->GetNumberOfPoints() * image->GetScalarSize() *
+                image->GetNumberOfScalarComponents() ==
+            static_cast<vtkIdType>(this->SliceSize))
+    {
+      std::memcpy(pixels.data(), image->GetScalarPointer(), this->SliceSize);
+    }
+
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Ready.emplace_back(slice, std::move(pixels));
+    this->Decoded.notify_all();
+  }
+}
+
+bool SeriesLoader::Deliver()
+{
+  std::vector<std::pair<int, std::vector<char>>> ready;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    ready.swap(this->Ready);
+  }
+  auto voxels = static_cast<char*>(this->Volume->GetScalarPointer());
+  for (auto const& slice : ready)
+  {
+    std::copy(slice.second.begin(), slice.second.end(),
+              voxels + slice.first * this->SliceSize);
+    this->Loaded[slice.first] = 1;
+    ++this->NumberOfLoaded;
+  }
+  if (!ready.empty())
+  {
+    this->Volume->Modified();
+  }
+  return !ready.empty();
+}
+
+void SeriesLoader::WaitForSlice(int slice)
+{
+  this->SetCurrentSlice(slice);
+  while (!this->Loaded[slice])
+  {
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      this->Decoded.wait(lock, [this]() { return !this->Ready.empty(); });
+    }
+    this->Deliver();
+  }
+}
+
+} // namespace
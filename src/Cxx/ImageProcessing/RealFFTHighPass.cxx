@@ -0,0 +1,798 @@
+#include <vtkImageData.h>
+#include <vtkImageExtractComponents.h>
+#include <vtkImageFFT.h>
+#include <vtkImageIdealHighPass.h>
+#include <vtkImageRFFT.h>
+#include <vtkNew.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace {
+using Complex = std::complex<double>;
+
+// The tables for complex FFTs of one length. Powers of two use an
+// iterative radix-2 transform; other lengths use Bluestein's algorithm,
+// a convolution with a chirp done with a power of two transform. A plan
+// is read only once it is made, so any number of threads can share it.
+class FFTPlan
+{
+public:
+  explicit FFTPlan(int length);
+
+  // Unnormalized, in place. work is scratch space for Bluestein's
+  // algorithm, resized as needed.
+  void Transform(Complex* data, bool inverse, std::vector<Complex>& work) const;
+
+private:
+  void Radix2(Complex* data, bool inverse) const;
+
+  int Length;
+  int PowerLength;
+  std::vector<Complex> Twiddles;
+  std::vector<int> Reversed;
+  std::vector<Complex> Chirp;
+  std::vector<Complex> ChirpFilter;
+};
+
+// FFT of real data of length n through a complex FFT of length n/2: the
+// even and odd samples are packed into the real and imaginary parts and
+// separated again after the transform. The result is the half spectrum,
+// n/2 + 1 coefficients; the rest follows from conjugate symmetry. Odd
+// lengths go through a complex FFT of length n.
+class RealFFTPlan
+{
+public:
+  explicit RealFFTPlan(int length);
+
+  void Forward(double const* in, Complex* out, std::vector<Complex>& line,
+               std::vector<Complex>& work) const;
+  // Unnormalized: returns length times the signal.
+  void Inverse(Complex const* in, double* out, std::vector<Complex>& line,
+               std::vector<Complex>& work) const;
+
+private:
+  int Length;
+  std::unique_ptr<FFTPlan> Half;
+  std::vector<Complex> Twiddles;
+};
+
+// Plans by length, made on first use and kept for later inputs.
+class PlanCache
+{
+public:
+  FFTPlan const& GetComplexPlan(int length);
+  RealFFTPlan const& GetRealPlan(int length);
+  int GetNumberOfPlans() const
+  {
+    return static_cast<int>(this->ComplexPlans.size() +
+                            this->RealPlans.size());
+  }
+
+private:
+  std::map<int, std::unique_ptr<FFTPlan>> ComplexPlans;
+  std::map<int, std::unique_ptr<RealFFTPlan>> RealPlans;
+};
+
+// Frequency domain filtering of real images on the half spectrum. The
+// rows along x are transformed real to complex; y and z are then
+// transformed in bundles of neighbouring columns, so every cache line
+// read is used for all of them. HighPass fuses the ideal high pass into
+// the transform of the last axis: each line is transformed, masked and
+// transformed back while it is in the cache. The spectrum is kept between
+// calls, as are the plans.
+class HalfSpectrumFilter
+{
+public:
+  // The half spectrum of the input, unnormalized like vtkImageFFT.
+  void Forward(vtkImageData* input);
+  // The real image of the current spectrum, normalized like vtkImageRFFT.
+  void Inverse(vtkImageData* output);
+  // Forward, ideal high pass and inverse in one go. The cut off is in
+  // cycles per world unit, as for vtkImageIdealHighPass.
+  void HighPass(vtkImageData* input, vtkImageData* output,
+                double const cutOff[3]);
+
+  Complex const* GetSpectrum() const
+  {
+    return this->Spectrum.data();
+  }
+  int GetNumberOfPlans() const
+  {
+    return this->Plans.GetNumberOfPlans();
+  }
+  double GetSpectrumMiB() const
+  {
+    return this->Spectrum.size() * sizeof(Complex) / 1048576.0;
+  }
+
+private:
+  enum class Pass
+  {
+    Forward,
+    Inverse,
+    Filter
+  };
+
+  void RowPass(vtkImageData* input);
+  void ColumnPass(int axis, Pass pass);
+  void InverseRowPass(vtkImageData* output);
+
+  int Dimensions[3] = {0, 0, 0};
+  int HalfWidth = 0;
+  double Scale[3] = {0.0, 0.0, 0.0};
+  PlanCache Plans;
+  std::vector<Complex> Spectrum;
+};
+
+// The most the output of HalfSpectrumFilter::HighPass can differ from
+// that of the vtkImageIdealHighPass pipeline at any voxel, given the full
+// spectrum of the input. vtkImageIdealHighPass mirrors an index about
+// (n - 1) / 2, not n / 2, so its mask is not conjugate symmetric, and the
+// real part that vtkImageRFFT gives keeps half of a coefficient where the
+// mask and its mirror image differ. The bound is the sum of the
+// magnitudes of the coefficients where the masks differ, so weighted,
+// over the number of voxels.
+double MaskDifferenceBound(vtkImageData* spectrum, double const cutOff[3]);
+
+vtkSmartPointer<vtkImageData> MakeImage(int nx, int ny, int nz);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [size2D [size3D [frames]]]. Each size is run frames times,
+  // as a stream of same-sized images would be.
+  int size2D = argc > 1 ? std::max(2, std::atoi(argv[1])) : 512;
+  int size3D = argc > 2 ? std::max(2, std::atoi(argv[2])) : 64;
+  int frames = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+  double const cutOff[3] = {0.1, 0.1, 0.1};
+  std::cout << vtkSMPTools::GetEstimatedNumberOfThreads() << " threads"
+            << std::endl;
+
+  bool ok = true;
+  HalfSpectrumFilter filter;
+  vtkNew<vtkTimerLog> timer;
+  for (int volume = 0; volume < 2; ++volume)
+  {
+    int size = volume ? size3D : size2D;
+    auto image = MakeImage(size, size, volume ? size : 1);
+    int* dims = image->GetDimensions();
+    vtkIdType voxels =
+        static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+    std::cout << dims[0] << " x " << dims[1] << " x " << dims[2] << std::endl;
+
+    // The pipeline of IdealHighPass.
+    vtkNew<vtkImageFFT> fft;
+    fft->SetInputData(image);
+    vtkNew<vtkImageIdealHighPass> highPass;
+    highPass->SetInputConnection(fft->GetOutputPort());
+    highPass->SetCutOff(cutOff[0], cutOff[1], cutOff[2]);
+    vtkNew<vtkImageRFFT> rfft;
+    rfft->SetInputConnection(highPass->GetOutputPort());
+    vtkNew<vtkImageExtractComponents> real;
+    real->SetInputConnection(rfft->GetOutputPort());
+    real->SetComponents(0);
+    double pipelineTime = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      fft->Modified();
+      timer->StartTimer();
+      real->Update();
+      timer->StopTimer();
+      pipelineTime += timer->GetElapsedTime();
+    }
+    double pipelineMiB = (fft->GetOutput()->GetActualMemorySize() +
+                          highPass->GetOutput()->GetActualMemorySize() +
+                          rfft->GetOutput()->GetActualMemorySize() +
+                          real->GetOutput()->GetActualMemorySize()) /
+        1024.0;
+    std::cout << "  vtkImageFFT pipeline: "
+              << 1000.0 * pipelineTime / frames << " ms per image, "
+              << pipelineMiB << " MiB" << std::endl;
+
+    // The half spectrum filter. Only the first image makes plans.
+    vtkNew<vtkImageData> filtered;
+    double firstTime = 0.0;
+    double laterTime = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      timer->StartTimer();
+      filter.HighPass(image, filtered, cutOff);
+      timer->StopTimer();
+      (frame == 0 ? firstTime : laterTime) += timer->GetElapsedTime();
+    }
+    double filterMiB = filter.GetSpectrumMiB() +
+        voxels * sizeof(double) / 1048576.0;
+    std::cout << "  Half spectrum, fused: " << 1000.0 * firstTime
+              << " ms for the first image";
+    if (frames > 1)
+    {
+      std::cout << ", " << 1000.0 * laterTime / (frames - 1)
+                << " ms per image after";
+    }
+    std::cout << ", " << filterMiB << " MiB, " << filter.GetNumberOfPlans()
+              << " plans" << std::endl;
+
+    // The masks differ along the cut off, so the outputs may differ by as
+    // much as the coefficients there allow, and not more.
+    auto a = static_cast<double*>(filtered->GetScalarPointer());
+    auto b = static_cast<double*>(real->GetOutput()->GetScalarPointer());
+    double range[2];
+    image->GetScalarRange(range);
+    double difference = 0.0;
+    for (vtkIdType i = 0; i < voxels; ++i)
+    {
+      difference = std::max(difference, std::abs(a[i] - b[i]));
+    }
+    double allowed = MaskDifferenceBound(fft->GetOutput(), cutOff);
+    std::cout << "  Largest difference from the pipeline: "
+              << difference / (range[1] - range[0])
+              << " of the range, allowed by the masks: "
+              << allowed / (range[1] - range[0]) << std::endl;
+    if (difference > allowed + 1.0e-9 * (range[1] - range[0]))
+    {
+      std::cout << "Error: the high pass differs from the pipeline."
+                << std::endl;
+      ok = false;
+    }
+
+    // The half spectrum must be that of vtkImageFFT. The sign of the
+    // exponent may differ, which conjugates every coefficient, so the
+    // smaller of the two errors is taken.
+    filter.Forward(image);
+    auto full = static_cast<double*>(fft->GetOutput()->GetScalarPointer());
+    int halfWidth = dims[0] / 2 + 1;
+    double largest = 0.0;
+    double sameError = 0.0;
+    double conjugateError = 0.0;
+    for (vtkIdType row = 0; row < voxels / dims[0]; ++row)
+    {
+      for (int x = 0; x < halfWidth; ++x)
+      {
+        Complex half = filter.GetSpectrum()[row * halfWidth + x];
+        double const* value = full + 2 * (row * dims[0] + x);
+        Complex expected(value[0], value[1]);
+        largest = std::max(largest, std::abs(expected));
+        sameError = std::max(sameError, std::abs(half - expected));
+        conjugateError =
+            std::max(conjugateError, std::abs(std::conj(half) - expected));
+      }
+    }
+    double error = std::min(sameError, conjugateError);
+    // And going back must give the input.
+    filter.Inverse(filtered);
+    auto back = static_cast<double*>(filtered->GetScalarPointer());
+    auto input = static_cast<float*>(image->GetScalarPointer());
+    double roundTrip = 0.0;
+    for (vtkIdType i = 0; i < voxels; ++i)
+    {
+      roundTrip = std::max(roundTrip, std::abs(back[i] - input[i]));
+    }
+    std::cout << "  Spectrum error: " << error / largest
+              << ", round trip error: " << roundTrip / (range[1] - range[0])
+              << std::endl;
+    if (error > 1.0e-9 * largest || roundTrip > 1.0e-9 * (range[1] - range[0]))
+    {
+      ok = false;
+    }
+  }
+
+  if (!ok)
+  {
+    std::cout << "Error: the half spectrum transform is wrong." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+double const Pi = 3.14159265358979323846;
+
+FFTPlan::FFTPlan(int length) : Length(length), PowerLength(1)
+{
+  bool power = (length & (length - 1)) == 0;
+  int minimum = power ? length : 2 * length - 1;
+  int bits = 0;
+  while (this->PowerLength < minimum)
+  {
+    this->PowerLength *= 2;
+    ++bits;
+  }
+  int n = this->PowerLength;
+  this->Twiddles.resize(n / 2);
+  for (int j = 0; j < n / 2; ++j)
+  {
+    this->Twiddles[j] = std::polar(1.0, -2.0 * Pi * j / n);
+  }
+  this->Reversed.resize(n);
+  for (int i = 0; i < n; ++i)
+  {
+    int r = 0;
+    for (int b = 0; b < bits; ++b)
+    {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    this->Reversed[i] = r;
+  }
+  if (power)
+  {
+    return;
+  }
+  // Bluestein: x_k e^(-i pi k^2 / N), convolved with e^(i pi k^2 / N).
+  // k^2 is taken modulo 2N to keep the angles small.
+  this->Chirp.resize(length);
+  for (int k = 0; k < length; ++k)
+  {
+    long long k2 = static_cast<long long>(k) * k % (2LL * length);
+    this->Chirp[k] = std::polar(1.0, -Pi * k2 / length);
+  }
+  this->ChirpFilter.assign(n, Complex(0.0, 0.0));
+  this->ChirpFilter[0] = std::conj(this->Chirp[0]);
+  for (int k = 1; k < length; ++k)
+  {
+    this->ChirpFilter[k] = std::conj(this->Chirp[k]);
+    this->ChirpFilter[n - k] = std::conj(this->Chirp[k]);
+  }
+  this->Radix2(this->ChirpFilter.data(), false);
+}
+
+void FFTPlan::Radix2(Complex* data, bool inverse) const
+{
+  int n = this->PowerLength;
+  for (int i = 0; i < n; ++i)
+  {
+    int r = this->Reversed[i];
+    if (i < r)
+    {
+      std::swap(data[i], data[r]);
+    }
+  }
+  for (int half = 1; half < n; half *= 2)
+  {
+    int step = n / (2 * half);
+    for (int start = 0; start < n; start += 2 * half)
+    {
+      for (int j = 0; j < half; ++j)
+      {
+        Complex w = this->Twiddles[j * step];
+        if (inverse)
+        {
+          w = std::conj(w);
+        }
+        Complex t = w * data[start + j + half];
+        data[start + j + half] = data[start + j] - t;
+        data[start + j] += t;
+      }
+    }
+  }
+}
+
+void FFTPlan::Transform(Complex* data, bool inverse,
+                        std::vector<Complex>& work) const
+{
+  if (this->Chirp.empty())
+  {
+    this->Radix2(data, inverse);
+    return;
+  }
+  // The inverse is the conjugate of the forward transform of the
+  // conjugate.
+  int n = this->PowerLength;
+  work.assign(n, Complex(0.0, 0.0));
+  for (int k = 0; k < this->Length; ++k)
+  {
+    work[k] = (inverse ? std::conj(data[k]) : data[k]) * this->Chirp[k];
+  }
+  this->Radix2(work.data(), false);
+  for (int k = 0; k < n; ++k)
+  {
+    work[k] *= this->ChirpFilter[k];
+  }
+  this->Radix2(work.data(), true);
+  for (int k = 0; k < this->Length; ++k)
+  {
+    Complex value = work[k] * this->Chirp[k] / static_cast<double>(n);
+    data[k] = inverse ? std::conj(value) : value;
+  }
+}
+
+RealFFTPlan::RealFFTPlan(int length) : Length(length)
+{
+  if (length % 2 == 1)
+  {
+    this->Half.reset(new FFTPlan(length));
+    return;
+  }
+  this->Half.reset(new FFTPlan(length / 2));
+  this->Twiddles.resize(length / 2);
+  for (int k = 0; k < length / 2; ++k)
+  {
+    this->Twiddles[k] = std::polar(1.0, -2.0 * Pi * k / length);
+  }
+}
+
+void RealFFTPlan::Forward(double const* in, Complex* out,
+                          std::vector<Complex>& line,
+                          std::vector<Complex>& work) const
+{
+  int n = this->Length;
+  if (n % 2 == 1)
+  {
+    line.resize(n);
+    for (int k = 0; k < n; ++k)
+    {
+      line[k] = Complex(in[k], 0.0);
+    }
+    this->Half->Transform(line.data(), false, work);
+    std::copy(line.begin(), line.begin() + n / 2 + 1, out);
+    return;
+  }
+  int m = n / 2;
+  line.resize(m);
+  for (int k = 0; k < m; ++k)
+  {
+    line[k] = Complex(in[2 * k], in[2 * k + 1]);
+  }
+  this->Half->Transform(line.data(), false, work);
+  // X_k = E_k + W^k O_k, with E and O the transforms of the even and odd
+  // samples: E_k = (Z_k + conj(Z_{m-k})) / 2, O_k = (Z_k - conj(Z_{m-k}))
+  // / 2i.
+  for (int k = 0; k <= m; ++k)
+  {
+    Complex z = line[k % m];
+    Complex zc = std::conj(line[(m - k) % m]);
+    Complex even = 0.5 * (z + zc);
+    Complex odd = Complex(0.0, -0.5) * (z - zc);
+    Complex w = k < m ? this->Twiddles[k] : Complex(-1.0, 0.0);
+    out[k] = even + w * odd;
+  }
+}
+
+void RealFFTPlan::Inverse(Complex const* in, double* out,
+                          std::vector<Complex>& line,
+                          std::vector<Complex>& work) const
+{
+  int n = this->Length;
+  if (n % 2 == 1)
+  {
+    line.resize(n);
+    for (int k = 0; k <= n / 2; ++k)
+    {
+      line[k] = in[k];
+    }
+    for (int k = n / 2 + 1; k < n; ++k)
+    {
+      line[k] = std::conj(in[n - k]);
+    }
+    this->Half->Transform(line.data(), true, work);
+    for (int k = 0; k < n; ++k)
+    {
+      out[k] = line[k].real();
+    }
+    return;
+  }
+  // The reverse of Forward, without the halves, so that the transform of
+  // length m gives n times the signal.
+  int m = n / 2;
+  line.resize(m);
+  for (int k = 0; k < m; ++k)
+  {
+    Complex x = in[k];
+    Complex xc = std::conj(in[m - k]);
+    Complex even = x + xc;
+    Complex odd = (x - xc) * std::conj(this->Twiddles[k]);
+    line[k] = even + Complex(0.0, 1.0) * odd;
+  }
+  this->Half->Transform(line.data(), true, work);
+  for (int k = 0; k < m; ++k)
+  {
+    out[2 * k] = line[k].real();
+    out[2 * k + 1] = line[k].imag();
+  }
+}
+
+FFTPlan const& PlanCache::GetComplexPlan(int length)
+{
+  auto& plan = this->ComplexPlans[length];
+  if (!plan)
+  {
+    plan.reset(new FFTPlan(length));
+  }
+  return *plan;
+}
+
+RealFFTPlan const& PlanCache::GetRealPlan(int length)
+{
+  auto& plan = this->RealPlans[length];
+  if (!plan)
+  {
+    plan.reset(new RealFFTPlan(length));
+  }
+  return *plan;
+}
+
+// Reads one row of any scalar type as doubles.
+template <typename T>
+void ReadRows(T const* scalars, int width, vtkIdType begin, vtkIdType end,
+              RealFFTPlan const& plan, Complex* spectrum, int halfWidth)
+{
+  std::vector<double> row(width);
+  std::vector<Complex> line;
+  std::vector<Complex> work;
+  for (vtkIdType r = begin; r < end; ++r)
+  {
+    T const* source = scalars + r * width;
+    std::copy(source, source + width, row.begin());
+    plan.Forward(row.data(), spectrum + r * halfWidth, line, work);
+  }
+}
+
+void HalfSpectrumFilter::RowPass(vtkImageData* input)
+{
+  input->GetDimensions(this->Dimensions);
+  this->HalfWidth = this->Dimensions[0] / 2 + 1;
+  vtkIdType rows =
+      static_cast<vtkIdType>(this->Dimensions[1]) * this->Dimensions[2];
+  this->Spectrum.resize(rows * this->HalfWidth);
+  RealFFTPlan const& plan = this->Plans.GetRealPlan(this->Dimensions[0]);
+  // Make the column plans now; the tasks only read the cache.
+  this->Plans.GetComplexPlan(this->Dimensions[1]);
+  this->Plans.GetComplexPlan(this->Dimensions[2]);
+  Complex* spectrum = this->Spectrum.data();
+  int width = this->Dimensions[0];
+  int halfWidth = this->HalfWidth;
+  void* scalars = input->GetScalarPointer();
+  int type = input->GetScalarType();
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    switch (type)
+    {
+      vtkTemplateMacro(ReadRows(static_cast<VTK_TT const*>(scalars), width,
+                                begin, end, plan, spectrum, halfWidth));
+    }
+  });
+}
+
+void HalfSpectrumFilter::ColumnPass(int axis, Pass pass)
+{
+  int const Lanes = 8;
+  int length = this->Dimensions[axis];
+  if (length == 1 && pass != Pass::Filter)
+  {
+    return;
+  }
+  int halfWidth = this->HalfWidth;
+  vtkIdType strides[3] = {1, halfWidth,
+                          static_cast<vtkIdType>(halfWidth) *
+                              this->Dimensions[1]};
+  int otherAxis = 3 - axis;
+  int otherLength = this->Dimensions[otherAxis];
+  int bundles = (halfWidth + Lanes - 1) / Lanes;
+  FFTPlan const& plan = this->Plans.GetComplexPlan(length);
+  Complex* spectrum = this->Spectrum.data();
+  double const* scale = this->Scale;
+  int const* dims = this->Dimensions;
+
+  vtkSMPTools::For(
+      0, static_cast<vtkIdType>(bundles) * otherLength,
+      [&](vtkIdType begin, vtkIdType end) {
+        std::vector<Complex> lines(static_cast<std::size_t>(Lanes) * length);
+        std::vector<Complex> work;
+        for (vtkIdType task = begin; task < end; ++task)
+        {
+          int first = static_cast<int>(task % bundles) * Lanes;
+          int lanes = std::min(Lanes, halfWidth - first);
+          int other = static_cast<int>(task / bundles);
+          Complex* base = spectrum + other * strides[otherAxis] + first;
+          for (int i = 0; i < length; ++i)
+          {
+            Complex const* source = base + i * strides[axis];
+            for (int l = 0; l < lanes; ++l)
+            {
+              lines[l * length + i] = source[l];
+            }
+          }
+          for (int l = 0; l < lanes; ++l)
+          {
+            Complex* line = &lines[l * length];
+            plan.Transform(line, pass == Pass::Inverse, work);
+            if (pass != Pass::Filter)
+            {
+              continue;
+            }
+            // Zero the coefficients inside the cut off ellipsoid, using
+            // the frequency of each coefficient, then transform back.
+            int index[3];
+            index[0] = first + l;
+            index[otherAxis] = other;
+            for (int i = 0; i < length; ++i)
+            {
+              index[axis] = i;
+              double sum = 0.0;
+              for (int a = 0; a < 3; ++a)
+              {
+                int frequency = std::min(index[a], dims[a] - index[a]);
+                double t = frequency * scale[a];
+                sum += t * t;
+              }
+              if (sum <= 1.0)
+              {
+                line[i] = 0.0;
+              }
+            }
+            plan.Transform(line, true, work);
+          }
+          for (int i = 0; i < length; ++i)
+          {
+            Complex* destination = base + i * strides[axis];
+            for (int l = 0; l < lanes; ++l)
+            {
+              destination[l] = lines[l * length + i];
+            }
+          }
+        }
+      });
+}
+
+void HalfSpectrumFilter::InverseRowPass(vtkImageData* output)
+{
+  output->SetDimensions(this->Dimensions);
+  output->AllocateScalars(VTK_DOUBLE, 1);
+  auto out = static_cast<double*>(output->GetScalarPointer());
+  int width = this->Dimensions[0];
+  int halfWidth = this->HalfWidth;
+  vtkIdType rows =
+      static_cast<vtkIdType>(this->Dimensions[1]) * this->Dimensions[2];
+  double norm = 1.0 / (static_cast<double>(width) * rows);
+  RealFFTPlan const& plan = this->Plans.GetRealPlan(width);
+  Complex const* spectrum = this->Spectrum.data();
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    std::vector<Complex> line;
+    std::vector<Complex> work;
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      double* row = out + r * width;
+      plan.Inverse(spectrum + r * halfWidth, row, line, work);
+      for (int x = 0; x < width; ++x)
+      {
+        row[x] *= norm;
+      }
+    }
+  });
+}
+
+void HalfSpectrumFilter::Forward(vtkImageData* input)
+{
+  this->RowPass(input);
+  this->ColumnPass(1, Pass::Forward);
+  this->ColumnPass(2, Pass::Forward);
+}
+
+void HalfSpectrumFilter::Inverse(vtkImageData* output)
+{
+  this->ColumnPass(2, Pass::Inverse);
+  this->ColumnPass(1, Pass::Inverse);
+  this->InverseRowPass(output);
+}
+
+void HalfSpectrumFilter::HighPass(vtkImageData* input, vtkImageData* output,
+                                  double const cutOff[3])
+{
+  this->RowPass(input);
+  double spacing[3];
+  input->GetSpacing(spacing);
+  for (int a = 0; a < 3; ++a)
+  {
+    this->Scale[a] =
+        1.0 / (this->Dimensions[a] * spacing[a] * cutOff[a]);
+  }
+  // The last axis longer than one sample does the filtering.
+  int last = this->Dimensions[2] > 1 ? 2 : 1;
+  if (last == 2)
+  {
+    this->ColumnPass(1, Pass::Forward);
+  }
+  this->ColumnPass(last, Pass::Filter);
+  if (last == 2)
+  {
+    this->ColumnPass(1, Pass::Inverse);
+  }
+  this->InverseRowPass(output);
+  output->SetSpacing(spacing);
+  output->SetOrigin(input->GetOrigin());
+}
+
+double MaskDifferenceBound(vtkImageData* spectrum, double const cutOff[3])
+{
+  int dims[3];
+  double spacing[3];
+  spectrum->GetDimensions(dims);
+  spectrum->GetSpacing(spacing);
+  // The square of the frequency over the cut off of each index along each
+  // axis, as this example and vtkImageIdealHighPass compute it.
+  std::vector<double> ours[3];
+  std::vector<double> theirs[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    double middle = (dims[a] - 1) / 2.0;
+    for (int i = 0; i < dims[a]; ++i)
+    {
+      double t = std::min(i, dims[a] - i) / (dims[a] * spacing[a] * cutOff[a]);
+      ours[a].push_back(t * t);
+      t = i > middle ? 2.0 * middle - i : i;
+      t = dims[a] > 1 ? t / (2.0 * middle * spacing[a] * cutOff[a]) : 0.0;
+      theirs[a].push_back(t * t);
+    }
+  }
+  auto full = static_cast<double const*>(spectrum->GetScalarPointer());
+  double bound = 0.0;
+  vtkIdType index = 0;
+  for (int z = 0; z < dims[2]; ++z)
+  {
+    int mz = (dims[2] - z) % dims[2];
+    for (int y = 0; y < dims[1]; ++y)
+    {
+      int my = (dims[1] - y) % dims[1];
+      for (int x = 0; x < dims[0]; ++x, ++index)
+      {
+        int mx = (dims[0] - x) % dims[0];
+        double keep = ours[0][x] + ours[1][y] + ours[2][z] > 1.0 ? 1.0 : 0.0;
+        double theirKeep =
+            theirs[0][x] + theirs[1][y] + theirs[2][z] > 1.0 ? 0.5 : 0.0;
+        theirKeep +=
+            theirs[0][mx] + theirs[1][my] + theirs[2][mz] > 1.0 ? 0.5 : 0.0;
+        if (keep != theirKeep)
+        {
+          double const* value = full + 2 * index;
+          bound += std::abs(keep - theirKeep) *
+              std::abs(Complex(value[0], value[1]));
+        }
+      }
+    }
+  }
+  return bound / static_cast<double>(index);
+}
+
+// Cells under a microscope: soft bright disks or balls on a slowly
+// varying background, with noise.
+vtkSmartPointer<vtkImageData> MakeImage(int nx, int ny, int nz)
+{
+  auto image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(nx, ny, nz);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto pixels = static_cast<float*>(image->GetScalarPointer());
+  vtkSMPTools::For(0, nz, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < ny; ++j)
+      {
+        for (int i = 0; i < nx; ++i)
+        {
+          double x = static_cast<double>(i) / nx;
+          double y = static_cast<double>(j) / ny;
+          double z = static_cast<double>(k) / nz;
+          double value = 100.0 + 50.0 * x + 30.0 * std::sin(2.0 * Pi * y);
+          double cells = std::sin(40.0 * x) * std::sin(34.0 * y) *
+              (nz > 1 ? std::sin(28.0 * z) : 1.0);
+          value += cells > 0.5 ? 400.0 * (cells - 0.5) : 0.0;
+          unsigned int h = (static_cast<unsigned int>(i) * 73856093u) ^
+              (static_cast<unsigned int>(j) * 19349663u) ^
+              (static_cast<unsigned int>(k) * 83492791u);
+          value += static_cast<double>(h % 1000) / 100.0;
+          pixels[i + nx * (j + static_cast<vtkIdType>(ny) * k)] =
+              static_cast<float>(value);
+        }
+      }
+    }
+  });
+  return image;
+}
+} // namespace
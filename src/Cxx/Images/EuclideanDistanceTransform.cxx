@@ -0,0 +1,455 @@
+#include <vtkImageCast.h>
+#include <vtkImageCityBlockDistance.h>
+#include <vtkImageData.h>
+#include <vtkImageEuclideanDistance.h>
+#include <vtkNew.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+// Computes the exact Euclidean distance transform of an image: for every
+// voxel, the squared distance to the nearest voxel whose value is zero, in
+// world units, as vtkImageEuclideanDistance does. The output is double.
+// If features is given, it gets the point id of that nearest zero voxel,
+// or -1 if the image has none.
+//
+// The transform is separable: one pass along each axis, each pass taking
+// the lower envelope of the parabolas of the previous pass along every
+// line (Felzenszwalb and Huttenlocher). That is linear in the number of
+// voxels, and the lines of a pass are independent, so they run in
+// parallel.
+void DistanceTransform(vtkImageData* image, vtkImageData* squaredDistances,
+                       vtkImageData* features = nullptr);
+
+// A CT scan of a cast part: a thick walled housing with ribs, bosses and
+// holes. The material is 1 and the air 0.
+void MakePart(vtkImageData* part, int dimension);
+
+// Checks the transform at a voxel: the feature must be a zero voxel at
+// the reported distance, and no zero voxel may be closer.
+bool CheckVoxel(vtkImageData* image, double const* distances,
+                vtkIdType const* features, vtkIdType id);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [dimension]. The part is dimension^3 voxels.
+  int dimension = argc > 1 ? std::max(8, std::atoi(argv[1])) : 160;
+  int maximumThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  vtkNew<vtkImageData> part;
+  MakePart(part, dimension);
+  double voxels = static_cast<double>(dimension) * dimension * dimension;
+  std::cout << "Part: " << dimension << "^3" << std::endl;
+
+  // Distances from the material to the air, in voxels.
+  vtkNew<vtkImageData> distances;
+  vtkNew<vtkImageData> features;
+  vtkNew<vtkTimerLog> timer;
+  for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+  {
+    vtkSMPTools::Initialize(threads);
+    timer->StartTimer();
+    DistanceTransform(part, distances);
+    timer->StopTimer();
+    double plain = timer->GetElapsedTime();
+    timer->StartTimer();
+    DistanceTransform(part, distances, features);
+    timer->StopTimer();
+    std::cout << "Separable exact transform, " << threads
+              << " threads: " << plain << " s, " << 1.0e-6 * voxels / plain
+              << " Mvoxels/s; with features " << timer->GetElapsedTime()
+              << " s" << std::endl;
+    if (threads == maximumThreads)
+    {
+      break;
+    }
+  }
+  auto exact = static_cast<double*>(distances->GetScalarPointer());
+
+  vtkNew<vtkImageEuclideanDistance> euclidean;
+  euclidean->SetInputData(part);
+  euclidean->InitializeOn();
+  euclidean->ConsiderAnisotropyOn();
+  euclidean->SetAlgorithmToSaitoCached();
+  timer->StartTimer();
+  euclidean->Update();
+  timer->StopTimer();
+  auto saito =
+      static_cast<double*>(euclidean->GetOutput()->GetScalarPointer());
+  double largestDifference = 0.0;
+  for (vtkIdType i = 0; i < static_cast<vtkIdType>(voxels); ++i)
+  {
+    largestDifference =
+        std::max(largestDifference, std::abs(saito[i] - exact[i]));
+  }
+  std::cout << "vtkImageEuclideanDistance: " << timer->GetElapsedTime()
+            << " s, largest difference in squared distance "
+            << largestDifference << std::endl;
+
+  // The city block distance, capped at 255, overestimates.
+  vtkNew<vtkImageCast> cast;
+  cast->SetInputData(part);
+  cast->SetOutputScalarTypeToShort();
+  cast->Update();
+  auto material = static_cast<short*>(cast->GetOutput()->GetScalarPointer());
+  for (vtkIdType i = 0; i < static_cast<vtkIdType>(voxels); ++i)
+  {
+    material[i] = material[i] ? 255 : 0;
+  }
+  vtkNew<vtkImageCityBlockDistance> cityBlock;
+  cityBlock->SetInputData(cast->GetOutput());
+  cityBlock->SetDimensionality(3);
+  timer->StartTimer();
+  cityBlock->Update();
+  timer->StopTimer();
+  auto blocks =
+      static_cast<short*>(cityBlock->GetOutput()->GetScalarPointer());
+  double worst = 0.0;
+  double mean = 0.0;
+  vtkIdType inside = 0;
+  for (vtkIdType i = 0; i < static_cast<vtkIdType>(voxels); ++i)
+  {
+    if (exact[i] > 0.0)
+    {
+      double error = blocks[i] - std::sqrt(exact[i]);
+      worst = std::max(worst, error);
+      mean += error;
+      ++inside;
+    }
+  }
+  std::cout << "vtkImageCityBlockDistance: " << timer->GetElapsedTime()
+            << " s, error up to " << worst << " voxels, mean "
+            << (inside > 0 ? mean / inside : 0.0) << std::endl;
+
+  // Wall thickness: twice the largest distance inside the material.
+  double deepest =
+      *std::max_element(exact, exact + static_cast<vtkIdType>(voxels));
+  std::cout << "Thickest wall: " << 2.0 * std::sqrt(deepest) << " voxels"
+            << std::endl;
+
+  // Check sampled voxels, with cubic voxels and with a CT's anisotropic
+  // ones.
+  bool ok = true;
+  std::mt19937 random(11u);
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    if (pass == 1)
+    {
+      part->SetSpacing(0.4, 0.4, 0.7);
+      DistanceTransform(part, distances, features);
+    }
+    auto d = static_cast<double*>(distances->GetScalarPointer());
+    auto f = static_cast<vtkIdType*>(features->GetScalarPointer());
+    int failures = 0;
+    for (int sample = 0; sample < 300; ++sample)
+    {
+      vtkIdType id = static_cast<vtkIdType>(random() % static_cast<unsigned>(
+                                                           voxels));
+      failures += !CheckVoxel(part, d, f, id);
+    }
+    if (failures > 0)
+    {
+      std::cout << "Error: " << failures << " sampled voxels are wrong"
+                << (pass == 1 ? " with anisotropic spacing." : ".")
+                << std::endl;
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+double const Infinity = std::numeric_limits<double>::infinity();
+
+// Scratch space of a thread for one line.
+struct LineScratch
+{
+  std::vector<double> Values;
+  std::vector<vtkIdType> Features;
+  std::vector<double> Distances;
+  std::vector<vtkIdType> Nearest;
+  std::vector<int> Parabolas;
+  std::vector<double> Bounds;
+
+  void Resize(int n)
+  {
+    if (static_cast<int>(this->Values.size()) < n)
+    {
+      this->Values.resize(n);
+      this->Features.resize(n);
+      this->Distances.resize(n);
+      this->Nearest.resize(n);
+      this->Parabolas.resize(n);
+      this->Bounds.resize(n + 1);
+    }
+  }
+};
+
+// The lower envelope of the parabolas f[q] + w (p - q)^2 along a line of n
+// voxels, with w the squared spacing. Writes the minimum at each p to d
+// and the feature of the parabola that gives it to nearest. Infinite f are
+// no parabola.
+void LowerEnvelope(double const* f, vtkIdType const* features, int n,
+                   double w, double* d, vtkIdType* nearest, int* v,
+                   double* z)
+{
+  int k = -1;
+  for (int q = 0; q < n; ++q)
+  {
+    if (f[q] == Infinity)
+    {
+      continue;
+    }
+    double s = -Infinity;
+    while (k >= 0)
+    {
+      // Where parabola q comes below parabola v[k].
+      s = ((f[q] + w * q * q) - (f[v[k]] + w * v[k] * v[k])) /
+          (2.0 * w * (q - v[k]));
+      if (s > z[k])
+      {
+        break;
+      }
+      --k;
+      s = -Infinity;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = Infinity;
+  }
+  if (k < 0)
+  {
+    std::fill(d, d + n, Infinity);
+    std::fill(nearest, nearest + n, -1);
+    return;
+  }
+  k = 0;
+  for (int p = 0; p < n; ++p)
+  {
+    while (z[k + 1] < p)
+    {
+      ++k;
+    }
+    double offset = p - v[k];
+    d[p] = f[v[k]] + w * offset * offset;
+    nearest[p] = features[v[k]];
+  }
+}
+
+// One pass along an axis, over all its lines in parallel. Lines are
+// numbered with x fastest, so that a thread's lines along y or z are
+// neighbours in memory.
+void Pass(double* distances, vtkIdType* features, int const dims[3],
+          double spacing, int axis, bool withFeatures)
+{
+  vtkIdType strides[3] = {1, dims[0],
+                          static_cast<vtkIdType>(dims[0]) * dims[1]};
+  int n = dims[axis];
+  vtkIdType stride = strides[axis];
+  // The other two axes, fastest first.
+  int a0 = axis == 0 ? 1 : 0;
+  int a1 = axis == 2 ? 1 : 2;
+  vtkIdType lines = static_cast<vtkIdType>(dims[a0]) * dims[a1];
+  double w = spacing * spacing;
+  vtkSMPThreadLocal<LineScratch> scratches;
+  vtkSMPTools::For(0, lines, [&](vtkIdType begin, vtkIdType end) {
+    LineScratch& scratch = scratches.Local();
+    scratch.Resize(n);
+    for (vtkIdType line = begin; line < end; ++line)
+    {
+      vtkIdType start = (line % dims[a0]) * strides[a0] +
+          (line / dims[a0]) * strides[a1];
+      double* f = scratch.Values.data();
+      vtkIdType* in = scratch.Features.data();
+      for (int i = 0; i < n; ++i)
+      {
+        f[i] = distances[start + i * stride];
+        in[i] = withFeatures ? features[start + i * stride] : 0;
+      }
+      LowerEnvelope(f, in, n, w, scratch.Distances.data(),
+                    scratch.Nearest.data(), scratch.Parabolas.data(),
+                    scratch.Bounds.data());
+      for (int i = 0; i < n; ++i)
+      {
+        distances[start + i * stride] = scratch.Distances[i];
+      }
+      if (withFeatures)
+      {
+        for (int i = 0; i < n; ++i)
+        {
+          features[start + i * stride] = scratch.Nearest[i];
+        }
+      }
+    }
+  });
+}
+
+template <typename T>
+void Initialize(T const* scalars, vtkIdType count, double* distances,
+                vtkIdType* features)
+{
+  vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      distances[i] = scalars[i] == 0 ? 0.0 : Infinity;
+      if (features)
+      {
+        features[i] = i;
+      }
+    }
+  });
+}
+
+void DistanceTransform(vtkImageData* image, vtkImageData* squaredDistances,
+                       vtkImageData* features)
+{
+  int dims[3];
+  image->GetDimensions(dims);
+  double spacing[3];
+  image->GetSpacing(spacing);
+  squaredDistances->SetDimensions(dims);
+  squaredDistances->SetSpacing(spacing);
+  squaredDistances->SetOrigin(image->GetOrigin());
+  squaredDistances->AllocateScalars(VTK_DOUBLE, 1);
+  auto distances = static_cast<double*>(squaredDistances->GetScalarPointer());
+  vtkIdType* nearest = nullptr;
+  if (features)
+  {
+    features->SetDimensions(dims);
+    features->SetSpacing(spacing);
+    features->SetOrigin(image->GetOrigin());
+    features->AllocateScalars(VTK_ID_TYPE, 1);
+    nearest = static_cast<vtkIdType*>(features->GetScalarPointer());
+  }
+  vtkIdType count = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  void const* scalars = image->GetScalarPointer();
+  switch (image->GetScalarType())
+  {
+    vtkTemplateMacro(Initialize(static_cast<VTK_TT const*>(scalars), count,
+                                distances, nearest));
+  }
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (dims[axis] > 1)
+    {
+      Pass(distances, nearest, dims, spacing[axis], axis, features != nullptr);
+    }
+  }
+}
+
+bool CheckVoxel(vtkImageData* image, double const* distances,
+                vtkIdType const* features, vtkIdType id)
+{
+  int* dims = image->GetDimensions();
+  double* spacing = image->GetSpacing();
+  auto scalars = static_cast<unsigned char*>(image->GetScalarPointer());
+  vtkIdType sliceSize = static_cast<vtkIdType>(dims[0]) * dims[1];
+  int p[3] = {static_cast<int>(id % dims[0]),
+              static_cast<int>((id / dims[0]) % dims[1]),
+              static_cast<int>(id / sliceSize)};
+  auto squaredDistance = [&](vtkIdType other) {
+    int q[3] = {static_cast<int>(other % dims[0]),
+                static_cast<int>((other / dims[0]) % dims[1]),
+                static_cast<int>(other / sliceSize)};
+    double sum = 0.0;
+    for (int a = 0; a < 3; ++a)
+    {
+      double d = (q[a] - p[a]) * spacing[a];
+      sum += d * d;
+    }
+    return sum;
+  };
+  double d = distances[id];
+  vtkIdType feature = features[id];
+  if (feature < 0)
+  {
+    return d == Infinity;
+  }
+  // The passes sum the terms in another order.
+  double tolerance = 1.0e-9 * (1.0 + d);
+  if (scalars[feature] != 0 ||
+      std::abs(squaredDistance(feature) - d) > tolerance)
+  {
+    return false;
+  }
+  // No zero voxel inside the sphere of that radius may be closer.
+  double radius = std::sqrt(d);
+  int low[3];
+  int high[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    int reach = static_cast<int>(std::ceil(radius / spacing[a]));
+    low[a] = std::max(0, p[a] - reach);
+    high[a] = std::min(dims[a] - 1, p[a] + reach);
+  }
+  for (int k = low[2]; k <= high[2]; ++k)
+  {
+    for (int j = low[1]; j <= high[1]; ++j)
+    {
+      for (int i = low[0]; i <= high[0]; ++i)
+      {
+        vtkIdType other = i + j * dims[0] + k * sliceSize;
+        if (scalars[other] == 0 && squaredDistance(other) < d - tolerance)
+        {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void MakePart(vtkImageData* part, int dimension)
+{
+  part->SetDimensions(dimension, dimension, dimension);
+  part->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  auto voxels = static_cast<unsigned char*>(part->GetScalarPointer());
+  vtkSMPTools::For(0, dimension, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      double z = (k + 0.5) / dimension;
+      for (int j = 0; j < dimension; ++j)
+      {
+        double y = (j + 0.5) / dimension - 0.5;
+        for (int i = 0; i < dimension; ++i)
+        {
+          double x = (i + 0.5) / dimension - 0.5;
+          double r = std::sqrt(x * x + y * y);
+          double angle = std::atan2(y, x);
+          // A tube with a floor, thicker at the bottom.
+          double wall = 0.05 + 0.04 * (1.0 - z);
+          bool solid = r < 0.42 && (r > 0.42 - wall || z < 0.12);
+          // Eight ribs on the outside.
+          double rib = std::abs(std::remainder(angle, 3.14159265 / 4.0));
+          solid = solid || (r < 0.47 && r >= 0.42 && rib * r < 0.012);
+          // Two bosses on the floor, with holes.
+          for (int b = 0; b < 2; ++b)
+          {
+            double bx = x - (b == 0 ? -0.18 : 0.18);
+            double rb = std::sqrt(bx * bx + y * y);
+            solid = solid || (rb < 0.08 && z < 0.35);
+            solid = solid && !(rb < 0.03);
+          }
+          // Four holes through the wall.
+          double hz = z - 0.6;
+          double side = std::abs(std::remainder(angle, 3.14159265 / 2.0));
+          solid = solid && !(r > 0.3 && hz * hz + side * side * 0.1 < 0.004);
+          voxels[i + dimension * (j + static_cast<vtkIdType>(dimension) * k)] =
+              solid ? 1 : 0;
+        }
+      }
+    }
+  });
+}
+} // namespace
@@ -0,0 +1,682 @@
+#include <vtkDataArray.h>
+#include <vtkImageCorrelation.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+using Complex = std::complex<double>;
+
+// Radix-2 complex FFT of one power of two length, with its tables. Read
+// only once made, so the threads share it.
+class FFTPlan
+{
+public:
+  explicit FFTPlan(int length);
+  // Unnormalized, in place.
+  void Transform(Complex* data, bool inverse) const;
+
+private:
+  int Length;
+  std::vector<Complex> Twiddles;
+  std::vector<int> Reversed;
+};
+
+// 2D FFT of real, square tiles of a power of two size through the half
+// spectrum: each row of n samples is packed into a complex row of n/2,
+// giving n/2 + 1 coefficients, and the columns of those are transformed.
+class TileFFT
+{
+public:
+  explicit TileFFT(int size);
+
+  int GetSize() const
+  {
+    return this->Size;
+  }
+  int GetHalfWidth() const
+  {
+    return this->Size / 2 + 1;
+  }
+  void Forward(double const* tile, Complex* spectrum,
+               std::vector<Complex>& line) const;
+  // Unnormalized; the spectrum is overwritten.
+  void Inverse(Complex* spectrum, double* tile,
+               std::vector<Complex>& line) const;
+
+private:
+  int Size;
+  FFTPlan Half;
+  FFTPlan Full;
+  std::vector<Complex> Twiddles;
+};
+
+// Correlation and convolution of a 2D float image with a kernel of any
+// size. Small kernels are summed in the spatial domain, a row at a time.
+// Large kernels go through the FFT with overlap-save: the output is cut
+// into tiles, each tile's input with a margin of the kernel size is
+// transformed, multiplied with the kernel spectrum and transformed back.
+// The kernel spectrum is made once per call and the work space is one
+// tile per thread, however large the image.
+class ImageCorrelator
+{
+public:
+  enum class Method
+  {
+    Automatic,
+    Direct,
+    FFT
+  };
+
+  void SetMethod(Method method)
+  {
+    this->UseMethod = method;
+  }
+  // In Automatic mode, kernels with at least this many pixels use the
+  // FFT.
+  void SetThreshold(vtkIdType pixels)
+  {
+    this->Threshold = pixels;
+  }
+  vtkIdType GetThreshold() const
+  {
+    return this->Threshold;
+  }
+  bool GetUsedFFT() const
+  {
+    return this->UsedFFT;
+  }
+  int GetTileSize() const
+  {
+    return this->TileSize;
+  }
+
+  // out(x) = sum over j of in(x + j) k(j), with the image zero outside,
+  // as vtkImageCorrelation computes it.
+  void Correlate(vtkImageData* input, vtkImageData* kernel,
+                 vtkImageData* output);
+  // out(x) = sum over j of in(x - j + c) k(j), with c the kernel center,
+  // as vtkImageConvolve computes it.
+  void Convolve(vtkImageData* input, vtkImageData* kernel,
+                vtkImageData* output);
+
+private:
+  void Execute(vtkImageData* input, std::vector<double> const& kernel,
+               int const kernelSize[2], int const offset[2],
+               vtkImageData* output);
+  void Direct(float const* in, int const size[2],
+              std::vector<double> const& kernel, int const kernelSize[2],
+              int const offset[2], double* out);
+  void Tiled(float const* in, int const size[2],
+             std::vector<double> const& kernel, int const kernelSize[2],
+             int const offset[2], double* out);
+
+  Method UseMethod = Method::Automatic;
+  vtkIdType Threshold = 15 * 15;
+  bool UsedFFT = false;
+  int TileSize = 0;
+};
+
+vtkSmartPointer<vtkImageData> MakeImage(int width, int height, int seed);
+vtkIdType FindCrossover(ImageCorrelator& correlator);
+double Compare(vtkImageData* a, vtkImageData* b, double& largest);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [imageSize [kernelSize]]. Template matching of a
+  // kernelSize^2 template in an imageSize^2 image.
+  int imageSize = argc > 1 ? std::max(16, std::atoi(argv[1])) : 512;
+  int kernelSize = argc > 2 ? std::max(1, std::atoi(argv[2])) : 64;
+  kernelSize = std::min(kernelSize, imageSize);
+  std::cout << vtkSMPTools::GetEstimatedNumberOfThreads() << " threads"
+            << std::endl;
+
+  ImageCorrelator correlator;
+  vtkIdType crossover = FindCrossover(correlator);
+  correlator.SetThreshold(crossover);
+  std::cout << "The FFT is used for kernels of " << crossover
+            << " pixels and more" << std::endl;
+
+  // The template is a zero mean patch of the image, so that correlation
+  // peaks where it was cut from.
+  auto image = MakeImage(imageSize, imageSize, 1);
+  int corner[2] = {imageSize / 3, imageSize / 2};
+  corner[0] = std::min(corner[0], imageSize - kernelSize);
+  corner[1] = std::min(corner[1], imageSize - kernelSize);
+  vtkNew<vtkImageData> kernel;
+  kernel->SetDimensions(kernelSize, kernelSize, 1);
+  kernel->AllocateScalars(VTK_FLOAT, 1);
+  auto pixels = static_cast<float*>(image->GetScalarPointer());
+  auto weights = static_cast<float*>(kernel->GetScalarPointer());
+  double mean = 0.0;
+  for (int j = 0; j < kernelSize; ++j)
+  {
+    for (int i = 0; i < kernelSize; ++i)
+    {
+      weights[i + kernelSize * j] =
+          pixels[corner[0] + i + imageSize * (corner[1] + j)];
+      mean += weights[i + kernelSize * j];
+    }
+  }
+  mean /= static_cast<double>(kernelSize) * kernelSize;
+  for (int i = 0; i < kernelSize * kernelSize; ++i)
+  {
+    weights[i] -= static_cast<float>(mean);
+  }
+
+  vtkNew<vtkTimerLog> timer;
+  vtkNew<vtkImageCorrelation> correlation;
+  correlation->SetInputData(0, image);
+  correlation->SetInputData(1, kernel);
+  correlation->SetDimensionality(2);
+  timer->StartTimer();
+  correlation->Update();
+  timer->StopTimer();
+  std::cout << "vtkImageCorrelation: " << timer->GetElapsedTime() << " s"
+            << std::endl;
+
+  vtkNew<vtkImageData> direct;
+  correlator.SetMethod(ImageCorrelator::Method::Direct);
+  timer->StartTimer();
+  correlator.Correlate(image, kernel, direct);
+  timer->StopTimer();
+  std::cout << "Direct: " << timer->GetElapsedTime() << " s" << std::endl;
+
+  vtkNew<vtkImageData> automatic;
+  correlator.SetMethod(ImageCorrelator::Method::Automatic);
+  timer->StartTimer();
+  correlator.Correlate(image, kernel, automatic);
+  timer->StopTimer();
+  std::cout << "Automatic: " << timer->GetElapsedTime() << " s, "
+            << (correlator.GetUsedFFT() ? "FFT" : "direct");
+  if (correlator.GetUsedFFT())
+  {
+    std::cout << " with " << correlator.GetTileSize() << "^2 tiles";
+  }
+  std::cout << std::endl;
+
+  vtkNew<vtkImageData> fft;
+  correlator.SetMethod(ImageCorrelator::Method::FFT);
+  timer->StartTimer();
+  correlator.Correlate(image, kernel, fft);
+  timer->StopTimer();
+  std::cout << "FFT: " << timer->GetElapsedTime() << " s" << std::endl;
+
+  auto values = static_cast<double*>(fft->GetScalarPointer());
+  auto peak = std::max_element(values, values + imageSize * imageSize);
+  vtkIdType peakId = peak - values;
+  std::cout << "Peak at (" << peakId % imageSize << ", " << peakId / imageSize
+            << "), template cut at (" << corner[0] << ", " << corner[1] << ")"
+            << std::endl;
+
+  // Convolution with a Gaussian of the same size.
+  double sigma = std::max(1.0, kernelSize / 6.0);
+  for (int j = 0; j < kernelSize; ++j)
+  {
+    for (int i = 0; i < kernelSize; ++i)
+    {
+      double x = i - 0.5 * (kernelSize - 1);
+      double y = j - 0.5 * (kernelSize - 1);
+      weights[i + kernelSize * j] =
+          static_cast<float>(std::exp(-(x * x + y * y) / (2 * sigma * sigma)));
+    }
+  }
+  kernel->Modified();
+  vtkNew<vtkImageData> directBlur;
+  vtkNew<vtkImageData> fftBlur;
+  correlator.SetMethod(ImageCorrelator::Method::Direct);
+  timer->StartTimer();
+  correlator.Convolve(image, kernel, directBlur);
+  timer->StopTimer();
+  std::cout << "Convolution, direct: " << timer->GetElapsedTime() << " s";
+  correlator.SetMethod(ImageCorrelator::Method::FFT);
+  timer->StartTimer();
+  correlator.Convolve(image, kernel, fftBlur);
+  timer->StopTimer();
+  std::cout << ", FFT: " << timer->GetElapsedTime() << " s" << std::endl;
+
+  double largest = 0.0;
+  double vtkDifference = Compare(direct, correlation->GetOutput(), largest);
+  double fftDifference = Compare(fft, direct, largest);
+  double blurLargest = 0.0;
+  double blurDifference = Compare(fftBlur, directBlur, blurLargest);
+  std::cout << "Largest difference, direct from vtkImageCorrelation: "
+            << vtkDifference / largest
+            << ", FFT from direct: " << fftDifference / largest
+            << ", convolution: " << blurDifference / blurLargest
+            << std::endl;
+  if (vtkDifference > 1.0e-4 * largest || fftDifference > 1.0e-9 * largest ||
+      blurDifference > 1.0e-9 * blurLargest)
+  {
+    std::cout << "Error: the correlations differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+double const Pi = 3.14159265358979323846;
+
+FFTPlan::FFTPlan(int length) : Length(length)
+{
+  int bits = 0;
+  while ((1 << bits) < length)
+  {
+    ++bits;
+  }
+  this->Twiddles.resize(length / 2);
+  for (int j = 0; j < length / 2; ++j)
+  {
+    this->Twiddles[j] = std::polar(1.0, -2.0 * Pi * j / length);
+  }
+  this->Reversed.resize(length);
+  for (int i = 0; i < length; ++i)
+  {
+    int r = 0;
+    for (int b = 0; b < bits; ++b)
+    {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    this->Reversed[i] = r;
+  }
+}
+
+void FFTPlan::Transform(Complex* data, bool inverse) const
+{
+  int n = this->Length;
+  for (int i = 0; i < n; ++i)
+  {
+    int r = this->Reversed[i];
+    if (i < r)
+    {
+      std::swap(data[i], data[r]);
+    }
+  }
+  for (int half = 1; half < n; half *= 2)
+  {
+    int step = n / (2 * half);
+    for (int start = 0; start < n; start += 2 * half)
+    {
+      for (int j = 0; j < half; ++j)
+      {
+        Complex w = this->Twiddles[j * step];
+        if (inverse)
+        {
+          w = std::conj(w);
+        }
+        Complex t = w * data[start + j + half];
+        data[start + j + half] = data[start + j] - t;
+        data[start + j] += t;
+      }
+    }
+  }
+}
+
+TileFFT::TileFFT(int size) : Size(size), Half(size / 2), Full(size)
+{
+  this->Twiddles.resize(size / 2);
+  for (int k = 0; k < size / 2; ++k)
+  {
+    this->Twiddles[k] = std::polar(1.0, -2.0 * Pi * k / size);
+  }
+}
+
+void TileFFT::Forward(double const* tile, Complex* spectrum,
+                      std::vector<Complex>& line) const
+{
+  int n = this->Size;
+  int m = n / 2;
+  int width = m + 1;
+  line.resize(n);
+  for (int row = 0; row < n; ++row)
+  {
+    double const* samples = tile + row * n;
+    for (int k = 0; k < m; ++k)
+    {
+      line[k] = Complex(samples[2 * k], samples[2 * k + 1]);
+    }
+    this->Half.Transform(line.data(), false);
+    // Separate the transforms of the even and odd samples.
+    Complex* out = spectrum + row * width;
+    for (int k = 0; k <= m; ++k)
+    {
+      Complex z = line[k % m];
+      Complex zc = std::conj(line[(m - k) % m]);
+      Complex w = k < m ? this->Twiddles[k] : Complex(-1.0, 0.0);
+      out[k] = 0.5 * (z + zc) + w * Complex(0.0, -0.5) * (z - zc);
+    }
+  }
+  for (int column = 0; column < width; ++column)
+  {
+    for (int row = 0; row < n; ++row)
+    {
+      line[row] = spectrum[row * width + column];
+    }
+    this->Full.Transform(line.data(), false);
+    for (int row = 0; row < n; ++row)
+    {
+      spectrum[row * width + column] = line[row];
+    }
+  }
+}
+
+void TileFFT::Inverse(Complex* spectrum, double* tile,
+                      std::vector<Complex>& line) const
+{
+  int n = this->Size;
+  int m = n / 2;
+  int width = m + 1;
+  line.resize(n);
+  for (int column = 0; column < width; ++column)
+  {
+    for (int row = 0; row < n; ++row)
+    {
+      line[row] = spectrum[row * width + column];
+    }
+    this->Full.Transform(line.data(), true);
+    for (int row = 0; row < n; ++row)
+    {
+      spectrum[row * width + column] = line[row];
+    }
+  }
+  for (int row = 0; row < n; ++row)
+  {
+    Complex const* in = spectrum + row * width;
+    for (int k = 0; k < m; ++k)
+    {
+      Complex x = in[k];
+      Complex xc = std::conj(in[m - k]);
+      Complex odd = (x - xc) * std::conj(this->Twiddles[k]);
+      line[k] = (x + xc) + Complex(0.0, 1.0) * odd;
+    }
+    this->Half.Transform(line.data(), true);
+    double* samples = tile + row * n;
+    for (int k = 0; k < m; ++k)
+    {
+      samples[2 * k] = line[k].real();
+      samples[2 * k + 1] = line[k].imag();
+    }
+  }
+}
+
+void ImageCorrelator::Correlate(vtkImageData* input, vtkImageData* kernel,
+                                vtkImageData* output)
+{
+  int kernelSize[2] = {kernel->GetDimensions()[0],
+                       kernel->GetDimensions()[1]};
+  auto weights = static_cast<float const*>(kernel->GetScalarPointer());
+  std::vector<double> values(weights, weights + kernelSize[0] * kernelSize[1]);
+  int offset[2] = {0, 0};
+  this->Execute(input, values, kernelSize, offset, output);
+}
+
+void ImageCorrelator::Convolve(vtkImageData* input, vtkImageData* kernel,
+                               vtkImageData* output)
+{
+  // A convolution is a correlation with the kernel turned around, moved
+  // so that its center lands on the output pixel.
+  int kernelSize[2] = {kernel->GetDimensions()[0],
+                       kernel->GetDimensions()[1]};
+  auto weights = static_cast<float const*>(kernel->GetScalarPointer());
+  std::vector<double> values(weights, weights + kernelSize[0] * kernelSize[1]);
+  std::reverse(values.begin(), values.end());
+  int offset[2] = {-(kernelSize[0] - 1 - kernelSize[0] / 2),
+                   -(kernelSize[1] - 1 - kernelSize[1] / 2)};
+  this->Execute(input, values, kernelSize, offset, output);
+}
+
+void ImageCorrelator::Execute(vtkImageData* input,
+                              std::vector<double> const& kernel,
+                              int const kernelSize[2], int const offset[2],
+                              vtkImageData* output)
+{
+  int size[2] = {input->GetDimensions()[0], input->GetDimensions()[1]};
+  output->SetDimensions(size[0], size[1], 1);
+  output->SetSpacing(input->GetSpacing());
+  output->SetOrigin(input->GetOrigin());
+  output->AllocateScalars(VTK_DOUBLE, 1);
+  auto in = static_cast<float const*>(input->GetScalarPointer());
+  auto out = static_cast<double*>(output->GetScalarPointer());
+  vtkIdType pixels = static_cast<vtkIdType>(kernelSize[0]) * kernelSize[1];
+  this->UsedFFT = this->UseMethod == Method::FFT ||
+      (this->UseMethod == Method::Automatic && pixels >= this->Threshold);
+  if (this->UsedFFT)
+  {
+    this->Tiled(in, size, kernel, kernelSize, offset, out);
+  }
+  else
+  {
+    this->Direct(in, size, kernel, kernelSize, offset, out);
+  }
+}
+
+void ImageCorrelator::Direct(float const* in, int const size[2],
+                             std::vector<double> const& kernel,
+                             int const kernelSize[2], int const offset[2],
+                             double* out)
+{
+  // Each kernel weight adds a shifted input row to the output row.
+  vtkSMPTools::For(0, size[1], [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType y = begin; y < end; ++y)
+    {
+      double* row = out + y * size[0];
+      std::fill(row, row + size[0], 0.0);
+      for (int j = 0; j < kernelSize[1]; ++j)
+      {
+        vtkIdType sourceY = y + offset[1] + j;
+        if (sourceY < 0 || sourceY >= size[1])
+        {
+          continue;
+        }
+        float const* source = in + sourceY * size[0];
+        for (int i = 0; i < kernelSize[0]; ++i)
+        {
+          double weight = kernel[i + kernelSize[0] * j];
+          int shift = offset[0] + i;
+          int first = std::max(0, -shift);
+          int last = std::min(size[0], size[0] - shift);
+          for (int x = first; x < last; ++x)
+          {
+            row[x] += weight * source[x + shift];
+          }
+        }
+      }
+    }
+  });
+}
+
+void ImageCorrelator::Tiled(float const* in, int const size[2],
+                            std::vector<double> const& kernel,
+                            int const kernelSize[2], int const offset[2],
+                            double* out)
+{
+  // A tile of n^2 gives (n - k + 1)^2 output pixels for a k^2 kernel;
+  // twice the kernel size keeps the margin to about half of the work.
+  int largest = std::max(kernelSize[0], kernelSize[1]);
+  int needed = std::min(2 * largest, std::max(size[0], size[1]) + largest);
+  int n = 32;
+  while (n < needed)
+  {
+    n *= 2;
+  }
+  this->TileSize = n;
+  TileFFT fft(n);
+  int width = fft.GetHalfWidth();
+  int block[2] = {n - kernelSize[0] + 1, n - kernelSize[1] + 1};
+  int tiles[2] = {(size[0] + block[0] - 1) / block[0],
+                  (size[1] + block[1] - 1) / block[1]};
+
+  // The spectrum of the kernel, conjugated for a correlation.
+  std::vector<Complex> kernelSpectrum(static_cast<std::size_t>(n) * width);
+  {
+    std::vector<double> tile(static_cast<std::size_t>(n) * n, 0.0);
+    for (int j = 0; j < kernelSize[1]; ++j)
+    {
+      for (int i = 0; i < kernelSize[0]; ++i)
+      {
+        tile[i + n * j] = kernel[i + kernelSize[0] * j];
+      }
+    }
+    std::vector<Complex> line;
+    fft.Forward(tile.data(), kernelSpectrum.data(), line);
+    double norm = 1.0 / (static_cast<double>(n) * n);
+    for (auto& value : kernelSpectrum)
+    {
+      value = std::conj(value) * norm;
+    }
+  }
+
+  // Every tile writes its own output pixels, so the tiles need no
+  // locking.
+  vtkSMPTools::For(
+      0, static_cast<vtkIdType>(tiles[0]) * tiles[1],
+      [&](vtkIdType begin, vtkIdType end) {
+        std::vector<double> tile(static_cast<std::size_t>(n) * n);
+        std::vector<Complex> spectrum(static_cast<std::size_t>(n) * width);
+        std::vector<Complex> line;
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+          int x0 = static_cast<int>(t % tiles[0]) * block[0];
+          int y0 = static_cast<int>(t / tiles[0]) * block[1];
+          // The input of the tile and its margin, zero outside the image.
+          for (int j = 0; j < n; ++j)
+          {
+            double* row = &tile[static_cast<std::size_t>(j) * n];
+            std::fill(row, row + n, 0.0);
+            int y = y0 + offset[1] + j;
+            if (j >= block[1] + kernelSize[1] - 1 || y < 0 || y >= size[1])
+            {
+              continue;
+            }
+            int xStart = x0 + offset[0];
+            int first = std::max(0, -xStart);
+            int last = std::min(block[0] + kernelSize[0] - 1, size[0] - xStart);
+            float const* source = in + static_cast<vtkIdType>(y) * size[0];
+            for (int i = first; i < last; ++i)
+            {
+              row[i] = source[xStart + i];
+            }
+          }
+          fft.Forward(tile.data(), spectrum.data(), line);
+          for (std::size_t i = 0; i < spectrum.size(); ++i)
+          {
+            spectrum[i] *= kernelSpectrum[i];
+          }
+          fft.Inverse(spectrum.data(), tile.data(), line);
+          int columns = std::min(block[0], size[0] - x0);
+          int rows = std::min(block[1], size[1] - y0);
+          for (int j = 0; j < rows; ++j)
+          {
+            std::copy(&tile[static_cast<std::size_t>(j) * n],
+                      &tile[static_cast<std::size_t>(j) * n] + columns,
+                      out + static_cast<vtkIdType>(y0 + j) * size[0] + x0);
+          }
+        }
+      });
+}
+
+// Times both methods on one image for growing kernels and returns the
+// size, in pixels, of the first kernel for which the FFT is faster.
+vtkIdType FindCrossover(ImageCorrelator& correlator)
+{
+  auto image = MakeImage(256, 256, 2);
+  vtkNew<vtkImageData> kernel;
+  vtkNew<vtkImageData> output;
+  vtkNew<vtkTimerLog> timer;
+  vtkIdType crossover = 0;
+  std::cout << "Kernel  Direct (ms)  FFT (ms)" << std::endl;
+  for (int size : {3, 5, 7, 9, 11, 15, 21, 31, 45, 63})
+  {
+    kernel->SetDimensions(size, size, 1);
+    kernel->AllocateScalars(VTK_FLOAT, 1);
+    std::fill_n(static_cast<float*>(kernel->GetScalarPointer()), size * size,
+                1.0f);
+    double times[2];
+    for (int m = 0; m < 2; ++m)
+    {
+      correlator.SetMethod(m == 0 ? ImageCorrelator::Method::Direct
+                                  : ImageCorrelator::Method::FFT);
+      timer->StartTimer();
+      correlator.Correlate(image, kernel, output);
+      timer->StopTimer();
+      times[m] = timer->GetElapsedTime();
+    }
+    std::cout << size << "^2 " << 1000.0 * times[0] << " " << 1000.0 * times[1]
+              << std::endl;
+    if (crossover == 0 && times[1] < times[0])
+    {
+      crossover = static_cast<vtkIdType>(size) * size;
+    }
+  }
+  correlator.SetMethod(ImageCorrelator::Method::Automatic);
+  return crossover == 0 ? 64 * 64 : crossover;
+}
+
+double Compare(vtkImageData* a, vtkImageData* b, double& largest)
+{
+  vtkDataArray* first = a->GetPointData()->GetScalars();
+  vtkDataArray* second = b->GetPointData()->GetScalars();
+  double difference = 0.0;
+  for (vtkIdType i = 0; i < first->GetNumberOfTuples(); ++i)
+  {
+    double value = first->GetTuple1(i);
+    largest = std::max(largest, std::abs(value));
+    difference = std::max(difference, std::abs(value - second->GetTuple1(i)));
+  }
+  return difference;
+}
+
+// A textured image: a few overlapping blobs and noise, so that a patch
+// of it matches itself best.
+vtkSmartPointer<vtkImageData> MakeImage(int width, int height, int seed)
+{
+  auto image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(width, height, 1);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto pixels = static_cast<float*>(image->GetScalarPointer());
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> noise(-20.0f, 20.0f);
+  for (vtkIdType i = 0; i < static_cast<vtkIdType>(width) * height; ++i)
+  {
+    pixels[i] = 100.0f + noise(random);
+  }
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  for (int blob = 0; blob < 60; ++blob)
+  {
+    double cx = width * unit(random);
+    double cy = height * unit(random);
+    double r = (0.01 + 0.04 * unit(random)) * std::max(width, height);
+    double brightness = 200.0 * (unit(random) - 0.3);
+    int x0 = std::max(0, static_cast<int>(cx - r));
+    int x1 = std::min(width - 1, static_cast<int>(cx + r));
+    int y0 = std::max(0, static_cast<int>(cy - r));
+    int y1 = std::min(height - 1, static_cast<int>(cy + r));
+    for (int y = y0; y <= y1; ++y)
+    {
+      for (int x = x0; x <= x1; ++x)
+      {
+        double d2 = ((x - cx) * (x - cx) + (y - cy) * (y - cy)) / (r * r);
+        if (d2 < 1.0)
+        {
+          pixels[x + static_cast<vtkIdType>(width) * y] +=
+              static_cast<float>(brightness * (1.0 - d2));
+        }
+      }
+    }
+  }
+  return image;
+}
+} // namespace
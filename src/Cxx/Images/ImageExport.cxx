@@ -27,7 +27,9 @@ int main(int, char*[])
     }
   }
 
-  // Create the c-style image to convert the VTK image to
+  // Create the c-style image to convert the VTK image to. Export copies the
+  // pixels; GetPointerToData gives them without a copy, see
+  // ImageImportExportZeroCopy.
   std::unique_ptr<unsigned char> cImage(
       new unsigned char[dims[0] * dims[1] * dims[2]]);
 
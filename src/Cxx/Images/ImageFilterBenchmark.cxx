@@ -0,0 +1,519 @@
+#include <vtkFloatArray.h>
+#include <vtkImageContinuousDilate3D.h>
+#include <vtkImageContinuousErode3D.h>
+#include <vtkImageData.h>
+#include <vtkImageDilateErode3D.h>
+#include <vtkImageGaussianSmooth.h>
+#include <vtkImageMedian3D.h>
+#include <vtkImageSeparableConvolution.h>
+#include <vtkImageVariance3D.h>
+#include <vtkNew.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkThreadedImageAlgorithm.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+// Median filter of an unsigned short volume with a box kernel, using a
+// running histogram (Huang's algorithm in 3D). The window slides along x:
+// each step adds the plane of voxels entering the kernel and removes the
+// plane leaving it, so the cost per voxel grows with the square of the
+// kernel size instead of its cube. The histogram has two levels, 256 bins
+// of 256 values, so the median is found by moving a pointer over the
+// coarse bins and scanning one fine bin. Near the boundary the kernel is
+// cut to the volume, and for an even number of values the upper median
+// is taken.
+void HistogramMedian(vtkImageData* input, vtkImageData* output,
+                     int kernelSize);
+
+// Erosion (or dilation) of an unsigned short volume with a box kernel, as
+// three passes of the van Herk/Gil-Werman algorithm: the minimum over a
+// window of any length costs three comparisons per voxel and axis. The
+// y and z passes work on bundles of neighbouring lines so that each cache
+// line read is used for all of them. Near the boundary the kernel is cut
+// to the volume, as for vtkImageContinuousErode3D.
+void BoxErode(vtkImageData* input, vtkImageData* output, int kernelSize,
+              bool dilate);
+
+// Compares the filtered volumes with a brute force evaluation at randomly
+// chosen voxels and returns the number of differences.
+int CheckSamples(vtkImageData* input, vtkImageData* median,
+                 vtkImageData* eroded, int kernelSize, int samples);
+
+vtkSmartPointer<vtkImageData> MakeStack(int dimension);
+double MiB(vtkImageData* image);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [dimension [kernelSize]]. The volume is dimension^3
+  // voxels of unsigned short; kernelSize is the edge of the large cubic
+  // kernel compared in the second part.
+  int dimension = argc > 1 ? std::max(8, std::atoi(argv[1])) : 96;
+  int kernelSize = argc > 2 ? std::max(1, std::atoi(argv[2])) : 7;
+  kernelSize |= 1;
+
+  auto stack = MakeStack(dimension);
+  double voxels = static_cast<double>(dimension) * dimension * dimension;
+  int maximumThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  std::cout << "Volume: " << dimension << "^3 unsigned short, " << MiB(stack)
+            << " MiB, up to " << maximumThreads << " threads" << std::endl;
+
+  // The filters of the Images examples, set up as in the examples.
+  vtkNew<vtkImageGaussianSmooth> gaussian;
+  vtkNew<vtkImageMedian3D> median;
+  median->SetKernelSize(3, 3, 3);
+  vtkNew<vtkImageDilateErode3D> dilateErode;
+  dilateErode->SetDilateValue(0);
+  dilateErode->SetErodeValue(255);
+  dilateErode->SetKernelSize(5, 5, 3);
+  vtkNew<vtkImageContinuousDilate3D> continuousDilate;
+  continuousDilate->SetKernelSize(10, 10, 1);
+  vtkNew<vtkImageVariance3D> variance;
+  variance->SetKernelSize(5, 4, 3);
+  vtkNew<vtkImageSeparableConvolution> separable;
+  vtkNew<vtkFloatArray> boxKernel;
+  boxKernel->SetNumberOfTuples(5);
+  boxKernel->SetNumberOfComponents(1);
+  for (vtkIdType i = 0; i < 5; ++i)
+  {
+    boxKernel->SetValue(i, 1);
+  }
+  separable->SetXKernel(boxKernel);
+  separable->SetYKernel(boxKernel);
+  separable->SetZKernel(boxKernel);
+
+  struct Filter
+  {
+    std::string Name;
+    vtkThreadedImageAlgorithm* Algorithm;
+  };
+  std::vector<Filter> filters{{"vtkImageGaussianSmooth", gaussian},
+                              {"vtkImageMedian3D 3x3x3", median},
+                              {"vtkImageDilateErode3D", dilateErode},
+                              {"vtkImageContinuousDilate3D", continuousDilate},
+                              {"vtkImageVariance3D", variance},
+                              {"vtkImageSeparableConvolution", separable}};
+
+  vtkNew<vtkTimerLog> timer;
+  for (auto& filter : filters)
+  {
+    filter.Algorithm->SetInputData(stack);
+    for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+    {
+      vtkSMPTools::Initialize(threads);
+      filter.Algorithm->SetNumberOfThreads(threads);
+      filter.Algorithm->Modified();
+      timer->StartTimer();
+      filter.Algorithm->Update();
+      timer->StopTimer();
+      double seconds = timer->GetElapsedTime();
+      std::cout << filter.Name << ", " << threads << " threads: " << seconds
+                << " s, " << 1.0e-6 * voxels / seconds << " Mvoxels/s, "
+                << MiB(stack) + MiB(filter.Algorithm->GetOutput()) << " MiB"
+                << std::endl;
+      if (threads == maximumThreads)
+      {
+        break;
+      }
+    }
+    // Release the output before the next filter runs.
+    filter.Algorithm->GetOutput()->Initialize();
+  }
+
+  // Large kernels: the VTK filters with all the threads, then the running
+  // histogram median and the van Herk/Gil-Werman erosion across thread
+  // counts.
+  std::cout << "Kernel " << kernelSize << "^3" << std::endl;
+  vtkSMPTools::Initialize(maximumThreads);
+  vtkNew<vtkImageMedian3D> largeMedian;
+  largeMedian->SetInputData(stack);
+  largeMedian->SetKernelSize(kernelSize, kernelSize, kernelSize);
+  largeMedian->SetNumberOfThreads(maximumThreads);
+  timer->StartTimer();
+  largeMedian->Update();
+  timer->StopTimer();
+  double vtkMedianTime = timer->GetElapsedTime();
+  std::cout << "vtkImageMedian3D, " << maximumThreads
+            << " threads: " << vtkMedianTime << " s, "
+            << 1.0e-6 * voxels / vtkMedianTime << " Mvoxels/s" << std::endl;
+  largeMedian->GetOutput()->Initialize();
+
+  // vtkImageContinuousErode3D uses an ellipsoidal kernel, so its result
+  // differs from the box erosion; the time is still a fair reference.
+  vtkNew<vtkImageContinuousErode3D> largeErode;
+  largeErode->SetInputData(stack);
+  largeErode->SetKernelSize(kernelSize, kernelSize, kernelSize);
+  largeErode->SetNumberOfThreads(maximumThreads);
+  timer->StartTimer();
+  largeErode->Update();
+  timer->StopTimer();
+  double vtkErodeTime = timer->GetElapsedTime();
+  std::cout << "vtkImageContinuousErode3D, " << maximumThreads
+            << " threads: " << vtkErodeTime << " s, "
+            << 1.0e-6 * voxels / vtkErodeTime << " Mvoxels/s" << std::endl;
+  largeErode->GetOutput()->Initialize();
+
+  vtkNew<vtkImageData> medianImage;
+  vtkNew<vtkImageData> erodedImage;
+  double histogramTime = 0.0;
+  double boxTime = 0.0;
+  for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+  {
+    vtkSMPTools::Initialize(threads);
+    timer->StartTimer();
+    HistogramMedian(stack, medianImage, kernelSize);
+    timer->StopTimer();
+    histogramTime = timer->GetElapsedTime();
+    std::cout << "Running histogram median, " << threads
+              << " threads: " << histogramTime << " s, "
+              << 1.0e-6 * voxels / histogramTime << " Mvoxels/s, "
+              << MiB(stack) + MiB(medianImage) << " MiB" << std::endl;
+
+    timer->StartTimer();
+    BoxErode(stack, erodedImage, kernelSize, false);
+    timer->StopTimer();
+    boxTime = timer->GetElapsedTime();
+    // The erosion needs one more volume for the passes.
+    std::cout << "van Herk/Gil-Werman erosion, " << threads
+              << " threads: " << boxTime << " s, "
+              << 1.0e-6 * voxels / boxTime << " Mvoxels/s, "
+              << MiB(stack) + 2.0 * MiB(erodedImage) << " MiB" << std::endl;
+    if (threads == maximumThreads)
+    {
+      break;
+    }
+  }
+  std::cout << "Speedup at " << maximumThreads
+            << " threads: median " << vtkMedianTime / histogramTime
+            << ", erosion " << vtkErodeTime / boxTime << std::endl;
+
+  int differences = CheckSamples(stack, medianImage, erodedImage, kernelSize,
+                                 2000);
+  if (differences > 0)
+  {
+    std::cout << "Error: " << differences
+              << " sampled voxels differ from brute force." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+void HistogramMedian(vtkImageData* input, vtkImageData* output,
+                     int kernelSize)
+{
+  int dims[3];
+  input->GetDimensions(dims);
+  output->SetDimensions(dims);
+  output->SetSpacing(input->GetSpacing());
+  output->SetOrigin(input->GetOrigin());
+  output->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto in = static_cast<unsigned short const*>(input->GetScalarPointer());
+  auto out = static_cast<unsigned short*>(output->GetScalarPointer());
+  int radius = kernelSize / 2;
+  vtkIdType sliceSize = static_cast<vtkIdType>(dims[0]) * dims[1];
+
+  // Each task takes a range of slices, one row after the other, so the
+  // neighbouring rows it reads next are still in the cache.
+  vtkSMPTools::For(0, dims[2], [&](vtkIdType zBegin, vtkIdType zEnd) {
+    std::vector<std::uint32_t> fine(65536, 0);
+    std::vector<std::uint32_t> coarse(256, 0);
+    for (int z = static_cast<int>(zBegin); z < zEnd; ++z)
+    {
+      int z0 = std::max(z - radius, 0);
+      int z1 = std::min(z + radius, dims[2] - 1);
+      for (int y = 0; y < dims[1]; ++y)
+      {
+        int y0 = std::max(y - radius, 0);
+        int y1 = std::min(y + radius, dims[1] - 1);
+        int c = 0;
+        std::uint32_t below = 0;
+        std::uint32_t count = 0;
+        // Adds (step 1) or removes (step -1) the plane of the window at x.
+        auto update = [&](int x, int step) {
+          for (int zz = z0; zz <= z1; ++zz)
+          {
+            unsigned short const* row = in + zz * sliceSize + x;
+            for (int yy = y0; yy <= y1; ++yy)
+            {
+              unsigned short v = row[yy * dims[0]];
+              fine[v] += step;
+              coarse[v >> 8] += step;
+              below += (v >> 8) < c ? step : 0;
+            }
+          }
+          count += step * (y1 - y0 + 1) * (z1 - z0 + 1);
+        };
+        for (int x = 0; x < std::min(radius, dims[0]); ++x)
+        {
+          update(x, 1);
+        }
+        unsigned short* target = out + z * sliceSize + y * dims[0];
+        for (int x = 0; x < dims[0]; ++x)
+        {
+          if (x + radius < dims[0])
+          {
+            update(x + radius, 1);
+          }
+          if (x - radius - 1 >= 0)
+          {
+            update(x - radius - 1, -1);
+          }
+          std::uint32_t rank = count / 2;
+          while (below > rank)
+          {
+            below -= coarse[--c];
+          }
+          while (below + coarse[c] <= rank)
+          {
+            below += coarse[c++];
+          }
+          std::uint32_t seen = below;
+          int v = c << 8;
+          while ((seen += fine[v]) <= rank)
+          {
+            ++v;
+          }
+          target[x] = static_cast<unsigned short>(v);
+        }
+        // Empty the histogram again; cheaper than clearing 64k bins.
+        for (int x = std::max(dims[0] - radius - 1, 0); x < dims[0]; ++x)
+        {
+          update(x, -1);
+        }
+      }
+    }
+  });
+}
+
+// One van Herk/Gil-Werman pass along an axis. The lines are taken in
+// bundles of Lanes neighbours along another axis and copied, padded with
+// the neutral value, into a buffer where the lanes are contiguous.
+void BoxPass(unsigned short const* in, unsigned short* out, int const dims[3],
+             int axis, int radius, bool dilate)
+{
+  int const Lanes = 16;
+  vtkIdType strides[3] = {1, dims[0],
+                          static_cast<vtkIdType>(dims[0]) * dims[1]};
+  int laneAxis = axis == 0 ? 1 : 0;
+  int otherAxis = 3 - axis - laneAxis;
+  int length = dims[axis];
+  int width = 2 * radius + 1;
+  int padded = length + 2 * radius;
+  int bundles = (dims[laneAxis] + Lanes - 1) / Lanes;
+  unsigned short neutral = dilate ? 0 : 65535;
+  auto select = [dilate](unsigned short a, unsigned short b) {
+    return dilate ? std::max(a, b) : std::min(a, b);
+  };
+
+  vtkSMPTools::For(
+      0, static_cast<vtkIdType>(bundles) * dims[otherAxis],
+      [&](vtkIdType begin, vtkIdType end) {
+        std::vector<unsigned short> line(padded * Lanes);
+        std::vector<unsigned short> g(padded * Lanes);
+        std::vector<unsigned short> h(padded * Lanes);
+        for (vtkIdType task = begin; task < end; ++task)
+        {
+          int first = static_cast<int>(task % bundles) * Lanes;
+          int lanes = std::min(Lanes, dims[laneAxis] - first);
+          vtkIdType base = (task / bundles) * strides[otherAxis] +
+              first * strides[laneAxis];
+          std::fill(line.begin(), line.end(), neutral);
+          for (int i = 0; i < length; ++i)
+          {
+            unsigned short const* source = in + base + i * strides[axis];
+            unsigned short* destination = &line[(i + radius) * Lanes];
+            for (int l = 0; l < lanes; ++l)
+            {
+              destination[l] = source[l * strides[laneAxis]];
+            }
+          }
+          // g runs forward and h backward within blocks of the window
+          // width; a window is the end of one block and the start of the
+          // next.
+          for (int j = 0; j < padded; ++j)
+          {
+            for (int l = 0; l < Lanes; ++l)
+            {
+              g[j * Lanes + l] = j % width == 0
+                  ? line[j * Lanes + l]
+                  : select(g[(j - 1) * Lanes + l], line[j * Lanes + l]);
+            }
+          }
+          for (int j = padded - 1; j >= 0; --j)
+          {
+            for (int l = 0; l < Lanes; ++l)
+            {
+              h[j * Lanes + l] = (j % width == width - 1 || j == padded - 1)
+                  ? line[j * Lanes + l]
+                  : select(h[(j + 1) * Lanes + l], line[j * Lanes + l]);
+            }
+          }
+          for (int i = 0; i < length; ++i)
+          {
+            unsigned short* destination = out + base + i * strides[axis];
+            for (int l = 0; l < lanes; ++l)
+            {
+              destination[l * strides[laneAxis]] =
+                  select(h[i * Lanes + l], g[(i + width - 1) * Lanes + l]);
+            }
+          }
+        }
+      });
+}
+
+void BoxErode(vtkImageData* input, vtkImageData* output, int kernelSize,
+              bool dilate)
+{
+  int dims[3];
+  input->GetDimensions(dims);
+  output->SetDimensions(dims);
+  output->SetSpacing(input->GetSpacing());
+  output->SetOrigin(input->GetOrigin());
+  output->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto in = static_cast<unsigned short const*>(input->GetScalarPointer());
+  auto out = static_cast<unsigned short*>(output->GetScalarPointer());
+  std::vector<unsigned short> work(static_cast<std::size_t>(dims[0]) *
+                                   dims[1] * dims[2]);
+  int radius = kernelSize / 2;
+  BoxPass(in, out, dims, 0, radius, dilate);
+  BoxPass(out, work.data(), dims, 1, radius, dilate);
+  BoxPass(work.data(), out, dims, 2, radius, dilate);
+}
+
+int CheckSamples(vtkImageData* input, vtkImageData* median,
+                 vtkImageData* eroded, int kernelSize, int samples)
+{
+  int dims[3];
+  input->GetDimensions(dims);
+  auto in = static_cast<unsigned short const*>(input->GetScalarPointer());
+  auto medianValues =
+      static_cast<unsigned short const*>(median->GetScalarPointer());
+  auto erodedValues =
+      static_cast<unsigned short const*>(eroded->GetScalarPointer());
+  int radius = kernelSize / 2;
+  std::mt19937 random(5489u);
+  int differences = 0;
+  std::vector<unsigned short> window;
+  for (int sample = 0; sample < samples; ++sample)
+  {
+    int p[3];
+    int low[3];
+    int high[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      p[axis] = static_cast<int>(random() % dims[axis]);
+      low[axis] = std::max(p[axis] - radius, 0);
+      high[axis] = std::min(p[axis] + radius, dims[axis] - 1);
+    }
+    window.clear();
+    for (int z = low[2]; z <= high[2]; ++z)
+    {
+      for (int y = low[1]; y <= high[1]; ++y)
+      {
+        for (int x = low[0]; x <= high[0]; ++x)
+        {
+          window.push_back(in[x + dims[0] * (y + dims[1] * z)]);
+        }
+      }
+    }
+    vtkIdType id = p[0] + dims[0] * (p[1] + static_cast<vtkIdType>(dims[1]) *
+                                         p[2]);
+    auto middle = window.begin() + window.size() / 2;
+    std::nth_element(window.begin(), middle, window.end());
+    differences += *middle != medianValues[id];
+    differences +=
+        *std::min_element(window.begin(), window.end()) != erodedValues[id];
+  }
+  return differences;
+}
+
+// Cheap, repeatable noise from the voxel index.
+unsigned int Hash(unsigned int x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// A synthetic fluorescence microscopy stack: bright nuclei on a dim
+// background, with noise and some hot and dead voxels, in 12 bits.
+vtkSmartPointer<vtkImageData> MakeStack(int dimension)
+{
+  struct Nucleus
+  {
+    double Center[3];
+    double Radius;
+    double Brightness;
+  };
+  std::mt19937 random(42u);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::vector<Nucleus> nuclei(40);
+  for (auto& nucleus : nuclei)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      nucleus.Center[axis] = dimension * unit(random);
+    }
+    nucleus.Radius = dimension * (0.03 + 0.05 * unit(random));
+    nucleus.Brightness = 1500.0 + 1500.0 * unit(random);
+  }
+
+  auto stack = vtkSmartPointer<vtkImageData>::New();
+  stack->SetDimensions(dimension, dimension, dimension);
+  stack->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto voxels = static_cast<unsigned short*>(stack->GetScalarPointer());
+  vtkSMPTools::For(0, dimension, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < dimension; ++j)
+      {
+        for (int i = 0; i < dimension; ++i)
+        {
+          vtkIdType id = i + dimension * (j + dimension * k);
+          double value = 100.0;
+          for (auto const& nucleus : nuclei)
+          {
+            double dx = i - nucleus.Center[0];
+            double dy = j - nucleus.Center[1];
+            double dz = k - nucleus.Center[2];
+            double r2 = (dx * dx + dy * dy + dz * dz) /
+                (nucleus.Radius * nucleus.Radius);
+            if (r2 < 1.0)
+            {
+              value = std::max(value, nucleus.Brightness * (1.0 - 0.5 * r2));
+            }
+          }
+          unsigned int noise = Hash(static_cast<unsigned int>(id));
+          value += 0.2 * std::sqrt(value) * ((noise & 0xff) - 127.5) / 32.0;
+          if ((noise >> 8) % 100 == 0)
+          {
+            value = (noise >> 16) & 1 ? 4095.0 : 0.0;
+          }
+          voxels[id] = static_cast<unsigned short>(
+              std::min(std::max(value, 0.0), 4095.0));
+        }
+      }
+    }
+  });
+  return stack;
+}
+
+double MiB(vtkImageData* image)
+{
+  return image->GetActualMemorySize() / 1024.0;
+}
+} // namespace
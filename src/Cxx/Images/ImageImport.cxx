@@ -28,7 +28,8 @@ int main(int, char*[])
     }
   }
 
-  // Convert the c-style image to a vtkImageData
+  // Convert the c-style image to a vtkImageData. The pixels are not copied,
+  // so cImage must outlive the output. See ImageImportExportZeroCopy.
   vtkNew<vtkImageImport> imageImport;
   imageImport->SetDataSpacing(1, 1, 1);
   imageImport->SetDataOrigin(0, 0, 0);
@@ -0,0 +1,351 @@
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkImageExport.h>
+#include <vtkImageImport.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+// The frame buffers of an acquisition system: a ring of equal slots in one
+// allocation, each aligned to Alignment bytes. A frame is written into the
+// oldest free slot, and the slot is free again when it is released.
+class FrameRing
+{
+public:
+  static constexpr std::size_t Alignment = 64;
+
+  FrameRing(int numberOfSlots, std::size_t frameSize);
+
+  // A free slot, or nullptr if all are in use.
+  void* Acquire();
+  void Release(void* slot);
+  int GetNumberOfFreeSlots();
+
+private:
+  std::size_t SlotSize;
+  std::unique_ptr<unsigned char[]> Storage;
+  unsigned char* First = nullptr;
+  std::deque<void*> Free;
+  std::mutex Mutex;
+};
+
+// Makes buffer, owned by someone else, the scalars of image, without
+// copying it. The image's array calls release when VTK frees it, that is
+// when the last image or filter that holds the array lets it go; until then
+// the buffer must not be reused. Returns false, and leaves the image alone,
+// if buffer is not aligned for the scalar type or is already wrapped.
+bool WrapBuffer(void* buffer, int scalarType, int numberOfComponents,
+                int const dimensions[3], std::function<void()> release,
+                vtkImageData* image);
+
+// A pointer to the scalars of an image, for code outside VTK, without
+// copying them. The view holds a reference to the array, so the scalars
+// stay valid when the image is changed or deleted, until the view goes.
+struct ExportedBuffer
+{
+  vtkSmartPointer<vtkDataArray> Owner;
+  void* Data = nullptr;
+  std::size_t Size = 0;
+  // The largest power of two, up to 64, that the address is a multiple of.
+  std::size_t Alignment = 0;
+};
+ExportedBuffer ExportBuffer(vtkImageData* image);
+
+// The largest power of two, up to 64, that pointer is a multiple of.
+std::size_t GetAlignment(void const* pointer);
+
+// Fills a frame of unsigned shorts with a pattern that depends on its
+// number.
+void WriteFrame(void* frame, std::size_t size, int number);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [totalMiB]. That many MiB of 2048^2 unsigned short frames
+  // go from the acquisition ring into VTK and back out.
+  int const width = 2048;
+  int const dimensions[3] = {width, width, 1};
+  std::size_t const frameSize =
+      static_cast<std::size_t>(width) * width * sizeof(unsigned short);
+  double totalMiB = argc > 1 ? std::max(8, std::atoi(argv[1])) : 256;
+  int frames =
+      std::max(1, static_cast<int>(totalMiB * 1048576.0 / frameSize));
+  double gib = static_cast<double>(frames) * frameSize / 1073741824.0;
+  std::cout << frames << " frames of " << width << "^2 unsigned short, "
+            << gib << " GiB" << std::endl;
+
+  FrameRing ring(4, frameSize);
+  for (int slot = 0; slot < 4; ++slot)
+  {
+    void* frame = ring.Acquire();
+    WriteFrame(frame, frameSize, slot);
+    ring.Release(frame);
+  }
+  std::unique_ptr<unsigned char[]> destination(new unsigned char[frameSize]);
+  bool ok = true;
+  vtkNew<vtkTimerLog> timer;
+  auto report = [&](char const* name) {
+    double seconds = timer->GetElapsedTime();
+    std::cout << name << ": " << seconds << " s, " << gib / seconds
+              << " GiB/s, " << 1.0e6 * seconds / frames << " us/frame"
+              << std::endl;
+  };
+
+  // Copying in with vtkImageImport::CopyImportVoidPointer and out with
+  // vtkImageExport::Export.
+  vtkNew<vtkImageImport> importer;
+  importer->SetDataScalarTypeToUnsignedShort();
+  importer->SetNumberOfScalarComponents(1);
+  importer->SetWholeExtent(0, width - 1, 0, width - 1, 0, 0);
+  importer->SetDataExtentToWholeExtent();
+  vtkNew<vtkImageExport> exporter;
+  exporter->SetInputConnection(importer->GetOutputPort());
+  exporter->ImageLowerLeftOn();
+  void* frame = nullptr;
+  timer->StartTimer();
+  for (int f = 0; f < frames; ++f)
+  {
+    frame = ring.Acquire();
+    importer->CopyImportVoidPointer(frame, static_cast<vtkIdType>(frameSize));
+    ring.Release(frame);
+    exporter->Export(destination.get());
+  }
+  timer->StopTimer();
+  report("Copy in and out");
+  if (std::memcmp(frame, destination.get(), frameSize) != 0)
+  {
+    std::cout << "Error: the copied frame differs from the original."
+              << std::endl;
+    ok = false;
+  }
+
+  // vtkImageImport does not copy a buffer given by SetImportVoidPointer,
+  // and vtkImageExport::GetPointerToData gives the input's scalars. The
+  // buffer must outlive the importer's output.
+  timer->StartTimer();
+  for (int f = 0; f < frames; ++f)
+  {
+    frame = ring.Acquire();
+    importer->SetImportVoidPointer(frame);
+    void* exported = exporter->GetPointerToData();
+    void* imported = importer->GetOutput()->GetScalarPointer();
+    ring.Release(frame);
+    if (imported != frame || exported != frame)
+    {
+      std::cout << "Error: vtkImageImport or vtkImageExport copied frame "
+                << f << "." << std::endl;
+      ok = false;
+      break;
+    }
+  }
+  timer->StopTimer();
+  report("vtkImageImport and vtkImageExport without copies");
+
+  // The frame given to VTK with the ring's release, and the scalars taken
+  // out with a reference. The slot goes back to the ring when both the
+  // image and the view are gone.
+  int released = 0;
+  timer->StartTimer();
+  for (int f = 0; f < frames; ++f)
+  {
+    frame = ring.Acquire();
+    if (!frame)
+    {
+      std::cout << "Error: frame " << f << " found no free slot."
+                << std::endl;
+      ok = false;
+      break;
+    }
+    ExportedBuffer view;
+    {
+      vtkNew<vtkImageData> image;
+      if (!WrapBuffer(frame, VTK_UNSIGNED_SHORT, 1, dimensions,
+                      [&ring, &released, frame]() {
+                        ring.Release(frame);
+                        ++released;
+                      },
+                      image))
+      {
+        std::cout << "Error: frame " << f << " could not be wrapped."
+                  << std::endl;
+        ok = false;
+        ring.Release(frame);
+        break;
+      }
+      view = ExportBuffer(image);
+    }
+    if (view.Data != frame || view.Size != frameSize ||
+        view.Alignment < FrameRing::Alignment)
+    {
+      std::cout << "Error: frame " << f << " was copied." << std::endl;
+      ok = false;
+    }
+    if (released != f)
+    {
+      std::cout << "Error: frame " << f << " was released with the image."
+                << std::endl;
+      ok = false;
+    }
+  }
+  timer->StopTimer();
+  report("Wrapped and exported without copies");
+  if (released != frames || ring.GetNumberOfFreeSlots() != 4)
+  {
+    std::cout << "Error: " << released << " of " << frames
+              << " frames were released." << std::endl;
+    ok = false;
+  }
+
+  vtkNew<vtkImageData> allocated;
+  allocated->SetDimensions(width, width, 1);
+  allocated->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  std::cout << "Scalars allocated by VTK are aligned to "
+            << GetAlignment(allocated->GetScalarPointer()) << " bytes"
+            << std::endl;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+FrameRing::FrameRing(int numberOfSlots, std::size_t frameSize)
+  : SlotSize((frameSize + Alignment - 1) / Alignment * Alignment)
+{
+  this->Storage.reset(
+      new unsigned char[numberOfSlots * this->SlotSize + Alignment]);
+  auto address = reinterpret_cast<std::uintptr_t>(this->Storage.get());
+  this->First = this->Storage.get() +
+      (Alignment - address % Alignment) % Alignment;
+  for (int slot = 0; slot < numberOfSlots; ++slot)
+  {
+    this->Free.push_back(this->First + slot * this->SlotSize);
+  }
+}
+
+void* FrameRing::Acquire()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Free.empty())
+  {
+    return nullptr;
+  }
+  void* slot = this->Free.front();
+  this->Free.pop_front();
+  return slot;
+}
+
+void FrameRing::Release(void* slot)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Free.push_back(slot);
+}
+
+int FrameRing::GetNumberOfFreeSlots()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return static_cast<int>(this->Free.size());
+}
+
+// A free function of an array gets only the pointer, so the release of
+// each wrapped buffer is looked up by it.
+std::mutex WrappedMutex;
+std::map<void*, std::function<void()>> Wrapped;
+
+void ReleaseBuffer(void* buffer)
+{
+  std::function<void()> release;
+  {
+    std::lock_guard<std::mutex> lock(WrappedMutex);
+    auto found = Wrapped.find(buffer);
+    if (found == Wrapped.end())
+    {
+      return;
+    }
+    release = std::move(found->second);
+    Wrapped.erase(found);
+  }
+  if (release)
+  {
+    release();
+  }
+}
+
+bool WrapBuffer(void* buffer, int scalarType, int numberOfComponents,
+                int const dimensions[3], std::function<void()> release,
+                vtkImageData* image)
+{
+  vtkSmartPointer<vtkDataArray> scalars;
+  scalars.TakeReference(vtkDataArray::CreateDataArray(scalarType));
+  if (!scalars ||
+      reinterpret_cast<std::uintptr_t>(buffer) %
+              scalars->GetDataTypeSize() !=
+          0)
+  {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(WrappedMutex);
+    if (!Wrapped.emplace(buffer, std::move(release)).second)
+    {
+      return false;
+    }
+  }
+  vtkIdType values = static_cast<vtkIdType>(dimensions[0]) * dimensions[1] *
+      dimensions[2] * numberOfComponents;
+  scalars->SetNumberOfComponents(numberOfComponents);
+  // Not saved: VTK frees the buffer, with our free function.
+  scalars->SetVoidArray(buffer, values, 0,
+                        vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+  scalars->SetArrayFreeFunction(ReleaseBuffer);
+  image->SetDimensions(dimensions[0], dimensions[1], dimensions[2]);
+  image->GetPointData()->SetScalars(scalars);
+  return true;
+}
+
+ExportedBuffer ExportBuffer(vtkImageData* image)
+{
+  ExportedBuffer view;
+  view.Owner = image->GetPointData()->GetScalars();
+  if (view.Owner)
+  {
+    view.Data = view.Owner->GetVoidPointer(0);
+    view.Size = static_cast<std::size_t>(view.Owner->GetNumberOfValues()) *
+        view.Owner->GetDataTypeSize();
+    view.Alignment = GetAlignment(view.Data);
+  }
+  return view;
+}
+
+std::size_t GetAlignment(void const* pointer)
+{
+  auto address = reinterpret_cast<std::uintptr_t>(pointer);
+  std::size_t alignment = 1;
+  while (alignment < 64 && address % (2 * alignment) == 0)
+  {
+    alignment *= 2;
+  }
+  return alignment;
+}
+
+void WriteFrame(void* frame, std::size_t size, int number)
+{
+  auto pixels = static_cast<unsigned short*>(frame);
+  std::size_t count = size / sizeof(unsigned short);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    pixels[i] = static_cast<unsigned short>(i * 7 + number * 1009);
+  }
+}
+} // namespace
@@ -0,0 +1,680 @@
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+int const TileSize = 256;
+
+// A whole slide image, too large to hold, read a tile at a time. Here the
+// tiles are made up: pink tissue with purple nuclei on a pale background,
+// like an H&E stained slide. A real source would decode them from a file.
+class SlideSource
+{
+public:
+  SlideSource(int width, int height) : Width(width), Height(height)
+  {
+  }
+  // Reads full resolution tile (tx, ty) into an RGB image.
+  void ReadTile(int tx, int ty, vtkImageData* tile) const;
+  void Pixel(int x, int y, unsigned char rgb[3]) const;
+
+  int Width;
+  int Height;
+  // The number of full resolution tiles read so far.
+  mutable vtkIdType TilesRead = 0;
+};
+
+// A tiled mipmap of a SlideSource, built lazily. Level 0 is the full
+// resolution and each level halves the one below with a 2 x 2 box
+// filter, down to a level that fits in one tile. A tile is read or built
+// the first time it is asked for, from the four tiles under it, and kept
+// in a cache of bounded size. When the cache is full the least recently
+// used tiles of the finest level are dropped first: a coarse tile is
+// cheap to keep and expensive to rebuild, since it needs every full
+// resolution tile under it.
+class ImagePyramid
+{
+public:
+  ImagePyramid(SlideSource const& source, double cacheMiB);
+
+  int GetNumberOfLevels() const
+  {
+    return static_cast<int>(this->Dimensions.size());
+  }
+  int const* GetLevelDimensions(int level) const
+  {
+    return this->Dimensions[level].data();
+  }
+  vtkSmartPointer<vtkImageData> GetTile(int level, int tx, int ty);
+  double GetCacheMiB() const
+  {
+    return this->CacheBytes / 1048576.0;
+  }
+
+  // The number of tiles of level 1 and up built so far.
+  vtkIdType TilesBuilt = 0;
+
+private:
+  using Key = std::tuple<int, int, int>;
+  struct Entry
+  {
+    vtkSmartPointer<vtkImageData> Tile;
+    std::list<Key>::iterator Position;
+  };
+
+  vtkSmartPointer<vtkImageData> NewTile(int level, int tx, int ty) const;
+  void Shrink(int level, int tx, int ty, vtkImageData* tile);
+  void Evict();
+
+  SlideSource const& Source;
+  double CacheLimit;
+  double CacheBytes = 0.0;
+  std::vector<std::array<int, 2>> Dimensions;
+  std::map<Key, Entry> Tiles;
+  // Tile keys by level, most recently used first.
+  std::vector<std::list<Key>> Recent;
+};
+
+// What an image viewer does to draw a frame: picks the pyramid level for
+// the zoom, fetches the tiles the window overlaps, and samples them.
+// Zoom is window pixels per full resolution pixel.
+class PyramidViewer
+{
+public:
+  PyramidViewer(ImagePyramid& pyramid) : Pyramid(pyramid)
+  {
+  }
+  void Render(double centerX, double centerY, double zoom,
+              vtkImageData* frame);
+  int Level = 0;
+
+private:
+  ImagePyramid& Pyramid;
+};
+
+// Draws a frame from the whole image at full resolution, as
+// vtkImageActor does with the image it is given.
+void RenderFullResolution(vtkImageData* image, double centerX,
+                          double centerY, double zoom, vtkImageData* frame);
+
+vtkSmartPointer<vtkImageData> NewFrame(int width, int height);
+
+// The mean of the full resolution pixels under a pixel of a level.
+void ReferencePixel(SlideSource const& source, int level, int x, int y,
+                    double rgb[3]);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [slideSize [cacheMiB]]. The slide is slideSize^2 RGB.
+  int slideSize = argc > 1 ? std::max(TileSize, std::atoi(argv[1])) : 8192;
+  double cacheMiB = argc > 2 ? std::max(1.0, std::atof(argv[2])) : 128.0;
+  int const windowWidth = 1024;
+  int const windowHeight = 768;
+
+  SlideSource source(slideSize, slideSize);
+  ImagePyramid pyramid(source, cacheMiB);
+  PyramidViewer viewer(pyramid);
+  double slideMiB = 3.0 * slideSize * slideSize / 1048576.0;
+  std::cout << "Slide: " << slideSize << "^2 RGB, " << slideMiB << " MiB, "
+            << pyramid.GetNumberOfLevels() << " levels of " << TileSize
+            << "^2 tiles, " << cacheMiB << " MiB cache" << std::endl;
+
+  // The full resolution image, if it is small enough to hold, as the
+  // viewer examples use it.
+  vtkSmartPointer<vtkImageData> image;
+  vtkNew<vtkTimerLog> timer;
+  if (slideMiB <= 1024.0)
+  {
+    timer->StartTimer();
+    image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(slideSize, slideSize, 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+    auto pixels = static_cast<unsigned char*>(image->GetScalarPointer());
+    int tiles = (slideSize + TileSize - 1) / TileSize;
+    vtkNew<vtkImageData> tile;
+    for (int ty = 0; ty < tiles; ++ty)
+    {
+      for (int tx = 0; tx < tiles; ++tx)
+      {
+        source.ReadTile(tx, ty, tile);
+        int* dims = tile->GetDimensions();
+        auto in = static_cast<unsigned char*>(tile->GetScalarPointer());
+        for (int j = 0; j < dims[1]; ++j)
+        {
+          std::copy_n(in + 3 * j * dims[0], 3 * dims[0],
+                      pixels +
+                          3 * ((ty * TileSize + j) *
+                                   static_cast<vtkIdType>(slideSize) +
+                               tx * TileSize));
+        }
+      }
+    }
+    timer->StopTimer();
+    std::cout << "Full resolution: loaded in " << timer->GetElapsedTime()
+              << " s, " << slideMiB << " MiB" << std::endl;
+    source.TilesRead = 0;
+  }
+  else
+  {
+    std::cout << "Full resolution: skipped, the slide is over 1 GiB"
+              << std::endl;
+  }
+
+  // A viewing session: open at 1:1 in the middle and pan, zoom out until
+  // the slide fits the window, pan at 1/4 and zoom back in.
+  struct View
+  {
+    double X;
+    double Y;
+    double Zoom;
+  };
+  std::vector<std::pair<std::string, std::vector<View>>> stages;
+  double middle = 0.5 * slideSize;
+  double fit = std::min(static_cast<double>(windowWidth) / slideSize,
+                        static_cast<double>(windowHeight) / slideSize);
+  std::vector<View> views;
+  for (int frame = 0; frame < 20; ++frame)
+  {
+    views.push_back({middle + 64.0 * frame, middle + 16.0 * frame, 1.0});
+  }
+  stages.emplace_back("Pan at 1:1", views);
+  views.clear();
+  for (double zoom = 1.0; zoom > fit; zoom *= 0.7)
+  {
+    views.push_back({middle, middle, zoom});
+  }
+  views.push_back({middle, middle, fit});
+  stages.emplace_back("Zoom out to fit", views);
+  views.clear();
+  for (int frame = 0; frame < 20; ++frame)
+  {
+    double x = slideSize * (0.2 + 0.03 * frame);
+    views.push_back({x, middle, 0.25});
+  }
+  stages.emplace_back("Pan at 1/4", views);
+  views.clear();
+  for (double zoom = fit; zoom < 1.0; zoom /= 0.7)
+  {
+    views.push_back({middle, middle, zoom});
+  }
+  views.push_back({middle, middle, 1.0});
+  stages.emplace_back("Zoom in", views);
+
+  auto frame = NewFrame(windowWidth, windowHeight);
+  auto reference = NewFrame(windowWidth, windowHeight);
+  bool ok = true;
+  for (auto const& stage : stages)
+  {
+    vtkIdType tilesRead = source.TilesRead;
+    vtkIdType tilesBuilt = pyramid.TilesBuilt;
+    double pyramidTime = 0.0;
+    double slowest = 0.0;
+    double fullTime = 0.0;
+    for (auto const& view : stage.second)
+    {
+      timer->StartTimer();
+      viewer.Render(view.X, view.Y, view.Zoom, frame);
+      timer->StopTimer();
+      pyramidTime += timer->GetElapsedTime();
+      slowest = std::max(slowest, timer->GetElapsedTime());
+      if (image)
+      {
+        timer->StartTimer();
+        RenderFullResolution(image, view.X, view.Y, view.Zoom, reference);
+        timer->StopTimer();
+        fullTime += timer->GetElapsedTime();
+        // At full resolution both must draw the same pixels.
+        if (viewer.Level == 0)
+        {
+          auto a = static_cast<unsigned char*>(frame->GetScalarPointer());
+          auto b = static_cast<unsigned char*>(reference->GetScalarPointer());
+          if (!std::equal(a, a + 3 * windowWidth * windowHeight, b))
+          {
+            std::cout << "Error: a full resolution frame differs."
+                      << std::endl;
+            ok = false;
+          }
+        }
+      }
+    }
+    double frames = static_cast<double>(stage.second.size());
+    std::cout << stage.first << ", " << stage.second.size()
+              << " frames: pyramid " << 1000.0 * pyramidTime / frames
+              << " ms/frame (slowest " << 1000.0 * slowest << "), "
+              << source.TilesRead - tilesRead
+              << " full resolution tiles read, "
+              << pyramid.TilesBuilt - tilesBuilt << " tiles built, "
+              << pyramid.GetCacheMiB() << " MiB cached";
+    if (image)
+    {
+      std::cout << "; full resolution " << 1000.0 * fullTime / frames
+                << " ms/frame";
+    }
+    std::cout << std::endl;
+  }
+
+  // Check pyramid pixels against the mean of the full resolution pixels
+  // under them. Each level rounds to the nearest integer, so a level can
+  // be off by up to a half per level.
+  std::mt19937 random(5u);
+  int differences = 0;
+  for (int sample = 0; sample < 2000; ++sample)
+  {
+    int level = static_cast<int>(random() % pyramid.GetNumberOfLevels());
+    int scale = 1 << level;
+    // Only pixels with all the full resolution pixels under them, so that
+    // the mean is over the same pixels.
+    int width = slideSize / scale;
+    if (width == 0)
+    {
+      continue;
+    }
+    int x = static_cast<int>(random() % width);
+    int y = static_cast<int>(random() % width);
+    auto tile = pyramid.GetTile(level, x / TileSize, y / TileSize);
+    auto pixel = static_cast<unsigned char*>(tile->GetScalarPointer()) +
+        3 * (x % TileSize + (y % TileSize) * tile->GetDimensions()[0]);
+    double expected[3];
+    ReferencePixel(source, level, x, y, expected);
+    for (int c = 0; c < 3; ++c)
+    {
+      differences += std::abs(pixel[c] - expected[c]) > 0.5 * level + 1e-9;
+    }
+  }
+  if (differences > 0)
+  {
+    std::cout << "Error: " << differences
+              << " pyramid samples differ from the full resolution mean."
+              << std::endl;
+    ok = false;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+inline std::uint32_t Hash(std::uint32_t x, std::uint32_t y, std::uint32_t seed)
+{
+  std::uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  h *= 0x297a2d39u;
+  h ^= h >> 15;
+  return h;
+}
+
+// Smooth value noise in [0, 1) with the given lattice spacing.
+inline double Noise(int x, int y, int spacing, std::uint32_t seed)
+{
+  int cx = x / spacing;
+  int cy = y / spacing;
+  double fx = static_cast<double>(x - cx * spacing) / spacing;
+  double fy = static_cast<double>(y - cy * spacing) / spacing;
+  fx = fx * fx * (3.0 - 2.0 * fx);
+  fy = fy * fy * (3.0 - 2.0 * fy);
+  double scale = 1.0 / 4294967296.0;
+  double v00 = Hash(cx, cy, seed) * scale;
+  double v10 = Hash(cx + 1, cy, seed) * scale;
+  double v01 = Hash(cx, cy + 1, seed) * scale;
+  double v11 = Hash(cx + 1, cy + 1, seed) * scale;
+  double v0 = v00 + fx * (v10 - v00);
+  double v1 = v01 + fx * (v11 - v01);
+  return v0 + fy * (v1 - v0);
+}
+
+void SlideSource::Pixel(int x, int y, unsigned char rgb[3]) const
+{
+  double tissue = 0.7 * Noise(x, y, 1024, 1u) + 0.3 * Noise(x, y, 128, 2u);
+  if (tissue < 0.45)
+  {
+    rgb[0] = 240;
+    rgb[1] = 236;
+    rgb[2] = 242;
+    return;
+  }
+  // Eosin, darker where the tissue is denser.
+  double shade = std::min(1.0, (tissue - 0.45) * 4.0);
+  double r = 235.0 - 25.0 * shade;
+  double g = 170.0 - 60.0 * shade;
+  double b = 205.0 - 25.0 * shade;
+  // A nucleus in each 24 pixel cell, with a random position and size.
+  int const cell = 24;
+  int cx = x / cell;
+  int cy = y / cell;
+  std::uint32_t h = Hash(cx, cy, 3u);
+  int nx = cx * cell + 6 + static_cast<int>(h % 12);
+  int ny = cy * cell + 6 + static_cast<int>((h >> 8) % 12);
+  int radius = 3 + static_cast<int>((h >> 16) % 4);
+  int dx = x - nx;
+  int dy = y - ny;
+  if (dx * dx + dy * dy <= radius * radius && (h >> 24) < 200)
+  {
+    // Hematoxylin.
+    r = 95.0;
+    g = 60.0;
+    b = 140.0;
+  }
+  rgb[0] = static_cast<unsigned char>(r);
+  rgb[1] = static_cast<unsigned char>(g);
+  rgb[2] = static_cast<unsigned char>(b);
+}
+
+void SlideSource::ReadTile(int tx, int ty, vtkImageData* tile) const
+{
+  int width = std::min(TileSize, this->Width - tx * TileSize);
+  int height = std::min(TileSize, this->Height - ty * TileSize);
+  tile->SetDimensions(width, height, 1);
+  tile->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  auto pixels = static_cast<unsigned char*>(tile->GetScalarPointer());
+  vtkSMPTools::For(0, height, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType j = begin; j < end; ++j)
+    {
+      for (int i = 0; i < width; ++i)
+      {
+        this->Pixel(tx * TileSize + i, ty * TileSize + static_cast<int>(j),
+                    pixels + 3 * (i + j * width));
+      }
+    }
+  });
+  ++this->TilesRead;
+}
+
+ImagePyramid::ImagePyramid(SlideSource const& source, double cacheMiB)
+  : Source(source), CacheLimit(cacheMiB * 1048576.0)
+{
+  std::array<int, 2> dims = {{source.Width, source.Height}};
+  this->Dimensions.push_back(dims);
+  while (dims[0] > TileSize || dims[1] > TileSize)
+  {
+    dims[0] = (dims[0] + 1) / 2;
+    dims[1] = (dims[1] + 1) / 2;
+    this->Dimensions.push_back(dims);
+  }
+  this->Recent.resize(this->Dimensions.size());
+}
+
+vtkSmartPointer<vtkImageData> ImagePyramid::NewTile(int level, int tx,
+                                                    int ty) const
+{
+  int const* dims = this->Dimensions[level].data();
+  auto tile = vtkSmartPointer<vtkImageData>::New();
+  tile->SetDimensions(std::min(TileSize, dims[0] - tx * TileSize),
+                      std::min(TileSize, dims[1] - ty * TileSize), 1);
+  tile->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  return tile;
+}
+
+vtkSmartPointer<vtkImageData> ImagePyramid::GetTile(int level, int tx, int ty)
+{
+  Key key(level, tx, ty);
+  auto found = this->Tiles.find(key);
+  if (found != this->Tiles.end())
+  {
+    auto& recent = this->Recent[level];
+    recent.splice(recent.begin(), recent, found->second.Position);
+    return found->second.Tile;
+  }
+
+  vtkSmartPointer<vtkImageData> tile;
+  if (level == 0)
+  {
+    tile = vtkSmartPointer<vtkImageData>::New();
+    this->Source.ReadTile(tx, ty, tile);
+  }
+  else
+  {
+    tile = this->NewTile(level, tx, ty);
+    this->Shrink(level, tx, ty, tile);
+    ++this->TilesBuilt;
+  }
+  this->Recent[level].push_front(key);
+  this->Tiles[key] = Entry{tile, this->Recent[level].begin()};
+  int* dims = tile->GetDimensions();
+  this->CacheBytes += 3.0 * dims[0] * dims[1];
+  this->Evict();
+  return tile;
+}
+
+void ImagePyramid::Shrink(int level, int tx, int ty, vtkImageData* tile)
+{
+  // The up to four tiles of the level below.
+  int const* below = this->Dimensions[level - 1].data();
+  int belowTiles[2] = {(below[0] + TileSize - 1) / TileSize,
+                       (below[1] + TileSize - 1) / TileSize};
+  vtkSmartPointer<vtkImageData> children[2][2];
+  for (int cy = 0; cy < 2; ++cy)
+  {
+    for (int cx = 0; cx < 2; ++cx)
+    {
+      if (2 * tx + cx < belowTiles[0] && 2 * ty + cy < belowTiles[1])
+      {
+        children[cy][cx] = this->GetTile(level - 1, 2 * tx + cx, 2 * ty + cy);
+      }
+    }
+  }
+
+  int* dims = tile->GetDimensions();
+  auto out = static_cast<unsigned char*>(tile->GetScalarPointer());
+  int x0 = 2 * tx * TileSize;
+  int y0 = 2 * ty * TileSize;
+  vtkSMPTools::For(0, dims[1], [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType j = begin; j < end; ++j)
+    {
+      for (int i = 0; i < dims[0]; ++i)
+      {
+        int sum[3] = {0, 0, 0};
+        int count = 0;
+        for (int y = 2 * static_cast<int>(j); y < 2 * j + 2; ++y)
+        {
+          for (int x = 2 * i; x < 2 * i + 2; ++x)
+          {
+            if (x0 + x >= below[0] || y0 + y >= below[1])
+            {
+              continue;
+            }
+            vtkImageData* child = children[y / TileSize][x / TileSize];
+            int width = child->GetDimensions()[0];
+            auto in = static_cast<unsigned char*>(child->GetScalarPointer()) +
+                3 * (x % TileSize + (y % TileSize) * width);
+            for (int c = 0; c < 3; ++c)
+            {
+              sum[c] += in[c];
+            }
+            ++count;
+          }
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+          out[3 * (i + j * dims[0]) + c] =
+              static_cast<unsigned char>((sum[c] + count / 2) / count);
+        }
+      }
+    }
+  });
+}
+
+void ImagePyramid::Evict()
+{
+  for (std::size_t level = 0;
+       level < this->Recent.size() && this->CacheBytes > this->CacheLimit;
+       ++level)
+  {
+    auto& recent = this->Recent[level];
+    while (!recent.empty() && this->CacheBytes > this->CacheLimit)
+    {
+      auto found = this->Tiles.find(recent.back());
+      int* dims = found->second.Tile->GetDimensions();
+      this->CacheBytes -= 3.0 * dims[0] * dims[1];
+      this->Tiles.erase(found);
+      recent.pop_back();
+    }
+  }
+}
+
+void PyramidViewer::Render(double centerX, double centerY, double zoom,
+                           vtkImageData* frame)
+{
+  int levels = this->Pyramid.GetNumberOfLevels();
+  // The finest level with at most one of its pixels per window pixel.
+  int level = zoom >= 1.0 ? 0 : static_cast<int>(std::log2(1.0 / zoom));
+  level = std::min(level, levels - 1);
+  this->Level = level;
+  int const* dims = this->Pyramid.GetLevelDimensions(level);
+  double scale = 1 << level;
+
+  int* size = frame->GetDimensions();
+  // Level pixel coordinates of the window's left and top edges, and the
+  // level pixels per window pixel.
+  double step = 1.0 / (zoom * scale);
+  double left = (centerX - 0.5 * size[0] / zoom) / scale;
+  double top = (centerY - 0.5 * size[1] / zoom) / scale;
+
+  // Fetch the tiles the window overlaps.
+  int first[2];
+  int last[2];
+  double low[2] = {left, top};
+  for (int a = 0; a < 2; ++a)
+  {
+    double high = low[a] + size[a] * step;
+    first[a] = std::max(0, static_cast<int>(std::floor(low[a])) / TileSize);
+    last[a] = std::min((dims[a] - 1) / TileSize,
+                       static_cast<int>(std::floor(high)) / TileSize);
+  }
+  int columns = std::max(0, last[0] - first[0] + 1);
+  int rows = std::max(0, last[1] - first[1] + 1);
+  std::vector<vtkSmartPointer<vtkImageData>> tiles(columns * rows);
+  for (int ty = 0; ty < rows; ++ty)
+  {
+    for (int tx = 0; tx < columns; ++tx)
+    {
+      tiles[tx + ty * columns] =
+          this->Pyramid.GetTile(level, first[0] + tx, first[1] + ty);
+    }
+  }
+
+  // Every row samples the same columns: look up their tile and offset
+  // once. A column outside the level has tile -1.
+  std::vector<int> columnTile(size[0]);
+  std::vector<int> columnOffset(size[0]);
+  for (int i = 0; i < size[0]; ++i)
+  {
+    double x = std::floor(left + (i + 0.5) * step);
+    bool inside = x >= 0.0 && x < dims[0];
+    int lx = inside ? static_cast<int>(x) : 0;
+    columnTile[i] = inside ? lx / TileSize - first[0] : -1;
+    columnOffset[i] = 3 * (lx % TileSize);
+  }
+
+  auto out = static_cast<unsigned char*>(frame->GetScalarPointer());
+  vtkSMPTools::For(0, size[1], [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType j = begin; j < end; ++j)
+    {
+      unsigned char* row = out + 3 * j * size[0];
+      double y = std::floor(top + (j + 0.5) * step);
+      if (y < 0.0 || y >= dims[1])
+      {
+        std::fill(row, row + 3 * size[0], 0);
+        continue;
+      }
+      int ly = static_cast<int>(y);
+      int tileRow = ly / TileSize - first[1];
+      // The start of this row in each tile of the tile row.
+      std::vector<unsigned char const*> rows(columns);
+      for (int t = 0; t < columns; ++t)
+      {
+        vtkImageData* tile = tiles[t + tileRow * columns];
+        rows[t] = static_cast<unsigned char*>(tile->GetScalarPointer()) +
+            3 * (ly % TileSize) * tile->GetDimensions()[0];
+      }
+      for (int i = 0; i < size[0]; ++i)
+      {
+        if (columnTile[i] < 0)
+        {
+          row[3 * i] = row[3 * i + 1] = row[3 * i + 2] = 0;
+          continue;
+        }
+        std::copy_n(rows[columnTile[i]] + columnOffset[i], 3, row + 3 * i);
+      }
+    }
+  });
+}
+
+void RenderFullResolution(vtkImageData* image, double centerX,
+                          double centerY, double zoom, vtkImageData* frame)
+{
+  int* dims = image->GetDimensions();
+  int* size = frame->GetDimensions();
+  double step = 1.0 / zoom;
+  double left = centerX - 0.5 * size[0] / zoom;
+  double top = centerY - 0.5 * size[1] / zoom;
+  auto in = static_cast<unsigned char*>(image->GetScalarPointer());
+  auto out = static_cast<unsigned char*>(frame->GetScalarPointer());
+  vtkSMPTools::For(0, size[1], [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType j = begin; j < end; ++j)
+    {
+      unsigned char* row = out + 3 * j * size[0];
+      double y = std::floor(top + (j + 0.5) * step);
+      for (int i = 0; i < size[0]; ++i)
+      {
+        double x = std::floor(left + (i + 0.5) * step);
+        if (x < 0.0 || x >= dims[0] || y < 0.0 || y >= dims[1])
+        {
+          row[3 * i] = row[3 * i + 1] = row[3 * i + 2] = 0;
+          continue;
+        }
+        std::copy_n(in + 3 * (static_cast<vtkIdType>(y) * dims[0] +
+                              static_cast<vtkIdType>(x)),
+                    3, row + 3 * i);
+      }
+    }
+  });
+}
+
+vtkSmartPointer<vtkImageData> NewFrame(int width, int height)
+{
+  auto frame = vtkSmartPointer<vtkImageData>::New();
+  frame->SetDimensions(width, height, 1);
+  frame->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  return frame;
+}
+
+void ReferencePixel(SlideSource const& source, int level, int x, int y,
+                    double rgb[3])
+{
+  int scale = 1 << level;
+  double sum[3] = {0.0, 0.0, 0.0};
+  for (int j = 0; j < scale; ++j)
+  {
+    for (int i = 0; i < scale; ++i)
+    {
+      unsigned char pixel[3];
+      source.Pixel(x * scale + i, y * scale + j, pixel);
+      for (int c = 0; c < 3; ++c)
+      {
+        sum[c] += pixel[c];
+      }
+    }
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    rgb[c] = sum[c] / (scale * scale);
+  }
+}
+} // namespace
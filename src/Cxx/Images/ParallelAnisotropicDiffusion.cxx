@@ -0,0 +1,578 @@
+#include <vtkImageAnisotropicDiffusion2D.h>
+#include <vtkImageAnisotropicDiffusion3D.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+// Edge preserving smoothing by anisotropic diffusion (Perona and Malik).
+// Each iteration moves every voxel towards its six face neighbors, by a
+// conductance that falls with the difference between them, so that noise
+// is smoothed and edges are kept:
+//
+//   v += factor * sum over neighbors of w g(|n - v| / h) (n - v)
+//
+// where h is the spacing along the neighbor's axis and the weights w,
+// proportional to 1 / h^2, add up to 1. With a factor of at most 1 the
+// new value lies between the old values of the neighborhood.
+//
+// Each iteration is a single sweep that computes the differences, the
+// conductances and the update together, from one float buffer into
+// another, and the buffers then swap. The rows are split among the
+// threads. A thread computes each flux between two voxels once and keeps
+// it for the second voxel: along x in a register, along y in a row and
+// along z in a slice of fluxes, so only the fluxes across the ends of a
+// thread's rows are computed twice.
+class AnisotropicDiffusion
+{
+public:
+  enum ConductanceType
+  {
+    // g = 1 when the gradient is under the threshold and 0 otherwise, as
+    // vtkImageAnisotropicDiffusion3D.
+    Threshold,
+    // g = exp(-(gradient / threshold)^2).
+    Exponential
+  };
+
+  void SetConductance(ConductanceType conductance)
+  {
+    this->Conductance = conductance;
+  }
+  void SetDiffusionThreshold(double threshold)
+  {
+    this->DiffusionThreshold = threshold;
+  }
+  void SetDiffusionFactor(double factor)
+  {
+    this->DiffusionFactor = factor;
+  }
+  void SetNumberOfIterations(int iterations)
+  {
+    this->NumberOfIterations = iterations;
+  }
+
+  // Smooths input, of any scalar type, into output, which is float.
+  void Execute(vtkImageData* input, vtkImageData* output);
+
+private:
+  ConductanceType Conductance = Exponential;
+  double DiffusionThreshold = 5.0;
+  double DiffusionFactor = 1.0;
+  int NumberOfIterations = 4;
+};
+
+// The textbook way, one voxel at a time: a pass that computes the fluxes
+// through the faces of every voxel into three temporary images, then a
+// pass that updates the voxels from them.
+void SerialDiffusion(vtkImageData* input, vtkImageData* output,
+                     AnisotropicDiffusion::ConductanceType conductance,
+                     double threshold, double factor, int iterations);
+
+// A CT-like volume, or a slice if depth is 1: a body with organs and
+// small bright vessels, and optionally Gaussian noise.
+void MakePhantom(vtkImageData* image, int width, int depth, double noise);
+
+// The root mean square difference between two float images.
+double RmsDifference(vtkImageData* a, vtkImageData* b);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [dimension [iterations]]. The volume is dimension^3 voxels.
+  int dimension = argc > 1 ? std::max(8, std::atoi(argv[1])) : 128;
+  int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+  int maximumThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  double const threshold = 100.0;
+  double const factor = 0.8;
+  double const noise = 40.0;
+
+  vtkNew<vtkImageData> clean;
+  MakePhantom(clean, dimension, dimension, 0.0);
+  vtkNew<vtkImageData> noisy;
+  MakePhantom(noisy, dimension, dimension, noise);
+  double voxels = static_cast<double>(dimension) * dimension * dimension;
+  std::cout << "Volume: " << dimension << "^3 float, " << iterations
+            << " iterations, noise " << RmsDifference(noisy, clean)
+            << std::endl;
+
+  vtkNew<vtkTimerLog> timer;
+  auto report = [&](char const* name, vtkImageData* result) {
+    double seconds = timer->GetElapsedTime();
+    std::cout << name << ": " << iterations / seconds << " iterations/s, "
+              << 1.0e-6 * voxels * iterations / seconds
+              << " Mvoxels/s, error " << RmsDifference(result, clean)
+              << std::endl;
+  };
+
+  vtkNew<vtkImageAnisotropicDiffusion3D> vtkDiffusion;
+  vtkDiffusion->SetInputData(noisy);
+  vtkDiffusion->SetNumberOfIterations(iterations);
+  vtkDiffusion->SetDiffusionThreshold(threshold);
+  vtkDiffusion->SetDiffusionFactor(factor);
+  vtkDiffusion->FacesOn();
+  vtkDiffusion->EdgesOff();
+  vtkDiffusion->CornersOff();
+  vtkDiffusion->GradientMagnitudeThresholdOff();
+  timer->StartTimer();
+  vtkDiffusion->Update();
+  timer->StopTimer();
+  report("vtkImageAnisotropicDiffusion3D", vtkDiffusion->GetOutput());
+
+  // The reference for the checks.
+  AnisotropicDiffusion::ConductanceType const conductances[2] = {
+      AnisotropicDiffusion::Threshold, AnisotropicDiffusion::Exponential};
+  char const* const names[2] = {"threshold", "exponential"};
+  vtkNew<vtkImageData> references[2];
+  for (int c = 0; c < 2; ++c)
+  {
+    timer->StartTimer();
+    SerialDiffusion(noisy, references[c], conductances[c], threshold, factor,
+                    iterations);
+    timer->StopTimer();
+    std::string name = std::string("Serial, unfused, ") + names[c];
+    report(name.c_str(), references[c]);
+  }
+
+  bool ok = true;
+  auto check = [&](vtkImageData* result, vtkImageData* reference,
+                   char const* what) {
+    double difference = RmsDifference(result, reference);
+    if (!(difference < 1.0e-3))
+    {
+      std::cout << "Error: " << what << " differs from the serial diffusion"
+                << " by " << difference << std::endl;
+      ok = false;
+    }
+  };
+
+  vtkNew<vtkImageData> smoothed;
+  for (int c = 0; c < 2; ++c)
+  {
+    AnisotropicDiffusion diffusion;
+    diffusion.SetConductance(conductances[c]);
+    diffusion.SetDiffusionThreshold(threshold);
+    diffusion.SetDiffusionFactor(factor);
+    diffusion.SetNumberOfIterations(iterations);
+    for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+    {
+      vtkSMPTools::Initialize(threads);
+      timer->StartTimer();
+      diffusion.Execute(noisy, smoothed);
+      timer->StopTimer();
+      std::string name = std::string("Fused, ") + names[c] + ", " +
+          std::to_string(threads) + " threads";
+      report(name.c_str(), smoothed);
+      check(smoothed, references[c], name.c_str());
+      if (threads == maximumThreads)
+      {
+        break;
+      }
+    }
+  }
+
+  // A 2D image, as ImageAnisotropicDiffusion2D smooths.
+  int const width = 1024;
+  MakePhantom(clean, width, 1, 0.0);
+  MakePhantom(noisy, width, 1, noise);
+  voxels = static_cast<double>(width) * width;
+  std::cout << "Image: " << width << "^2 float" << std::endl;
+  vtkNew<vtkImageAnisotropicDiffusion2D> vtkDiffusion2D;
+  vtkDiffusion2D->SetInputData(noisy);
+  vtkDiffusion2D->SetNumberOfIterations(iterations);
+  vtkDiffusion2D->SetDiffusionThreshold(threshold);
+  vtkDiffusion2D->SetDiffusionFactor(factor);
+  vtkDiffusion2D->FacesOn();
+  vtkDiffusion2D->EdgesOff();
+  vtkDiffusion2D->CornersOff();
+  vtkDiffusion2D->GradientMagnitudeThresholdOff();
+  timer->StartTimer();
+  vtkDiffusion2D->Update();
+  timer->StopTimer();
+  report("vtkImageAnisotropicDiffusion2D", vtkDiffusion2D->GetOutput());
+
+  SerialDiffusion(noisy, references[1], AnisotropicDiffusion::Exponential,
+                  threshold, factor, iterations);
+  AnisotropicDiffusion diffusion;
+  diffusion.SetDiffusionThreshold(threshold);
+  diffusion.SetDiffusionFactor(factor);
+  diffusion.SetNumberOfIterations(iterations);
+  timer->StartTimer();
+  diffusion.Execute(noisy, smoothed);
+  timer->StopTimer();
+  report("Fused, exponential", smoothed);
+  check(smoothed, references[1], "The 2D diffusion");
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+// The flux w g(|b - a| / h) (b - a) from voxel a to its neighbor b along
+// an axis. Scale is 1 / (h threshold), and the weight includes the
+// diffusion factor.
+struct ThresholdFlux
+{
+  float Weight[3];
+  float Scale[3];
+
+  float operator()(float a, float b, int axis) const
+  {
+    float difference = b - a;
+    return std::abs(difference * this->Scale[axis]) < 1.0f
+        ? this->Weight[axis] * difference
+        : 0.0f;
+  }
+};
+
+struct ExponentialFlux
+{
+  float Weight[3];
+  float Scale[3];
+
+  float operator()(float a, float b, int axis) const
+  {
+    float difference = b - a;
+    float t = difference * this->Scale[axis];
+    return this->Weight[axis] * std::exp(-t * t) * difference;
+  }
+};
+
+// The fluxes a thread keeps for the next row and the next slice.
+struct FluxScratch
+{
+  std::vector<float> Row;
+  std::vector<float> Slice;
+};
+
+// One iteration on rows [begin, end), numbered j + k dims[1].
+template <typename Flux>
+void DiffuseRows(float const* in, float* out, int const dims[3],
+                 Flux const& flux, vtkIdType begin, vtkIdType end,
+                 FluxScratch& scratch)
+{
+  int nx = dims[0];
+  int ny = dims[1];
+  int nz = dims[2];
+  vtkIdType sliceSize = static_cast<vtkIdType>(nx) * ny;
+  scratch.Row.resize(nx);
+  scratch.Slice.resize(nz > 1 ? sliceSize : 0);
+  float* below = scratch.Row.data();
+  for (vtkIdType r = begin; r < end; ++r)
+  {
+    int j = static_cast<int>(r % ny);
+    int k = static_cast<int>(r / ny);
+    float const* p = in + r * nx;
+    float* o = out + r * nx;
+    // The fluxes through the lower faces were computed for the previous
+    // row and slice if this thread did them.
+    bool haveBelow = j > 0;
+    bool keptBelow = haveBelow && r - 1 >= begin;
+    bool haveAbove = j < ny - 1;
+    bool haveBehind = k > 0;
+    bool keptBehind = haveBehind && r - ny >= begin;
+    bool haveFront = k < nz - 1;
+    float* behind = nz > 1 ? scratch.Slice.data() + j * nx : nullptr;
+    float left = 0.0f;
+    for (int i = 0; i < nx; ++i)
+    {
+      float v = p[i];
+      float sum = -left;
+      if (i < nx - 1)
+      {
+        left = flux(v, p[i + 1], 0);
+        sum += left;
+      }
+      if (haveBelow)
+      {
+        sum -= keptBelow ? below[i] : flux(p[i - nx], v, 1);
+      }
+      if (haveAbove)
+      {
+        below[i] = flux(v, p[i + nx], 1);
+        sum += below[i];
+      }
+      if (haveBehind)
+      {
+        sum -= keptBehind ? behind[i] : flux(p[i - sliceSize], v, 2);
+      }
+      if (haveFront)
+      {
+        behind[i] = flux(v, p[i + sliceSize], 2);
+        sum += behind[i];
+      }
+      o[i] = v + sum;
+    }
+  }
+}
+
+// The flux weights and scales of an image.
+template <typename Flux>
+Flux MakeFlux(vtkImageData* image, double threshold, double factor)
+{
+  int dims[3];
+  image->GetDimensions(dims);
+  double spacing[3];
+  image->GetSpacing(spacing);
+  double total = 0.0;
+  for (int a = 0; a < 3; ++a)
+  {
+    total += dims[a] > 1 ? 2.0 / (spacing[a] * spacing[a]) : 0.0;
+  }
+  Flux flux;
+  for (int a = 0; a < 3; ++a)
+  {
+    flux.Weight[a] = static_cast<float>(
+        total > 0.0 ? factor / (spacing[a] * spacing[a] * total) : 0.0);
+    flux.Scale[a] = static_cast<float>(1.0 / (spacing[a] * threshold));
+  }
+  return flux;
+}
+
+template <typename Flux>
+void Diffuse(std::vector<float>& values, int const dims[3], Flux const& flux,
+             int iterations)
+{
+  std::vector<float> next(values.size());
+  vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+  vtkSMPThreadLocal<FluxScratch> scratches;
+  for (int iteration = 0; iteration < iterations; ++iteration)
+  {
+    float const* in = values.data();
+    float* out = next.data();
+    vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+      DiffuseRows(in, out, dims, flux, begin, end, scratches.Local());
+    });
+    values.swap(next);
+  }
+}
+
+template <typename T>
+void ToFloat(T const* scalars, vtkIdType count, float* values)
+{
+  vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      values[i] = static_cast<float>(scalars[i]);
+    }
+  });
+}
+
+// The scalars of an image, as floats.
+std::vector<float> GetValues(vtkImageData* image)
+{
+  int dims[3];
+  image->GetDimensions(dims);
+  vtkIdType count = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  std::vector<float> values(count);
+  void const* scalars = image->GetScalarPointer();
+  switch (image->GetScalarType())
+  {
+    vtkTemplateMacro(
+        ToFloat(static_cast<VTK_TT const*>(scalars), count, values.data()));
+  }
+  return values;
+}
+
+void SetValues(std::vector<float> const& values, vtkImageData* input,
+               vtkImageData* output)
+{
+  output->SetDimensions(input->GetDimensions());
+  output->SetSpacing(input->GetSpacing());
+  output->SetOrigin(input->GetOrigin());
+  output->AllocateScalars(VTK_FLOAT, 1);
+  std::copy(values.begin(), values.end(),
+            static_cast<float*>(output->GetScalarPointer()));
+}
+
+void AnisotropicDiffusion::Execute(vtkImageData* input, vtkImageData* output)
+{
+  int dims[3];
+  input->GetDimensions(dims);
+  std::vector<float> values = GetValues(input);
+  if (this->Conductance == Threshold)
+  {
+    Diffuse(values, dims,
+            MakeFlux<ThresholdFlux>(input, this->DiffusionThreshold,
+                                    this->DiffusionFactor),
+            this->NumberOfIterations);
+  }
+  else
+  {
+    Diffuse(values, dims,
+            MakeFlux<ExponentialFlux>(input, this->DiffusionThreshold,
+                                      this->DiffusionFactor),
+            this->NumberOfIterations);
+  }
+  SetValues(values, input, output);
+}
+
+template <typename Flux>
+void SerialDiffuse(std::vector<float>& values, int const dims[3],
+                   Flux const& flux, int iterations)
+{
+  vtkIdType strides[3] = {1, dims[0],
+                          static_cast<vtkIdType>(dims[0]) * dims[1]};
+  std::vector<float> fluxes[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    fluxes[a].assign(values.size(), 0.0f);
+  }
+  for (int iteration = 0; iteration < iterations; ++iteration)
+  {
+    // The flux through the upper face of every voxel along each axis.
+    vtkIdType id = 0;
+    for (int k = 0; k < dims[2]; ++k)
+    {
+      for (int j = 0; j < dims[1]; ++j)
+      {
+        for (int i = 0; i < dims[0]; ++i, ++id)
+        {
+          int index[3] = {i, j, k};
+          for (int a = 0; a < 3; ++a)
+          {
+            fluxes[a][id] = index[a] < dims[a] - 1
+                ? flux(values[id], values[id + strides[a]], a)
+                : 0.0f;
+          }
+        }
+      }
+    }
+    // In through the upper faces, out through the lower ones.
+    id = 0;
+    for (int k = 0; k < dims[2]; ++k)
+    {
+      for (int j = 0; j < dims[1]; ++j)
+      {
+        for (int i = 0; i < dims[0]; ++i, ++id)
+        {
+          int index[3] = {i, j, k};
+          float sum = 0.0f;
+          for (int a = 0; a < 3; ++a)
+          {
+            sum += fluxes[a][id];
+            if (index[a] > 0)
+            {
+              sum -= fluxes[a][id - strides[a]];
+            }
+          }
+          values[id] += sum;
+        }
+      }
+    }
+  }
+}
+
+void SerialDiffusion(vtkImageData* input, vtkImageData* output,
+                     AnisotropicDiffusion::ConductanceType conductance,
+                     double threshold, double factor, int iterations)
+{
+  int dims[3];
+  input->GetDimensions(dims);
+  std::vector<float> values = GetValues(input);
+  if (conductance == AnisotropicDiffusion::Threshold)
+  {
+    SerialDiffuse(values, dims,
+                  MakeFlux<ThresholdFlux>(input, threshold, factor),
+                  iterations);
+  }
+  else
+  {
+    SerialDiffuse(values, dims,
+                  MakeFlux<ExponentialFlux>(input, threshold, factor),
+                  iterations);
+  }
+  SetValues(values, input, output);
+}
+
+void MakePhantom(vtkImageData* image, int width, int depth, double noise)
+{
+  image->SetDimensions(width, width, depth);
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto voxels = static_cast<float*>(image->GetScalarPointer());
+  vtkSMPTools::For(0, depth, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      // Each slice has its own noise, so that the phantom does not depend
+      // on the threads.
+      std::mt19937 random(static_cast<unsigned>(1234 + k));
+      std::normal_distribution<float> gaussian(0.0f, 1.0f);
+      double z = depth > 1 ? (k + 0.5) / depth - 0.5 : 0.0;
+      for (int j = 0; j < width; ++j)
+      {
+        double y = (j + 0.5) / width - 0.5;
+        for (int i = 0; i < width; ++i)
+        {
+          double x = (i + 0.5) / width - 0.5;
+          double value = 0.0;
+          // The body, two organs and a lesion.
+          if (x * x / 0.18 + y * y / 0.12 + z * z / 0.2 < 1.0)
+          {
+            value = 400.0;
+          }
+          double dx = x + 0.15;
+          if (dx * dx + y * y + z * z < 0.02)
+          {
+            value = 700.0;
+          }
+          dx = x - 0.17;
+          double dy = y - 0.05;
+          if (dx * dx + dy * dy + z * z < 0.012)
+          {
+            value = 550.0;
+            dx -= 0.03;
+            if (dx * dx + dy * dy + z * z < 0.001)
+            {
+              value = 1000.0;
+            }
+          }
+          // Thin vessels along z.
+          for (int v = 0; v < 4; ++v)
+          {
+            dx = x - (-0.2 + 0.12 * v);
+            dy = y + 0.2;
+            if (dx * dx + dy * dy < 0.0002 * (v + 1))
+            {
+              value = 900.0;
+            }
+          }
+          if (noise > 0.0)
+          {
+            value += noise * gaussian(random);
+          }
+          voxels[i + width * (j + static_cast<vtkIdType>(width) * k)] =
+              static_cast<float>(value);
+        }
+      }
+    }
+  });
+}
+
+double RmsDifference(vtkImageData* a, vtkImageData* b)
+{
+  int dims[3];
+  a->GetDimensions(dims);
+  vtkIdType count = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  auto p = static_cast<float const*>(a->GetScalarPointer());
+  auto q = static_cast<float const*>(b->GetScalarPointer());
+  double sum = 0.0;
+  for (vtkIdType i = 0; i < count; ++i)
+  {
+    double difference = p[i] - q[i];
+    sum += difference * difference;
+  }
+  return count > 0 ? std::sqrt(sum / count) : 0.0;
+}
+} // namespace
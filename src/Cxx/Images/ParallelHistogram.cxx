@@ -0,0 +1,605 @@
+#include <vtkImageAccumulate.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+// The count, range, mean and spread of a set of voxels, and their
+// histogram. M2 is the sum of squared differences from the mean, which
+// merges without the cancellation of a sum of squares.
+struct ImageStatistics
+{
+  vtkIdType Count = 0;
+  double Min = std::numeric_limits<double>::max();
+  double Max = std::numeric_limits<double>::lowest();
+  double Mean = 0.0;
+  double M2 = 0.0;
+  std::vector<vtkIdType> Histogram;
+
+  double GetStandardDeviation() const
+  {
+    return this->Count > 0 ? std::sqrt(this->M2 / this->Count) : 0.0;
+  }
+  // Adds the voxels of other, with the pairwise update of Chan et al.
+  void Merge(ImageStatistics const& other);
+};
+
+// What one thread has counted. For 8 and 16 bit integers it is just the
+// number of voxels of each value, and the histogram and statistics are
+// computed from that at the end.
+struct ThreadPart
+{
+  ImageStatistics Statistics;
+  std::vector<vtkIdType> ValueCounts;
+  double Lowest = 0.0;
+};
+using ThreadStatistics = vtkSMPThreadLocal<ThreadPart>;
+
+// Computes the histogram and statistics of an image in one parallel
+// pass. Each thread counts into its own histogram, so the threads never
+// write the same bins. The image can be given a piece at a time, for
+// example the slabs of a volume that is read in pieces. The threads keep
+// their counts from piece to piece, and they are added only when the
+// statistics are asked for.
+//
+// The voxels of 8 and 16 bit integer images are counted by value, which
+// is a single increment per voxel. The bins, range, mean and deviation
+// are computed from the value counts afterwards, with exact sums.
+class HistogramAccumulator
+{
+public:
+  HistogramAccumulator()
+  {
+    this->Reset();
+  }
+
+  // The bins are as vtkImageAccumulate's component origin, spacing and
+  // extent: bin i counts values in [origin + i spacing, origin +
+  // (i + 1) spacing). Values outside all bins are not counted, but are in
+  // the statistics.
+  void SetBins(double origin, double spacing, int numberOfBins);
+  void Reset();
+  void Add(vtkImageData* piece);
+  ImageStatistics const& GetStatistics();
+
+  double Origin = 0.0;
+  double Spacing = 1.0;
+  int NumberOfBins = 256;
+
+private:
+  ImageStatistics Total;
+  std::unique_ptr<ThreadStatistics> Locals;
+};
+
+// One voxel at a time into a single histogram, as a plain loop over the
+// scalars would. The statistics use a sum and a sum of squares of the
+// differences from origin.
+void SerialStatistics(vtkImageData* piece, double origin, double spacing,
+                      ImageStatistics& statistics, double& sum,
+                      double& sumOfSquares);
+
+// The value below which the given fraction of the counted voxels lie.
+double Percentile(ImageStatistics const& statistics, double origin,
+                  double spacing, double fraction);
+
+// Slices [firstSlice, firstSlice + slices) of a 12-bit CT-like volume.
+void FillSlab(vtkImageData* slab, int dimension, int firstSlice, int slices);
+
+// The voxels of slab as floats, value / 4 + 10^6: fractional values with
+// a mean far from zero, where a sum of squares loses the deviation.
+void MakeFloatSlab(vtkImageData* slab, vtkImageData* floatSlab);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [dimension [slabDepth]]. The volume is dimension^3
+  // unsigned short voxels, made and processed slabDepth slices at a time.
+  int dimension = argc > 1 ? std::max(16, std::atoi(argv[1])) : 256;
+  int slabDepth = argc > 2 ? std::max(1, std::atoi(argv[2])) : 16;
+  slabDepth = std::min(slabDepth, dimension);
+  double voxels = static_cast<double>(dimension) * dimension * dimension;
+  double volumeGiB = voxels * sizeof(unsigned short) / 1073741824.0;
+  int maximumThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  std::cout << "Volume: " << dimension << "^3 unsigned short, " << volumeGiB
+            << " GiB, streamed in " << slabDepth << " slice slabs"
+            << std::endl;
+
+  // A full histogram of the 16 bit values and a coarse one of 256 bins of
+  // width 256, both counted by value, and 256 bins of the float volume,
+  // which takes the general binning path row by row.
+  struct Binning
+  {
+    char const* Name;
+    double Origin;
+    double Spacing;
+    int NumberOfBins;
+    bool Float;
+  };
+  int const numberOfBinnings = 3;
+  Binning const binnings[numberOfBinnings] = {
+      {"65536 bins", 0.0, 1.0, 65536, false},
+      {"256 bins", 0.0, 256.0, 256, false},
+      {"float, 256 bins", 1.0e6, 4.0, 256, true}};
+
+  // One accumulator per binning and thread count.
+  std::vector<int> threadCounts;
+  for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+  {
+    threadCounts.push_back(threads);
+    if (threads == maximumThreads)
+    {
+      break;
+    }
+  }
+  std::vector<HistogramAccumulator> accumulators(numberOfBinnings *
+                                                 threadCounts.size());
+  std::vector<double> accumulatorTimes(accumulators.size(), 0.0);
+  for (std::size_t a = 0; a < accumulators.size(); ++a)
+  {
+    Binning const& binning = binnings[a / threadCounts.size()];
+    accumulators[a].SetBins(binning.Origin, binning.Spacing,
+                            binning.NumberOfBins);
+  }
+  ImageStatistics serial[numberOfBinnings];
+  double serialSums[numberOfBinnings][2] = {};
+  double serialTimes[numberOfBinnings] = {};
+
+  // vtkImageAccumulate on each slab, with the slab results combined.
+  vtkNew<vtkImageAccumulate> accumulate;
+  std::vector<vtkIdType> vtkHistogram(65536, 0);
+  vtkIdType vtkCount = 0;
+  double vtkSum = 0.0;
+  double vtkSumOfSquares = 0.0;
+  double vtkMin = std::numeric_limits<double>::max();
+  double vtkMax = std::numeric_limits<double>::lowest();
+  double vtkTime = 0.0;
+
+  vtkNew<vtkImageData> slab;
+  vtkNew<vtkImageData> floatSlab;
+  vtkNew<vtkTimerLog> timer;
+  for (int first = 0; first < dimension; first += slabDepth)
+  {
+    int slices = std::min(slabDepth, dimension - first);
+    FillSlab(slab, dimension, first, slices);
+    MakeFloatSlab(slab, floatSlab);
+
+    for (std::size_t a = 0; a < accumulators.size(); ++a)
+    {
+      vtkSMPTools::Initialize(threadCounts[a % threadCounts.size()]);
+      timer->StartTimer();
+      accumulators[a].Add(binnings[a / threadCounts.size()].Float
+                              ? floatSlab.GetPointer()
+                              : slab.GetPointer());
+      timer->StopTimer();
+      accumulatorTimes[a] += timer->GetElapsedTime();
+    }
+    vtkSMPTools::Initialize(maximumThreads);
+
+    for (int b = 0; b < numberOfBinnings; ++b)
+    {
+      if (serial[b].Histogram.empty())
+      {
+        serial[b].Histogram.assign(binnings[b].NumberOfBins, 0);
+      }
+      timer->StartTimer();
+      SerialStatistics(binnings[b].Float ? floatSlab.GetPointer()
+                                         : slab.GetPointer(),
+                       binnings[b].Origin, binnings[b].Spacing, serial[b],
+                       serialSums[b][0], serialSums[b][1]);
+      timer->StopTimer();
+      serialTimes[b] += timer->GetElapsedTime();
+    }
+
+    accumulate->SetInputData(slab);
+    accumulate->SetComponentExtent(0, 65535, 0, 0, 0, 0);
+    accumulate->SetComponentOrigin(0, 0, 0);
+    accumulate->SetComponentSpacing(1, 0, 0);
+    accumulate->Modified();
+    timer->StartTimer();
+    accumulate->Update();
+    timer->StopTimer();
+    vtkTime += timer->GetElapsedTime();
+    auto counts =
+        static_cast<vtkIdType*>(accumulate->GetOutput()->GetScalarPointer());
+    for (int i = 0; i < 65536; ++i)
+    {
+      vtkHistogram[i] += counts[i];
+    }
+    vtkIdType count = accumulate->GetVoxelCount();
+    double mean = accumulate->GetMean()[0];
+    double deviation = accumulate->GetStandardDeviation()[0];
+    vtkCount += count;
+    vtkSum += count * mean;
+    vtkSumOfSquares += count * (deviation * deviation + mean * mean);
+    vtkMin = std::min(vtkMin, accumulate->GetMin()[0]);
+    vtkMax = std::max(vtkMax, accumulate->GetMax()[0]);
+  }
+
+  // Adding up the threads' histograms is part of the cost.
+  for (std::size_t a = 0; a < accumulators.size(); ++a)
+  {
+    timer->StartTimer();
+    accumulators[a].GetStatistics();
+    timer->StopTimer();
+    accumulatorTimes[a] += timer->GetElapsedTime();
+  }
+
+  auto rate = [&](double seconds, bool isFloat) {
+    return voxels * (isFloat ? sizeof(float) : sizeof(unsigned short)) /
+        1073741824.0 / seconds;
+  };
+  for (int b = 0; b < numberOfBinnings; ++b)
+  {
+    std::cout << binnings[b].Name << ", serial loop: " << serialTimes[b]
+              << " s, " << rate(serialTimes[b], binnings[b].Float)
+              << " GiB/s" << std::endl;
+    for (std::size_t t = 0; t < threadCounts.size(); ++t)
+    {
+      double seconds = accumulatorTimes[b * threadCounts.size() + t];
+      std::cout << binnings[b].Name << ", privatized, " << threadCounts[t]
+                << " threads: " << seconds << " s, "
+                << rate(seconds, binnings[b].Float) << " GiB/s" << std::endl;
+    }
+  }
+  std::cout << "65536 bins, vtkImageAccumulate: " << vtkTime << " s, "
+            << rate(vtkTime, false) << " GiB/s" << std::endl;
+
+  // The statistics, and a window from the 1st to the 99th percentile as
+  // auto-windowing would choose it.
+  ImageStatistics const& statistics =
+      accumulators[threadCounts.size() - 1].GetStatistics();
+  double low = Percentile(statistics, 0.0, 1.0, 0.01);
+  double high = Percentile(statistics, 0.0, 1.0, 0.99);
+  std::cout << "Min " << statistics.Min << ", max " << statistics.Max
+            << ", mean " << statistics.Mean << ", standard deviation "
+            << statistics.GetStandardDeviation() << ", window " << high - low
+            << ", level " << 0.5 * (low + high) << std::endl;
+  double vtkMean = vtkSum / vtkCount;
+  std::cout << "vtkImageAccumulate: min " << vtkMin << ", max " << vtkMax
+            << ", mean " << vtkMean << ", standard deviation "
+            << std::sqrt(std::max(0.0, vtkSumOfSquares / vtkCount -
+                                           vtkMean * vtkMean))
+            << ", histogram "
+            << (vtkHistogram == statistics.Histogram ? "equal" : "differs")
+            << std::endl;
+
+  // Every accumulator must agree with the serial loop: exactly on the
+  // counts and range, and to rounding on the mean and deviation.
+  bool ok = true;
+  for (std::size_t a = 0; a < accumulators.size(); ++a)
+  {
+    int b = static_cast<int>(a / threadCounts.size());
+    ImageStatistics const& expected = serial[b];
+    ImageStatistics const& result = accumulators[a].GetStatistics();
+    double shifted = serialSums[b][0] / expected.Count;
+    double mean = binnings[b].Origin + shifted;
+    double deviation = std::sqrt(std::max(
+        0.0, serialSums[b][1] / expected.Count - shifted * shifted));
+    bool same = result.Count == expected.Count &&
+        result.Min == expected.Min && result.Max == expected.Max &&
+        result.Histogram == expected.Histogram &&
+        std::abs(result.Mean - mean) <= 1.0e-9 * std::abs(mean) + 1.0e-9 &&
+        std::abs(result.GetStandardDeviation() - deviation) <=
+            1.0e-6 * deviation + 1.0e-6;
+    if (!same)
+    {
+      std::cout << "Error: " << binnings[b].Name << " with "
+                << threadCounts[a % threadCounts.size()]
+                << " threads differs from the serial loop." << std::endl;
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+void ImageStatistics::Merge(ImageStatistics const& other)
+{
+  if (other.Count == 0)
+  {
+    return;
+  }
+  double n = static_cast<double>(this->Count);
+  double m = static_cast<double>(other.Count);
+  double delta = other.Mean - this->Mean;
+  this->Mean += delta * m / (n + m);
+  this->M2 += other.M2 + delta * delta * n * m / (n + m);
+  this->Count += other.Count;
+  this->Min = std::min(this->Min, other.Min);
+  this->Max = std::max(this->Max, other.Max);
+  if (this->Histogram.size() < other.Histogram.size())
+  {
+    this->Histogram.resize(other.Histogram.size(), 0);
+  }
+  for (std::size_t i = 0; i < other.Histogram.size(); ++i)
+  {
+    this->Histogram[i] += other.Histogram[i];
+  }
+}
+
+// Counts one row into a thread's statistics.
+template <typename T>
+void AccumulateRow(T const* row, int length, double origin, double spacing,
+                   ImageStatistics& local)
+{
+  int bins = static_cast<int>(local.Histogram.size());
+  vtkIdType* histogram = local.Histogram.data();
+  // The sums are of the differences from the first value, which is close
+  // to the mean of a row in any smooth image, so the sum of squares does
+  // not cancel when the values are far from zero.
+  double shift = row[0];
+  double rowMin = row[0];
+  double rowMax = row[0];
+  double sum = 0.0;
+  double sumOfSquares = 0.0;
+  for (int i = 0; i < length; ++i)
+  {
+    double v = row[i];
+    rowMin = std::min(rowMin, v);
+    rowMax = std::max(rowMax, v);
+    sum += v - shift;
+    sumOfSquares += (v - shift) * (v - shift);
+    double bin = std::floor((v - origin) / spacing);
+    if (bin >= 0.0 && bin < bins)
+    {
+      ++histogram[static_cast<int>(bin)];
+    }
+  }
+
+  // The row then merges like any other set.
+  ImageStatistics rowStatistics;
+  rowStatistics.Count = length;
+  rowStatistics.Min = rowMin;
+  rowStatistics.Max = rowMax;
+  rowStatistics.Mean = shift + sum / length;
+  rowStatistics.M2 = std::max(0.0, sumOfSquares - sum * sum / length);
+  local.Merge(rowStatistics);
+}
+
+template <typename T>
+void AccumulatePiece(T const* scalars, int const dims[3], double origin,
+                     double spacing, int numberOfBins, ThreadStatistics& locals)
+{
+  bool byValue = std::numeric_limits<T>::is_integer && sizeof(T) <= 2;
+  std::size_t values = std::size_t(1)
+      << (8 * std::min(sizeof(T), static_cast<std::size_t>(2)));
+  vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    ThreadPart& local = locals.Local();
+    if (byValue)
+    {
+      if (local.ValueCounts.empty())
+      {
+        local.ValueCounts.assign(values, 0);
+        local.Lowest = std::numeric_limits<T>::lowest();
+      }
+      // The rows are contiguous, so count them in one loop.
+      vtkIdType* counts = local.ValueCounts.data();
+      auto lowest = static_cast<long long>(std::numeric_limits<T>::lowest());
+      T const* last = scalars + end * dims[0];
+      for (T const* v = scalars + begin * dims[0]; v < last; ++v)
+      {
+        ++counts[static_cast<long long>(*v) - lowest];
+      }
+      return;
+    }
+    if (local.Statistics.Histogram.empty())
+    {
+      local.Statistics.Histogram.assign(numberOfBins, 0);
+    }
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      AccumulateRow(scalars + r * dims[0], dims[0], origin, spacing,
+                    local.Statistics);
+    }
+  });
+}
+
+// Adds voxels given as the number of each value, lowest + v for count v.
+void MergeValueCounts(std::vector<vtkIdType> const& counts, double lowest,
+                      double origin, double spacing, ImageStatistics& total)
+{
+  ImageStatistics part;
+  int bins = static_cast<int>(total.Histogram.size());
+  part.Histogram.assign(bins, 0);
+  // Each term is an integer, so the sum is exact up to 2^53, which a 16
+  // bit volume passes only beyond 10^11 voxels.
+  double sum = 0.0;
+  for (std::size_t v = 0; v < counts.size(); ++v)
+  {
+    if (counts[v] == 0)
+    {
+      continue;
+    }
+    double value = lowest + v;
+    part.Min = std::min(part.Min, value);
+    part.Max = std::max(part.Max, value);
+    part.Count += counts[v];
+    sum += counts[v] * value;
+    double bin = std::floor((value - origin) / spacing);
+    if (bin >= 0.0 && bin < bins)
+    {
+      part.Histogram[static_cast<int>(bin)] += counts[v];
+    }
+  }
+  if (part.Count == 0)
+  {
+    return;
+  }
+  part.Mean = sum / part.Count;
+  for (std::size_t v = 0; v < counts.size(); ++v)
+  {
+    double d = lowest + v - part.Mean;
+    part.M2 += counts[v] * d * d;
+  }
+  total.Merge(part);
+}
+
+void HistogramAccumulator::SetBins(double origin, double spacing,
+                                   int numberOfBins)
+{
+  this->Origin = origin;
+  this->Spacing = spacing;
+  this->NumberOfBins = numberOfBins;
+  this->Reset();
+}
+
+void HistogramAccumulator::Reset()
+{
+  this->Total = ImageStatistics();
+  this->Total.Histogram.assign(this->NumberOfBins, 0);
+  this->Locals.reset(new ThreadStatistics);
+}
+
+ImageStatistics const& HistogramAccumulator::GetStatistics()
+{
+  for (auto const& local : *this->Locals)
+  {
+    this->Total.Merge(local.Statistics);
+    MergeValueCounts(local.ValueCounts, local.Lowest, this->Origin,
+                     this->Spacing, this->Total);
+  }
+  this->Locals.reset(new ThreadStatistics);
+  return this->Total;
+}
+
+void HistogramAccumulator::Add(vtkImageData* piece)
+{
+  int dims[3];
+  piece->GetDimensions(dims);
+  if (static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2] == 0)
+  {
+    return;
+  }
+  void const* scalars = piece->GetScalarPointer();
+  switch (piece->GetScalarType())
+  {
+    vtkTemplateMacro(AccumulatePiece(static_cast<VTK_TT const*>(scalars),
+                                     dims, this->Origin, this->Spacing,
+                                     this->NumberOfBins, *this->Locals));
+  }
+}
+
+template <typename T>
+void SerialLoop(T const* scalars, vtkIdType count, double origin,
+                double spacing, ImageStatistics& statistics, double& sum,
+                double& sumOfSquares)
+{
+  int bins = static_cast<int>(statistics.Histogram.size());
+  for (vtkIdType i = 0; i < count; ++i)
+  {
+    double v = scalars[i];
+    statistics.Min = std::min(statistics.Min, v);
+    statistics.Max = std::max(statistics.Max, v);
+    sum += v - origin;
+    sumOfSquares += (v - origin) * (v - origin);
+    int bin = static_cast<int>(std::floor((v - origin) / spacing));
+    if (bin >= 0 && bin < bins)
+    {
+      ++statistics.Histogram[bin];
+    }
+  }
+  statistics.Count += count;
+}
+
+void SerialStatistics(vtkImageData* piece, double origin, double spacing,
+                      ImageStatistics& statistics, double& sum,
+                      double& sumOfSquares)
+{
+  int* dims = piece->GetDimensions();
+  vtkIdType count = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  void const* scalars = piece->GetScalarPointer();
+  switch (piece->GetScalarType())
+  {
+    vtkTemplateMacro(SerialLoop(static_cast<VTK_TT const*>(scalars), count,
+                                origin, spacing, statistics, sum,
+                                sumOfSquares));
+  }
+}
+
+double Percentile(ImageStatistics const& statistics, double origin,
+                  double spacing, double fraction)
+{
+  vtkIdType counted = 0;
+  for (auto count : statistics.Histogram)
+  {
+    counted += count;
+  }
+  double target = fraction * counted;
+  vtkIdType below = 0;
+  for (std::size_t i = 0; i < statistics.Histogram.size(); ++i)
+  {
+    below += statistics.Histogram[i];
+    if (below >= target)
+    {
+      return origin + (i + 0.5) * spacing;
+    }
+  }
+  return origin + statistics.Histogram.size() * spacing;
+}
+
+void FillSlab(vtkImageData* slab, int dimension, int firstSlice, int slices)
+{
+  slab->SetDimensions(dimension, dimension, slices);
+  slab->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto voxels = static_cast<unsigned short*>(slab->GetScalarPointer());
+  vtkSMPTools::For(0, slices, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType s = begin; s < end; ++s)
+    {
+      double z = 2.0 * (firstSlice + s) / dimension - 1.0;
+      for (int j = 0; j < dimension; ++j)
+      {
+        double y = 2.0 * j / dimension - 1.0;
+        unsigned short* row = voxels + (s * dimension + j) * dimension;
+        for (int i = 0; i < dimension; ++i)
+        {
+          double x = 2.0 * i / dimension - 1.0;
+          // Air, then soft tissue, then bone in a shell, with noise.
+          double r = std::sqrt(x * x / 0.8 + y * y / 0.6 + z * z);
+          double value = r < 0.9 ? 1040.0 : 60.0;
+          if (r > 0.78 && r < 0.84)
+          {
+            value = 1900.0;
+          }
+          std::uint32_t h = static_cast<std::uint32_t>(i) * 0x9e3779b1u ^
+              static_cast<std::uint32_t>(j) * 0x85ebca77u ^
+              static_cast<std::uint32_t>(firstSlice + s) * 0xc2b2ae3du;
+          h ^= h >> 15;
+          h *= 0x2c1b3c6du;
+          h ^= h >> 12;
+          value += static_cast<double>(h % 61) - 30.0;
+          row[i] = static_cast<unsigned short>(value);
+        }
+      }
+    }
+  });
+}
+
+void MakeFloatSlab(vtkImageData* slab, vtkImageData* floatSlab)
+{
+  int* dims = slab->GetDimensions();
+  floatSlab->SetDimensions(dims);
+  floatSlab->AllocateScalars(VTK_FLOAT, 1);
+  auto in = static_cast<unsigned short const*>(slab->GetScalarPointer());
+  auto out = static_cast<float*>(floatSlab->GetScalarPointer());
+  vtkIdType count = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      out[i] = static_cast<float>(in[i] / 4.0 + 1.0e6);
+    }
+  });
+}
+} // namespace
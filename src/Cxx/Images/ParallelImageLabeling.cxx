@@ -0,0 +1,677 @@
+#include <vtkIdTypeArray.h>
+#include <vtkImageConnectivityFilter.h>
+#include <vtkImageData.h>
+#include <vtkImageIslandRemoval2D.h>
+#include <vtkNew.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace {
+// Labels the face connected components of the voxels of an image whose
+// values are in a range, in parallel. Each row of the image is first cut
+// into runs of foreground voxels. Each run is then joined to the runs it
+// touches in the row below and the slice below, with a lock free
+// union-find, so all rows are processed at once. The components are
+// numbered in scan order, as a serial flood fill would number them, and
+// their voxel counts and bounds come from their runs.
+class ImageLabeling
+{
+public:
+  // Voxels with values in [lower, upper] are foreground, as with
+  // vtkImageConnectivityFilter's scalar range.
+  void SetScalarRange(double lower, double upper)
+  {
+    this->Lower = lower;
+    this->Upper = upper;
+  }
+  void Execute(vtkImageData* image);
+
+  vtkIdType GetNumberOfLabels() const
+  {
+    return static_cast<vtkIdType>(this->Sizes.size());
+  }
+  // The voxel count and the extent of each label, labels from 0.
+  std::vector<vtkIdType> const& GetLabelSizes() const
+  {
+    return this->Sizes;
+  }
+  std::vector<std::array<int, 6>> const& GetLabelExtents() const
+  {
+    return this->Extents;
+  }
+  // An int image of the labels from 1, with 0 for the background.
+  void GetLabelImage(vtkImageData* labels) const;
+  // Sets the voxels of components of fewer than minimumSize voxels to
+  // value, in the image that was labeled.
+  void RemoveSmallIslands(vtkImageData* image, vtkIdType minimumSize,
+                          double value) const;
+
+private:
+  vtkIdType Find(vtkIdType x);
+  void Union(vtkIdType a, vtkIdType b);
+  // Joins the overlapping runs of two rows.
+  void JoinRows(vtkIdType row, vtkIdType other);
+
+  double Lower = 0.5;
+  double Upper = std::numeric_limits<double>::max();
+  int Dimensions[3] = {0, 0, 0};
+  // The runs of row r are RowOffsets[r] to RowOffsets[r + 1]. A run is
+  // the foreground voxels [start, end) of its row.
+  std::vector<vtkIdType> RowOffsets;
+  std::vector<std::array<int, 2>> Runs;
+  std::vector<std::atomic<vtkIdType>> Parents;
+  std::vector<vtkIdType> RunLabels;
+  std::vector<vtkIdType> Sizes;
+  std::vector<std::array<int, 6>> Extents;
+};
+
+// Labels by a serial flood fill, one voxel at a time, in scan order.
+vtkIdType FloodFill(vtkImageData* mask, std::vector<int>& labels);
+
+// A binary segmentation with large smooth structures and many specks.
+void MakeMask(vtkImageData* mask, int dimension, int depth);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [dimension [minimumIslandSize]]. The 3D mask is
+  // dimension^3 and the 2D mask (4 dimension)^2.
+  int dimension = argc > 1 ? std::max(8, std::atoi(argv[1])) : 192;
+  vtkIdType minimumSize = argc > 2 ? std::max(1, std::atoi(argv[2])) : 50;
+  int maximumThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+
+  vtkNew<vtkImageData> mask;
+  MakeMask(mask, dimension, dimension);
+  double voxels = static_cast<double>(dimension) * dimension * dimension;
+  std::cout << "3D mask: " << dimension << "^3 unsigned char" << std::endl;
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  vtkNew<vtkImageConnectivityFilter> connectivity;
+  connectivity->SetInputData(mask);
+  connectivity->SetScalarRange(1, 255);
+  connectivity->SetExtractionModeToAllRegions();
+  connectivity->SetLabelModeToSizeRank();
+  connectivity->SetLabelScalarTypeToInt();
+  connectivity->Update();
+  timer->StopTimer();
+  vtkIdType vtkRegions = connectivity->GetNumberOfExtractedRegions();
+  std::cout << "vtkImageConnectivityFilter: " << timer->GetElapsedTime()
+            << " s, " << vtkRegions << " regions" << std::endl;
+
+  std::vector<int> reference;
+  timer->StartTimer();
+  vtkIdType referenceLabels = FloodFill(mask, reference);
+  timer->StopTimer();
+  std::cout << "Serial flood fill: " << timer->GetElapsedTime() << " s, "
+            << referenceLabels << " regions" << std::endl;
+
+  ImageLabeling labeling;
+  labeling.SetScalarRange(1, 255);
+  vtkNew<vtkImageData> labels;
+  for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+  {
+    vtkSMPTools::Initialize(threads);
+    timer->StartTimer();
+    labeling.Execute(mask);
+    labeling.GetLabelImage(labels);
+    timer->StopTimer();
+    std::cout << "Parallel union-find, " << threads
+              << " threads: " << timer->GetElapsedTime() << " s, "
+              << 1.0e-6 * voxels / timer->GetElapsedTime() << " Mvoxels/s, "
+              << labeling.GetNumberOfLabels() << " regions" << std::endl;
+    if (threads == maximumThreads)
+    {
+      break;
+    }
+  }
+
+  // The labels must be the flood fill's, and the region sizes
+  // vtkImageConnectivityFilter's.
+  bool ok = labeling.GetNumberOfLabels() == referenceLabels &&
+      std::equal(reference.begin(), reference.end(),
+                 static_cast<int*>(labels->GetScalarPointer()));
+  if (!ok)
+  {
+    std::cout << "Error: the labels differ from the flood fill's."
+              << std::endl;
+  }
+  std::vector<vtkIdType> sizes = labeling.GetLabelSizes();
+  std::sort(sizes.rbegin(), sizes.rend());
+  vtkIdTypeArray* vtkSizes = connectivity->GetExtractedRegionSizes();
+  bool sameSizes = vtkSizes->GetNumberOfTuples() ==
+      static_cast<vtkIdType>(sizes.size());
+  for (vtkIdType i = 0; sameSizes && i < vtkSizes->GetNumberOfTuples(); ++i)
+  {
+    sameSizes = vtkSizes->GetValue(i) == sizes[i];
+  }
+  if (!sameSizes)
+  {
+    std::cout << "Error: the region sizes differ from "
+                 "vtkImageConnectivityFilter's."
+              << std::endl;
+    ok = false;
+  }
+  if (!sizes.empty())
+  {
+    auto largest = std::max_element(labeling.GetLabelSizes().begin(),
+                                    labeling.GetLabelSizes().end()) -
+        labeling.GetLabelSizes().begin();
+    auto const& extent = labeling.GetLabelExtents()[largest];
+    std::cout << "Largest region: " << sizes[0] << " voxels, extent "
+              << extent[0] << " " << extent[1] << " " << extent[2] << " "
+              << extent[3] << " " << extent[4] << " " << extent[5]
+              << std::endl;
+  }
+
+  // Island removal in 3D: keep regions of minimumSize voxels or more.
+  connectivity->SetSizeRange(minimumSize, VTK_ID_MAX);
+  timer->StartTimer();
+  connectivity->Update();
+  timer->StopTimer();
+  std::cout << "Islands under " << minimumSize
+            << " voxels, vtkImageConnectivityFilter: "
+            << timer->GetElapsedTime() << " s, "
+            << connectivity->GetNumberOfExtractedRegions() << " regions kept"
+            << std::endl;
+  vtkNew<vtkImageData> cleaned;
+  cleaned->DeepCopy(mask);
+  timer->StartTimer();
+  labeling.Execute(cleaned);
+  labeling.RemoveSmallIslands(cleaned, minimumSize, 0.0);
+  timer->StopTimer();
+  vtkIdType kept = 0;
+  for (auto size : labeling.GetLabelSizes())
+  {
+    kept += size >= minimumSize;
+  }
+  std::cout << "Islands under " << minimumSize
+            << " voxels, parallel union-find: " << timer->GetElapsedTime()
+            << " s, " << kept << " regions kept" << std::endl;
+  if (kept != connectivity->GetNumberOfExtractedRegions())
+  {
+    std::cout << "Error: the 3D island removal keeps a different number of "
+                 "regions than vtkImageConnectivityFilter."
+              << std::endl;
+    ok = false;
+  }
+
+  // Island removal in 2D, as vtkImageIslandRemoval2D does it.
+  int dimension2D = 4 * dimension;
+  vtkNew<vtkImageData> mask2D;
+  MakeMask(mask2D, dimension2D, 1);
+  std::cout << "2D mask: " << dimension2D << "^2 unsigned char" << std::endl;
+  vtkNew<vtkImageIslandRemoval2D> islandRemoval;
+  islandRemoval->SetInputData(mask2D);
+  islandRemoval->SetAreaThreshold(static_cast<int>(minimumSize));
+  islandRemoval->SetIslandValue(255);
+  islandRemoval->SetReplaceValue(0);
+  islandRemoval->SquareNeighborhoodOff();
+  timer->StartTimer();
+  islandRemoval->Update();
+  timer->StopTimer();
+  std::cout << "vtkImageIslandRemoval2D: " << timer->GetElapsedTime() << " s"
+            << std::endl;
+  vtkNew<vtkImageData> cleaned2D;
+  cleaned2D->DeepCopy(mask2D);
+  timer->StartTimer();
+  labeling.Execute(cleaned2D);
+  labeling.RemoveSmallIslands(cleaned2D, minimumSize, 0.0);
+  timer->StopTimer();
+  auto ours = static_cast<unsigned char*>(cleaned2D->GetScalarPointer());
+  auto theirs = static_cast<unsigned char*>(
+      islandRemoval->GetOutput()->GetScalarPointer());
+  vtkIdType pixels = static_cast<vtkIdType>(dimension2D) * dimension2D;
+  vtkIdType differences = 0;
+  for (vtkIdType i = 0; i < pixels; ++i)
+  {
+    differences += ours[i] != theirs[i];
+  }
+  std::cout << "Parallel union-find: " << timer->GetElapsedTime() << " s, "
+            << differences << " pixels differ from vtkImageIslandRemoval2D"
+            << std::endl;
+  if (differences > 0)
+  {
+    std::cout << "Error: the 2D island removal differs from "
+                 "vtkImageIslandRemoval2D's."
+              << std::endl;
+    ok = false;
+  }
+
+  // The 2D labels must be the flood fill's too.
+  labeling.Execute(mask2D);
+  labeling.GetLabelImage(labels);
+  vtkIdType referenceLabels2D = FloodFill(mask2D, reference);
+  if (labeling.GetNumberOfLabels() != referenceLabels2D ||
+      !std::equal(reference.begin(), reference.end(),
+                  static_cast<int*>(labels->GetScalarPointer())))
+  {
+    std::cout << "Error: the 2D labels differ from the flood fill's."
+              << std::endl;
+    ok = false;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+namespace {
+vtkIdType ImageLabeling::Find(vtkIdType x)
+{
+  for (;;)
+  {
+    vtkIdType parent = this->Parents[x].load();
+    vtkIdType grandParent = this->Parents[parent].load();
+    if (parent == grandParent)
+    {
+      return parent;
+    }
+    // Path halving: if another thread changed the parent, it only made
+    // the path shorter.
+    this->Parents[x].compare_exchange_weak(parent, grandParent);
+    x = grandParent;
+  }
+}
+
+void ImageLabeling::Union(vtkIdType a, vtkIdType b)
+{
+  for (;;)
+  {
+    a = this->Find(a);
+    b = this->Find(b);
+    if (a == b)
+    {
+      return;
+    }
+    // Always link the larger root to the smaller one, so no cycle forms
+    // and the root of a component is its first run.
+    if (a < b)
+    {
+      std::swap(a, b);
+    }
+    vtkIdType expected = a;
+    if (this->Parents[a].compare_exchange_strong(expected, b))
+    {
+      return;
+    }
+    // a was linked by another thread meanwhile; try again from the roots.
+  }
+}
+
+void ImageLabeling::JoinRows(vtkIdType row, vtkIdType other)
+{
+  vtkIdType a = this->RowOffsets[row];
+  vtkIdType aEnd = this->RowOffsets[row + 1];
+  vtkIdType b = this->RowOffsets[other];
+  vtkIdType bEnd = this->RowOffsets[other + 1];
+  while (a < aEnd && b < bEnd)
+  {
+    auto const& ra = this->Runs[a];
+    auto const& rb = this->Runs[b];
+    if (ra[0] < rb[1] && rb[0] < ra[1])
+    {
+      this->Union(a, b);
+    }
+    // Advance the run that ends first; the other may touch the next one.
+    if (ra[1] < rb[1])
+    {
+      ++a;
+    }
+    else
+    {
+      ++b;
+    }
+  }
+}
+
+template <typename T>
+void CountRuns(T const* scalars, int length, double lower, double upper,
+               vtkIdType& count, std::array<int, 2>* runs)
+{
+  count = 0;
+  int i = 0;
+  while (i < length)
+  {
+    while (i < length && !(scalars[i] >= lower && scalars[i] <= upper))
+    {
+      ++i;
+    }
+    if (i == length)
+    {
+      break;
+    }
+    int start = i;
+    while (i < length && scalars[i] >= lower && scalars[i] <= upper)
+    {
+      ++i;
+    }
+    if (runs)
+    {
+      runs[count] = {{start, i}};
+    }
+    ++count;
+  }
+}
+
+template <typename T>
+void FindRuns(T const* scalars, int const dims[3], double lower,
+              double upper, std::vector<vtkIdType>& rowOffsets,
+              std::vector<std::array<int, 2>>& runs)
+{
+  vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+  // Count the runs of each row, then find them again into their place.
+  rowOffsets.assign(rows + 1, 0);
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      CountRuns(scalars + r * dims[0], dims[0], lower, upper,
+                rowOffsets[r + 1], static_cast<std::array<int, 2>*>(nullptr));
+    }
+  });
+  for (vtkIdType r = 0; r < rows; ++r)
+  {
+    rowOffsets[r + 1] += rowOffsets[r];
+  }
+  runs.resize(rowOffsets[rows]);
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      vtkIdType count;
+      CountRuns(scalars + r * dims[0], dims[0], lower, upper, count,
+                runs.data() + rowOffsets[r]);
+    }
+  });
+}
+
+void ImageLabeling::Execute(vtkImageData* image)
+{
+  image->GetDimensions(this->Dimensions);
+  int const* dims = this->Dimensions;
+  void const* scalars = image->GetScalarPointer();
+  switch (image->GetScalarType())
+  {
+    vtkTemplateMacro(FindRuns(static_cast<VTK_TT const*>(scalars), dims,
+                              this->Lower, this->Upper, this->RowOffsets,
+                              this->Runs));
+  }
+  auto numberOfRuns = static_cast<vtkIdType>(this->Runs.size());
+  std::vector<std::atomic<vtkIdType>> parents(numberOfRuns);
+  this->Parents.swap(parents);
+  vtkSMPTools::For(0, numberOfRuns, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      this->Parents[r].store(r);
+    }
+  });
+
+  // Join each row to the row below and the row of the slice below.
+  vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      if (r % dims[1] > 0)
+      {
+        this->JoinRows(r, r - 1);
+      }
+      if (r >= dims[1])
+      {
+        this->JoinRows(r, r - dims[1]);
+      }
+    }
+  });
+
+  // The roots are the first runs of the components; number them in
+  // order, then give every run its root's label.
+  std::vector<vtkIdType> roots(numberOfRuns);
+  vtkSMPTools::For(0, numberOfRuns, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      roots[r] = this->Find(r);
+    }
+  });
+  this->RunLabels.resize(numberOfRuns);
+  vtkIdType numberOfLabels = 0;
+  for (vtkIdType r = 0; r < numberOfRuns; ++r)
+  {
+    if (roots[r] == r)
+    {
+      this->RunLabels[r] = numberOfLabels++;
+    }
+  }
+  vtkSMPTools::For(0, numberOfRuns, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      this->RunLabels[r] = this->RunLabels[roots[r]];
+    }
+  });
+
+  // Sizes and extents from the runs.
+  std::vector<std::atomic<vtkIdType>> sizes(numberOfLabels);
+  std::vector<std::array<std::atomic<int>, 6>> extents(numberOfLabels);
+  vtkSMPTools::For(0, numberOfLabels, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType l = begin; l < end; ++l)
+    {
+      sizes[l].store(0);
+      for (int a = 0; a < 3; ++a)
+      {
+        extents[l][2 * a].store(std::numeric_limits<int>::max());
+        extents[l][2 * a + 1].store(std::numeric_limits<int>::lowest());
+      }
+    }
+  });
+  auto atomicMin = [](std::atomic<int>& target, int value) {
+    int current = target.load();
+    while (value < current && !target.compare_exchange_weak(current, value))
+    {
+    }
+  };
+  auto atomicMax = [](std::atomic<int>& target, int value) {
+    int current = target.load();
+    while (value > current && !target.compare_exchange_weak(current, value))
+    {
+    }
+  };
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType row = begin; row < end; ++row)
+    {
+      int j = static_cast<int>(row % dims[1]);
+      int k = static_cast<int>(row / dims[1]);
+      for (vtkIdType r = this->RowOffsets[row]; r < this->RowOffsets[row + 1];
+           ++r)
+      {
+        auto& extent = extents[this->RunLabels[r]];
+        auto const& run = this->Runs[r];
+        sizes[this->RunLabels[r]].fetch_add(run[1] - run[0],
+                                            std::memory_order_relaxed);
+        atomicMin(extent[0], run[0]);
+        atomicMax(extent[1], run[1] - 1);
+        atomicMin(extent[2], j);
+        atomicMax(extent[3], j);
+        atomicMin(extent[4], k);
+        atomicMax(extent[5], k);
+      }
+    }
+  });
+  this->Sizes.resize(numberOfLabels);
+  this->Extents.resize(numberOfLabels);
+  for (vtkIdType l = 0; l < numberOfLabels; ++l)
+  {
+    this->Sizes[l] = sizes[l].load();
+    for (int e = 0; e < 6; ++e)
+    {
+      this->Extents[l][e] = extents[l][e].load();
+    }
+  }
+}
+
+void ImageLabeling::GetLabelImage(vtkImageData* labels) const
+{
+  int const* dims = this->Dimensions;
+  labels->SetDimensions(dims[0], dims[1], dims[2]);
+  labels->AllocateScalars(VTK_INT, 1);
+  auto out = static_cast<int*>(labels->GetScalarPointer());
+  vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType row = begin; row < end; ++row)
+    {
+      int* line = out + row * dims[0];
+      std::fill(line, line + dims[0], 0);
+      for (vtkIdType r = this->RowOffsets[row]; r < this->RowOffsets[row + 1];
+           ++r)
+      {
+        std::fill(line + this->Runs[r][0], line + this->Runs[r][1],
+                  static_cast<int>(this->RunLabels[r] + 1));
+      }
+    }
+  });
+}
+
+template <typename T>
+void FillRuns(T* scalars, int const dims[3],
+              std::vector<vtkIdType> const& rowOffsets,
+              std::vector<std::array<int, 2>> const& runs,
+              std::vector<char> const& fill, double value)
+{
+  vtkIdType rows = static_cast<vtkIdType>(dims[1]) * dims[2];
+  T replacement = static_cast<T>(value);
+  vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType row = begin; row < end; ++row)
+    {
+      T* line = scalars + row * dims[0];
+      for (vtkIdType r = rowOffsets[row]; r < rowOffsets[row + 1]; ++r)
+      {
+        if (fill[r])
+        {
+          std::fill(line + runs[r][0], line + runs[r][1], replacement);
+        }
+      }
+    }
+  });
+}
+
+void ImageLabeling::RemoveSmallIslands(vtkImageData* image,
+                                       vtkIdType minimumSize,
+                                       double value) const
+{
+  auto numberOfRuns = static_cast<vtkIdType>(this->Runs.size());
+  std::vector<char> small(numberOfRuns);
+  vtkSMPTools::For(0, numberOfRuns, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      small[r] = this->Sizes[this->RunLabels[r]] < minimumSize;
+    }
+  });
+  void* scalars = image->GetScalarPointer();
+  switch (image->GetScalarType())
+  {
+    vtkTemplateMacro(FillRuns(static_cast<VTK_TT*>(scalars), this->Dimensions,
+                              this->RowOffsets, this->Runs, small, value));
+  }
+}
+
+vtkIdType FloodFill(vtkImageData* mask, std::vector<int>& labels)
+{
+  int* dims = mask->GetDimensions();
+  vtkIdType sliceSize = static_cast<vtkIdType>(dims[0]) * dims[1];
+  vtkIdType size = sliceSize * dims[2];
+  auto voxels = static_cast<unsigned char*>(mask->GetScalarPointer());
+  labels.assign(size, 0);
+  int next = 0;
+  std::deque<vtkIdType> queue;
+  for (vtkIdType seed = 0; seed < size; ++seed)
+  {
+    if (voxels[seed] == 0 || labels[seed] != 0)
+    {
+      continue;
+    }
+    labels[seed] = ++next;
+    queue.push_back(seed);
+    while (!queue.empty())
+    {
+      vtkIdType v = queue.front();
+      queue.pop_front();
+      int i = static_cast<int>(v % dims[0]);
+      int j = static_cast<int>((v / dims[0]) % dims[1]);
+      int k = static_cast<int>(v / sliceSize);
+      vtkIdType neighbors[6] = {i > 0 ? v - 1 : -1,
+                                i < dims[0] - 1 ? v + 1 : -1,
+                                j > 0 ? v - dims[0] : -1,
+                                j < dims[1] - 1 ? v + dims[0] : -1,
+                                k > 0 ? v - sliceSize : -1,
+                                k < dims[2] - 1 ? v + sliceSize : -1};
+      for (auto n : neighbors)
+      {
+        if (n >= 0 && voxels[n] != 0 && labels[n] == 0)
+        {
+          labels[n] = next;
+          queue.push_back(n);
+        }
+      }
+    }
+  }
+  return next;
+}
+
+void MakeMask(vtkImageData* mask, int dimension, int depth)
+{
+  mask->SetDimensions(dimension, dimension, depth);
+  mask->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  auto voxels = static_cast<unsigned char*>(mask->GetScalarPointer());
+  auto hash = [](std::uint32_t x, std::uint32_t y, std::uint32_t z) {
+    std::uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ z * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+  };
+  // Trilinear value noise on a 12 voxel lattice.
+  int const cell = 12;
+  auto noise = [&](int i, int j, int k) {
+    int c[3] = {i / cell, j / cell, k / cell};
+    double f[3] = {static_cast<double>(i % cell) / cell,
+                   static_cast<double>(j % cell) / cell,
+                   static_cast<double>(k % cell) / cell};
+    double value = 0.0;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+      int o[3] = {corner & 1, (corner >> 1) & 1, (corner >> 2) & 1};
+      double weight = 1.0;
+      for (int a = 0; a < 3; ++a)
+      {
+        weight *= o[a] ? f[a] : 1.0 - f[a];
+      }
+      value += weight * hash(c[0] + o[0], c[1] + o[1], c[2] + o[2]) /
+          4294967296.0;
+    }
+    return value;
+  };
+  vtkSMPTools::For(0, depth, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < dimension; ++j)
+      {
+        unsigned char* row =
+            voxels + (k * dimension + j) * static_cast<vtkIdType>(dimension);
+        for (int i = 0; i < dimension; ++i)
+        {
+          int z = static_cast<int>(k);
+          bool structure = noise(i, j, z) > 0.62;
+          bool speck = hash(i, j, z + 7919) % 1000 < 4;
+          row[i] = structure || speck ? 255 : 0;
+        }
+      }
+    }
+  });
+}
+} // namespace
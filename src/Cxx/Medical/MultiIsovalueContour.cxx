@@ -0,0 +1,458 @@
+#include <vtkCompositeDataSet.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkMarchingCubesTriangleCases.h>
+#include <vtkMetaImageReader.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+// Extracts several isosurfaces of a volume in one traversal. Every cell is
+// read once: its eight values are loaded, and the cell is triangulated for
+// each isovalue between their minimum and maximum. The volume is split
+// into slabs along z, one task each. Points on the edges between two
+// slabs are merged when the slabs are joined, so every mesh is the same
+// as vtkMarchingCubes would make for its value.
+class MultiContour
+{
+public:
+  vtkSmartPointer<vtkMultiBlockDataSet>
+  Execute(vtkImageData* volume, std::vector<double> const& values);
+
+  // The index of an x or y edge in a plane of the volume, and the id of
+  // the point on it.
+  typedef std::pair<vtkIdType, vtkIdType> PlanePoint;
+
+  // The part of one isosurface made by one slab. The first and last plane
+  // hold only the points made on the x and y edges of the slab's bottom
+  // and top planes, sorted by edge.
+  struct Piece
+  {
+    std::vector<float> Points;
+    std::vector<vtkIdType> Triangles;
+    std::vector<PlanePoint> FirstPlane;
+    std::vector<PlanePoint> LastPlane;
+  };
+
+private:
+  vtkSmartPointer<vtkPolyData> Join(std::vector<Piece*> const& pieces);
+
+  int Dimensions[3];
+};
+
+vtkSmartPointer<vtkImageData> MakeHead(int dimension);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [volume.mhd [isovalue ...]]. The default isovalues are the
+  // skin and bone of MedicalDemo2.
+  vtkSmartPointer<vtkImageData> volume;
+  if (argc > 1)
+  {
+    vtkNew<vtkMetaImageReader> reader;
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    volume = reader->GetOutput();
+  }
+  else
+  {
+    volume = MakeHead(200);
+  }
+  std::vector<double> values;
+  for (int i = 2; i < argc; ++i)
+  {
+    values.push_back(std::atof(argv[i]));
+  }
+  if (values.empty())
+  {
+    values = {500.0, 1150.0};
+  }
+  int* dimensions = volume->GetDimensions();
+  std::cout << "Volume: " << dimensions[0] << " x " << dimensions[1] << " x "
+            << dimensions[2] << ", " << values.size() << " isovalues, "
+            << vtkSMPTools::GetEstimatedNumberOfThreads() << " threads"
+            << std::endl;
+
+  // One vtkFlyingEdges3D per isovalue, as MedicalDemo2 does.
+  vtkNew<vtkTimerLog> timer;
+  std::vector<vtkIdType> separateTriangles;
+  timer->StartTimer();
+  for (auto value : values)
+  {
+    vtkNew<vtkFlyingEdges3D> extractor;
+    extractor->SetInputData(volume);
+    extractor->SetValue(0, value);
+    extractor->ComputeNormalsOff();
+    extractor->ComputeGradientsOff();
+    extractor->ComputeScalarsOff();
+    extractor->Update();
+    separateTriangles.push_back(extractor->GetOutput()->GetNumberOfPolys());
+  }
+  timer->StopTimer();
+  double separateTime = timer->GetElapsedTime();
+
+  // One vtkFlyingEdges3D with all the isovalues: all the surfaces end up
+  // in one mesh.
+  timer->StartTimer();
+  vtkNew<vtkFlyingEdges3D> combined;
+  combined->SetInputData(volume);
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    combined->SetValue(static_cast<int>(i), values[i]);
+  }
+  combined->ComputeNormalsOff();
+  combined->ComputeGradientsOff();
+  combined->ComputeScalarsOff();
+  combined->Update();
+  timer->StopTimer();
+  double combinedTime = timer->GetElapsedTime();
+
+  // One traversal, one mesh per isovalue.
+  timer->StartTimer();
+  MultiContour contour;
+  auto surfaces = contour.Execute(volume, values);
+  timer->StopTimer();
+  double multiTime = timer->GetElapsedTime();
+
+  std::cout << "Separate vtkFlyingEdges3D: " << separateTime << " s"
+            << std::endl;
+  std::cout << "One vtkFlyingEdges3D, one mesh: " << combinedTime << " s"
+            << std::endl;
+  std::cout << "Single pass, one mesh per value: " << multiTime << " s"
+            << std::endl;
+  // Both use the marching cubes cases, so the triangles are the same.
+  bool same = true;
+  for (unsigned int i = 0; i < surfaces->GetNumberOfBlocks(); ++i)
+  {
+    auto surface = vtkPolyData::SafeDownCast(surfaces->GetBlock(i));
+    std::cout << "  "
+              << surfaces->GetMetaData(i)->Get(vtkCompositeDataSet::NAME())
+              << ": " << surface->GetNumberOfPoints() << " points, "
+              << surface->GetNumberOfPolys() << " triangles ("
+              << separateTriangles[i] << " from vtkFlyingEdges3D)"
+              << std::endl;
+    same = same && surface->GetNumberOfPolys() == separateTriangles[i];
+  }
+  if (!same)
+  {
+    std::cout << "Error: the single pass and vtkFlyingEdges3D made different "
+                 "numbers of triangles."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+// The cell corners in the order of the marching cubes cases.
+const int CornerOffsets[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0},
+                                 {0, 1, 0}, {0, 0, 1}, {1, 0, 1},
+                                 {1, 1, 1}, {0, 1, 1}};
+const int EdgeCorners[12][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3},
+                                {4, 5}, {5, 6}, {7, 6}, {4, 7},
+                                {0, 4}, {1, 5}, {3, 7}, {2, 6}};
+// The axis of each edge.
+const int EdgeAxes[12] = {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2};
+
+// Triangulates the cells of the layers k0 to k1 - 1 for every isovalue.
+template <typename T>
+void ContourSlab(const T* scalars, const int dimensions[3],
+                 const double origin[3], const double spacing[3],
+                 std::vector<double> const& values, int k0, int k1,
+                 std::vector<MultiContour::Piece>& pieces)
+{
+  const vtkIdType nx = dimensions[0];
+  const vtkIdType nxy = nx * dimensions[1];
+  const std::size_t numberOfValues = values.size();
+  vtkIdType cornerIncrements[8];
+  for (int c = 0; c < 8; ++c)
+  {
+    cornerIncrements[c] = CornerOffsets[c][0] + CornerOffsets[c][1] * nx +
+        CornerOffsets[c][2] * nxy;
+  }
+
+  // The point ids of the x and y edges of the bottom and top plane of the
+  // current layer, and of its z edges, for each isovalue.
+  std::vector<std::vector<vtkIdType>> bottom(numberOfValues);
+  std::vector<std::vector<vtkIdType>> top(numberOfValues);
+  std::vector<std::vector<vtkIdType>> vertical(numberOfValues);
+  for (std::size_t v = 0; v < numberOfValues; ++v)
+  {
+    bottom[v].assign(2 * nxy, -1);
+    top[v].assign(2 * nxy, -1);
+  }
+
+  auto cases = vtkMarchingCubesTriangleCases::GetCases();
+  double s[8];
+  for (int k = k0; k < k1; ++k)
+  {
+    for (std::size_t v = 0; v < numberOfValues; ++v)
+    {
+      vertical[v].assign(nxy, -1);
+    }
+    for (int j = 0; j < dimensions[1] - 1; ++j)
+    {
+      for (int i = 0; i < dimensions[0] - 1; ++i)
+      {
+        const T* cell = scalars + i + j * nx + k * nxy;
+        double low = VTK_DOUBLE_MAX;
+        double high = VTK_DOUBLE_MIN;
+        for (int c = 0; c < 8; ++c)
+        {
+          s[c] = static_cast<double>(cell[cornerIncrements[c]]);
+          low = std::min(low, s[c]);
+          high = std::max(high, s[c]);
+        }
+        for (std::size_t v = 0; v < numberOfValues; ++v)
+        {
+          double value = values[v];
+          if (high < value || low >= value)
+          {
+            continue;
+          }
+          int index = 0;
+          for (int c = 0; c < 8; ++c)
+          {
+            if (s[c] >= value)
+            {
+              index |= 1 << c;
+            }
+          }
+          MultiContour::Piece& piece = pieces[v];
+          for (auto edge = cases[index].edges; *edge > -1; edge += 3)
+          {
+            vtkIdType ids[3];
+            for (int t = 0; t < 3; ++t)
+            {
+              // The point of an edge belongs to its first corner.
+              int e = edge[t];
+              const int* a = CornerOffsets[EdgeCorners[e][0]];
+              vtkIdType column = (i + a[0]) + (j + a[1]) * nx;
+              vtkIdType& id = EdgeAxes[e] == 2
+                  ? vertical[v][column]
+                  : (a[2] ? top[v] : bottom[v])[2 * column + EdgeAxes[e]];
+              if (id < 0)
+              {
+                double s0 = s[EdgeCorners[e][0]];
+                double s1 = s[EdgeCorners[e][1]];
+                double r = (value - s0) / (s1 - s0);
+                id = static_cast<vtkIdType>(piece.Points.size() / 3);
+                if (EdgeAxes[e] != 2 && k + a[2] == (a[2] ? k1 : k0))
+                {
+                  (a[2] ? piece.LastPlane : piece.FirstPlane)
+                      .emplace_back(2 * column + EdgeAxes[e], id);
+                }
+                int position[3] = {i + a[0], j + a[1], k + a[2]};
+                for (int d = 0; d < 3; ++d)
+                {
+                  double x = position[d] + (d == EdgeAxes[e] ? r : 0.0);
+                  piece.Points.push_back(
+                      static_cast<float>(origin[d] + spacing[d] * x));
+                }
+              }
+              ids[t] = id;
+            }
+            piece.Triangles.insert(piece.Triangles.end(), ids, ids + 3);
+          }
+        }
+      }
+    }
+    for (std::size_t v = 0; v < numberOfValues; ++v)
+    {
+      std::swap(bottom[v], top[v]);
+      top[v].assign(2 * nxy, -1);
+    }
+  }
+  for (auto& piece : pieces)
+  {
+    std::sort(piece.FirstPlane.begin(), piece.FirstPlane.end());
+    std::sort(piece.LastPlane.begin(), piece.LastPlane.end());
+  }
+}
+
+vtkSmartPointer<vtkMultiBlockDataSet>
+MultiContour::Execute(vtkImageData* volume, std::vector<double> const& values)
+{
+  volume->GetDimensions(this->Dimensions);
+  double origin[3];
+  double spacing[3];
+  volume->GetOrigin(origin);
+  volume->GetSpacing(spacing);
+
+  // A few slabs per thread, so that the threads stay busy where the
+  // surfaces are dense. A single slice has no cells, and gives empty
+  // meshes.
+  int layers = std::max(this->Dimensions[2] - 1, 0);
+  int numberOfSlabs =
+      std::min(layers, 4 * vtkSMPTools::GetEstimatedNumberOfThreads());
+  std::vector<std::vector<Piece>> slabs(numberOfSlabs,
+                                        std::vector<Piece>(values.size()));
+  void* scalars = volume->GetScalarPointer();
+  int* dimensions = this->Dimensions;
+  vtkSMPTools::For(0, numberOfSlabs, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType slab = begin; slab < end; ++slab)
+    {
+      int k0 = static_cast<int>(slab * layers / numberOfSlabs);
+      int k1 = static_cast<int>((slab + 1) * layers / numberOfSlabs);
+      switch (volume->GetScalarType())
+      {
+        vtkTemplateMacro(ContourSlab(static_cast<const VTK_TT*>(scalars),
+                                     dimensions, origin, spacing, values, k0,
+                                     k1, slabs[slab]));
+      }
+    }
+  });
+
+  // Join the slabs of each isovalue into one mesh, in parallel.
+  std::vector<vtkSmartPointer<vtkPolyData>> surfaces(values.size());
+  vtkSMPTools::For(0, static_cast<vtkIdType>(values.size()),
+                   [&](vtkIdType begin, vtkIdType end) {
+                     for (vtkIdType v = begin; v < end; ++v)
+                     {
+                       std::vector<Piece*> pieces;
+                       for (auto& slab : slabs)
+                       {
+                         pieces.push_back(&slab[v]);
+                       }
+                       surfaces[v] = this->Join(pieces);
+                     }
+                   });
+
+  auto output = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+  output->SetNumberOfBlocks(static_cast<unsigned int>(values.size()));
+  for (std::size_t v = 0; v < values.size(); ++v)
+  {
+    auto block = static_cast<unsigned int>(v);
+    output->SetBlock(block, surfaces[v]);
+    output->GetMetaData(block)->Set(vtkCompositeDataSet::NAME(),
+                                    ("Isovalue " + std::to_string(values[v]))
+                                        .c_str());
+  }
+  return output;
+}
+
+vtkSmartPointer<vtkPolyData>
+MultiContour::Join(std::vector<Piece*> const& pieces)
+{
+  // The points of a slab's first plane are already in the previous slab.
+  // Both lists are sorted by edge, so they are matched in one walk.
+  std::vector<PlanePoint> previousPlane;
+  std::vector<float> points;
+  std::vector<vtkIdType> triangles;
+  for (auto piece : pieces)
+  {
+    vtkIdType numberOfLocal = static_cast<vtkIdType>(piece->Points.size() / 3);
+    std::vector<vtkIdType> map(numberOfLocal, -1);
+    auto previous = previousPlane.begin();
+    for (auto const& point : piece->FirstPlane)
+    {
+      while (previous != previousPlane.end() && previous->first < point.first)
+      {
+        ++previous;
+      }
+      if (previous != previousPlane.end() && previous->first == point.first)
+      {
+        map[point.second] = previous->second;
+      }
+    }
+    for (vtkIdType id = 0; id < numberOfLocal; ++id)
+    {
+      if (map[id] < 0)
+      {
+        map[id] = static_cast<vtkIdType>(points.size() / 3);
+        points.insert(points.end(), piece->Points.begin() + 3 * id,
+                      piece->Points.begin() + 3 * id + 3);
+      }
+    }
+    for (auto id : piece->Triangles)
+    {
+      triangles.push_back(map[id]);
+    }
+    previousPlane.clear();
+    for (auto const& point : piece->LastPlane)
+    {
+      previousPlane.emplace_back(point.first, map[point.second]);
+    }
+    // The slab is not needed any more.
+    *piece = Piece();
+  }
+
+  vtkNew<vtkPoints> meshPoints;
+  meshPoints->SetDataTypeToFloat();
+  meshPoints->SetNumberOfPoints(static_cast<vtkIdType>(points.size() / 3));
+  if (!points.empty())
+  {
+    std::memcpy(meshPoints->GetVoidPointer(0), points.data(),
+                points.size() * sizeof(float));
+  }
+  vtkNew<vtkCellArray> polys;
+  for (std::size_t t = 0; t < triangles.size(); t += 3)
+  {
+    polys->InsertNextCell(3, &triangles[t]);
+  }
+  auto mesh = vtkSmartPointer<vtkPolyData>::New();
+  mesh->SetPoints(meshPoints);
+  mesh->SetPolys(polys);
+  return mesh;
+}
+
+// A head-like phantom with the values of FullHead.mhd: air, skin and soft
+// tissue, a skull and the brain, with some texture so that the surfaces
+// are not smooth.
+vtkSmartPointer<vtkImageData> MakeHead(int dimension)
+{
+  auto volume = vtkSmartPointer<vtkImageData>::New();
+  volume->SetDimensions(dimension, dimension, dimension);
+  volume->SetSpacing(1.0, 1.0, 1.0);
+  volume->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto voxels = static_cast<unsigned short*>(volume->GetScalarPointer());
+  vtkSMPTools::For(0, dimension, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < dimension; ++j)
+      {
+        for (int i = 0; i < dimension; ++i)
+        {
+          double x = (i - 0.5 * dimension) / (0.40 * dimension);
+          double y = (j - 0.5 * dimension) / (0.45 * dimension);
+          double z = (k - 0.5 * dimension) / (0.42 * dimension);
+          double r = std::sqrt(x * x + y * y + z * z) +
+              0.02 * std::sin(0.7 * i) * std::sin(0.5 * j) *
+                  std::sin(0.3 * k);
+          double value = 0.0;
+          if (r < 0.80)
+          {
+            value = 1050.0 + 40.0 * std::sin(0.9 * i + 0.4 * k);
+          }
+          else if (r < 0.90)
+          {
+            value = 1500.0 + 200.0 * std::sin(0.3 * j + 0.2 * k);
+          }
+          else if (r < 1.0)
+          {
+            value = 950.0;
+          }
+          voxels[i + dimension * (j + dimension * k)] =
+              static_cast<unsigned short>(value);
+        }
+      }
+    }
+  });
+  return volume;
+}
+} // namespace
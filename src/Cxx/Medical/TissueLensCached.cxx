@@ -0,0 +1,622 @@
+#include <vtkCellArray.h>
+#include <vtkClipDataSet.h>
+#include <vtkClipPolyData.h>
+#include <vtkDataArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkMetaImageReader.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkProbeFilter.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphere.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace {
+// Keeps everything the tissue lens needs that does not depend on where the
+// lens is. The skin surface is extracted once and cut into pieces on a
+// grid of bricks; the lens is a sphere template around the origin. When
+// the lens moves, only the pieces whose bounds cross its sphere are
+// clipped again. The pieces outside the sphere are passed on as they are
+// and the pieces inside it are dropped. The lens surface is the template
+// moved to the new center, with its scalars sampled from the volume in
+// parallel.
+class CachedTissueLens
+{
+public:
+  void Initialize(vtkImageData* volume, vtkPolyData* skin, double radius,
+                  double isovalue);
+  void Move(double const center[3]);
+
+  vtkMultiBlockDataSet* GetSkin()
+  {
+    return this->Skin;
+  }
+  vtkPolyData* GetLens()
+  {
+    return this->LensClip->GetOutput();
+  }
+  vtkIdType GetNumberOfPieces() const
+  {
+    return static_cast<vtkIdType>(this->Pieces.size());
+  }
+  vtkIdType GetNumberOfClippedPieces() const
+  {
+    return this->ClippedPieces;
+  }
+
+private:
+  struct Piece
+  {
+    vtkSmartPointer<vtkPolyData> Surface;
+    double Bounds[6];
+  };
+
+  void CutSkin(vtkPolyData* skin);
+
+  vtkImageData* Volume = nullptr;
+  double Radius = 0.0;
+  std::vector<Piece> Pieces;
+  vtkIdType ClippedPieces = 0;
+  vtkNew<vtkMultiBlockDataSet> Skin;
+  vtkNew<vtkPolyData> Empty;
+  vtkNew<vtkSphere> Sphere;
+  vtkNew<vtkClipPolyData> SkinClip;
+  std::vector<double> LensTemplate;
+  vtkNew<vtkFloatArray> LensCoordinates;
+  vtkSmartPointer<vtkDataArray> LensScalars;
+  vtkNew<vtkPolyData> Lens;
+  vtkNew<vtkClipPolyData> LensClip;
+};
+
+// The number of bricks along each axis the skin is cut into.
+int const BricksPerAxis = 8;
+
+vtkSmartPointer<vtkImageData> MakeHead(int dimension);
+void Report(char const* name, std::vector<double> const& times);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [volume.mhd [numberOfFrames]]. The lens is dragged once
+  // around the head in numberOfFrames steps.
+  vtkSmartPointer<vtkImageData> volume;
+  if (argc > 1)
+  {
+    vtkNew<vtkMetaImageReader> reader;
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    volume = reader->GetOutput();
+  }
+  else
+  {
+    volume = MakeHead(200);
+  }
+  int frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : 36;
+  double const isovalue = 500.0;
+
+  double bounds[6];
+  volume->GetBounds(bounds);
+  double middle[3];
+  double diagonal = 0.0;
+  for (int i = 0; i < 3; ++i)
+  {
+    middle[i] = 0.5 * (bounds[2 * i] + bounds[2 * i + 1]);
+    double length = bounds[2 * i + 1] - bounds[2 * i];
+    diagonal += length * length;
+  }
+  double radius = 0.15 * std::sqrt(diagonal);
+
+  // The lens follows an ellipse around the middle of the volume, about
+  // where the skin is.
+  std::vector<std::array<double, 3>> path(frames);
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    double angle = 2.0 * 3.14159265358979 * frame / frames;
+    path[frame] = {{middle[0] + 0.4 * (bounds[1] - bounds[0]) * std::cos(angle),
+                    middle[1] + 0.4 * (bounds[3] - bounds[2]) * std::sin(angle),
+                    middle[2]}};
+  }
+
+  int* dimensions = volume->GetDimensions();
+  std::cout << "Volume: " << dimensions[0] << " x " << dimensions[1] << " x "
+            << dimensions[2] << ", lens radius " << radius << ", " << frames
+            << " frames, " << vtkSMPTools::GetEstimatedNumberOfThreads()
+            << " threads" << std::endl;
+
+  // The skin is extracted once; both versions of the lens start from it.
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  vtkNew<vtkFlyingEdges3D> skinExtractor;
+  skinExtractor->SetInputData(volume);
+  skinExtractor->SetValue(0, isovalue);
+  skinExtractor->Update();
+  timer->StopTimer();
+  std::cout << "Skin: " << skinExtractor->GetOutput()->GetNumberOfPolys()
+            << " triangles in " << timer->GetElapsedTime() << " s"
+            << std::endl;
+
+  // The pipeline of TissueLens. Each move clips the whole skin again and
+  // probes the volume with the whole lens.
+  vtkNew<vtkSphere> clipFunction;
+  clipFunction->SetRadius(radius);
+
+  vtkNew<vtkClipDataSet> skinClip;
+  skinClip->SetInputConnection(skinExtractor->GetOutputPort());
+  skinClip->SetClipFunction(clipFunction);
+  skinClip->SetValue(0);
+  skinClip->GenerateClipScalarsOn();
+
+  vtkNew<vtkSphereSource> lensModel;
+  lensModel->SetRadius(radius);
+  lensModel->SetPhiResolution(201);
+  lensModel->SetThetaResolution(101);
+
+  vtkNew<vtkProbeFilter> lensProbe;
+  lensProbe->SetInputConnection(lensModel->GetOutputPort());
+  lensProbe->SetSourceData(volume);
+
+  vtkNew<vtkClipDataSet> lensClip;
+  lensClip->SetInputConnection(lensProbe->GetOutputPort());
+  lensClip->SetValue(isovalue);
+  lensClip->GenerateClipScalarsOff();
+
+  std::vector<double> originalTimes(frames);
+  std::vector<vtkIdType> originalCells(frames);
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    timer->StartTimer();
+    clipFunction->SetCenter(path[frame].data());
+    lensModel->SetCenter(path[frame].data());
+    skinClip->Update();
+    lensClip->Update();
+    timer->StopTimer();
+    originalTimes[frame] = timer->GetElapsedTime();
+    originalCells[frame] = skinClip->GetOutput()->GetNumberOfCells() +
+        lensClip->GetOutput()->GetNumberOfCells();
+  }
+
+  // The cached lens. Building the cache is paid once, before dragging.
+  timer->StartTimer();
+  CachedTissueLens cachedLens;
+  cachedLens.Initialize(volume, skinExtractor->GetOutput(), radius, isovalue);
+  timer->StopTimer();
+  std::cout << "Cache: " << cachedLens.GetNumberOfPieces()
+            << " skin pieces in " << timer->GetElapsedTime() << " s"
+            << std::endl;
+
+  std::vector<double> cachedTimes(frames);
+  int differentFrames = 0;
+  std::cout << "Frame  TissueLens (ms)  Cached (ms)  Clipped pieces"
+            << std::endl;
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    timer->StartTimer();
+    cachedLens.Move(path[frame].data());
+    timer->StopTimer();
+    cachedTimes[frame] = timer->GetElapsedTime();
+
+    vtkIdType cells = cachedLens.GetLens()->GetNumberOfCells();
+    auto skin = cachedLens.GetSkin();
+    for (unsigned int i = 0; i < skin->GetNumberOfBlocks(); ++i)
+    {
+      cells += vtkPolyData::SafeDownCast(skin->GetBlock(i))->GetNumberOfCells();
+    }
+    if (cells != originalCells[frame])
+    {
+      ++differentFrames;
+    }
+    std::cout << std::setw(5) << frame << std::setw(17)
+              << 1000.0 * originalTimes[frame] << std::setw(13)
+              << 1000.0 * cachedTimes[frame] << std::setw(16)
+              << cachedLens.GetNumberOfClippedPieces() << std::endl;
+  }
+
+  Report("TissueLens", originalTimes);
+  Report("Cached", cachedTimes);
+  std::cout << "Frames with a different number of cells: " << differentFrames
+            << std::endl;
+
+  return differentFrames > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+namespace {
+// Stores an interpolated value the way vtkProbeFilter does: integer types
+// are clamped to their range and rounded half away from zero.
+template <typename T>
+T Convert(double value)
+{
+  if (std::numeric_limits<T>::is_integer)
+  {
+    double low = static_cast<double>(std::numeric_limits<T>::lowest());
+    double high = static_cast<double>(std::numeric_limits<T>::max());
+    value = std::min(std::max(value, low), high);
+    value = value >= 0.0 ? value + 0.5 : value - 0.5;
+  }
+  return static_cast<T>(value);
+}
+
+// Trilinear interpolation of the volume at each lens point, in the scalar
+// type of the volume. Points outside the volume get 0, as vtkProbeFilter
+// gives them.
+template <typename T>
+void SampleVolume(T const* voxels, vtkImageData* volume, float const* points,
+                  vtkIdType numberOfPoints, T* scalars)
+{
+  int dimensions[3];
+  double origin[3];
+  double spacing[3];
+  volume->GetDimensions(dimensions);
+  volume->GetOrigin(origin);
+  volume->GetSpacing(spacing);
+  // Along an axis with one sample the neighbour is the sample itself.
+  vtkIdType dx = dimensions[0] > 1 ? 1 : 0;
+  vtkIdType dy = dimensions[1] > 1 ? dimensions[0] : 0;
+  vtkIdType dz =
+      dimensions[2] > 1 ? static_cast<vtkIdType>(dimensions[0]) * dimensions[1]
+                        : 0;
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType id = begin; id < end; ++id)
+    {
+      int index[3];
+      double weight[3];
+      bool inside = true;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        double x = (points[3 * id + axis] - origin[axis]) / spacing[axis];
+        int last = dimensions[axis] - 1;
+        if (x < 0.0 || x > last)
+        {
+          inside = false;
+          break;
+        }
+        index[axis] = std::min(static_cast<int>(x), std::max(last - 1, 0));
+        weight[axis] = last > 0 ? x - index[axis] : 0.0;
+      }
+      if (!inside)
+      {
+        scalars[id] = 0;
+        continue;
+      }
+      T const* corner = voxels + index[0] +
+          dimensions[0] *
+              (index[1] + static_cast<vtkIdType>(dimensions[1]) * index[2]);
+      double c000 = corner[0];
+      double c100 = corner[dx];
+      double c010 = corner[dy];
+      double c110 = corner[dy + dx];
+      double c001 = corner[dz];
+      double c101 = corner[dz + dx];
+      double c011 = corner[dz + dy];
+      double c111 = corner[dz + dy + dx];
+      double x0 = c000 + weight[0] * (c100 - c000);
+      double x1 = c010 + weight[0] * (c110 - c010);
+      double x2 = c001 + weight[0] * (c101 - c001);
+      double x3 = c011 + weight[0] * (c111 - c011);
+      double y0 = x0 + weight[1] * (x1 - x0);
+      double y1 = x2 + weight[1] * (x3 - x2);
+      scalars[id] = Convert<T>(y0 + weight[2] * (y1 - y0));
+    }
+  });
+}
+
+void CachedTissueLens::Initialize(vtkImageData* volume, vtkPolyData* skin,
+                                  double radius, double isovalue)
+{
+  this->Volume = volume;
+  this->Radius = radius;
+  this->CutSkin(skin);
+
+  this->Sphere->SetRadius(radius);
+  this->SkinClip->SetClipFunction(this->Sphere);
+  this->SkinClip->SetValue(0);
+
+  // The lens template is the sphere of TissueLens around the origin. Its
+  // triangles never change; only its points move. The template is kept in
+  // double precision, so that the moved points round to the same floats
+  // as the points of the sphere in TissueLens.
+  vtkNew<vtkSphereSource> lensModel;
+  lensModel->SetRadius(radius);
+  lensModel->SetCenter(0, 0, 0);
+  lensModel->SetPhiResolution(201);
+  lensModel->SetThetaResolution(101);
+  lensModel->SetOutputPointsPrecision(vtkAlgorithm::DOUBLE_PRECISION);
+  lensModel->Update();
+  vtkPolyData* model = lensModel->GetOutput();
+  vtkIdType numberOfPoints = model->GetNumberOfPoints();
+  this->LensTemplate.resize(3 * numberOfPoints);
+  for (vtkIdType id = 0; id < numberOfPoints; ++id)
+  {
+    double point[3];
+    model->GetPoint(id, &this->LensTemplate[3 * id]);
+  }
+  this->LensCoordinates->SetNumberOfComponents(3);
+  this->LensCoordinates->SetNumberOfTuples(numberOfPoints);
+  vtkNew<vtkPoints> lensPoints;
+  lensPoints->SetData(this->LensCoordinates);
+  // The scalars have the type of the volume, as vtkProbeFilter gives them.
+  this->LensScalars.TakeReference(
+      vtkDataArray::CreateDataArray(volume->GetScalarType()));
+  this->LensScalars->SetName("ImageScalars");
+  this->LensScalars->SetNumberOfTuples(numberOfPoints);
+  this->Lens->SetPoints(lensPoints);
+  this->Lens->SetPolys(model->GetPolys());
+  this->Lens->GetPointData()->SetScalars(this->LensScalars);
+
+  this->LensClip->SetInputData(this->Lens);
+  this->LensClip->SetValue(isovalue);
+  this->LensClip->GenerateClipScalarsOff();
+}
+
+void CachedTissueLens::Move(double const center[3])
+{
+  // Classify each piece against the sphere by its bounds: the nearest and
+  // farthest points of the box from the center decide whether the piece
+  // is outside, inside or crossing the sphere.
+  this->Sphere->SetCenter(center[0], center[1], center[2]);
+  double radius2 = this->Radius * this->Radius;
+  this->Skin->SetNumberOfBlocks(static_cast<unsigned int>(this->Pieces.size()));
+  this->ClippedPieces = 0;
+  for (std::size_t i = 0; i < this->Pieces.size(); ++i)
+  {
+    Piece const& piece = this->Pieces[i];
+    double nearest2 = 0.0;
+    double farthest2 = 0.0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      double low = piece.Bounds[2 * axis] - center[axis];
+      double high = center[axis] - piece.Bounds[2 * axis + 1];
+      double gap = std::max(0.0, std::max(low, high));
+      nearest2 += gap * gap;
+      double reach = std::max(std::abs(low), std::abs(high));
+      farthest2 += reach * reach;
+    }
+    unsigned int block = static_cast<unsigned int>(i);
+    if (nearest2 > radius2)
+    {
+      this->Skin->SetBlock(block, piece.Surface);
+    }
+    else if (farthest2 < radius2)
+    {
+      this->Skin->SetBlock(block, this->Empty);
+    }
+    else
+    {
+      this->SkinClip->SetInputData(piece.Surface);
+      this->SkinClip->Update();
+      vtkNew<vtkPolyData> clipped;
+      clipped->ShallowCopy(this->SkinClip->GetOutput());
+      this->Skin->SetBlock(block, clipped);
+      ++this->ClippedPieces;
+    }
+  }
+
+  // Move the lens and sample the volume at its points.
+  float* coordinates = this->LensCoordinates->GetPointer(0);
+  vtkIdType numberOfPoints = this->LensCoordinates->GetNumberOfTuples();
+  double const* lensTemplate = this->LensTemplate.data();
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType id = begin; id < end; ++id)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        coordinates[3 * id + axis] =
+            static_cast<float>(lensTemplate[3 * id + axis] + center[axis]);
+      }
+    }
+  });
+  void* scalars = this->LensScalars->GetVoidPointer(0);
+  switch (this->Volume->GetScalarType())
+  {
+    vtkTemplateMacro(SampleVolume(
+        static_cast<VTK_TT const*>(this->Volume->GetScalarPointer()),
+        this->Volume, coordinates, numberOfPoints,
+        static_cast<VTK_TT*>(scalars)));
+  }
+  this->LensCoordinates->Modified();
+  this->LensScalars->Modified();
+  this->Lens->Modified();
+  this->LensClip->Update();
+}
+
+// Cuts the skin into pieces. Each triangle goes to the brick holding its
+// centroid, so a piece may reach a little past its brick; the bounds of a
+// piece are those of its own points.
+void CachedTissueLens::CutSkin(vtkPolyData* skin)
+{
+  vtkIdType numberOfTriangles = skin->GetNumberOfPolys();
+  std::vector<vtkIdType> triangles(3 * numberOfTriangles);
+  vtkCellArray* polys = skin->GetPolys();
+  vtkIdType npts;
+#ifdef VTK_CELL_ARRAY_V2
+  const vtkIdType* pts;
+#else // VTK_CELL_ARRAY_V2
+  vtkIdType* pts;
+#endif // VTK_CELL_ARRAY_V2
+  vtkIdType cell = 0;
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts); ++cell)
+  {
+    std::copy(pts, pts + 3, &triangles[3 * cell]);
+  }
+
+  double bounds[6];
+  skin->GetBounds(bounds);
+  double scale[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    double length = bounds[2 * axis + 1] - bounds[2 * axis];
+    scale[axis] = length > 0.0 ? BricksPerAxis / length : 0.0;
+  }
+  vtkPoints* points = skin->GetPoints();
+  std::vector<int> brickOf(numberOfTriangles);
+  vtkSMPTools::For(0, numberOfTriangles, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType cell = begin; cell < end; ++cell)
+    {
+      double centroid[3] = {0.0, 0.0, 0.0};
+      for (int corner = 0; corner < 3; ++corner)
+      {
+        double point[3];
+        points->GetPoint(triangles[3 * cell + corner], point);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          centroid[axis] += point[axis] / 3.0;
+        }
+      }
+      int brick[3];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        int b = static_cast<int>((centroid[axis] - bounds[2 * axis]) *
+                                 scale[axis]);
+        brick[axis] = std::min(std::max(b, 0), BricksPerAxis - 1);
+      }
+      brickOf[cell] =
+          brick[0] + BricksPerAxis * (brick[1] + BricksPerAxis * brick[2]);
+    }
+  });
+
+  // Sort the triangles by brick.
+  int numberOfBricks = BricksPerAxis * BricksPerAxis * BricksPerAxis;
+  std::vector<vtkIdType> offsets(numberOfBricks + 1, 0);
+  for (auto brick : brickOf)
+  {
+    ++offsets[brick + 1];
+  }
+  for (int brick = 0; brick < numberOfBricks; ++brick)
+  {
+    offsets[brick + 1] += offsets[brick];
+  }
+  std::vector<vtkIdType> order(numberOfTriangles);
+  std::vector<vtkIdType> next(offsets.begin(), offsets.end() - 1);
+  for (vtkIdType cell = 0; cell < numberOfTriangles; ++cell)
+  {
+    order[next[brickOf[cell]]++] = cell;
+  }
+
+  // Make one polydata per brick with triangles, with its own points and a
+  // copy of the skin's point data (the normals).
+  vtkPointData* skinData = skin->GetPointData();
+  std::vector<vtkIdType> localIds(skin->GetNumberOfPoints(), -1);
+  std::vector<vtkIdType> used;
+  this->Pieces.clear();
+  for (int brick = 0; brick < numberOfBricks; ++brick)
+  {
+    vtkIdType first = offsets[brick];
+    vtkIdType last = offsets[brick + 1];
+    if (first == last)
+    {
+      continue;
+    }
+    used.clear();
+    vtkNew<vtkCellArray> pieceTriangles;
+    for (vtkIdType i = first; i < last; ++i)
+    {
+      vtkIdType triangle[3];
+      for (int corner = 0; corner < 3; ++corner)
+      {
+        vtkIdType id = triangles[3 * order[i] + corner];
+        if (localIds[id] < 0)
+        {
+          localIds[id] = static_cast<vtkIdType>(used.size());
+          used.push_back(id);
+        }
+        triangle[corner] = localIds[id];
+      }
+      pieceTriangles->InsertNextCell(3, triangle);
+    }
+    vtkNew<vtkPoints> piecePoints;
+    piecePoints->SetDataType(points->GetDataType());
+    piecePoints->SetNumberOfPoints(static_cast<vtkIdType>(used.size()));
+    Piece piece;
+    piece.Surface = vtkSmartPointer<vtkPolyData>::New();
+    vtkPointData* pieceData = piece.Surface->GetPointData();
+    pieceData->CopyAllocate(skinData, static_cast<vtkIdType>(used.size()));
+    for (std::size_t i = 0; i < used.size(); ++i)
+    {
+      vtkIdType id = static_cast<vtkIdType>(i);
+      piecePoints->SetPoint(id, points->GetPoint(used[i]));
+      pieceData->CopyData(skinData, used[i], id);
+      localIds[used[i]] = -1;
+    }
+    piece.Surface->SetPoints(piecePoints);
+    piece.Surface->SetPolys(pieceTriangles);
+    piece.Surface->GetBounds(piece.Bounds);
+    this->Pieces.push_back(piece);
+  }
+}
+
+void Report(char const* name, std::vector<double> const& times)
+{
+  double total = 0.0;
+  double slowest = 0.0;
+  for (auto time : times)
+  {
+    total += time;
+    slowest = std::max(slowest, time);
+  }
+  double mean = total / times.size();
+  std::cout << name << ": mean " << 1000.0 * mean << " ms, slowest "
+            << 1000.0 * slowest << " ms, " << 1.0 / mean << " frames/s"
+            << std::endl;
+}
+
+// A head-like phantom with the values of FullHead.mhd: air, skin and soft
+// tissue, a skull and the brain, with some texture so that the surfaces
+// are not smooth.
+vtkSmartPointer<vtkImageData> MakeHead(int dimension)
+{
+  auto volume = vtkSmartPointer<vtkImageData>::New();
+  volume->SetDimensions(dimension, dimension, dimension);
+  volume->SetSpacing(1.0, 1.0, 1.0);
+  volume->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto voxels = static_cast<unsigned short*>(volume->GetScalarPointer());
+  vtkSMPTools::For(0, dimension, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < dimension; ++j)
+      {
+        for (int i = 0; i < dimension; ++i)
+        {
+          double x = (i - 0.5 * dimension) / (0.40 * dimension);
+          double y = (j - 0.5 * dimension) / (0.45 * dimension);
+          double z = (k - 0.5 * dimension) / (0.42 * dimension);
+          double r = std::sqrt(x * x + y * y + z * z) +
+              0.02 * std::sin(0.7 * i) * std::sin(0.5 * j) *
+                  std::sin(0.3 * k);
+          double value = 0.0;
+          if (r < 0.80)
+          {
+            value = 1050.0 + 40.0 * std::sin(0.9 * i + 0.4 * k);
+          }
+          else if (r < 0.90)
+          {
+            value = 1500.0 + 200.0 * std::sin(0.3 * j + 0.2 * k);
+          }
+          else if (r < 1.0)
+          {
+            value = 950.0;
+          }
+          voxels[i + dimension * (j + dimension * k)] =
+              static_cast<unsigned short>(value);
+        }
+      }
+    }
+  });
+  return volume;
+}
+} // namespace
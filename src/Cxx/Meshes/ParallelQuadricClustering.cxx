@@ -0,0 +1,548 @@
+#include <vtkCellArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkQuadricClustering.h>
+#include <vtkIdList.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+#include <vtkXMLPolyDataReader.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+// Error quadric stored as the upper triangle of a symmetric 4x4 matrix.
+struct Quadric
+{
+  double A[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+  void AddPlane(const double n[3], double d, double weight);
+  bool Minimize(double x[3]) const;
+  Quadric& operator+=(Quadric const& other);
+};
+
+struct Bin
+{
+  Quadric Q;
+  double Sum[3] = {0, 0, 0};
+  vtkIdType Count = 0;
+
+  Bin& operator+=(Bin const& other);
+};
+
+typedef std::array<vtkIdType, 3> BinTriangle;
+
+struct BinTriangleHash
+{
+  std::size_t operator()(BinTriangle const& t) const;
+};
+
+// Quadric clustering over a fixed grid of bins. Pieces of the input are
+// added with Append() in any order, and the accumulated bins are turned into
+// a mesh by EndAppend(). Within a piece, the triangles are sorted into slabs of
+// bins along z and the slabs are processed concurrently, each thread
+// accumulating into its own bins.
+class ParallelQuadricClustering
+{
+public:
+  void StartAppend(const double bounds[6], int divisions);
+  void Append(vtkPolyData* piece);
+  vtkSmartPointer<vtkPolyData> EndAppend();
+
+private:
+  struct Accumulator
+  {
+    std::unordered_map<vtkIdType, Bin> Bins;
+    std::vector<BinTriangle> Triangles;
+  };
+
+  vtkIdType BinIndex(const double x[3]) const;
+
+  double Origin[3];
+  double Spacing[3];
+  int Divisions;
+  std::unordered_map<vtkIdType, Bin> Bins;
+  std::unordered_set<BinTriangle, BinTriangleHash> Triangles;
+};
+
+vtkSmartPointer<vtkPolyData> GetPiece(vtkPolyData* mesh, int piece,
+                                      int numberOfPieces);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  int divisions = argc > 2 ? std::stoi(argv[2]) : 64;
+  int numberOfPieces = argc > 3 ? std::stoi(argv[3]) : 16;
+
+  // The pieces come either from slicing a mesh read from a file, or from
+  // asking a vtkSphereSource for one piece at a time. The latter never
+  // holds the whole input in memory.
+  vtkSmartPointer<vtkPolyData> mesh;
+  vtkNew<vtkSphereSource> sphereSource;
+  double bounds[6];
+  std::function<vtkSmartPointer<vtkPolyData>(int)> pieceSource;
+  if (argc > 1)
+  {
+    vtkNew<vtkXMLPolyDataReader> reader;
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    mesh = reader->GetOutput();
+    mesh->GetBounds(bounds);
+    pieceSource = [&](int piece) {
+      return GetPiece(mesh, piece, numberOfPieces);
+    };
+  }
+  else
+  {
+    sphereSource->SetThetaResolution(600);
+    sphereSource->SetPhiResolution(300);
+    sphereSource->SetRadius(0.5);
+    double radius = sphereSource->GetRadius();
+    for (int i = 0; i < 3; ++i)
+    {
+      bounds[2 * i] = -radius;
+      bounds[2 * i + 1] = radius;
+    }
+    pieceSource = [&](int piece) {
+      sphereSource->UpdatePiece(piece, numberOfPieces, 0);
+      auto output = vtkSmartPointer<vtkPolyData>::New();
+      output->ShallowCopy(sphereSource->GetOutput());
+      return output;
+    };
+  }
+
+  vtkNew<vtkTimerLog> timer;
+  std::cout << "Divisions: " << divisions << "^3, pieces: " << numberOfPieces
+            << ", threads: " << vtkSMPTools::GetEstimatedNumberOfThreads()
+            << std::endl;
+
+  // Whole input at once, only possible when the mesh is in memory.
+  if (mesh)
+  {
+    std::cout << "# of input triangles: " << mesh->GetNumberOfPolys()
+              << std::endl;
+
+    vtkNew<vtkQuadricClustering> clustering;
+    clustering->SetInputData(mesh);
+    clustering->AutoAdjustNumberOfDivisionsOff();
+    clustering->SetNumberOfDivisions(divisions, divisions, divisions);
+    timer->StartTimer();
+    clustering->Update();
+    timer->StopTimer();
+    std::cout << "vtkQuadricClustering:           "
+              << clustering->GetOutput()->GetNumberOfPolys()
+              << " triangles in " << timer->GetElapsedTime() << "s"
+              << std::endl;
+
+    ParallelQuadricClustering parallel;
+    timer->StartTimer();
+    parallel.StartAppend(bounds, divisions);
+    parallel.Append(mesh);
+    auto output = parallel.EndAppend();
+    timer->StopTimer();
+    std::cout << "ParallelQuadricClustering:      "
+              << output->GetNumberOfPolys() << " triangles in "
+              << timer->GetElapsedTime() << "s" << std::endl;
+  }
+
+  // Streaming: only one piece of the input is alive at any time.
+  {
+    vtkNew<vtkQuadricClustering> clustering;
+    clustering->AutoAdjustNumberOfDivisionsOff();
+    clustering->SetNumberOfDivisions(divisions, divisions, divisions);
+    vtkIdType numberOfTriangles = 0;
+    timer->StartTimer();
+    clustering->StartAppend(bounds);
+    for (int piece = 0; piece < numberOfPieces; ++piece)
+    {
+      auto input = pieceSource(piece);
+      numberOfTriangles += input->GetNumberOfPolys();
+      clustering->Append(input);
+    }
+    clustering->EndAppend();
+    timer->StopTimer();
+    std::cout << "# of streamed triangles: " << numberOfTriangles
+              << std::endl;
+    std::cout << "vtkQuadricClustering append:    "
+              << clustering->GetOutput()->GetNumberOfPolys()
+              << " triangles in " << timer->GetElapsedTime() << "s"
+              << std::endl;
+  }
+  {
+    ParallelQuadricClustering parallel;
+    timer->StartTimer();
+    parallel.StartAppend(bounds, divisions);
+    for (int piece = 0; piece < numberOfPieces; ++piece)
+    {
+      parallel.Append(pieceSource(piece));
+    }
+    auto output = parallel.EndAppend();
+    timer->StopTimer();
+    std::cout << "ParallelQuadricClustering append: "
+              << output->GetNumberOfPolys() << " triangles in "
+              << timer->GetElapsedTime() << "s" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+namespace {
+std::size_t BinTriangleHash::operator()(BinTriangle const& t) const
+{
+  std::hash<vtkIdType> hash;
+  std::size_t h = hash(t[0]);
+  h ^= hash(t[1]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  h ^= hash(t[2]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  return h;
+}
+
+void Quadric::AddPlane(const double n[3], double d, double weight)
+{
+  const double p[4] = {n[0], n[1], n[2], d};
+  int k = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    for (int j = i; j < 4; ++j)
+    {
+      this->A[k++] += weight * p[i] * p[j];
+    }
+  }
+}
+
+bool Quadric::Minimize(double x[3]) const
+{
+  // Solve the 3x3 system [A] x = -b by Cramer's rule.
+  const double* a = this->A;
+  double m[3][3] = {{a[0], a[1], a[2]}, {a[1], a[4], a[5]}, {a[2], a[5], a[7]}};
+  double b[3] = {-a[3], -a[6], -a[8]};
+  auto determinant = [](double const c[3][3]) {
+    return c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1]) -
+        c[0][1] * (c[1][0] * c[2][2] - c[1][2] * c[2][0]) +
+        c[0][2] * (c[1][0] * c[2][1] - c[1][1] * c[2][0]);
+  };
+  double det = determinant(m);
+  double scale = m[0][0] + m[1][1] + m[2][2];
+  if (std::abs(det) <= 1.0e-9 * scale * scale * scale)
+  {
+    return false;
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    double mc[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        mc[i][j] = j == c ? b[i] : m[i][j];
+      }
+    }
+    x[c] = determinant(mc) / det;
+  }
+  return true;
+}
+
+Quadric& Quadric::operator+=(Quadric const& other)
+{
+  for (int i = 0; i < 10; ++i)
+  {
+    this->A[i] += other.A[i];
+  }
+  return *this;
+}
+
+Bin& Bin::operator+=(Bin const& other)
+{
+  this->Q += other.Q;
+  for (int i = 0; i < 3; ++i)
+  {
+    this->Sum[i] += other.Sum[i];
+  }
+  this->Count += other.Count;
+  return *this;
+}
+
+void ParallelQuadricClustering::StartAppend(const double bounds[6],
+                                            int divisions)
+{
+  this->Divisions = std::max(divisions, 1);
+  for (int i = 0; i < 3; ++i)
+  {
+    // Pad the bounds slightly so that points on the maximum face fall
+    // inside the last bin.
+    double range = std::max(bounds[2 * i + 1] - bounds[2 * i], 1.0e-12);
+    this->Origin[i] = bounds[2 * i] - 1.0e-6 * range;
+    this->Spacing[i] = range * (1.0 + 2.0e-6) / this->Divisions;
+  }
+  this->Bins.clear();
+  this->Triangles.clear();
+}
+
+vtkIdType ParallelQuadricClustering::BinIndex(const double x[3]) const
+{
+  vtkIdType ijk[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    auto index = static_cast<vtkIdType>(
+        std::floor((x[i] - this->Origin[i]) / this->Spacing[i]));
+    ijk[i] = std::min<vtkIdType>(std::max<vtkIdType>(index, 0),
+                                 this->Divisions - 1);
+  }
+  return ijk[0] + this->Divisions * (ijk[1] + this->Divisions * ijk[2]);
+}
+
+void ParallelQuadricClustering::Append(vtkPolyData* piece)
+{
+  auto points = piece->GetPoints();
+  if (!points || piece->GetNumberOfPolys() == 0)
+  {
+    return;
+  }
+
+  // Bin the points in parallel.
+  vtkIdType numberOfPoints = piece->GetNumberOfPoints();
+  std::vector<vtkIdType> pointBins(numberOfPoints);
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      double x[3];
+      points->GetPoint(i, x);
+      pointBins[i] = this->BinIndex(x);
+    }
+  });
+
+  // Fan triangulate the polygons in parallel. The triangles of each cell
+  // start at the running sum of the triangle counts of the cells before it.
+  auto polys = piece->GetPolys();
+  vtkIdType numberOfCells = polys->GetNumberOfCells();
+  std::vector<vtkIdType> firstTriangle(numberOfCells + 1, 0);
+  vtkSMPTools::For(0, numberOfCells, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType cellId = begin; cellId < end; ++cellId)
+    {
+      firstTriangle[cellId + 1] =
+          std::max<vtkIdType>(polys->GetCellSize(cellId) - 2, 0);
+    }
+  });
+  std::partial_sum(firstTriangle.begin(), firstTriangle.end(),
+                   firstTriangle.begin());
+  std::vector<std::array<vtkIdType, 3>> triangles(firstTriangle.back());
+  vtkSMPThreadLocalObject<vtkIdList> cellPoints;
+  vtkSMPTools::For(0, numberOfCells, [&](vtkIdType begin, vtkIdType end) {
+    auto pts = cellPoints.Local();
+    for (vtkIdType cellId = begin; cellId < end; ++cellId)
+    {
+      polys->GetCellAtId(cellId, pts);
+      auto t = triangles.begin() + firstTriangle[cellId];
+      for (vtkIdType i = 1; i + 1 < pts->GetNumberOfIds(); ++i, ++t)
+      {
+        *t = {{pts->GetId(0), pts->GetId(i), pts->GetId(i + 1)}};
+      }
+    }
+  });
+
+  // Sort the triangles into slabs of bins along z, by the bin of their first
+  // vertex: a counting sort over blocks of triangles, each block counted and
+  // then scattered in parallel. Block b of slab s starts after all of slab
+  // s in the blocks before b, so the order is the same as a serial sort.
+  vtkIdType const numberOfTriangles = static_cast<vtkIdType>(triangles.size());
+  vtkIdType const blockSize = 65536;
+  vtkIdType const numberOfBlocks = (numberOfTriangles + blockSize - 1) /
+      blockSize;
+  vtkIdType const binsPerSlab =
+      static_cast<vtkIdType>(this->Divisions) * this->Divisions;
+  auto slabOf = [&](vtkIdType t) {
+    return pointBins[triangles[t][0]] / binsPerSlab;
+  };
+  // counts[s * numberOfBlocks + b] is the number of triangles of block b in
+  // slab s, and then the first position in order of those triangles.
+  std::vector<vtkIdType> counts(this->Divisions * numberOfBlocks + 1, 0);
+  vtkSMPTools::For(0, numberOfBlocks, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType b = begin; b < end; ++b)
+    {
+      vtkIdType last = std::min(numberOfTriangles, (b + 1) * blockSize);
+      for (vtkIdType t = b * blockSize; t < last; ++t)
+      {
+        ++counts[slabOf(t) * numberOfBlocks + b];
+      }
+    }
+  });
+  vtkIdType position = 0;
+  for (auto& count : counts)
+  {
+    vtkIdType blockCount = count;
+    count = position;
+    position += blockCount;
+  }
+  std::vector<vtkIdType> slabOffsets(this->Divisions + 1);
+  for (int s = 0; s <= this->Divisions; ++s)
+  {
+    slabOffsets[s] = counts[s * numberOfBlocks];
+  }
+  std::vector<vtkIdType> order(numberOfTriangles);
+  vtkSMPTools::For(0, numberOfBlocks, [&](vtkIdType begin, vtkIdType end) {
+    std::vector<vtkIdType> next(this->Divisions);
+    for (vtkIdType b = begin; b < end; ++b)
+    {
+      for (int s = 0; s < this->Divisions; ++s)
+      {
+        next[s] = counts[s * numberOfBlocks + b];
+      }
+      vtkIdType last = std::min(numberOfTriangles, (b + 1) * blockSize);
+      for (vtkIdType t = b * blockSize; t < last; ++t)
+      {
+        order[next[slabOf(t)]++] = t;
+      }
+    }
+  });
+
+  // Accumulate the slabs concurrently into per-thread bins.
+  vtkSMPThreadLocal<Accumulator> accumulators;
+  auto accumulate = [&](vtkIdType begin, vtkIdType end) {
+    auto& local = accumulators.Local();
+    for (auto k = slabOffsets[begin]; k < slabOffsets[end]; ++k)
+    {
+      auto const& t = triangles[order[k]];
+      double x[3][3];
+      for (int i = 0; i < 3; ++i)
+      {
+        points->GetPoint(t[i], x[i]);
+      }
+      double e1[3] = {x[1][0] - x[0][0], x[1][1] - x[0][1], x[1][2] - x[0][2]};
+      double e2[3] = {x[2][0] - x[0][0], x[2][1] - x[0][1], x[2][2] - x[0][2]};
+      double n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                     e1[2] * e2[0] - e1[0] * e2[2],
+                     e1[0] * e2[1] - e1[1] * e2[0]};
+      double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      BinTriangle bins = {
+          {pointBins[t[0]], pointBins[t[1]], pointBins[t[2]]}};
+      for (int i = 0; i < 3; ++i)
+      {
+        auto& bin = local.Bins[bins[i]];
+        if (length > 0.0)
+        {
+          double unit[3] = {n[0] / length, n[1] / length, n[2] / length};
+          double d = -(unit[0] * x[0][0] + unit[1] * x[0][1] +
+                       unit[2] * x[0][2]);
+          bin.Q.AddPlane(unit, d, 0.5 * length);
+        }
+        for (int j = 0; j < 3; ++j)
+        {
+          bin.Sum[j] += x[i][j];
+        }
+        ++bin.Count;
+      }
+      if (bins[0] != bins[1] && bins[1] != bins[2] && bins[2] != bins[0])
+      {
+        // Rotate so that the smallest bin comes first, keeping orientation.
+        std::rotate(bins.begin(), std::min_element(bins.begin(), bins.end()),
+                    bins.end());
+        local.Triangles.push_back(bins);
+      }
+    }
+  };
+  vtkSMPTools::For(0, this->Divisions, 1, accumulate);
+
+  // Merge the per-thread bins. The set of output triangles drops the ones
+  // already seen, in this or an earlier piece, in constant time each.
+  for (auto& local : accumulators)
+  {
+    for (auto const& bin : local.Bins)
+    {
+      this->Bins[bin.first] += bin.second;
+    }
+    this->Triangles.insert(local.Triangles.begin(), local.Triangles.end());
+  }
+}
+
+vtkSmartPointer<vtkPolyData> ParallelQuadricClustering::EndAppend()
+{
+  // One output point per bin used by a triangle, placed at the minimum of
+  // the bin quadric if that lies near the bin, otherwise at the mean.
+  // The triangles are sorted once, so the output does not depend on the
+  // order of the set.
+  std::vector<BinTriangle> triangles(this->Triangles.begin(),
+                                     this->Triangles.end());
+  std::sort(triangles.begin(), triangles.end());
+  std::unordered_map<vtkIdType, vtkIdType> pointIds;
+  vtkNew<vtkPoints> points;
+  vtkNew<vtkCellArray> polys;
+  for (auto const& t : triangles)
+  {
+    vtkIdType ids[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      auto found = pointIds.find(t[i]);
+      if (found != pointIds.end())
+      {
+        ids[i] = found->second;
+        continue;
+      }
+      auto const& bin = this->Bins[t[i]];
+      double mean[3] = {bin.Sum[0] / bin.Count, bin.Sum[1] / bin.Count,
+                        bin.Sum[2] / bin.Count};
+      double x[3];
+      bool inside = bin.Q.Minimize(x);
+      for (int j = 0; inside && j < 3; ++j)
+      {
+        inside = std::abs(x[j] - mean[j]) <= this->Spacing[j];
+      }
+      ids[i] = points->InsertNextPoint(inside ? x : mean);
+      pointIds[t[i]] = ids[i];
+    }
+    polys->InsertNextCell(3, ids);
+  }
+  auto output = vtkSmartPointer<vtkPolyData>::New();
+  output->SetPoints(points);
+  output->SetPolys(polys);
+  this->Bins.clear();
+  this->Triangles.clear();
+  return output;
+}
+
+vtkSmartPointer<vtkPolyData> GetPiece(vtkPolyData* mesh, int piece,
+                                      int numberOfPieces)
+{
+  // A contiguous range of the polygons with only the points they use, as a
+  // piece of a partitioned file would be.
+  vtkIdType numberOfPolys = mesh->GetNumberOfPolys();
+  vtkIdType begin = numberOfPolys * piece / numberOfPieces;
+  vtkIdType end = numberOfPolys * (piece + 1) / numberOfPieces;
+  std::vector<vtkIdType> pointMap(mesh->GetNumberOfPoints(), -1);
+  vtkNew<vtkPoints> points;
+  vtkNew<vtkCellArray> polys;
+  auto allPolys = mesh->GetPolys();
+  std::vector<vtkIdType> ids;
+  for (vtkIdType cellId = begin; cellId < end; ++cellId)
+  {
+    vtkIdType npts;
+    const vtkIdType* pts;
+    allPolys->GetCellAtId(cellId, npts, pts);
+    ids.resize(npts);
+    for (vtkIdType i = 0; i < npts; ++i)
+    {
+      if (pointMap[pts[i]] < 0)
+      {
+        pointMap[pts[i]] = points->InsertNextPoint(mesh->GetPoint(pts[i]));
+      }
+      ids[i] = pointMap[pts[i]];
+    }
+    polys->InsertNextCell(npts, ids.data());
+  }
+  auto output = vtkSmartPointer<vtkPolyData>::New();
+  output->SetPoints(points);
+  output->SetPolys(polys);
+  return output;
+}
+} // namespace
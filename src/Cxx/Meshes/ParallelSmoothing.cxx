@@ -0,0 +1,447 @@
+#include <vtkCellArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkSmoothPolyDataFilter.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+#include <vtkWindowedSincPolyDataFilter.h>
+
+// Readers
+#include <vtkBYUReader.h>
+#include <vtkOBJReader.h>
+#include <vtkPLYReader.h>
+#include <vtkPolyDataReader.h>
+#include <vtkSTLReader.h>
+#include <vtkXMLPolyDataReader.h>
+
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+// Point coordinates stored as a structure of arrays.
+struct Coordinates
+{
+  std::vector<double> X;
+  std::vector<double> Y;
+  std::vector<double> Z;
+
+  void Resize(std::size_t n)
+  {
+    this->X.resize(n);
+    this->Y.resize(n);
+    this->Z.resize(n);
+  }
+};
+
+// Vertex adjacency in compressed sparse row form. The neighbors of vertex i
+// are Neighbors[Offsets[i]] ... Neighbors[Offsets[i + 1] - 1]. Vertices on a
+// boundary or non-manifold edge have no neighbors, so they stay fixed.
+struct Adjacency
+{
+  std::vector<vtkIdType> Offsets;
+  std::vector<vtkIdType> Neighbors;
+
+  void Build(vtkPolyData* mesh);
+};
+
+// Multiply the coordinates by the neighbor averaging matrix W.
+// Fixed vertices are copied.
+template <typename Functor>
+void Average(Adjacency const& adjacency, Coordinates const& in,
+             Functor&& store)
+{
+  auto n = static_cast<vtkIdType>(adjacency.Offsets.size() - 1);
+  vtkSMPTools::For(0, n, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      auto first = adjacency.Offsets[i];
+      auto last = adjacency.Offsets[i + 1];
+      if (first == last)
+      {
+        store(i, in.X[i], in.Y[i], in.Z[i]);
+        continue;
+      }
+      double x = 0.0, y = 0.0, z = 0.0;
+      for (auto k = first; k < last; ++k)
+      {
+        auto j = adjacency.Neighbors[k];
+        x += in.X[j];
+        y += in.Y[j];
+        z += in.Z[j];
+      }
+      double scale = 1.0 / (last - first);
+      store(i, x * scale, y * scale, z * scale);
+    }
+  });
+}
+
+void LaplacianSmooth(Adjacency const& adjacency, Coordinates& coordinates,
+                     int numberOfIterations, double relaxationFactor);
+
+void WindowedSincSmooth(Adjacency const& adjacency, Coordinates& coordinates,
+                        int numberOfIterations, double passBand);
+
+void ToCoordinates(vtkPoints* points, Coordinates& coordinates);
+
+double MaximumDifference(Coordinates const& coordinates, vtkPoints* points);
+
+vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  auto mesh = ReadPolyData(argc > 1 ? argv[1] : "");
+  int numberOfIterations = argc > 2 ? std::stoi(argv[2]) : 20;
+  double relaxationFactor = 0.1;
+  double passBand = 0.1;
+
+  std::cout << "# of points: " << mesh->GetNumberOfPoints()
+            << ", # of polys: " << mesh->GetNumberOfPolys()
+            << ", threads: " << vtkSMPTools::GetEstimatedNumberOfThreads()
+            << ", iterations: " << numberOfIterations << std::endl;
+
+  vtkNew<vtkTimerLog> timer;
+
+  // The adjacency is built once and reused by every iteration, and by every
+  // smoothing pass over meshes with the same connectivity.
+  timer->StartTimer();
+  Adjacency adjacency;
+  adjacency.Build(mesh);
+  timer->StopTimer();
+  std::cout << "CSR adjacency: " << timer->GetElapsedTime() << "s, "
+            << adjacency.Neighbors.size() << " neighbor entries" << std::endl;
+
+  // Laplacian.
+  {
+    vtkNew<vtkSmoothPolyDataFilter> smoother;
+    smoother->SetInputData(mesh);
+    smoother->SetNumberOfIterations(numberOfIterations);
+    smoother->SetRelaxationFactor(relaxationFactor);
+    smoother->SetConvergence(0.0);
+    smoother->BoundarySmoothingOff();
+    smoother->FeatureEdgeSmoothingOff();
+    timer->StartTimer();
+    smoother->Update();
+    timer->StopTimer();
+    double filterTime = timer->GetElapsedTime();
+
+    Coordinates coordinates;
+    ToCoordinates(mesh->GetPoints(), coordinates);
+    timer->StartTimer();
+    LaplacianSmooth(adjacency, coordinates, numberOfIterations,
+                    relaxationFactor);
+    timer->StopTimer();
+    double parallelTime = timer->GetElapsedTime();
+
+    std::cout << "Laplacian" << std::endl;
+    std::cout << "  vtkSmoothPolyDataFilter: " << filterTime << "s, "
+              << numberOfIterations / filterTime << " iterations/s"
+              << std::endl;
+    std::cout << "  CSR Jacobi:              " << parallelTime << "s, "
+              << numberOfIterations / parallelTime << " iterations/s"
+              << std::endl;
+    std::cout << "  Maximum difference:      "
+              << MaximumDifference(coordinates,
+                                   smoother->GetOutput()->GetPoints())
+              << std::endl;
+  }
+
+  // Windowed sinc.
+  {
+    vtkNew<vtkWindowedSincPolyDataFilter> smoother;
+    smoother->SetInputData(mesh);
+    smoother->SetNumberOfIterations(numberOfIterations);
+    smoother->SetPassBand(passBand);
+    smoother->BoundarySmoothingOff();
+    smoother->FeatureEdgeSmoothingOff();
+    smoother->NonManifoldSmoothingOff();
+    timer->StartTimer();
+    smoother->Update();
+    timer->StopTimer();
+    double filterTime = timer->GetElapsedTime();
+
+    Coordinates coordinates;
+    ToCoordinates(mesh->GetPoints(), coordinates);
+    timer->StartTimer();
+    WindowedSincSmooth(adjacency, coordinates, numberOfIterations, passBand);
+    timer->StopTimer();
+    double parallelTime = timer->GetElapsedTime();
+
+    std::cout << "Windowed sinc" << std::endl;
+    std::cout << "  vtkWindowedSincPolyDataFilter: " << filterTime << "s, "
+              << numberOfIterations / filterTime << " iterations/s"
+              << std::endl;
+    std::cout << "  CSR Chebyshev:                 " << parallelTime << "s, "
+              << numberOfIterations / parallelTime << " iterations/s"
+              << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+namespace {
+void Adjacency::Build(vtkPolyData* mesh)
+{
+  // Collect the edges of the polygons as (low, high) pairs, sort them and
+  // count how many polygons use each one.
+  std::vector<std::array<vtkIdType, 2>> edges;
+  auto polys = mesh->GetPolys();
+  vtkIdType npts;
+#ifdef VTK_CELL_ARRAY_V2
+  const vtkIdType* pts;
+#else // VTK_CELL_ARRAY_V2
+  vtkIdType* pts;
+#endif // VTK_CELL_ARRAY_V2
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+  {
+    for (vtkIdType i = 0; i < npts; ++i)
+    {
+      auto a = pts[i];
+      auto b = pts[(i + 1) % npts];
+      edges.push_back({{std::min(a, b), std::max(a, b)}});
+    }
+  }
+  vtkSMPTools::Sort(edges.begin(), edges.end());
+
+  auto numberOfPoints = mesh->GetNumberOfPoints();
+  std::vector<char> fixed(numberOfPoints, 0);
+  std::vector<std::array<vtkIdType, 2>> unique;
+  unique.reserve(edges.size() / 2);
+  for (std::size_t i = 0; i < edges.size();)
+  {
+    std::size_t j = i + 1;
+    while (j < edges.size() && edges[j] == edges[i])
+    {
+      ++j;
+    }
+    if (j - i != 2)
+    {
+      // Boundary or non-manifold edge.
+      fixed[edges[i][0]] = 1;
+      fixed[edges[i][1]] = 1;
+    }
+    unique.push_back(edges[i]);
+    i = j;
+  }
+
+  // Count, then fill, the neighbors of the free vertices.
+  this->Offsets.assign(numberOfPoints + 1, 0);
+  for (auto const& e : unique)
+  {
+    this->Offsets[e[0] + 1] += fixed[e[0]] ? 0 : 1;
+    this->Offsets[e[1] + 1] += fixed[e[1]] ? 0 : 1;
+  }
+  for (vtkIdType i = 0; i < numberOfPoints; ++i)
+  {
+    this->Offsets[i + 1] += this->Offsets[i];
+  }
+  this->Neighbors.resize(this->Offsets[numberOfPoints]);
+  std::vector<vtkIdType> next(this->Offsets.begin(), this->Offsets.end() - 1);
+  for (auto const& e : unique)
+  {
+    if (!fixed[e[0]])
+    {
+      this->Neighbors[next[e[0]]++] = e[1];
+    }
+    if (!fixed[e[1]])
+    {
+      this->Neighbors[next[e[1]]++] = e[0];
+    }
+  }
+}
+
+void LaplacianSmooth(Adjacency const& adjacency, Coordinates& coordinates,
+                     int numberOfIterations, double relaxationFactor)
+{
+  // Jacobi iterations x <- x + r (W x - x), ping-ponging between two
+  // buffers so that every thread reads only the previous iterate.
+  Coordinates other;
+  other.Resize(coordinates.X.size());
+  Coordinates* in = &coordinates;
+  Coordinates* out = &other;
+  for (int iteration = 0; iteration < numberOfIterations; ++iteration)
+  {
+    Average(adjacency, *in,
+            [&](vtkIdType i, double x, double y, double z) {
+              out->X[i] = in->X[i] + relaxationFactor * (x - in->X[i]);
+              out->Y[i] = in->Y[i] + relaxationFactor * (y - in->Y[i]);
+              out->Z[i] = in->Z[i] + relaxationFactor * (z - in->Z[i]);
+            });
+    std::swap(in, out);
+  }
+  if (in != &coordinates)
+  {
+    coordinates = *in;
+  }
+}
+
+void WindowedSincSmooth(Adjacency const& adjacency, Coordinates& coordinates,
+                        int numberOfIterations, double passBand)
+{
+  // The filter is a polynomial in the averaging matrix W expanded in
+  // Chebyshev polynomials, f(W) = sum_j w_j c_j T_j(W), where c_j are the
+  // coefficients of an ideal low pass filter with cutoff theta =
+  // acos(1 - passBand) and w_j is a Hamming window. The terms follow the
+  // recurrence T_0 x = x, T_1 x = W x, T_j+1 x = 2 W T_j x - T_j-1 x.
+  const double pi = std::acos(-1.0);
+  int n = std::max(numberOfIterations, 1);
+  double theta = std::acos(1.0 - std::min(std::max(passBand, 0.0), 2.0));
+  std::vector<double> weights(n + 1);
+  double sum = 0.0;
+  for (int j = 0; j <= n; ++j)
+  {
+    double c = j == 0 ? theta / pi : 2.0 * std::sin(j * theta) / (j * pi);
+    double w = 0.54 + 0.46 * std::cos(j * pi / (n + 1));
+    weights[j] = w * c;
+    sum += weights[j];
+  }
+  // Normalize so that f(1) = 1, which leaves a flat mesh unchanged.
+  for (auto& weight : weights)
+  {
+    weight /= sum;
+  }
+
+  auto size = coordinates.X.size();
+  Coordinates previous = coordinates;
+  Coordinates current, next, result;
+  current.Resize(size);
+  next.Resize(size);
+  result.Resize(size);
+  Average(adjacency, previous,
+          [&](vtkIdType i, double x, double y, double z) {
+            current.X[i] = x;
+            current.Y[i] = y;
+            current.Z[i] = z;
+            result.X[i] = weights[0] * previous.X[i] + weights[1] * x;
+            result.Y[i] = weights[0] * previous.Y[i] + weights[1] * y;
+            result.Z[i] = weights[0] * previous.Z[i] + weights[1] * z;
+          });
+  for (int j = 1; j < n; ++j)
+  {
+    // Compute the next term and accumulate it in the same sweep.
+    double weight = weights[j + 1];
+    Average(adjacency, current,
+            [&](vtkIdType i, double x, double y, double z) {
+              next.X[i] = 2.0 * x - previous.X[i];
+              next.Y[i] = 2.0 * y - previous.Y[i];
+              next.Z[i] = 2.0 * z - previous.Z[i];
+              result.X[i] += weight * next.X[i];
+              result.Y[i] += weight * next.Y[i];
+              result.Z[i] += weight * next.Z[i];
+            });
+    std::swap(previous, current);
+    std::swap(current, next);
+  }
+  coordinates = std::move(result);
+}
+
+void ToCoordinates(vtkPoints* points, Coordinates& coordinates)
+{
+  auto n = points->GetNumberOfPoints();
+  coordinates.Resize(n);
+  vtkSMPTools::For(0, n, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      double x[3];
+      points->GetPoint(i, x);
+      coordinates.X[i] = x[0];
+      coordinates.Y[i] = x[1];
+      coordinates.Z[i] = x[2];
+    }
+  });
+}
+
+double MaximumDifference(Coordinates const& coordinates, vtkPoints* points)
+{
+  double maximum = 0.0;
+  for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+  {
+    double x[3];
+    points->GetPoint(i, x);
+    maximum = std::max(maximum, std::abs(x[0] - coordinates.X[i]));
+    maximum = std::max(maximum, std::abs(x[1] - coordinates.Y[i]));
+    maximum = std::max(maximum, std::abs(x[2] - coordinates.Z[i]));
+  }
+  return maximum;
+}
+
+vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName)
+{
+  vtkSmartPointer<vtkPolyData> polyData;
+  std::string extension =
+      vtksys::SystemTools::GetFilenameExtension(std::string(fileName));
+  if (extension == ".ply")
+  {
+    vtkNew<vtkPLYReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".vtp")
+  {
+    vtkNew<vtkXMLPolyDataReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".obj")
+  {
+    vtkNew<vtkOBJReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".stl")
+  {
+    vtkNew<vtkSTLReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".vtk")
+  {
+    vtkNew<vtkPolyDataReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".g")
+  {
+    vtkNew<vtkBYUReader> reader;
+    reader->SetGeometryFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else
+  {
+    // A noisy sphere.
+    vtkNew<vtkSphereSource> source;
+    source->SetPhiResolution(400);
+    source->SetThetaResolution(800);
+    source->Update();
+    polyData = source->GetOutput();
+    std::mt19937 generator(5127);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    auto points = polyData->GetPoints();
+    for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+    {
+      double x[3];
+      points->GetPoint(i, x);
+      points->SetPoint(i, x[0] + noise(generator), x[1] + noise(generator),
+                       x[2] + noise(generator));
+    }
+  }
+  return polyData;
+}
+} // namespace
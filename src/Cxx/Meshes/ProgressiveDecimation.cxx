@@ -0,0 +1,890 @@
+#include <vtkCellArray.h>
+#include <vtkCleanPolyData.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+#include <vtkTriangleFilter.h>
+#include <vtkXMLPolyDataWriter.h>
+
+// Readers
+#include <vtkBYUReader.h>
+#include <vtkOBJReader.h>
+#include <vtkPLYReader.h>
+#include <vtkPolyDataReader.h>
+#include <vtkSTLReader.h>
+#include <vtkXMLPolyDataReader.h>
+
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+typedef std::array<vtkIdType, 3> Triangle;
+
+// One step of the progressive mesh: Remove is merged into Keep, and Keep
+// moves to Position.
+struct Collapse
+{
+  vtkIdType Keep;
+  vtkIdType Remove;
+  double Position[3];
+  double Error;
+  int FacesRemoved;
+};
+
+// Garland-Heckbert error quadric stored as the upper triangle of a
+// symmetric 4x4 matrix.
+struct Quadric
+{
+  double A[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+  void AddPlane(const double n[3], double d, double weight);
+  double Evaluate(const double x[3]) const;
+  bool Minimize(double x[3]) const;
+  Quadric& operator+=(Quadric const& other);
+};
+
+// Edge collapse simplifier that records every collapse it performs.
+// Locked vertices never move and are never removed.
+class EdgeCollapseSimplifier
+{
+public:
+  EdgeCollapseSimplifier(std::vector<double> const& points,
+                         std::vector<Triangle> const& triangles,
+                         std::vector<char> const& locked);
+
+  // Collapse edges in order of increasing error until no legal collapse is
+  // left or the time budget (in seconds, <= 0 for none) runs out. Returns
+  // false if it was interrupted. The recorded prefix is valid either way.
+  bool Run(double timeBudget, std::vector<Collapse>& collapses);
+
+private:
+  struct Candidate
+  {
+    double Cost;
+    vtkIdType U;
+    vtkIdType V;
+    unsigned int StampU;
+    unsigned int StampV;
+    double Position[3];
+
+    bool operator>(Candidate const& other) const
+    {
+      return this->Cost > other.Cost;
+    }
+  };
+
+  void PushEdge(vtkIdType u, vtkIdType v);
+  void Neighbors(vtkIdType v, std::vector<vtkIdType>& neighbors) const;
+  bool IsLegal(vtkIdType u, vtkIdType v, const double p[3]) const;
+  bool Flips(vtkIdType f, vtkIdType moved, const double p[3]) const;
+  int Apply(vtkIdType u, vtkIdType v, const double p[3]);
+
+  std::vector<double> Points;
+  std::vector<Triangle> Triangles;
+  std::vector<char> Locked;
+  std::vector<char> Removed;
+  std::vector<unsigned int> Stamps;
+  std::vector<Quadric> Quadrics;
+  std::vector<std::vector<vtkIdType>> VertexFaces;
+  std::priority_queue<Candidate, std::vector<Candidate>,
+                      std::greater<Candidate>>
+      Heap;
+};
+
+// Applies a prefix of a collapse sequence to the original mesh.
+class LODReplayer
+{
+public:
+  LODReplayer(std::vector<double> const& points,
+              std::vector<Triangle> const& triangles,
+              std::vector<Collapse> const& collapses);
+
+  // Apply the collapses up to count (which never decreases between calls)
+  // and return the resulting mesh.
+  vtkSmartPointer<vtkPolyData> Advance(std::size_t count);
+
+private:
+  vtkIdType Find(vtkIdType v);
+
+  std::vector<double> Points;
+  std::vector<Triangle> const& Triangles;
+  std::vector<Collapse> const& Collapses;
+  std::vector<vtkIdType> Parent;
+  std::size_t Applied = 0;
+};
+
+std::vector<Collapse> RecordCollapses(std::vector<double> const& points,
+                                      std::vector<Triangle> const& triangles,
+                                      int numberOfPartitions,
+                                      double timeBudget, bool& complete);
+
+vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  auto polyData = ReadPolyData(argc > 1 ? argv[1] : "");
+  int numberOfPartitions = argc > 2 ? std::max(1, std::stoi(argv[2])) : 1;
+  double timeBudget = argc > 3 ? std::stod(argv[3]) : 0.0;
+  std::string outputPrefix = argc > 4 ? argv[4] : "";
+
+  vtkNew<vtkTriangleFilter> triangleFilter;
+  triangleFilter->SetInputData(polyData);
+  vtkNew<vtkCleanPolyData> clean;
+  clean->SetInputConnection(triangleFilter->GetOutputPort());
+  clean->Update();
+  vtkSmartPointer<vtkPolyData> mesh = clean->GetOutput();
+
+  std::vector<double> points(3 * mesh->GetNumberOfPoints());
+  for (vtkIdType i = 0; i < mesh->GetNumberOfPoints(); ++i)
+  {
+    mesh->GetPoint(i, &points[3 * i]);
+  }
+  std::vector<Triangle> triangles;
+  triangles.reserve(mesh->GetNumberOfPolys());
+  auto polys = mesh->GetPolys();
+  vtkIdType npts;
+#ifdef VTK_CELL_ARRAY_V2
+  const vtkIdType* pts;
+#else // VTK_CELL_ARRAY_V2
+  vtkIdType* pts;
+#endif // VTK_CELL_ARRAY_V2
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+  {
+    if (npts == 3)
+    {
+      triangles.push_back(Triangle{{pts[0], pts[1], pts[2]}});
+    }
+  }
+  auto numberOfTriangles = static_cast<vtkIdType>(triangles.size());
+  std::cout << "# of points:    " << mesh->GetNumberOfPoints() << std::endl;
+  std::cout << "# of triangles: " << numberOfTriangles << std::endl;
+
+  // Record the collapse sequence once.
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  bool complete = true;
+  auto collapses = RecordCollapses(points, triangles, numberOfPartitions,
+                                   timeBudget, complete);
+  timer->StopTimer();
+  double recordTime = timer->GetElapsedTime();
+  std::cout << "Recorded " << collapses.size() << " collapses in "
+            << recordTime << "s using " << numberOfPartitions
+            << " partition(s)" << (complete ? "" : " (interrupted)")
+            << std::endl;
+
+  // Number of triangles left and the error bound after each prefix.
+  std::vector<vtkIdType> remaining(collapses.size() + 1, numberOfTriangles);
+  std::vector<double> errorBound(collapses.size() + 1, 0.0);
+  for (std::size_t i = 0; i < collapses.size(); ++i)
+  {
+    remaining[i + 1] = remaining[i] - collapses[i].FacesRemoved;
+    errorBound[i + 1] = std::max(errorBound[i], collapses[i].Error);
+  }
+
+  // Emit the levels of detail from the one sequence.
+  std::vector<double> reductions{0.5, 0.75, 0.9, 0.95, 0.98};
+  LODReplayer replayer(points, triangles, collapses);
+  double emitTime = 0.0;
+  std::cout << "Level  Reduction  Triangles  ErrorBound  Time" << std::endl;
+  for (std::size_t level = 0; level < reductions.size(); ++level)
+  {
+    auto target =
+        static_cast<vtkIdType>((1.0 - reductions[level]) * numberOfTriangles);
+    auto count = static_cast<std::size_t>(
+        std::find_if(remaining.begin(), remaining.end(),
+                     [target](vtkIdType n) { return n <= target; }) -
+        remaining.begin());
+    count = std::min(count, collapses.size());
+
+    timer->StartTimer();
+    auto lod = replayer.Advance(count);
+    timer->StopTimer();
+    emitTime += timer->GetElapsedTime();
+    std::cout << level << "      " << reductions[level] << "       "
+              << lod->GetNumberOfPolys() << "      " << errorBound[count]
+              << "      " << timer->GetElapsedTime() << "s" << std::endl;
+
+    if (!outputPrefix.empty())
+    {
+      std::ostringstream fileName;
+      fileName << outputPrefix << "_LOD" << level << ".vtp";
+      vtkNew<vtkXMLPolyDataWriter> writer;
+      writer->SetFileName(fileName.str().c_str());
+      writer->SetInputData(lod);
+      writer->Write();
+    }
+  }
+  std::cout << "Progressive total: " << recordTime + emitTime << "s"
+            << std::endl;
+
+  // For comparison, run vtkQuadricDecimation once per level.
+  double decimateTime = 0.0;
+  for (auto reduction : reductions)
+  {
+    vtkNew<vtkQuadricDecimation> decimate;
+    decimate->SetInputData(mesh);
+    decimate->SetTargetReduction(reduction);
+    timer->StartTimer();
+    decimate->Update();
+    timer->StopTimer();
+    decimateTime += timer->GetElapsedTime();
+    std::cout << "vtkQuadricDecimation " << reduction << ": "
+              << decimate->GetOutput()->GetNumberOfPolys() << " triangles in "
+              << timer->GetElapsedTime() << "s" << std::endl;
+  }
+  std::cout << "vtkQuadricDecimation total: " << decimateTime << "s"
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+namespace {
+void Quadric::AddPlane(const double n[3], double d, double weight)
+{
+  const double p[4] = {n[0], n[1], n[2], d};
+  int k = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    for (int j = i; j < 4; ++j)
+    {
+      this->A[k++] += weight * p[i] * p[j];
+    }
+  }
+}
+
+double Quadric::Evaluate(const double x[3]) const
+{
+  const double p[4] = {x[0], x[1], x[2], 1.0};
+  double sum = 0.0;
+  int k = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    for (int j = i; j < 4; ++j)
+    {
+      sum += (i == j ? 1.0 : 2.0) * this->A[k++] * p[i] * p[j];
+    }
+  }
+  return sum;
+}
+
+bool Quadric::Minimize(double x[3]) const
+{
+  // Solve the 3x3 system [A] x = -b by Cramer's rule.
+  const double* a = this->A;
+  double m[3][3] = {{a[0], a[1], a[2]}, {a[1], a[4], a[5]}, {a[2], a[5], a[7]}};
+  double b[3] = {-a[3], -a[6], -a[8]};
+  double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+      m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+      m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+  double scale = m[0][0] + m[1][1] + m[2][2];
+  if (std::abs(det) <= 1.0e-9 * scale * scale * scale)
+  {
+    return false;
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    double mc[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        mc[i][j] = j == c ? b[i] : m[i][j];
+      }
+    }
+    x[c] = (mc[0][0] * (mc[1][1] * mc[2][2] - mc[1][2] * mc[2][1]) -
+            mc[0][1] * (mc[1][0] * mc[2][2] - mc[1][2] * mc[2][0]) +
+            mc[0][2] * (mc[1][0] * mc[2][1] - mc[1][1] * mc[2][0])) /
+        det;
+  }
+  return true;
+}
+
+Quadric& Quadric::operator+=(Quadric const& other)
+{
+  for (int i = 0; i < 10; ++i)
+  {
+    this->A[i] += other.A[i];
+  }
+  return *this;
+}
+
+void Normal(const double* a, const double* b, const double* c, double n[3])
+{
+  double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+  n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+EdgeCollapseSimplifier::EdgeCollapseSimplifier(
+    std::vector<double> const& points, std::vector<Triangle> const& triangles,
+    std::vector<char> const& locked)
+  : Points(points), Triangles(triangles), Locked(locked)
+{
+  auto numberOfPoints = this->Points.size() / 3;
+  this->Removed.assign(numberOfPoints, 0);
+  this->Stamps.assign(numberOfPoints, 0);
+  this->Quadrics.resize(numberOfPoints);
+  this->VertexFaces.resize(numberOfPoints);
+
+  // Face quadrics, weighted by area.
+  std::vector<std::array<vtkIdType, 3>> edges;
+  edges.reserve(3 * this->Triangles.size());
+  for (std::size_t f = 0; f < this->Triangles.size(); ++f)
+  {
+    auto const& t = this->Triangles[f];
+    double n[3];
+    Normal(&this->Points[3 * t[0]], &this->Points[3 * t[1]],
+           &this->Points[3 * t[2]], n);
+    double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.0)
+    {
+      n[0] /= length;
+      n[1] /= length;
+      n[2] /= length;
+      const double* a = &this->Points[3 * t[0]];
+      double d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+      for (int i = 0; i < 3; ++i)
+      {
+        this->Quadrics[t[i]].AddPlane(n, d, 0.5 * length);
+      }
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      this->VertexFaces[t[i]].push_back(static_cast<vtkIdType>(f));
+      vtkIdType a = t[i];
+      vtkIdType b = t[(i + 1) % 3];
+      edges.push_back({{std::min(a, b), std::max(a, b),
+                        static_cast<vtkIdType>(f)}});
+    }
+  }
+
+  // Boundary edges get a perpendicular plane so that open boundaries keep
+  // their shape.
+  std::sort(edges.begin(), edges.end());
+  for (std::size_t i = 0; i < edges.size();)
+  {
+    std::size_t j = i;
+    while (j < edges.size() && edges[j][0] == edges[i][0] &&
+           edges[j][1] == edges[i][1])
+    {
+      ++j;
+    }
+    if (j - i == 1)
+    {
+      auto const& t = this->Triangles[edges[i][2]];
+      const double* a = &this->Points[3 * edges[i][0]];
+      const double* b = &this->Points[3 * edges[i][1]];
+      double n[3];
+      Normal(&this->Points[3 * t[0]], &this->Points[3 * t[1]],
+             &this->Points[3 * t[2]], n);
+      double e[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      double m[3] = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2],
+                     e[0] * n[1] - e[1] * n[0]};
+      double length = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+      if (length > 0.0)
+      {
+        m[0] /= length;
+        m[1] /= length;
+        m[2] /= length;
+        double d = -(m[0] * a[0] + m[1] * a[1] + m[2] * a[2]);
+        double weight = 100.0 * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+        this->Quadrics[edges[i][0]].AddPlane(m, d, weight);
+        this->Quadrics[edges[i][1]].AddPlane(m, d, weight);
+      }
+    }
+    i = j;
+  }
+
+  // Queue each edge once.
+  for (std::size_t i = 0; i < edges.size(); ++i)
+  {
+    if (i == 0 || edges[i][0] != edges[i - 1][0] ||
+        edges[i][1] != edges[i - 1][1])
+    {
+      this->PushEdge(edges[i][0], edges[i][1]);
+    }
+  }
+}
+
+void EdgeCollapseSimplifier::PushEdge(vtkIdType u, vtkIdType v)
+{
+  if (this->Locked[u] && this->Locked[v])
+  {
+    return;
+  }
+  if (this->Locked[v])
+  {
+    std::swap(u, v);
+  }
+  Candidate c;
+  c.U = u;
+  c.V = v;
+  c.StampU = this->Stamps[u];
+  c.StampV = this->Stamps[v];
+  Quadric q = this->Quadrics[u];
+  q += this->Quadrics[v];
+  const double* pu = &this->Points[3 * u];
+  const double* pv = &this->Points[3 * v];
+  if (this->Locked[u] || !q.Minimize(c.Position))
+  {
+    // Fall back to the best of the end points and the midpoint.
+    double mid[3] = {0.5 * (pu[0] + pv[0]), 0.5 * (pu[1] + pv[1]),
+                     0.5 * (pu[2] + pv[2])};
+    const double* choices[3] = {pu, pv, mid};
+    int count = this->Locked[u] ? 1 : 3;
+    double best = VTK_DOUBLE_MAX;
+    for (int i = 0; i < count; ++i)
+    {
+      double cost = q.Evaluate(choices[i]);
+      if (cost < best)
+      {
+        best = cost;
+        std::copy(choices[i], choices[i] + 3, c.Position);
+      }
+    }
+  }
+  c.Cost = std::max(q.Evaluate(c.Position), 0.0);
+  this->Heap.push(c);
+}
+
+void EdgeCollapseSimplifier::Neighbors(vtkIdType v,
+                                       std::vector<vtkIdType>& neighbors) const
+{
+  neighbors.clear();
+  for (auto f : this->VertexFaces[v])
+  {
+    for (auto w : this->Triangles[f])
+    {
+      if (w != v)
+      {
+        neighbors.push_back(w);
+      }
+    }
+  }
+  std::sort(neighbors.begin(), neighbors.end());
+  neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                  neighbors.end());
+}
+
+bool EdgeCollapseSimplifier::Flips(vtkIdType f, vtkIdType moved,
+                                   const double p[3]) const
+{
+  auto const& t = this->Triangles[f];
+  const double* x[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    x[i] = t[i] == moved ? p : &this->Points[3 * t[i]];
+  }
+  double before[3], after[3];
+  Normal(&this->Points[3 * t[0]], &this->Points[3 * t[1]],
+         &this->Points[3 * t[2]], before);
+  Normal(x[0], x[1], x[2], after);
+  return before[0] * after[0] + before[1] * after[1] +
+      before[2] * after[2] <=
+      0.0;
+}
+
+bool EdgeCollapseSimplifier::IsLegal(vtkIdType u, vtkIdType v,
+                                     const double p[3]) const
+{
+  // The edge must still exist.
+  std::size_t shared = 0;
+  for (auto f : this->VertexFaces[v])
+  {
+    auto const& t = this->Triangles[f];
+    if (t[0] == u || t[1] == u || t[2] == u)
+    {
+      ++shared;
+    }
+  }
+  if (shared == 0)
+  {
+    return false;
+  }
+
+  // Link condition: the only common neighbors of u and v are the vertices
+  // opposite the edge, otherwise the collapse makes the mesh non-manifold.
+  std::vector<vtkIdType> nu, nv, common;
+  this->Neighbors(u, nu);
+  this->Neighbors(v, nv);
+  std::set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(),
+                        std::back_inserter(common));
+  if (common.size() != shared)
+  {
+    return false;
+  }
+
+  // Reject collapses that fold a triangle over.
+  for (auto w : {u, v})
+  {
+    for (auto f : this->VertexFaces[w])
+    {
+      auto const& t = this->Triangles[f];
+      bool hasBoth = (t[0] == u || t[1] == u || t[2] == u) &&
+          (t[0] == v || t[1] == v || t[2] == v);
+      if (!hasBoth && this->Flips(f, w, p))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int EdgeCollapseSimplifier::Apply(vtkIdType u, vtkIdType v, const double p[3])
+{
+  int facesRemoved = 0;
+  for (auto f : this->VertexFaces[v])
+  {
+    auto& t = this->Triangles[f];
+    if (t[0] == u || t[1] == u || t[2] == u)
+    {
+      // The face degenerates; detach it from its other vertices.
+      for (auto w : t)
+      {
+        if (w != v)
+        {
+          auto& faces = this->VertexFaces[w];
+          faces.erase(std::remove(faces.begin(), faces.end(), f),
+                      faces.end());
+        }
+      }
+      ++facesRemoved;
+    }
+    else
+    {
+      std::replace(t.begin(), t.end(), v, u);
+      this->VertexFaces[u].push_back(f);
+    }
+  }
+  this->VertexFaces[v].clear();
+  std::copy(p, p + 3, &this->Points[3 * u]);
+  this->Quadrics[u] += this->Quadrics[v];
+  this->Removed[v] = 1;
+  ++this->Stamps[u];
+  ++this->Stamps[v];
+
+  std::vector<vtkIdType> neighbors;
+  this->Neighbors(u, neighbors);
+  for (auto w : neighbors)
+  {
+    this->PushEdge(u, w);
+  }
+  return facesRemoved;
+}
+
+bool EdgeCollapseSimplifier::Run(double timeBudget,
+                                 std::vector<Collapse>& collapses)
+{
+  auto start = std::chrono::steady_clock::now();
+  while (!this->Heap.empty())
+  {
+    Candidate c = this->Heap.top();
+    this->Heap.pop();
+    if (this->Removed[c.U] || this->Removed[c.V] ||
+        this->Stamps[c.U] != c.StampU || this->Stamps[c.V] != c.StampV ||
+        !this->IsLegal(c.U, c.V, c.Position))
+    {
+      continue;
+    }
+    Collapse collapse;
+    collapse.Keep = c.U;
+    collapse.Remove = c.V;
+    std::copy(c.Position, c.Position + 3, collapse.Position);
+    collapse.Error = c.Cost;
+    collapse.FacesRemoved = this->Apply(c.U, c.V, c.Position);
+    collapses.push_back(collapse);
+
+    if (timeBudget > 0.0 && collapses.size() % 1024 == 0 &&
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      start)
+                .count() > timeBudget)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+LODReplayer::LODReplayer(std::vector<double> const& points,
+                         std::vector<Triangle> const& triangles,
+                         std::vector<Collapse> const& collapses)
+  : Points(points), Triangles(triangles), Collapses(collapses)
+{
+  this->Parent.resize(this->Points.size() / 3);
+  for (std::size_t i = 0; i < this->Parent.size(); ++i)
+  {
+    this->Parent[i] = static_cast<vtkIdType>(i);
+  }
+}
+
+vtkIdType LODReplayer::Find(vtkIdType v)
+{
+  while (this->Parent[v] != v)
+  {
+    this->Parent[v] = this->Parent[this->Parent[v]];
+    v = this->Parent[v];
+  }
+  return v;
+}
+
+vtkSmartPointer<vtkPolyData> LODReplayer::Advance(std::size_t count)
+{
+  for (; this->Applied < count; ++this->Applied)
+  {
+    auto const& c = this->Collapses[this->Applied];
+    this->Parent[c.Remove] = c.Keep;
+    std::copy(c.Position, c.Position + 3, &this->Points[3 * c.Keep]);
+  }
+
+  std::vector<vtkIdType> outputId(this->Parent.size(), -1);
+  vtkNew<vtkPoints> points;
+  vtkNew<vtkCellArray> polys;
+  for (auto const& t : this->Triangles)
+  {
+    vtkIdType ids[3] = {this->Find(t[0]), this->Find(t[1]), this->Find(t[2])};
+    if (ids[0] == ids[1] || ids[1] == ids[2] || ids[2] == ids[0])
+    {
+      continue;
+    }
+    for (auto& id : ids)
+    {
+      if (outputId[id] < 0)
+      {
+        outputId[id] = points->InsertNextPoint(&this->Points[3 * id]);
+      }
+      id = outputId[id];
+    }
+    polys->InsertNextCell(3, ids);
+  }
+  auto lod = vtkSmartPointer<vtkPolyData>::New();
+  lod->SetPoints(points);
+  lod->SetPolys(polys);
+  return lod;
+}
+
+std::vector<Collapse> RecordCollapses(std::vector<double> const& points,
+                                      std::vector<Triangle> const& triangles,
+                                      int numberOfPartitions,
+                                      double timeBudget, bool& complete)
+{
+  complete = true;
+  if (triangles.empty())
+  {
+    return std::vector<Collapse>();
+  }
+
+  // Partition the triangles into slabs of equal count along the longest
+  // axis of the bounding box.
+  double bounds[6] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX,
+                      VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN};
+  for (std::size_t i = 0; i < points.size(); ++i)
+  {
+    bounds[2 * (i % 3)] = std::min(bounds[2 * (i % 3)], points[i]);
+    bounds[2 * (i % 3) + 1] = std::max(bounds[2 * (i % 3) + 1], points[i]);
+  }
+  int axis = 0;
+  for (int i = 1; i < 3; ++i)
+  {
+    if (bounds[2 * i + 1] - bounds[2 * i] >
+        bounds[2 * axis + 1] - bounds[2 * axis])
+    {
+      axis = i;
+    }
+  }
+  std::vector<double> keys(triangles.size());
+  for (std::size_t f = 0; f < triangles.size(); ++f)
+  {
+    keys[f] = points[3 * triangles[f][0] + axis] +
+        points[3 * triangles[f][1] + axis] + points[3 * triangles[f][2] + axis];
+  }
+  std::vector<double> sorted(keys);
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<double> splits;
+  for (int s = 1; s < numberOfPartitions; ++s)
+  {
+    splits.push_back(sorted[(s * sorted.size()) / numberOfPartitions]);
+  }
+
+  // Vertices used by more than one slab are locked.
+  std::vector<std::vector<Triangle>> slabTriangles(numberOfPartitions);
+  std::vector<int> vertexSlab(points.size() / 3, -1);
+  std::vector<char> locked(points.size() / 3, 0);
+  for (std::size_t f = 0; f < triangles.size(); ++f)
+  {
+    auto slab = static_cast<int>(
+        std::upper_bound(splits.begin(), splits.end(), keys[f]) -
+        splits.begin());
+    slabTriangles[slab].push_back(triangles[f]);
+    for (auto v : triangles[f])
+    {
+      if (vertexSlab[v] < 0)
+      {
+        vertexSlab[v] = slab;
+      }
+      else if (vertexSlab[v] != slab)
+      {
+        locked[v] = 1;
+      }
+    }
+  }
+
+  // Simplify the slabs in parallel. The slabs share only locked vertices,
+  // so their collapses are independent of each other.
+  std::vector<std::vector<Collapse>> slabCollapses(numberOfPartitions);
+  std::vector<char> slabComplete(numberOfPartitions, 1);
+  vtkSMPTools::For(0, numberOfPartitions, 1, [&](vtkIdType begin,
+                                                 vtkIdType end) {
+    for (vtkIdType s = begin; s < end; ++s)
+    {
+      // Renumber the slab vertices.
+      std::vector<vtkIdType> localToGlobal;
+      for (auto const& t : slabTriangles[s])
+      {
+        localToGlobal.insert(localToGlobal.end(), t.begin(), t.end());
+      }
+      std::sort(localToGlobal.begin(), localToGlobal.end());
+      localToGlobal.erase(
+          std::unique(localToGlobal.begin(), localToGlobal.end()),
+          localToGlobal.end());
+      auto toLocal = [&localToGlobal](vtkIdType v) {
+        return static_cast<vtkIdType>(
+            std::lower_bound(localToGlobal.begin(), localToGlobal.end(), v) -
+            localToGlobal.begin());
+      };
+      std::vector<double> localPoints(3 * localToGlobal.size());
+      std::vector<char> localLocked(localToGlobal.size());
+      for (std::size_t i = 0; i < localToGlobal.size(); ++i)
+      {
+        std::copy(&points[3 * localToGlobal[i]],
+                  &points[3 * localToGlobal[i]] + 3, &localPoints[3 * i]);
+        localLocked[i] = locked[localToGlobal[i]];
+      }
+      std::vector<Triangle> localTriangles;
+      localTriangles.reserve(slabTriangles[s].size());
+      for (auto const& t : slabTriangles[s])
+      {
+        localTriangles.push_back(
+            Triangle{{toLocal(t[0]), toLocal(t[1]), toLocal(t[2])}});
+      }
+
+      EdgeCollapseSimplifier simplifier(localPoints, localTriangles,
+                                        localLocked);
+      slabComplete[s] = simplifier.Run(timeBudget, slabCollapses[s]);
+      for (auto& c : slabCollapses[s])
+      {
+        c.Keep = localToGlobal[c.Keep];
+        c.Remove = localToGlobal[c.Remove];
+      }
+    }
+  });
+
+  // Merge the slab sequences by error. Any interleaving that keeps the order
+  // within each slab is a valid global sequence.
+  complete = std::all_of(slabComplete.begin(), slabComplete.end(),
+                         [](char c) { return c != 0; });
+  typedef std::pair<double, std::pair<int, std::size_t>> Head;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  std::size_t total = 0;
+  for (int s = 0; s < numberOfPartitions; ++s)
+  {
+    total += slabCollapses[s].size();
+    if (!slabCollapses[s].empty())
+    {
+      heads.push(Head(slabCollapses[s][0].Error, std::make_pair(s, 0)));
+    }
+  }
+  std::vector<Collapse> collapses;
+  collapses.reserve(total);
+  while (!heads.empty())
+  {
+    auto head = heads.top();
+    heads.pop();
+    auto s = head.second.first;
+    auto i = head.second.second;
+    collapses.push_back(slabCollapses[s][i]);
+    if (++i < slabCollapses[s].size())
+    {
+      heads.push(Head(slabCollapses[s][i].Error, std::make_pair(s, i)));
+    }
+  }
+  return collapses;
+}
+
+vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName)
+{
+  vtkSmartPointer<vtkPolyData> polyData;
+  std::string extension =
+      vtksys::SystemTools::GetFilenameExtension(std::string(fileName));
+  if (extension == ".ply")
+  {
+    vtkNew<vtkPLYReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".vtp")
+  {
+    vtkNew<vtkXMLPolyDataReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".obj")
+  {
+    vtkNew<vtkOBJReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".stl")
+  {
+    vtkNew<vtkSTLReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".vtk")
+  {
+    vtkNew<vtkPolyDataReader> reader;
+    reader->SetFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else if (extension == ".g")
+  {
+    vtkNew<vtkBYUReader> reader;
+    reader->SetGeometryFileName(fileName);
+    reader->Update();
+    polyData = reader->GetOutput();
+  }
+  else
+  {
+    vtkNew<vtkSphereSource> source;
+    source->SetPhiResolution(200);
+    source->SetThetaResolution(200);
+    source->Update();
+    polyData = source->GetOutput();
+  }
+  return polyData;
+}
+} // namespace
@@ -0,0 +1,574 @@
+#include <vtkCellArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkMarchingCubesTriangleCases.h>
+#include <vtkMetaImageReader.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace {
+// A two level min/max pyramid over blocks of 8^3 cells, built once per
+// volume. An isosurface only goes through the blocks whose range holds
+// the isovalue, so on each isovalue change only those blocks are read.
+// A superblock of 8^3 blocks is skipped with one test.
+//
+// Contour() makes the marching cubes surface of the candidate blocks in
+// two parallel passes. Each block first makes the points of the crossing
+// edges that start at the vertices it owns, then its triangles, which
+// look the points up in the block that owns them. Points are shared
+// across blocks, so the mesh is the same as vtkMarchingCubes makes.
+class MinMaxTree
+{
+public:
+  void Build(vtkImageData* volume);
+  vtkSmartPointer<vtkPolyData> Contour(double value);
+
+  vtkIdType GetNumberOfBlocks() const
+  {
+    return static_cast<vtkIdType>(this->BlockMin.size());
+  }
+  vtkIdType GetNumberOfVisitedBlocks() const
+  {
+    return static_cast<vtkIdType>(this->Candidates.size());
+  }
+
+  static const int BlockSize = 8;
+
+private:
+  template <typename T> void BuildBlocks(const T* scalars);
+  template <typename T>
+  vtkSmartPointer<vtkPolyData> ContourBlocks(const T* scalars, double value);
+  void FindCandidates(double value);
+
+  // The vertices along one axis that a block owns: its cells' first
+  // vertices, and for the last block the last vertex too.
+  int OwnedVertices(int axis, int block) const
+  {
+    return block == this->NumberOfBlocks[axis] - 1
+        ? this->Dimensions[axis] - block * BlockSize
+        : BlockSize;
+  }
+  int OwnerBlock(int axis, int vertex) const
+  {
+    return std::min(vertex / BlockSize, this->NumberOfBlocks[axis] - 1);
+  }
+  vtkIdType BlockIndex(int i, int j, int k) const
+  {
+    return i + this->NumberOfBlocks[0] *
+        (j + static_cast<vtkIdType>(this->NumberOfBlocks[1]) * k);
+  }
+
+  vtkImageData* Volume = nullptr;
+  int Dimensions[3];
+  int NumberOfBlocks[3];
+  int NumberOfSuperBlocks[3];
+  std::vector<double> BlockMin;
+  std::vector<double> BlockMax;
+  std::vector<double> SuperBlockMin;
+  std::vector<double> SuperBlockMax;
+
+  // Per contour: the candidate blocks, and for each block its position in
+  // the candidates or -1.
+  std::vector<vtkIdType> Candidates;
+  std::vector<int> CandidateOf;
+};
+
+vtkSmartPointer<vtkImageData> MakeBlobs(int dimension);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [volume.mhd [numberOfTicks]].
+  vtkSmartPointer<vtkImageData> volume;
+  if (argc > 1)
+  {
+    vtkNew<vtkMetaImageReader> reader;
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    volume = reader->GetOutput();
+  }
+  else
+  {
+    volume = MakeBlobs(160);
+  }
+  int numberOfTicks = argc > 2 ? std::atoi(argv[2]) : 10;
+  int* dimensions = volume->GetDimensions();
+  double range[2];
+  volume->GetScalarRange(range);
+  std::cout << "Volume: " << dimensions[0] << " x " << dimensions[1] << " x "
+            << dimensions[2] << ", range " << range[0] << " to " << range[1]
+            << std::endl;
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  MinMaxTree tree;
+  tree.Build(volume);
+  timer->StopTimer();
+  std::cout << "Min/max tree of " << tree.GetNumberOfBlocks()
+            << " blocks built in " << timer->GetElapsedTime() << " s"
+            << std::endl;
+
+  // Each tick stands for a move of an isovalue slider: the surface is
+  // made again, once by scanning the whole volume with vtkFlyingEdges3D
+  // and once from the candidate blocks of the tree.
+  vtkNew<vtkFlyingEdges3D> flyingEdges;
+  flyingEdges->SetInputData(volume);
+  flyingEdges->ComputeNormalsOff();
+  flyingEdges->ComputeGradientsOff();
+  flyingEdges->ComputeScalarsOff();
+  double totalFlyingEdges = 0.0;
+  double totalTree = 0.0;
+  bool same = true;
+  std::cout << "Isovalue | vtkFlyingEdges3D (s) | Tree (s) | Blocks visited "
+               "| Triangles (vtkFlyingEdges3D / tree)"
+            << std::endl;
+  for (int tick = 0; tick < numberOfTicks; ++tick)
+  {
+    double value = range[0] +
+        (range[1] - range[0]) * (0.1 + 0.8 * (tick + 0.5) / numberOfTicks);
+
+    timer->StartTimer();
+    flyingEdges->SetValue(0, value);
+    flyingEdges->Update();
+    timer->StopTimer();
+    double flyingEdgesTime = timer->GetElapsedTime();
+
+    timer->StartTimer();
+    auto surface = tree.Contour(value);
+    timer->StopTimer();
+    double treeTime = timer->GetElapsedTime();
+
+    totalFlyingEdges += flyingEdgesTime;
+    totalTree += treeTime;
+    double visited = 100.0 * tree.GetNumberOfVisitedBlocks() /
+        tree.GetNumberOfBlocks();
+    std::cout << value << " | " << flyingEdgesTime << " | " << treeTime
+              << " | " << visited << "% | "
+              << flyingEdges->GetOutput()->GetNumberOfPolys() << " / "
+              << surface->GetNumberOfPolys() << std::endl;
+    same = same &&
+        surface->GetNumberOfPolys() ==
+            flyingEdges->GetOutput()->GetNumberOfPolys();
+  }
+  if (numberOfTicks > 0)
+  {
+    std::cout << "Mean update: vtkFlyingEdges3D "
+              << totalFlyingEdges / numberOfTicks << " s, tree "
+              << totalTree / numberOfTicks << " s" << std::endl;
+  }
+  if (!same)
+  {
+    std::cout << "Error: the tree and vtkFlyingEdges3D made different "
+                 "numbers of triangles."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+// The cell corners in the order of the marching cubes cases.
+const int CornerOffsets[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0},
+                                 {0, 1, 0}, {0, 0, 1}, {1, 0, 1},
+                                 {1, 1, 1}, {0, 1, 1}};
+const int EdgeCorners[12][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3},
+                                {4, 5}, {5, 6}, {7, 6}, {4, 7},
+                                {0, 4}, {1, 5}, {3, 7}, {2, 6}};
+// The axis of each edge.
+const int EdgeAxes[12] = {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2};
+
+void MinMaxTree::Build(vtkImageData* volume)
+{
+  this->Volume = volume;
+  volume->GetDimensions(this->Dimensions);
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    int cells = std::max(this->Dimensions[axis] - 1, 1);
+    this->NumberOfBlocks[axis] = (cells + BlockSize - 1) / BlockSize;
+    this->NumberOfSuperBlocks[axis] =
+        (this->NumberOfBlocks[axis] + BlockSize - 1) / BlockSize;
+  }
+  switch (volume->GetScalarType())
+  {
+    vtkTemplateMacro(this->BuildBlocks(
+        static_cast<const VTK_TT*>(volume->GetScalarPointer())));
+  }
+  this->CandidateOf.assign(this->BlockMin.size(), -1);
+}
+
+template <typename T> void MinMaxTree::BuildBlocks(const T* scalars)
+{
+  const int* nb = this->NumberOfBlocks;
+  const int* dims = this->Dimensions;
+  vtkIdType numberOfBlocks = static_cast<vtkIdType>(nb[0]) * nb[1] * nb[2];
+  this->BlockMin.assign(numberOfBlocks, VTK_DOUBLE_MAX);
+  this->BlockMax.assign(numberOfBlocks, VTK_DOUBLE_MIN);
+
+  // A block's range covers the vertices of its cells, so the blocks
+  // share their faces.
+  vtkSMPTools::For(0, nb[2], [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType bk = begin; bk < end; ++bk)
+    {
+      for (int bj = 0; bj < nb[1]; ++bj)
+      {
+        for (int bi = 0; bi < nb[0]; ++bi)
+        {
+          int first[3] = {bi * BlockSize, bj * BlockSize,
+                          static_cast<int>(bk) * BlockSize};
+          int last[3];
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            last[axis] =
+                std::min(first[axis] + BlockSize, dims[axis] - 1);
+          }
+          double low = VTK_DOUBLE_MAX;
+          double high = VTK_DOUBLE_MIN;
+          for (int k = first[2]; k <= last[2]; ++k)
+          {
+            for (int j = first[1]; j <= last[1]; ++j)
+            {
+              const T* row = scalars +
+                  dims[0] * (j + static_cast<vtkIdType>(dims[1]) * k);
+              for (int i = first[0]; i <= last[0]; ++i)
+              {
+                low = std::min(low, static_cast<double>(row[i]));
+                high = std::max(high, static_cast<double>(row[i]));
+              }
+            }
+          }
+          vtkIdType block =
+              this->BlockIndex(bi, bj, static_cast<int>(bk));
+          this->BlockMin[block] = low;
+          this->BlockMax[block] = high;
+        }
+      }
+    }
+  });
+
+  const int* ns = this->NumberOfSuperBlocks;
+  vtkIdType numberOfSuperBlocks =
+      static_cast<vtkIdType>(ns[0]) * ns[1] * ns[2];
+  this->SuperBlockMin.assign(numberOfSuperBlocks, VTK_DOUBLE_MAX);
+  this->SuperBlockMax.assign(numberOfSuperBlocks, VTK_DOUBLE_MIN);
+  for (int bk = 0; bk < nb[2]; ++bk)
+  {
+    for (int bj = 0; bj < nb[1]; ++bj)
+    {
+      for (int bi = 0; bi < nb[0]; ++bi)
+      {
+        vtkIdType block = this->BlockIndex(bi, bj, bk);
+        vtkIdType super = bi / BlockSize +
+            ns[0] * (bj / BlockSize + ns[1] * (bk / BlockSize));
+        this->SuperBlockMin[super] =
+            std::min(this->SuperBlockMin[super], this->BlockMin[block]);
+        this->SuperBlockMax[super] =
+            std::max(this->SuperBlockMax[super], this->BlockMax[block]);
+      }
+    }
+  }
+}
+
+void MinMaxTree::FindCandidates(double value)
+{
+  for (auto block : this->Candidates)
+  {
+    this->CandidateOf[block] = -1;
+  }
+  this->Candidates.clear();
+
+  // The same test as for a cell: some vertex is below the isovalue and
+  // some is not.
+  auto crosses = [value](double low, double high) {
+    return low < value && high >= value;
+  };
+  const int* nb = this->NumberOfBlocks;
+  const int* ns = this->NumberOfSuperBlocks;
+  for (int sk = 0; sk < ns[2]; ++sk)
+  {
+    for (int sj = 0; sj < ns[1]; ++sj)
+    {
+      for (int si = 0; si < ns[0]; ++si)
+      {
+        vtkIdType super = si + ns[0] * (sj + ns[1] * sk);
+        if (!crosses(this->SuperBlockMin[super], this->SuperBlockMax[super]))
+        {
+          continue;
+        }
+        for (int bk = sk * BlockSize;
+             bk < std::min((sk + 1) * BlockSize, nb[2]); ++bk)
+        {
+          for (int bj = sj * BlockSize;
+               bj < std::min((sj + 1) * BlockSize, nb[1]); ++bj)
+          {
+            for (int bi = si * BlockSize;
+                 bi < std::min((si + 1) * BlockSize, nb[0]); ++bi)
+            {
+              vtkIdType block = this->BlockIndex(bi, bj, bk);
+              if (crosses(this->BlockMin[block], this->BlockMax[block]))
+              {
+                this->CandidateOf[block] =
+                    static_cast<int>(this->Candidates.size());
+                this->Candidates.push_back(block);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+vtkSmartPointer<vtkPolyData> MinMaxTree::Contour(double value)
+{
+  this->FindCandidates(value);
+  switch (this->Volume->GetScalarType())
+  {
+    vtkTemplateMacro(return this->ContourBlocks(
+        static_cast<const VTK_TT*>(this->Volume->GetScalarPointer()),
+        value));
+  }
+  return vtkSmartPointer<vtkPolyData>::New();
+}
+
+template <typename T>
+vtkSmartPointer<vtkPolyData> MinMaxTree::ContourBlocks(const T* scalars,
+                                                       double value)
+{
+  const int* dims = this->Dimensions;
+  const int* nb = this->NumberOfBlocks;
+  const vtkIdType nx = dims[0];
+  const vtkIdType nxy = nx * dims[1];
+  double origin[3];
+  double spacing[3];
+  this->Volume->GetOrigin(origin);
+  this->Volume->GetSpacing(spacing);
+  auto candidates = static_cast<vtkIdType>(this->Candidates.size());
+
+  // Per candidate block: the index of its first vertex, the number of
+  // vertices it owns along each axis, the point of each of its edges or
+  // -1, its points and its triangles.
+  struct BlockSurface
+  {
+    int First[3];
+    int Owned[3];
+    std::vector<int> EdgePoints;
+    std::vector<float> Points;
+    std::vector<vtkIdType> Triangles;
+  };
+  std::vector<BlockSurface> blocks(candidates);
+
+  // First pass: the points on the crossing edges the blocks own.
+  vtkSMPTools::For(0, candidates, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      BlockSurface& b = blocks[c];
+      vtkIdType block = this->Candidates[c];
+      int index[3] = {static_cast<int>(block % nb[0]),
+                      static_cast<int>((block / nb[0]) % nb[1]),
+                      static_cast<int>(block / nb[0] / nb[1])};
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        b.First[axis] = index[axis] * BlockSize;
+        b.Owned[axis] = this->OwnedVertices(axis, index[axis]);
+      }
+      b.EdgePoints.assign(3 * b.Owned[0] * b.Owned[1] * b.Owned[2], -1);
+      int slot = 0;
+      for (int k = b.First[2]; k < b.First[2] + b.Owned[2]; ++k)
+      {
+        for (int j = b.First[1]; j < b.First[1] + b.Owned[1]; ++j)
+        {
+          for (int i = b.First[0]; i < b.First[0] + b.Owned[0]; ++i)
+          {
+            int vertex[3] = {i, j, k};
+            const T* s = scalars + i + j * nx + k * nxy;
+            vtkIdType increments[3] = {1, nx, nxy};
+            for (int axis = 0; axis < 3; ++axis, ++slot)
+            {
+              if (vertex[axis] + 1 >= dims[axis])
+              {
+                continue;
+              }
+              double s0 = static_cast<double>(s[0]);
+              double s1 = static_cast<double>(s[increments[axis]]);
+              if ((s0 >= value) == (s1 >= value))
+              {
+                continue;
+              }
+              double r = (value - s0) / (s1 - s0);
+              b.EdgePoints[slot] = static_cast<int>(b.Points.size() / 3);
+              for (int d = 0; d < 3; ++d)
+              {
+                double x = vertex[d] + (d == axis ? r : 0.0);
+                b.Points.push_back(
+                    static_cast<float>(origin[d] + spacing[d] * x));
+              }
+            }
+          }
+        }
+      }
+    }
+  });
+  std::vector<vtkIdType> pointOffsets(candidates + 1, 0);
+  for (vtkIdType c = 0; c < candidates; ++c)
+  {
+    pointOffsets[c + 1] =
+        pointOffsets[c] + static_cast<vtkIdType>(blocks[c].Points.size() / 3);
+  }
+
+  // Second pass: the triangles of the crossing cells.
+  auto cases = vtkMarchingCubesTriangleCases::GetCases();
+  vtkIdType cornerIncrements[8];
+  for (int corner = 0; corner < 8; ++corner)
+  {
+    cornerIncrements[corner] = CornerOffsets[corner][0] +
+        CornerOffsets[corner][1] * nx + CornerOffsets[corner][2] * nxy;
+  }
+  vtkSMPTools::For(0, candidates, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      BlockSurface& b = blocks[c];
+      int last[3];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        last[axis] = std::min(b.First[axis] + BlockSize, dims[axis] - 1);
+      }
+      for (int k = b.First[2]; k < last[2]; ++k)
+      {
+        for (int j = b.First[1]; j < last[1]; ++j)
+        {
+          for (int i = b.First[0]; i < last[0]; ++i)
+          {
+            const T* cell = scalars + i + j * nx + k * nxy;
+            int index = 0;
+            for (int corner = 0; corner < 8; ++corner)
+            {
+              if (static_cast<double>(cell[cornerIncrements[corner]]) >=
+                  value)
+              {
+                index |= 1 << corner;
+              }
+            }
+            for (auto edge = cases[index].edges; *edge > -1; ++edge)
+            {
+              // The point of an edge belongs to the block that owns its
+              // first corner.
+              const int* a = CornerOffsets[EdgeCorners[*edge][0]];
+              int vertex[3] = {i + a[0], j + a[1], k + a[2]};
+              int owner[3];
+              for (int axis = 0; axis < 3; ++axis)
+              {
+                owner[axis] = this->OwnerBlock(axis, vertex[axis]);
+              }
+              int o = this->CandidateOf[this->BlockIndex(owner[0], owner[1],
+                                                         owner[2])];
+              BlockSurface const& ob = blocks[o];
+              int slot = (vertex[0] - ob.First[0]) +
+                  ob.Owned[0] *
+                      ((vertex[1] - ob.First[1]) +
+                       ob.Owned[1] * (vertex[2] - ob.First[2]));
+              b.Triangles.push_back(pointOffsets[o] +
+                                    ob.EdgePoints[3 * slot +
+                                                  EdgeAxes[*edge]]);
+            }
+          }
+        }
+      }
+    }
+  });
+
+  // Gather the blocks into one mesh, in parallel too.
+  std::vector<vtkIdType> triangleOffsets(candidates + 1, 0);
+  for (vtkIdType c = 0; c < candidates; ++c)
+  {
+    triangleOffsets[c + 1] = triangleOffsets[c] +
+        static_cast<vtkIdType>(blocks[c].Triangles.size() / 3);
+  }
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToFloat();
+  points->SetNumberOfPoints(pointOffsets[candidates]);
+  auto pointData = static_cast<float*>(points->GetVoidPointer(0));
+  vtkNew<vtkIdTypeArray> connectivity;
+  connectivity->SetNumberOfValues(4 * triangleOffsets[candidates]);
+  auto cellData = connectivity->GetPointer(0);
+  vtkSMPTools::For(0, candidates, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      std::copy(blocks[c].Points.begin(), blocks[c].Points.end(),
+                pointData + 3 * pointOffsets[c]);
+      vtkIdType* cell = cellData + 4 * triangleOffsets[c];
+      auto const& triangles = blocks[c].Triangles;
+      for (std::size_t t = 0; t < triangles.size(); t += 3, cell += 4)
+      {
+        cell[0] = 3;
+        std::copy(triangles.begin() + t, triangles.begin() + t + 3,
+                  cell + 1);
+      }
+    }
+  });
+  vtkNew<vtkCellArray> polys;
+  polys->SetCells(triangleOffsets[candidates], connectivity);
+
+  auto surface = vtkSmartPointer<vtkPolyData>::New();
+  surface->SetPoints(points);
+  surface->SetPolys(polys);
+  return surface;
+}
+
+// Overlapping Gaussian blobs, so that every isovalue has its own set of
+// surfaces.
+vtkSmartPointer<vtkImageData> MakeBlobs(int dimension)
+{
+  const int numberOfBlobs = 24;
+  double blobs[numberOfBlobs][5];
+  for (int b = 0; b < numberOfBlobs; ++b)
+  {
+    // Center, width and height from a fixed sequence.
+    for (int d = 0; d < 3; ++d)
+    {
+      blobs[b][d] = dimension * (0.15 + 0.7 * std::fmod(0.618 * (b + 1) *
+                                                            (d + 1.3),
+                                                        1.0));
+    }
+    blobs[b][3] = dimension * (0.04 + 0.06 * std::fmod(0.37 * b, 1.0));
+    blobs[b][4] = 400.0 + 600.0 * std::fmod(0.71 * b, 1.0);
+  }
+  auto volume = vtkSmartPointer<vtkImageData>::New();
+  volume->SetDimensions(dimension, dimension, dimension);
+  volume->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto voxels = static_cast<unsigned short*>(volume->GetScalarPointer());
+  vtkSMPTools::For(0, dimension, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < dimension; ++j)
+      {
+        for (int i = 0; i < dimension; ++i)
+        {
+          double value = 0.0;
+          for (auto const& blob : blobs)
+          {
+            double dx = i - blob[0];
+            double dy = j - blob[1];
+            double dz = k - blob[2];
+            value += blob[4] *
+                std::exp(-(dx * dx + dy * dy + dz * dz) /
+                         (2.0 * blob[3] * blob[3]));
+          }
+          voxels[i + dimension * (j + dimension * k)] =
+              static_cast<unsigned short>(std::min(value, 4095.0));
+        }
+      }
+    }
+  });
+  return volume;
+}
+} // namespace
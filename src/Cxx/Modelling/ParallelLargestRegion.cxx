@@ -0,0 +1,446 @@
+#include <vtkCellArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataConnectivityFilter.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkStructuredPointsReader.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace {
+// Labels the connected regions of a mesh in parallel, with the same
+// connectivity as vtkPolyDataConnectivityFilter: two cells are connected
+// if they share a point. Every cell joins its points in a union-find
+// forest over the points. The unions are lock free: a root is linked to
+// a smaller root with a compare and swap, and a find halves the path it
+// walks. The roots of the cells then give the regions and their sizes.
+class RegionLabeling
+{
+public:
+  void Execute(vtkPolyData* mesh);
+
+  vtkIdType GetNumberOfRegions() const
+  {
+    return static_cast<vtkIdType>(this->RegionSizes.size());
+  }
+  vtkIdType GetLargestRegion() const;
+  // The region of each cell and the number of cells of each region.
+  std::vector<vtkIdType> const& GetCellRegions() const
+  {
+    return this->CellRegions;
+  }
+  std::vector<vtkIdType> const& GetRegionSizes() const
+  {
+    return this->RegionSizes;
+  }
+
+  // The cells of one region and the points they use.
+  vtkSmartPointer<vtkPolyData> ExtractRegion(vtkPolyData* mesh,
+                                             vtkIdType region);
+
+private:
+  vtkIdType Find(vtkIdType x);
+  void Union(vtkIdType a, vtkIdType b);
+
+  std::vector<vtkIdType> Offsets;
+  std::vector<vtkIdType> Connectivity;
+  std::vector<std::atomic<vtkIdType>> Parents;
+  std::vector<vtkIdType> CellRegions;
+  std::vector<vtkIdType> RegionSizes;
+  std::vector<vtkIdType> RegionRoots;
+};
+
+// Numbers the set entries of a mask in order, in parallel. Returns the
+// count; the entries that are not set get -1.
+vtkIdType Compact(std::vector<char> const& mask, std::vector<vtkIdType>& ids);
+
+vtkSmartPointer<vtkImageData> MakeNoisyHead(int dimension);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [file.vtk threshold], as for ExtractLargestIsosurface.
+  vtkSmartPointer<vtkImageData> volume;
+  double threshold = 500.0;
+  if (argc > 2)
+  {
+    vtkNew<vtkStructuredPointsReader> reader;
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    volume = reader->GetOutput();
+    threshold = std::atof(argv[2]);
+  }
+  else
+  {
+    volume = MakeNoisyHead(200);
+  }
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  vtkNew<vtkFlyingEdges3D> contour;
+  contour->SetInputData(volume);
+  contour->SetValue(0, threshold);
+  contour->ComputeNormalsOff();
+  contour->ComputeGradientsOff();
+  contour->ComputeScalarsOff();
+  contour->Update();
+  timer->StopTimer();
+  vtkPolyData* surface = contour->GetOutput();
+  std::cout << "Isosurface: " << surface->GetNumberOfPoints() << " points, "
+            << surface->GetNumberOfCells() << " cells in "
+            << timer->GetElapsedTime() << " s" << std::endl;
+
+  // The serial flood fill of vtkPolyDataConnectivityFilter.
+  timer->StartTimer();
+  vtkNew<vtkPolyDataConnectivityFilter> connectivity;
+  connectivity->SetInputData(surface);
+  connectivity->SetExtractionModeToLargestRegion();
+  connectivity->Update();
+  timer->StopTimer();
+  vtkIdType serialRegions = connectivity->GetNumberOfExtractedRegions();
+  vtkIdType serialCells = connectivity->GetOutput()->GetNumberOfCells();
+  std::cout << "vtkPolyDataConnectivityFilter: " << timer->GetElapsedTime()
+            << " s, " << serialRegions << " regions, largest has "
+            << serialCells << " cells" << std::endl;
+
+  // Union-find labeling and extraction of the largest region.
+  timer->StartTimer();
+  RegionLabeling labeling;
+  labeling.Execute(surface);
+  timer->StopTimer();
+  double labelTime = timer->GetElapsedTime();
+  timer->StartTimer();
+  vtkIdType largest = labeling.GetLargestRegion();
+  auto largestRegion = labeling.ExtractRegion(surface, largest);
+  timer->StopTimer();
+  std::cout << "Union-find on " << vtkSMPTools::GetEstimatedNumberOfThreads()
+            << " threads: " << labelTime + timer->GetElapsedTime()
+            << " s (labels " << labelTime << " s, extraction "
+            << timer->GetElapsedTime() << " s), "
+            << labeling.GetNumberOfRegions() << " regions, largest has "
+            << largestRegion->GetNumberOfCells() << " cells" << std::endl;
+
+  if (labeling.GetNumberOfRegions() != serialRegions ||
+      largestRegion->GetNumberOfCells() != serialCells)
+  {
+    std::cout << "Error: the regions differ from "
+                 "vtkPolyDataConnectivityFilter's."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+vtkIdType RegionLabeling::Find(vtkIdType x)
+{
+  for (;;)
+  {
+    vtkIdType parent = this->Parents[x].load();
+    vtkIdType grandParent = this->Parents[parent].load();
+    if (parent == grandParent)
+    {
+      return parent;
+    }
+    // Path halving: if another thread changed the parent, it only made
+    // the path shorter.
+    this->Parents[x].compare_exchange_weak(parent, grandParent);
+    x = grandParent;
+  }
+}
+
+void RegionLabeling::Union(vtkIdType a, vtkIdType b)
+{
+  for (;;)
+  {
+    a = this->Find(a);
+    b = this->Find(b);
+    if (a == b)
+    {
+      return;
+    }
+    // Always link the larger root to the smaller one, so no cycle forms.
+    if (a < b)
+    {
+      std::swap(a, b);
+    }
+    vtkIdType expected = a;
+    if (this->Parents[a].compare_exchange_strong(expected, b))
+    {
+      return;
+    }
+    // a was linked by another thread meanwhile; try again from the roots.
+  }
+}
+
+void RegionLabeling::Execute(vtkPolyData* mesh)
+{
+  // Flat copies of the cells, which the threads can read.
+  this->Offsets.assign(1, 0);
+  this->Connectivity.clear();
+  for (auto cells : {mesh->GetVerts(), mesh->GetLines(), mesh->GetPolys(),
+                     mesh->GetStrips()})
+  {
+    vtkIdType npts;
+#ifdef VTK_CELL_ARRAY_V2
+    const vtkIdType* pts;
+#else // VTK_CELL_ARRAY_V2
+    vtkIdType* pts;
+#endif // VTK_CELL_ARRAY_V2
+    for (cells->InitTraversal(); cells->GetNextCell(npts, pts);)
+    {
+      this->Connectivity.insert(this->Connectivity.end(), pts, pts + npts);
+      this->Offsets.push_back(
+          static_cast<vtkIdType>(this->Connectivity.size()));
+    }
+  }
+  auto numberOfCells = static_cast<vtkIdType>(this->Offsets.size() - 1);
+  vtkIdType numberOfPoints = mesh->GetNumberOfPoints();
+
+  std::vector<std::atomic<vtkIdType>> parents(numberOfPoints);
+  this->Parents.swap(parents);
+  vtkSMPTools::For(0, numberOfPoints, [this](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType p = begin; p < end; ++p)
+    {
+      this->Parents[p].store(p);
+    }
+  });
+  vtkSMPTools::For(0, numberOfCells, [this](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      for (vtkIdType i = this->Offsets[c] + 1; i < this->Offsets[c + 1]; ++i)
+      {
+        this->Union(this->Connectivity[this->Offsets[c]],
+                    this->Connectivity[i]);
+      }
+    }
+  });
+
+  // The roots of the cells are the regions. Number them in the order of
+  // the roots, and count their cells.
+  std::vector<vtkIdType> cellRoots(numberOfCells);
+  vtkSMPTools::For(0, numberOfCells, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      cellRoots[c] = this->Find(this->Connectivity[this->Offsets[c]]);
+    }
+  });
+  std::vector<char> hasCells(numberOfPoints, 0);
+  for (auto root : cellRoots)
+  {
+    hasCells[root] = 1;
+  }
+  std::vector<vtkIdType> regionOfRoot;
+  vtkIdType numberOfRegions = Compact(hasCells, regionOfRoot);
+
+  this->CellRegions.resize(numberOfCells);
+  std::vector<std::atomic<vtkIdType>> sizes(numberOfRegions);
+  vtkSMPTools::For(0, numberOfRegions, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType r = begin; r < end; ++r)
+    {
+      sizes[r].store(0);
+    }
+  });
+  vtkSMPTools::For(0, numberOfCells, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      vtkIdType region = regionOfRoot[cellRoots[c]];
+      this->CellRegions[c] = region;
+      sizes[region].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  this->RegionSizes.resize(numberOfRegions);
+  this->RegionRoots.resize(numberOfRegions);
+  for (vtkIdType p = 0; p < numberOfPoints; ++p)
+  {
+    if (regionOfRoot[p] >= 0)
+    {
+      this->RegionRoots[regionOfRoot[p]] = p;
+      this->RegionSizes[regionOfRoot[p]] = sizes[regionOfRoot[p]].load();
+    }
+  }
+}
+
+vtkIdType RegionLabeling::GetLargestRegion() const
+{
+  auto largest =
+      std::max_element(this->RegionSizes.begin(), this->RegionSizes.end());
+  return largest == this->RegionSizes.end()
+      ? -1
+      : static_cast<vtkIdType>(largest - this->RegionSizes.begin());
+}
+
+vtkSmartPointer<vtkPolyData>
+RegionLabeling::ExtractRegion(vtkPolyData* mesh, vtkIdType region)
+{
+  auto output = vtkSmartPointer<vtkPolyData>::New();
+  if (region < 0 || region >= this->GetNumberOfRegions())
+  {
+    return output;
+  }
+
+  // The points of a region are the points with its root, and its cells
+  // the cells with its id.
+  vtkIdType root = this->RegionRoots[region];
+  auto numberOfPoints = static_cast<vtkIdType>(this->Parents.size());
+  auto numberOfCells = static_cast<vtkIdType>(this->CellRegions.size());
+  std::vector<char> keepPoint(numberOfPoints);
+  std::vector<char> keepCell(numberOfCells);
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType p = begin; p < end; ++p)
+    {
+      keepPoint[p] = this->Find(p) == root;
+    }
+  });
+  vtkSMPTools::For(0, numberOfCells, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      keepCell[c] = this->CellRegions[c] == region;
+    }
+  });
+  std::vector<vtkIdType> pointIds;
+  std::vector<vtkIdType> cellIds;
+  vtkIdType outputPoints = Compact(keepPoint, pointIds);
+  vtkIdType outputCells = Compact(keepCell, cellIds);
+
+  // Where each kept cell goes in the legacy cell array: its size, then
+  // its points.
+  std::vector<vtkIdType> cellStarts(outputCells + 1, 0);
+  for (vtkIdType c = 0; c < numberOfCells; ++c)
+  {
+    if (cellIds[c] >= 0)
+    {
+      cellStarts[cellIds[c] + 1] =
+          1 + this->Offsets[c + 1] - this->Offsets[c];
+    }
+  }
+  for (vtkIdType c = 0; c < outputCells; ++c)
+  {
+    cellStarts[c + 1] += cellStarts[c];
+  }
+
+  vtkNew<vtkPoints> points;
+  points->SetDataType(mesh->GetPoints()->GetDataType());
+  points->SetNumberOfPoints(outputPoints);
+  vtkPoints* inputPoints = mesh->GetPoints();
+  vtkSMPTools::For(0, numberOfPoints, [&](vtkIdType begin, vtkIdType end) {
+    double x[3];
+    for (vtkIdType p = begin; p < end; ++p)
+    {
+      if (pointIds[p] >= 0)
+      {
+        inputPoints->GetPoint(p, x);
+        points->SetPoint(pointIds[p], x);
+      }
+    }
+  });
+  vtkNew<vtkIdTypeArray> legacy;
+  legacy->SetNumberOfValues(cellStarts[outputCells]);
+  vtkIdType* cells = legacy->GetPointer(0);
+  vtkSMPTools::For(0, numberOfCells, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType c = begin; c < end; ++c)
+    {
+      if (cellIds[c] < 0)
+      {
+        continue;
+      }
+      vtkIdType* cell = cells + cellStarts[cellIds[c]];
+      *cell++ = this->Offsets[c + 1] - this->Offsets[c];
+      for (vtkIdType i = this->Offsets[c]; i < this->Offsets[c + 1]; ++i)
+      {
+        *cell++ = pointIds[this->Connectivity[i]];
+      }
+    }
+  });
+  vtkNew<vtkCellArray> polys;
+  polys->SetCells(outputCells, legacy);
+  output->SetPoints(points);
+  output->SetPolys(polys);
+  return output;
+}
+
+vtkIdType Compact(std::vector<char> const& mask, std::vector<vtkIdType>& ids)
+{
+  auto size = static_cast<vtkIdType>(mask.size());
+  ids.resize(size);
+  const vtkIdType chunkSize = 65536;
+  vtkIdType numberOfChunks = (size + chunkSize - 1) / chunkSize;
+  std::vector<vtkIdType> chunkCounts(numberOfChunks + 1, 0);
+  vtkSMPTools::For(0, numberOfChunks, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType chunk = begin; chunk < end; ++chunk)
+    {
+      vtkIdType last = std::min(size, (chunk + 1) * chunkSize);
+      chunkCounts[chunk + 1] =
+          std::count(mask.begin() + chunk * chunkSize, mask.begin() + last, 1);
+    }
+  });
+  for (vtkIdType chunk = 0; chunk < numberOfChunks; ++chunk)
+  {
+    chunkCounts[chunk + 1] += chunkCounts[chunk];
+  }
+  vtkSMPTools::For(0, numberOfChunks, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType chunk = begin; chunk < end; ++chunk)
+    {
+      vtkIdType next = chunkCounts[chunk];
+      vtkIdType last = std::min(size, (chunk + 1) * chunkSize);
+      for (vtkIdType i = chunk * chunkSize; i < last; ++i)
+      {
+        ids[i] = mask[i] ? next++ : -1;
+      }
+    }
+  });
+  return chunkCounts[numberOfChunks];
+}
+
+// A CT-like head whose background has sparse spikes of noise above the
+// threshold. The skin becomes one large region and the spikes many small
+// ones.
+vtkSmartPointer<vtkImageData> MakeNoisyHead(int dimension)
+{
+  auto volume = vtkSmartPointer<vtkImageData>::New();
+  volume->SetDimensions(dimension, dimension, dimension);
+  volume->AllocateScalars(VTK_SHORT, 1);
+  auto voxels = static_cast<short*>(volume->GetScalarPointer());
+  vtkSMPTools::For(0, dimension, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      for (int j = 0; j < dimension; ++j)
+      {
+        for (int i = 0; i < dimension; ++i)
+        {
+          vtkIdType index = i + dimension * (j + dimension * k);
+          // A hash of the index for the noise.
+          std::uint32_t h = static_cast<std::uint32_t>(index) * 2654435761u;
+          h ^= h >> 15;
+          h *= 2246822519u;
+          h ^= h >> 13;
+          double noise = (h & 0xffff) / 65535.0;
+          double x = (i - 0.5 * dimension) / (0.40 * dimension);
+          double y = (j - 0.5 * dimension) / (0.45 * dimension);
+          double z = (k - 0.5 * dimension) / (0.42 * dimension);
+          double r = std::sqrt(x * x + y * y + z * z);
+          double value = r < 1.0 ? 1000.0 : 0.0;
+          value += 200.0 * (noise - 0.5);
+          if (noise > 0.97)
+          {
+            value += 600.0;
+          }
+          voxels[index] = static_cast<short>(value);
+        }
+      }
+    }
+  });
+  return volume;
+}
+} // namespace
@@ -0,0 +1,529 @@
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkRadiusOutlierRemoval.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// The point file is a flat sequence of little-endian float32 x y z records.
+// It is never loaded as a whole. It is read in chunks, first to find the
+// bounds and then to scatter the points into spatial tiles on disk. Each tile
+// also receives the points of its neighbors that lie within a halo of the
+// outlier radius, so the neighbor counts at the tile boundary are exact.
+// The tiles are then cleaned in parallel, and only the points that lie in the
+// core of a tile are appended to the output file.
+
+namespace {
+struct TileGrid
+{
+  double Origin[3];
+  double TileSize[3];
+  int Dimensions[3];
+  double Halo;
+
+  int NumberOfTiles() const
+  {
+    return this->Dimensions[0] * this->Dimensions[1] * this->Dimensions[2];
+  }
+
+  int TileIndex(int axis, double x) const
+  {
+    auto i = static_cast<int>(
+        std::floor((x - this->Origin[axis]) / this->TileSize[axis]));
+    return std::min(std::max(i, 0), this->Dimensions[axis] - 1);
+  }
+
+  int CoreTile(const float* p) const
+  {
+    return this->TileIndex(0, p[0]) +
+        this->Dimensions[0] *
+        (this->TileIndex(1, p[1]) +
+         this->Dimensions[1] * this->TileIndex(2, p[2]));
+  }
+};
+
+std::string TileFileName(std::string const& prefix, int tile);
+
+bool ComputeBounds(std::string const& fileName, double bounds[6],
+                   std::uint64_t& numberOfPoints);
+
+bool ScatterToTiles(std::string const& fileName, TileGrid const& grid,
+                    std::string const& prefix);
+
+void CleanTile(vtkPoints* tilePoints, TileGrid const& grid, int tile,
+               double radius, int numberOfNeighbors, double voxelSize,
+               std::vector<float>& result);
+
+void GeneratePointCloud(std::string const& fileName, std::uint64_t n);
+
+// The points vtkRadiusOutlierRemoval keeps from the whole cloud, as x y z
+// triples sorted in lexicographic order.
+std::vector<std::array<float, 3>> CleanInMemory(std::string const& fileName,
+                                                double radius,
+                                                int numberOfNeighbors);
+
+// Reads a raw point file into sorted x y z triples.
+bool ReadSortedPoints(std::string const& fileName,
+                      std::vector<std::array<float, 3>>& points);
+
+const std::size_t chunkSize = 1 << 20; // Points read per chunk.
+// Floats held by all the scatter buffers together.
+const std::size_t maxBufferedFloats = 3 << 20;
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  std::string inputFile =
+      argc > 1 ? argv[1] : "StreamingPointCloudCleaningInput.raw";
+  std::string outputFile =
+      argc > 2 ? argv[2] : "StreamingPointCloudCleaningOutput.raw";
+  std::uint64_t maxPointsPerTile = argc > 3 ? std::stoull(argv[3]) : 50000;
+  double radius = argc > 4 ? std::stod(argv[4]) : 0.0;
+  int numberOfNeighbors = argc > 5 ? std::stoi(argv[5]) : 6;
+  double voxelSize = argc > 6 ? std::stod(argv[6]) : 0.0;
+
+  if (argc < 2)
+  {
+    std::cout << "No input file given, generating " << inputFile << std::endl;
+    GeneratePointCloud(inputFile, 200000);
+  }
+
+  vtkNew<vtkTimerLog> timer;
+
+  // Pass 1: bounds.
+  timer->StartTimer();
+  double bounds[6];
+  std::uint64_t numberOfPoints = 0;
+  if (!ComputeBounds(inputFile, bounds, numberOfPoints))
+  {
+    std::cerr << "Cannot read " << inputFile << std::endl;
+    return EXIT_FAILURE;
+  }
+  timer->StopTimer();
+  std::cout << "# of input points: " << numberOfPoints << std::endl;
+  std::cout << "Bounds time:   " << timer->GetElapsedTime() << "s"
+            << std::endl;
+
+  // Choose the tiling so that each tile holds about maxPointsPerTile points
+  // if the cloud was uniform.
+  TileGrid grid;
+  double range[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    range[i] = std::max(bounds[2 * i + 1] - bounds[2 * i], 1.0e-6);
+  }
+  if (radius <= 0.0)
+  {
+    radius = range[0] / 50.0;
+  }
+  auto pointsPerTile =
+      static_cast<double>(std::max<std::uint64_t>(maxPointsPerTile, 1));
+  auto tilesPerAxis = static_cast<int>(std::ceil(
+      std::cbrt(static_cast<double>(numberOfPoints) / pointsPerTile)));
+  tilesPerAxis = std::max(tilesPerAxis, 1);
+  for (int i = 0; i < 3; ++i)
+  {
+    grid.Origin[i] = bounds[2 * i];
+    grid.Dimensions[i] = tilesPerAxis;
+    grid.TileSize[i] = range[i] / tilesPerAxis;
+    if (voxelSize > 0.0)
+    {
+      // Align the tiles with the voxels so that no voxel straddles two tiles.
+      grid.TileSize[i] = std::ceil(grid.TileSize[i] / voxelSize) * voxelSize;
+    }
+  }
+  grid.Halo = radius;
+  std::cout << "Tiles:         " << tilesPerAxis << "^3" << std::endl;
+  std::cout << "Radius:        " << radius << std::endl;
+
+  // Pass 2: scatter the points into tile files, including the halo.
+  std::string prefix = vtksys::SystemTools::GetFilenameWithoutLastExtension(
+      outputFile);
+  timer->StartTimer();
+  if (!ScatterToTiles(inputFile, grid, prefix))
+  {
+    std::cerr << "Cannot write the tiles of " << outputFile << std::endl;
+    return EXIT_FAILURE;
+  }
+  timer->StopTimer();
+  std::cout << "Scatter time:  " << timer->GetElapsedTime() << "s"
+            << std::endl;
+
+  // Pass 3: clean the tiles in parallel and append them to the output.
+  std::ofstream output(outputFile, std::ios::binary | std::ios::trunc);
+  std::mutex outputMutex;
+  std::uint64_t numberOfOutputPoints = 0;
+  bool failed = !output;
+  timer->StartTimer();
+  auto cleanTiles = [&](vtkIdType begin, vtkIdType end) {
+    for (auto tile = static_cast<int>(begin); tile < end; ++tile)
+    {
+      auto fileName = TileFileName(prefix, tile);
+      std::ifstream tileFile(fileName, std::ios::binary | std::ios::ate);
+      if (!tileFile)
+      {
+        continue; // Empty tile.
+      }
+      auto n =
+          static_cast<vtkIdType>(static_cast<std::streamoff>(tileFile.tellg()) /
+                                 (3 * sizeof(float)));
+      tileFile.seekg(0);
+      vtkNew<vtkPoints> tilePoints;
+      tilePoints->SetDataTypeToFloat();
+      tilePoints->SetNumberOfPoints(n);
+      tileFile.read(reinterpret_cast<char*>(tilePoints->GetVoidPointer(0)),
+                    n * 3 * sizeof(float));
+      bool readFailed = !tileFile;
+      tileFile.close();
+      vtksys::SystemTools::RemoveFile(fileName);
+      if (readFailed)
+      {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        failed = true;
+        continue;
+      }
+
+      std::vector<float> result;
+      CleanTile(tilePoints, grid, tile, radius, numberOfNeighbors, voxelSize,
+                result);
+
+      std::lock_guard<std::mutex> lock(outputMutex);
+      output.write(reinterpret_cast<const char*>(result.data()),
+                   result.size() * sizeof(float));
+      failed = failed || !output;
+      numberOfOutputPoints += result.size() / 3;
+    }
+  };
+  vtkSMPTools::For(0, grid.NumberOfTiles(), 1, cleanTiles);
+  output.close();
+  timer->StopTimer();
+  if (failed || !output)
+  {
+    std::cerr << "Cannot read a tile or write " << outputFile << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Clean time:    " << timer->GetElapsedTime() << "s using "
+            << vtkSMPTools::GetEstimatedNumberOfThreads() << " threads"
+            << std::endl;
+  std::cout << "# of output points: " << numberOfOutputPoints << std::endl;
+
+  // For clouds that fit in memory, check the result against a single
+  // vtkRadiusOutlierRemoval over the whole cloud. The points are copied,
+  // not computed, so both must keep exactly the same points.
+  if (voxelSize <= 0.0 && numberOfPoints <= 2000000)
+  {
+    timer->StartTimer();
+    auto expected = CleanInMemory(inputFile, radius, numberOfNeighbors);
+    timer->StopTimer();
+    std::cout << "In memory time: " << timer->GetElapsedTime() << "s"
+              << std::endl;
+    std::cout << "# of in memory output points: " << expected.size()
+              << std::endl;
+    std::vector<std::array<float, 3>> tiled;
+    if (!ReadSortedPoints(outputFile, tiled) || tiled != expected)
+    {
+      std::cerr << "Tiled and in memory results differ" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+namespace {
+std::string TileFileName(std::string const& prefix, int tile)
+{
+  std::ostringstream ss;
+  ss << prefix << "_tile" << tile << ".raw";
+  return ss.str();
+}
+
+bool ComputeBounds(std::string const& fileName, double bounds[6],
+                   std::uint64_t& numberOfPoints)
+{
+  std::ifstream input(fileName, std::ios::binary);
+  if (!input)
+  {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    bounds[2 * i] = VTK_DOUBLE_MAX;
+    bounds[2 * i + 1] = VTK_DOUBLE_MIN;
+  }
+  numberOfPoints = 0;
+  std::vector<float> chunk(3 * chunkSize);
+  while (input)
+  {
+    input.read(reinterpret_cast<char*>(chunk.data()),
+               chunk.size() * sizeof(float));
+    auto n = static_cast<std::size_t>(input.gcount()) / (3 * sizeof(float));
+    for (std::size_t p = 0; p < n; ++p)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        bounds[2 * i] = std::min<double>(bounds[2 * i], chunk[3 * p + i]);
+        bounds[2 * i + 1] =
+            std::max<double>(bounds[2 * i + 1], chunk[3 * p + i]);
+      }
+    }
+    numberOfPoints += n;
+  }
+  return numberOfPoints > 0;
+}
+
+bool ScatterToTiles(std::string const& fileName, TileGrid const& grid,
+                    std::string const& prefix)
+{
+  // Points are buffered per tile, and all the buffers are flushed, and their
+  // memory released, when together they hold maxBufferedFloats. The memory
+  // used does not depend on the number of tiles, and only one file is open
+  // at a time.
+  std::map<int, std::vector<float>> buffers;
+  std::size_t buffered = 0;
+  bool ok = true;
+  auto flushAll = [&]() {
+    for (auto& buffer : buffers)
+    {
+      if (buffer.second.empty())
+      {
+        continue;
+      }
+      std::ofstream out(TileFileName(prefix, buffer.first),
+                        std::ios::binary | std::ios::app);
+      out.write(reinterpret_cast<const char*>(buffer.second.data()),
+                buffer.second.size() * sizeof(float));
+      out.close();
+      ok = ok && !out.fail();
+      std::vector<float>().swap(buffer.second);
+    }
+    buffered = 0;
+  };
+
+  // Remove tiles left over from an earlier run.
+  for (int tile = 0; tile < grid.NumberOfTiles(); ++tile)
+  {
+    vtksys::SystemTools::RemoveFile(TileFileName(prefix, tile));
+  }
+
+  std::ifstream input(fileName, std::ios::binary);
+  std::vector<float> chunk(3 * chunkSize);
+  while (input)
+  {
+    input.read(reinterpret_cast<char*>(chunk.data()),
+               chunk.size() * sizeof(float));
+    auto n = static_cast<std::size_t>(input.gcount()) / (3 * sizeof(float));
+    for (std::size_t p = 0; p < n; ++p)
+    {
+      const float* x = &chunk[3 * p];
+      int lo[3], hi[3];
+      for (int i = 0; i < 3; ++i)
+      {
+        lo[i] = grid.TileIndex(i, x[i] - grid.Halo);
+        hi[i] = grid.TileIndex(i, x[i] + grid.Halo);
+      }
+      for (int k = lo[2]; k <= hi[2]; ++k)
+      {
+        for (int j = lo[1]; j <= hi[1]; ++j)
+        {
+          for (int i = lo[0]; i <= hi[0]; ++i)
+          {
+            int tile = i + grid.Dimensions[0] * (j + grid.Dimensions[1] * k);
+            auto& buffer = buffers[tile];
+            buffer.insert(buffer.end(), x, x + 3);
+            buffered += 3;
+            if (buffered >= maxBufferedFloats)
+            {
+              flushAll();
+            }
+          }
+        }
+      }
+    }
+  }
+  flushAll();
+  return ok && input.eof();
+}
+
+void CleanTile(vtkPoints* tilePoints, TileGrid const& grid, int tile,
+               double radius, int numberOfNeighbors, double voxelSize,
+               std::vector<float>& result)
+{
+  vtkNew<vtkPolyData> cloud;
+  cloud->SetPoints(tilePoints);
+
+  vtkNew<vtkRadiusOutlierRemoval> removal;
+  removal->SetInputData(cloud);
+  removal->SetRadius(radius);
+  removal->SetNumberOfNeighbors(numberOfNeighbors);
+  removal->Update();
+
+  // Keep only the inliers that lie in the core of this tile. The halo points
+  // belong to, and are written by, the neighboring tiles.
+  auto inliers = removal->GetOutput()->GetPoints();
+  vtkIdType numberOfInliers = inliers ? inliers->GetNumberOfPoints() : 0;
+  if (voxelSize <= 0.0)
+  {
+    for (vtkIdType id = 0; id < numberOfInliers; ++id)
+    {
+      double x[3];
+      inliers->GetPoint(id, x);
+      float p[3] = {static_cast<float>(x[0]), static_cast<float>(x[1]),
+                    static_cast<float>(x[2])};
+      if (grid.CoreTile(p) == tile)
+      {
+        result.insert(result.end(), p, p + 3);
+      }
+    }
+    return;
+  }
+
+  // Downsample by replacing the points in each voxel with their centroid.
+  // The voxels are aligned with the tiles, so this is exact per tile.
+  std::map<std::tuple<long long, long long, long long>, std::array<double, 4>>
+      voxels;
+  for (vtkIdType id = 0; id < numberOfInliers; ++id)
+  {
+    double x[3];
+    inliers->GetPoint(id, x);
+    float p[3] = {static_cast<float>(x[0]), static_cast<float>(x[1]),
+                  static_cast<float>(x[2])};
+    if (grid.CoreTile(p) != tile)
+    {
+      continue;
+    }
+    long long v[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      v[i] = static_cast<long long>(
+          std::floor((x[i] - grid.Origin[i]) / voxelSize));
+    }
+    auto& voxel = voxels[std::make_tuple(v[0], v[1], v[2])];
+    voxel[0] += x[0];
+    voxel[1] += x[1];
+    voxel[2] += x[2];
+    voxel[3] += 1.0;
+  }
+  result.reserve(3 * voxels.size());
+  for (auto const& voxel : voxels)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      result.push_back(static_cast<float>(voxel.second[i] / voxel.second[3]));
+    }
+  }
+}
+
+void GeneratePointCloud(std::string const& fileName, std::uint64_t n)
+{
+  // Points on a noisy shell with a sprinkling of uniform outliers.
+  std::mt19937 generator(8775070);
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  std::uniform_real_distribution<float> uniform(-12.0f, 12.0f);
+  std::ofstream output(fileName, std::ios::binary | std::ios::trunc);
+  std::vector<float> chunk;
+  chunk.reserve(3 * chunkSize);
+  for (std::uint64_t p = 0; p < n; ++p)
+  {
+    float x[3];
+    if (p % 50 == 0)
+    {
+      x[0] = uniform(generator);
+      x[1] = uniform(generator);
+      x[2] = uniform(generator);
+    }
+    else
+    {
+      float d[3] = {normal(generator), normal(generator), normal(generator)};
+      float r = 10.0f /
+          std::max(std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]), 1e-6f);
+      float noise = 1.0f + 0.01f * normal(generator);
+      x[0] = d[0] * r * noise;
+      x[1] = d[1] * r * noise;
+      x[2] = d[2] * r * noise;
+    }
+    chunk.insert(chunk.end(), x, x + 3);
+    if (chunk.size() == 3 * chunkSize || p == n - 1)
+    {
+      output.write(reinterpret_cast<const char*>(chunk.data()),
+                   chunk.size() * sizeof(float));
+      chunk.clear();
+    }
+  }
+}
+
+std::vector<std::array<float, 3>> CleanInMemory(std::string const& fileName,
+                                                double radius,
+                                                int numberOfNeighbors)
+{
+  std::ifstream input(fileName, std::ios::binary | std::ios::ate);
+  auto n = static_cast<vtkIdType>(static_cast<std::streamoff>(input.tellg()) /
+                                  (3 * sizeof(float)));
+  input.seekg(0);
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToFloat();
+  points->SetNumberOfPoints(n);
+  input.read(reinterpret_cast<char*>(points->GetVoidPointer(0)),
+             n * 3 * sizeof(float));
+
+  vtkNew<vtkPolyData> cloud;
+  cloud->SetPoints(points);
+
+  vtkNew<vtkRadiusOutlierRemoval> removal;
+  removal->SetInputData(cloud);
+  removal->SetRadius(radius);
+  removal->SetNumberOfNeighbors(numberOfNeighbors);
+  removal->Update();
+
+  std::vector<std::array<float, 3>> result;
+  auto inliers = removal->GetOutput()->GetPoints();
+  vtkIdType numberOfInliers = inliers ? inliers->GetNumberOfPoints() : 0;
+  result.resize(numberOfInliers);
+  for (vtkIdType id = 0; id < numberOfInliers; ++id)
+  {
+    double x[3];
+    inliers->GetPoint(id, x);
+    for (int i = 0; i < 3; ++i)
+    {
+      result[id][i] = static_cast<float>(x[i]);
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+bool ReadSortedPoints(std::string const& fileName,
+                      std::vector<std::array<float, 3>>& points)
+{
+  std::ifstream input(fileName, std::ios::binary | std::ios::ate);
+  if (!input)
+  {
+    return false;
+  }
+  auto n = static_cast<std::size_t>(
+      static_cast<std::streamoff>(input.tellg()) / (3 * sizeof(float)));
+  input.seekg(0);
+  points.resize(n);
+  input.read(reinterpret_cast<char*>(points.data()),
+             n * 3 * sizeof(float));
+  std::sort(points.begin(), points.end());
+  return static_cast<bool>(input);
+}
+} // namespace
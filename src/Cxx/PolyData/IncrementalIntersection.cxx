@@ -0,0 +1,420 @@
+#include <vtkCellArray.h>
+#include <vtkCollisionDetectionFilter.h>
+#include <vtkIdList.h>
+#include <vtkIntersectionPolyDataFilter.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkOBBTree.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+#include <vtkTimerLog.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+#include <vtkTriangleFilter.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+typedef std::array<vtkIdType, 2> CellPair;
+typedef std::array<double, 6> Segment;
+
+// Intersection of a moving tool with a static part. The OBB trees of both
+// meshes are built once, in their own coordinates, and stay valid under any
+// rigid motion of the tool. Each update only walks the pairs of tree leaves
+// whose boxes overlap and tests their triangle pairs in parallel.
+class IncrementalIntersection
+{
+public:
+  void SetPart(vtkPolyData* part);
+  void SetTool(vtkPolyData* tool);
+
+  // Intersect the tool, placed by toolToPart, with the part and return the
+  // number of candidate triangle pairs that were tested.
+  std::size_t Update(vtkMatrix4x4* toolToPart);
+
+  std::vector<Segment> const& GetSegments() const
+  {
+    return this->Segments;
+  }
+
+private:
+  static int CollectPairs(vtkOBBNode* nodeA, vtkOBBNode* nodeB,
+                          vtkMatrix4x4* matrix, void* pairs);
+
+  vtkSmartPointer<vtkPolyData> Part;
+  vtkSmartPointer<vtkPolyData> Tool;
+  vtkNew<vtkOBBTree> PartTree;
+  vtkNew<vtkOBBTree> ToolTree;
+  std::vector<double> PartPoints;
+  std::vector<double> ToolPoints;
+  std::vector<double> MovedToolPoints;
+  std::vector<vtkIdType> PartTriangles;
+  std::vector<vtkIdType> ToolTriangles;
+  std::vector<CellPair> Pairs;
+  std::vector<Segment> Segments;
+};
+
+vtkSmartPointer<vtkPolyData> Triangulate(vtkPolyData* mesh);
+void CopyMesh(vtkPolyData* mesh, std::vector<double>& points,
+              std::vector<vtkIdType>& triangles);
+bool IntersectTriangles(const double* a[3], const double* b[3],
+                        Segment& segment);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  int numberOfSteps = argc > 1 ? std::stoi(argv[1]) : 20;
+
+  vtkNew<vtkSphereSource> partSource;
+  partSource->SetRadius(1.0);
+  partSource->SetPhiResolution(100);
+  partSource->SetThetaResolution(200);
+  partSource->Update();
+  vtkSmartPointer<vtkPolyData> part = partSource->GetOutput();
+
+  vtkNew<vtkSphereSource> toolSource;
+  toolSource->SetRadius(0.35);
+  toolSource->SetPhiResolution(50);
+  toolSource->SetThetaResolution(100);
+  toolSource->Update();
+  vtkSmartPointer<vtkPolyData> tool = toolSource->GetOutput();
+
+  std::cout << "Part: " << part->GetNumberOfPolys()
+            << " triangles, tool: " << tool->GetNumberOfPolys()
+            << " triangles, threads: "
+            << vtkSMPTools::GetEstimatedNumberOfThreads() << std::endl;
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  IncrementalIntersection incremental;
+  incremental.SetPart(part);
+  incremental.SetTool(tool);
+  timer->StopTimer();
+  std::cout << "Tree build (once): " << timer->GetElapsedTime() << "s"
+            << std::endl;
+
+  // The filters that recompute everything on each move.
+  vtkNew<vtkTransform> transform;
+  vtkNew<vtkTransformPolyDataFilter> movedTool;
+  movedTool->SetInputData(tool);
+  movedTool->SetTransform(transform);
+
+  vtkNew<vtkIntersectionPolyDataFilter> intersection;
+  intersection->SetInputData(0, part);
+  intersection->SetInputConnection(1, movedTool->GetOutputPort());
+  intersection->SplitFirstOutputOff();
+  intersection->SplitSecondOutputOff();
+
+  vtkNew<vtkMatrix4x4> identity;
+  vtkNew<vtkCollisionDetectionFilter> collide;
+  collide->SetInputData(0, part);
+  collide->SetMatrix(0, identity);
+  collide->SetInputData(1, tool);
+  collide->SetTransform(1, transform);
+  collide->SetCollisionModeToAllContacts();
+  collide->SetBoxTolerance(0.0);
+  collide->SetCellTolerance(0.0);
+
+  // Sweep the tool through the surface of the part while spinning it.
+  double intersectionTime = 0.0, collideTime = 0.0, incrementalTime = 0.0;
+  double intersectionWorst = 0.0, collideWorst = 0.0, incrementalWorst = 0.0;
+  std::cout << "Step  Pairs  Segments  vtkIntersectionPolyDataFilter "
+               "vtkCollisionDetectionFilter  Incremental (ms)"
+            << std::endl;
+  for (int step = 0; step < numberOfSteps; ++step)
+  {
+    double t = numberOfSteps > 1
+        ? static_cast<double>(step) / (numberOfSteps - 1)
+        : 0.0;
+    transform->Identity();
+    transform->Translate(-1.2 + 2.4 * t, 0.0, 0.8);
+    transform->RotateZ(90.0 * t);
+
+    timer->StartTimer();
+    intersection->Update();
+    timer->StopTimer();
+    double ms1 = 1000.0 * timer->GetElapsedTime();
+
+    timer->StartTimer();
+    collide->Update();
+    timer->StopTimer();
+    double ms2 = 1000.0 * timer->GetElapsedTime();
+
+    timer->StartTimer();
+    auto pairs = incremental.Update(transform->GetMatrix());
+    timer->StopTimer();
+    double ms3 = 1000.0 * timer->GetElapsedTime();
+
+    intersectionTime += ms1;
+    collideTime += ms2;
+    incrementalTime += ms3;
+    intersectionWorst = std::max(intersectionWorst, ms1);
+    collideWorst = std::max(collideWorst, ms2);
+    incrementalWorst = std::max(incrementalWorst, ms3);
+    std::cout << step << "  " << pairs << "  "
+              << incremental.GetSegments().size() << " ("
+              << intersection->GetOutput()->GetNumberOfLines() << ")  "
+              << ms1 << "  " << ms2 << "  " << ms3 << std::endl;
+  }
+  std::cout << "Mean (worst) ms per step" << std::endl;
+  std::cout << "  vtkIntersectionPolyDataFilter: "
+            << intersectionTime / numberOfSteps << " (" << intersectionWorst
+            << ")" << std::endl;
+  std::cout << "  vtkCollisionDetectionFilter:   "
+            << collideTime / numberOfSteps << " (" << collideWorst << ")"
+            << std::endl;
+  std::cout << "  Incremental:                   "
+            << incrementalTime / numberOfSteps << " (" << incrementalWorst
+            << ")" << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+namespace {
+void IncrementalIntersection::SetPart(vtkPolyData* part)
+{
+  this->Part = Triangulate(part);
+  CopyMesh(this->Part, this->PartPoints, this->PartTriangles);
+  this->PartTree->SetDataSet(this->Part);
+  this->PartTree->SetMaxLevel(20);
+  this->PartTree->SetNumberOfCellsPerNode(8);
+  this->PartTree->BuildLocator();
+}
+
+void IncrementalIntersection::SetTool(vtkPolyData* tool)
+{
+  this->Tool = Triangulate(tool);
+  CopyMesh(this->Tool, this->ToolPoints, this->ToolTriangles);
+  this->ToolTree->SetDataSet(this->Tool);
+  this->ToolTree->SetMaxLevel(20);
+  this->ToolTree->SetNumberOfCellsPerNode(8);
+  this->ToolTree->BuildLocator();
+  this->MovedToolPoints.resize(this->ToolPoints.size());
+}
+
+int IncrementalIntersection::CollectPairs(vtkOBBNode* nodeA,
+                                          vtkOBBNode* nodeB, vtkMatrix4x4*,
+                                          void* pairs)
+{
+  // Called for each pair of leaves whose boxes overlap.
+  auto cellPairs = static_cast<std::vector<CellPair>*>(pairs);
+  for (vtkIdType i = 0; i < nodeA->Cells->GetNumberOfIds(); ++i)
+  {
+    for (vtkIdType j = 0; j < nodeB->Cells->GetNumberOfIds(); ++j)
+    {
+      cellPairs->push_back(
+          CellPair{{nodeA->Cells->GetId(i), nodeB->Cells->GetId(j)}});
+    }
+  }
+  return 1;
+}
+
+std::size_t IncrementalIntersection::Update(vtkMatrix4x4* toolToPart)
+{
+  // Candidate pairs from the cached trees.
+  this->Pairs.clear();
+  this->PartTree->IntersectWithOBBTree(this->ToolTree, toolToPart,
+                                       CollectPairs, &this->Pairs);
+
+  // Move the tool points into the part's coordinates.
+  double m[16];
+  vtkMatrix4x4::DeepCopy(m, toolToPart);
+  vtkSMPTools::For(
+      0, static_cast<vtkIdType>(this->ToolPoints.size() / 3),
+      [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+          const double* x = &this->ToolPoints[3 * i];
+          for (int r = 0; r < 3; ++r)
+          {
+            this->MovedToolPoints[3 * i + r] = m[4 * r] * x[0] +
+                m[4 * r + 1] * x[1] + m[4 * r + 2] * x[2] + m[4 * r + 3];
+          }
+        }
+      });
+
+  // Exact triangle-triangle tests, in parallel.
+  vtkSMPThreadLocal<std::vector<Segment>> localSegments;
+  vtkSMPTools::For(
+      0, static_cast<vtkIdType>(this->Pairs.size()),
+      [&](vtkIdType begin, vtkIdType end) {
+        auto& segments = localSegments.Local();
+        for (vtkIdType k = begin; k < end; ++k)
+        {
+          const vtkIdType* pa = &this->PartTriangles[3 * this->Pairs[k][0]];
+          const vtkIdType* pb = &this->ToolTriangles[3 * this->Pairs[k][1]];
+          const double* a[3];
+          const double* b[3];
+          for (int i = 0; i < 3; ++i)
+          {
+            a[i] = &this->PartPoints[3 * pa[i]];
+            b[i] = &this->MovedToolPoints[3 * pb[i]];
+          }
+          Segment segment;
+          if (IntersectTriangles(a, b, segment))
+          {
+            segments.push_back(segment);
+          }
+        }
+      });
+  this->Segments.clear();
+  for (auto const& segments : localSegments)
+  {
+    this->Segments.insert(this->Segments.end(), segments.begin(),
+                          segments.end());
+  }
+  return this->Pairs.size();
+}
+
+// Only the polygons of mesh, as triangles, so that the cell ids of the
+// trees index the flat triangle lists.
+vtkSmartPointer<vtkPolyData> Triangulate(vtkPolyData* mesh)
+{
+  vtkNew<vtkTriangleFilter> triangleFilter;
+  triangleFilter->SetInputData(mesh);
+  triangleFilter->PassVertsOff();
+  triangleFilter->PassLinesOff();
+  triangleFilter->Update();
+  return triangleFilter->GetOutput();
+}
+
+// Flat copies of the points and triangles, safe to read from many threads.
+// The mesh holds only triangles, from Triangulate().
+void CopyMesh(vtkPolyData* mesh, std::vector<double>& points,
+              std::vector<vtkIdType>& triangles)
+{
+  points.resize(3 * mesh->GetNumberOfPoints());
+  for (vtkIdType i = 0; i < mesh->GetNumberOfPoints(); ++i)
+  {
+    mesh->GetPoint(i, &points[3 * i]);
+  }
+  triangles.clear();
+  vtkNew<vtkIdList> pts;
+  auto polys = mesh->GetPolys();
+  polys->InitTraversal();
+  while (polys->GetNextCell(pts))
+  {
+    for (vtkIdType i = 0; i < 3; ++i)
+    {
+      triangles.push_back(pts->GetId(i));
+    }
+  }
+}
+
+double Dot(const double a[3], const double b[3])
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Normal(const double* t[3], double n[3])
+{
+  double e1[3] = {t[1][0] - t[0][0], t[1][1] - t[0][1], t[1][2] - t[0][2]};
+  double e2[3] = {t[2][0] - t[0][0], t[2][1] - t[0][1], t[2][2] - t[0][2]};
+  n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// The segment where triangle t crosses the plane on which its vertices have
+// signed distances d. Returns false if it does not cross.
+bool PlaneCrossing(const double* t[3], const double d[3], double p[2][3])
+{
+  int count = 0;
+  for (int i = 0; i < 3 && count < 2; ++i)
+  {
+    int j = (i + 1) % 3;
+    if (d[i] == 0.0)
+    {
+      std::copy(t[i], t[i] + 3, p[count++]);
+    }
+    else if ((d[i] < 0.0 && d[j] > 0.0) || (d[i] > 0.0 && d[j] < 0.0))
+    {
+      double s = d[i] / (d[i] - d[j]);
+      for (int k = 0; k < 3; ++k)
+      {
+        p[count][k] = t[i][k] + s * (t[j][k] - t[i][k]);
+      }
+      ++count;
+    }
+  }
+  if (count == 1)
+  {
+    std::copy(p[0], p[0] + 3, p[1]); // Touches at a vertex.
+  }
+  return count > 0;
+}
+
+bool IntersectTriangles(const double* a[3], const double* b[3],
+                        Segment& segment)
+{
+  double na[3], nb[3];
+  Normal(a, na);
+  Normal(b, nb);
+
+  // Signed distances of each triangle's vertices to the other's plane,
+  // snapped to zero within a small tolerance.
+  double da[3], db[3];
+  double tolerance = 1.0e-12 * std::sqrt(Dot(na, na) + Dot(nb, nb));
+  for (int i = 0; i < 3; ++i)
+  {
+    double va[3] = {a[i][0] - b[0][0], a[i][1] - b[0][1], a[i][2] - b[0][2]};
+    double vb[3] = {b[i][0] - a[0][0], b[i][1] - a[0][1], b[i][2] - a[0][2]};
+    da[i] = Dot(nb, va);
+    db[i] = Dot(na, vb);
+    da[i] = std::abs(da[i]) < tolerance ? 0.0 : da[i];
+    db[i] = std::abs(db[i]) < tolerance ? 0.0 : db[i];
+  }
+  auto oneSide = [](const double d[3]) {
+    return (d[0] > 0.0 && d[1] > 0.0 && d[2] > 0.0) ||
+        (d[0] < 0.0 && d[1] < 0.0 && d[2] < 0.0) ||
+        (d[0] == 0.0 && d[1] == 0.0 && d[2] == 0.0); // Coplanar.
+  };
+  if (oneSide(da) || oneSide(db))
+  {
+    return false;
+  }
+
+  // Both crossings lie on the line where the planes meet. The intersection
+  // is the overlap of the two crossings along that line.
+  double pa[2][3], pb[2][3];
+  if (!PlaneCrossing(a, da, pa) || !PlaneCrossing(b, db, pb))
+  {
+    return false;
+  }
+  double line[3] = {na[1] * nb[2] - na[2] * nb[1],
+                    na[2] * nb[0] - na[0] * nb[2],
+                    na[0] * nb[1] - na[1] * nb[0]};
+  double ta[2] = {Dot(line, pa[0]), Dot(line, pa[1])};
+  double tb[2] = {Dot(line, pb[0]), Dot(line, pb[1])};
+  if (ta[0] > ta[1])
+  {
+    std::swap(ta[0], ta[1]);
+    std::swap(pa[0], pa[1]);
+  }
+  double lo = std::max(ta[0], std::min(tb[0], tb[1]));
+  double hi = std::min(ta[1], std::max(tb[0], tb[1]));
+  if (lo > hi)
+  {
+    return false;
+  }
+  double length = ta[1] - ta[0];
+  for (int k = 0; k < 3; ++k)
+  {
+    double direction = pa[1][k] - pa[0][k];
+    segment[k] =
+        pa[0][k] + (length > 0.0 ? direction * (lo - ta[0]) / length : 0.0);
+    segment[3 + k] =
+        pa[0][k] + (length > 0.0 ? direction * (hi - ta[0]) / length : 0.0);
+  }
+  return true;
+}
+} // namespace
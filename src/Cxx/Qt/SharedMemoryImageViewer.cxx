@@ -0,0 +1,517 @@
+#include <QApplication>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QStringList>
+#include <QTimer>
+
+#include <vtkGenericOpenGLRenderWindow.h>
+#include <vtkImageActor.h>
+#include <vtkImageData.h>
+#include <vtkNamedColors.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkVersion.h>
+
+#if VTK_VERSION_NUMBER >= 89000000000ULL
+#define VTK890 1
+#endif
+
+#include <QSurfaceFormat>
+#include <QVTKOpenGLNativeWidget.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "The channel needs lock free 64 bit atomics.");
+
+namespace {
+// The start of the shared memory. Frames are numbered from 0; frame n is
+// in slot n % NumberOfSlots. The producer writes frames [Released,
+// Released + NumberOfSlots) and the viewer reads frames [Released,
+// Written), so a slot is never written while it is read. Each counter is
+// written by one process only, which makes the ring lock free.
+struct ChannelHeader
+{
+  std::uint32_t Magic;
+  std::int32_t Width;
+  std::int32_t Height;
+  std::int32_t NumberOfSlots;
+  std::uint64_t SlotSize;
+  // Written by the producer, on its own cache line.
+  alignas(64) std::atomic<std::uint64_t> Written;
+  std::atomic<std::uint64_t> Dropped;
+  // Written by the viewer.
+  alignas(64) std::atomic<std::uint64_t> Released;
+  std::atomic<std::uint32_t> Stop;
+};
+
+// Each slot is this header, then the RGB pixels, 64 byte aligned.
+struct SlotHeader
+{
+  // When the frame was acquired, on the steady clock, in nanoseconds.
+  std::int64_t Timestamp;
+  // The producer's frame number. Gaps are frames it dropped.
+  std::uint64_t Number;
+};
+
+// A ring of RGB frames in shared memory, between one producer process
+// that writes frames and one viewer process that reads them, in place.
+class ImageChannel
+{
+public:
+  // The viewer creates the channel, the producer attaches to it.
+  bool Create(QString const& key, int width, int height, int numberOfSlots);
+  bool Attach(QString const& key);
+
+  int GetWidth() const
+  {
+    return this->Header->Width;
+  }
+  int GetHeight() const
+  {
+    return this->Header->Height;
+  }
+
+  // The producer's side. BeginFrame gives the slot to write the next frame
+  // into, or nullptr if the ring is full, and EndFrame publishes it.
+  unsigned char* BeginFrame();
+  void EndFrame(std::int64_t timestamp, std::uint64_t number);
+  void DropFrame()
+  {
+    this->Header->Dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  bool IsStopRequested() const
+  {
+    return this->Header->Stop.load(std::memory_order_acquire) != 0;
+  }
+
+  // The viewer's side. The frames published and not yet released, oldest
+  // first, stay valid until they are released.
+  int GetNumberOfFrames() const;
+  unsigned char* GetPixels(int frame) const;
+  std::int64_t GetTimestamp(int frame) const;
+  void Release(int count);
+  void RequestStop()
+  {
+    this->Header->Stop.store(1, std::memory_order_release);
+  }
+  std::uint64_t GetNumberOfWrittenFrames() const
+  {
+    return this->Header->Written.load(std::memory_order_acquire);
+  }
+  std::uint64_t GetNumberOfDroppedFrames() const
+  {
+    return this->Header->Dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  SlotHeader* GetSlot(std::uint64_t frame) const;
+
+  QSharedMemory Memory;
+  ChannelHeader* Header = nullptr;
+  unsigned char* Slots = nullptr;
+};
+
+// The producer process: writes frames at the given rate until the viewer
+// asks it to stop, or until the viewer has released no frame for a while,
+// which means it has hung or is gone.
+int RunProducer(QString const& key, double framesPerSecond);
+
+// Draws frame number into an RGB image, a pattern that moves.
+void DrawFrame(unsigned char* pixels, int width, int height,
+               std::uint64_t number);
+
+// The steady clock in nanoseconds, the same in both processes.
+std::int64_t Now();
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc > 3 && std::string(argv[1]) == "--producer")
+  {
+    return RunProducer(QString(argv[2]), std::atof(argv[3]));
+  }
+
+  // Arguments: [frames [framesPerSecond]]. The viewer shows that many
+  // 1920x1080 frames from a producer that writes them at that rate.
+  int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 600;
+  double framesPerSecond = argc > 2 ? std::max(1.0, std::atof(argv[2])) : 60;
+  int const width = 1920;
+  int const height = 1080;
+
+  // Needed to ensure appropriate OpenGL context is created for VTK rendering.
+  QSurfaceFormat::setDefaultFormat(QVTKOpenGLNativeWidget::defaultFormat());
+
+  QApplication app(argc, argv);
+
+  QString key =
+      QString("SharedMemoryImageViewer-%1").arg(app.applicationPid());
+  ImageChannel channel;
+  if (!channel.Create(key, width, height, 4))
+  {
+    std::cout << "Could not create the shared memory." << std::endl;
+    return EXIT_FAILURE;
+  }
+  QProcess producer;
+  producer.setProcessChannelMode(QProcess::ForwardedChannels);
+  producer.start(app.applicationFilePath(),
+                 QStringList() << "--producer" << key
+                               << QString::number(framesPerSecond));
+  if (!producer.waitForStarted())
+  {
+    std::cout << "Could not start the producer." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The producer runs until it is asked to stop. If it ends before that,
+  // or crashes, there are no more frames, and the viewer fails.
+  bool stopping = false;
+  bool producerFailed = false;
+  QObject::connect(
+      &producer,
+      static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(
+          &QProcess::finished),
+      [&](int exitCode, QProcess::ExitStatus exitStatus) {
+        if (!stopping)
+        {
+          std::cout << "The producer "
+                    << (exitStatus == QProcess::CrashExit ? "crashed"
+                                                          : "ended")
+                    << " with exit code " << exitCode << "." << std::endl;
+          producerFailed = true;
+          app.quit();
+        }
+      });
+  QObject::connect(&producer, &QProcess::errorOccurred,
+                   [&](QProcess::ProcessError) {
+                     if (!stopping)
+                     {
+                       std::cout << "The producer failed." << std::endl;
+                       producerFailed = true;
+                       app.quit();
+                     }
+                   });
+
+  // The image's scalars are the pixels of a slot, not a copy. Save is 1,
+  // so VTK does not free them.
+  vtkIdType values = static_cast<vtkIdType>(width) * height * 3;
+  vtkNew<vtkUnsignedCharArray> scalars;
+  scalars->SetNumberOfComponents(3);
+  scalars->SetArray(channel.GetPixels(0), values, 1);
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(width, height, 1);
+  image->GetPointData()->SetScalars(scalars);
+
+  vtkNew<vtkNamedColors> colors;
+
+  vtkNew<vtkImageActor> actor;
+  actor->SetInputData(image);
+
+  vtkNew<vtkRenderer> renderer;
+  renderer->AddActor(actor);
+  renderer->SetBackground(colors->GetColor3d("SlateGray").GetData());
+  renderer->ResetCamera();
+
+  QVTKOpenGLNativeWidget widget;
+  vtkNew<vtkGenericOpenGLRenderWindow> renderWindow;
+#if VTK890
+  widget.setRenderWindow(renderWindow);
+#else
+  widget.SetRenderWindow(renderWindow);
+#endif
+  renderWindow->AddRenderer(renderer);
+  renderWindow->SetWindowName("SharedMemoryImageViewer");
+  widget.resize(960, 540);
+  widget.show();
+
+  // Poll the ring. Show the newest frame and release the older ones; the
+  // frame on show stays in its slot until a newer one replaces it.
+  int received = 0;
+  int shown = 0;
+  bool showing = false;
+  double latencySum = 0.0;
+  double latencyMax = 0.0;
+  std::int64_t start = 0;
+  std::int64_t stop = 0;
+  QTimer timer;
+  timer.setTimerType(Qt::PreciseTimer);
+  QObject::connect(&timer, &QTimer::timeout, [&]() {
+    int available = channel.GetNumberOfFrames();
+    int pinned = showing ? 1 : 0;
+    if (available <= pinned)
+    {
+      return;
+    }
+    int newest = available - 1;
+    scalars->SetArray(channel.GetPixels(newest), values, 1);
+    scalars->Modified();
+    image->Modified();
+    renderWindow->Render();
+    std::int64_t now = Now();
+    double latency = 1.0e-6 * (now - channel.GetTimestamp(newest));
+    channel.Release(newest);
+    showing = true;
+
+    if (received == 0)
+    {
+      start = now;
+    }
+    received += available - pinned;
+    ++shown;
+    latencySum += latency;
+    latencyMax = std::max(latencyMax, latency);
+    stop = now;
+    if (shown % 60 == 0)
+    {
+      double seconds = 1.0e-9 * (now - start);
+      renderWindow->SetWindowName(
+          (std::to_string(static_cast<int>(shown / seconds)) +
+           " frames/s, " + std::to_string(latency) + " ms")
+              .c_str());
+    }
+    if (received >= frames)
+    {
+      app.quit();
+    }
+  });
+  timer.start(1);
+
+  app.exec();
+
+  stopping = true;
+  channel.RequestStop();
+  if (producer.state() != QProcess::NotRunning &&
+      !producer.waitForFinished(5000))
+  {
+    std::cout << "The producer did not stop." << std::endl;
+    producer.kill();
+    producer.waitForFinished();
+    producerFailed = true;
+  }
+  if (producer.exitStatus() != QProcess::NormalExit ||
+      producer.exitCode() != EXIT_SUCCESS)
+  {
+    producerFailed = true;
+  }
+  double seconds = 1.0e-9 * (stop - start);
+  std::cout << "Written " << channel.GetNumberOfWrittenFrames()
+            << ", dropped by the producer "
+            << channel.GetNumberOfDroppedFrames() << ", received "
+            << received << ", shown " << shown << std::endl;
+  if (shown > 1 && seconds > 0.0)
+  {
+    std::cout << "Received " << (received - 1) / seconds
+              << " frames/s, shown " << (shown - 1) / seconds
+              << " frames/s" << std::endl;
+  }
+  if (shown > 0)
+  {
+    std::cout << "Latency from acquisition to display: mean "
+              << latencySum / shown << " ms, max " << latencyMax << " ms"
+              << std::endl;
+  }
+
+  return producerFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+namespace {
+std::uint32_t const ChannelMagic = 0x564b4943;
+std::size_t const Alignment = 64;
+
+std::size_t RoundUp(std::size_t size)
+{
+  return (size + Alignment - 1) / Alignment * Alignment;
+}
+
+bool ImageChannel::Create(QString const& key, int width, int height,
+                          int numberOfSlots)
+{
+  std::size_t pixels = static_cast<std::size_t>(width) * height * 3;
+  std::size_t slotSize = RoundUp(sizeof(SlotHeader)) + RoundUp(pixels);
+  std::size_t headerSize = RoundUp(sizeof(ChannelHeader));
+  this->Memory.setKey(key);
+  if (!this->Memory.create(
+          static_cast<int>(headerSize + numberOfSlots * slotSize)))
+  {
+    return false;
+  }
+  auto data = static_cast<unsigned char*>(this->Memory.data());
+  this->Header = new (data) ChannelHeader;
+  this->Header->Magic = ChannelMagic;
+  this->Header->Width = width;
+  this->Header->Height = height;
+  this->Header->NumberOfSlots = numberOfSlots;
+  this->Header->SlotSize = slotSize;
+  this->Header->Written.store(0);
+  this->Header->Dropped.store(0);
+  this->Header->Released.store(0);
+  this->Header->Stop.store(0);
+  this->Slots = data + headerSize;
+  return true;
+}
+
+bool ImageChannel::Attach(QString const& key)
+{
+  this->Memory.setKey(key);
+  if (!this->Memory.attach())
+  {
+    return false;
+  }
+  auto data = static_cast<unsigned char*>(this->Memory.data());
+  this->Header = reinterpret_cast<ChannelHeader*>(data);
+  if (this->Header->Magic != ChannelMagic)
+  {
+    this->Memory.detach();
+    this->Header = nullptr;
+    return false;
+  }
+  this->Slots = data + RoundUp(sizeof(ChannelHeader));
+  return true;
+}
+
+SlotHeader* ImageChannel::GetSlot(std::uint64_t frame) const
+{
+  return reinterpret_cast<SlotHeader*>(
+      this->Slots + (frame % this->Header->NumberOfSlots) *
+          this->Header->SlotSize);
+}
+
+unsigned char* ImageChannel::BeginFrame()
+{
+  std::uint64_t written = this->Header->Written.load(std::memory_order_relaxed);
+  std::uint64_t released =
+      this->Header->Released.load(std::memory_order_acquire);
+  if (written - released >=
+      static_cast<std::uint64_t>(this->Header->NumberOfSlots))
+  {
+    return nullptr;
+  }
+  return reinterpret_cast<unsigned char*>(this->GetSlot(written)) +
+      RoundUp(sizeof(SlotHeader));
+}
+
+void ImageChannel::EndFrame(std::int64_t timestamp, std::uint64_t number)
+{
+  std::uint64_t written = this->Header->Written.load(std::memory_order_relaxed);
+  SlotHeader* slot = this->GetSlot(written);
+  slot->Timestamp = timestamp;
+  slot->Number = number;
+  this->Header->Written.store(written + 1, std::memory_order_release);
+}
+
+int ImageChannel::GetNumberOfFrames() const
+{
+  std::uint64_t written = this->Header->Written.load(std::memory_order_acquire);
+  std::uint64_t released =
+      this->Header->Released.load(std::memory_order_relaxed);
+  return static_cast<int>(written - released);
+}
+
+unsigned char* ImageChannel::GetPixels(int frame) const
+{
+  std::uint64_t released =
+      this->Header->Released.load(std::memory_order_relaxed);
+  return reinterpret_cast<unsigned char*>(this->GetSlot(released + frame)) +
+      RoundUp(sizeof(SlotHeader));
+}
+
+std::int64_t ImageChannel::GetTimestamp(int frame) const
+{
+  std::uint64_t released =
+      this->Header->Released.load(std::memory_order_relaxed);
+  return this->GetSlot(released + frame)->Timestamp;
+}
+
+void ImageChannel::Release(int count)
+{
+  std::uint64_t released =
+      this->Header->Released.load(std::memory_order_relaxed);
+  this->Header->Released.store(released + count, std::memory_order_release);
+}
+
+int RunProducer(QString const& key, double framesPerSecond)
+{
+  ImageChannel channel;
+  if (!channel.Attach(key))
+  {
+    std::cout << "The producer could not attach to the shared memory."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  // A camera: a frame every period, whether the viewer keeps up or not.
+  auto period = std::chrono::nanoseconds(
+      static_cast<std::int64_t>(1.0e9 / framesPerSecond));
+  auto next = std::chrono::steady_clock::now();
+  // The ring stays full only while the viewer releases nothing. If that
+  // lasts this long, the viewer has hung or died without asking the
+  // producer to stop, and the producer must not outlive it.
+  auto const timeout = std::chrono::seconds(10);
+  auto fullSince = next;
+  bool full = false;
+  for (std::uint64_t number = 0; !channel.IsStopRequested(); ++number)
+  {
+    std::this_thread::sleep_until(next);
+    next += period;
+    std::int64_t acquired = Now();
+    unsigned char* pixels = channel.BeginFrame();
+    if (!pixels)
+    {
+      channel.DropFrame();
+      auto now = std::chrono::steady_clock::now();
+      if (!full)
+      {
+        full = true;
+        fullSince = now;
+      }
+      else if (now - fullSince > timeout)
+      {
+        std::cout << "The viewer has released no frame for "
+                  << timeout.count() << " s, the producer stops."
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    full = false;
+    DrawFrame(pixels, channel.GetWidth(), channel.GetHeight(), number);
+    channel.EndFrame(acquired, number);
+  }
+  return EXIT_SUCCESS;
+}
+
+void DrawFrame(unsigned char* pixels, int width, int height,
+               std::uint64_t number)
+{
+  int shift = static_cast<int>(number * 8 % 256);
+  int bar = static_cast<int>(number * 16 % width);
+  for (int y = 0; y < height; ++y)
+  {
+    unsigned char* row = pixels + static_cast<std::size_t>(3) * width * y;
+    for (int x = 0; x < width; ++x)
+    {
+      bool onBar = x >= bar && x < bar + 32;
+      row[3 * x] = onBar ? 255 : static_cast<unsigned char>(x + shift);
+      row[3 * x + 1] = onBar ? 255 : static_cast<unsigned char>(y - shift);
+      row[3 * x + 2] = onBar ? 255 : static_cast<unsigned char>(x ^ y);
+    }
+  }
+}
+
+std::int64_t Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
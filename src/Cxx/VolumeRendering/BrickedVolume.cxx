@@ -0,0 +1,682 @@
+#include <vtkLZ4DataCompressor.h>
+#include <vtkNew.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+typedef std::vector<short> Brick;
+typedef std::shared_ptr<const Brick> BrickPointer;
+
+// A 16-bit volume split into bricks that are kept LZ4 compressed in memory.
+// Bricks overlap by one voxel so that trilinear interpolation never needs a
+// neighbour. Decompressed bricks are kept in a least recently used cache of
+// fixed size, so the memory used is the compressed size plus the cache,
+// however large the volume.
+class BrickedVolume
+{
+public:
+  BrickedVolume(const int dimensions[3], int brickSize,
+                std::size_t cacheBytes);
+
+  // Compress the bricks of one layer along z from its slices, which start
+  // at slice GetLayerFirstSlice(layer) and run to GetLayerLastSlice(layer).
+  void CompressLayer(int layer, std::vector<short> const& slices);
+
+  int GetNumberOfLayers() const
+  {
+    return this->NumberOfBricks[2];
+  }
+  int GetLayerFirstSlice(int layer) const
+  {
+    return layer * this->BrickSize;
+  }
+  int GetLayerLastSlice(int layer) const
+  {
+    return std::min((layer + 1) * this->BrickSize, this->Dimensions[2] - 1);
+  }
+
+  // The brick containing the continuous index p, with its first voxel.
+  BrickPointer GetBrick(const double p[3], int origin[3], int size[3]);
+
+  // Trilinear interpolation at continuous index p. The caller keeps the
+  // brick it last used, so that most samples do not go to the cache.
+  double Sample(const double p[3], BrickPointer& brick, int origin[3],
+                int size[3]);
+
+  // An axis aligned slice, through the cache.
+  void ExtractSlice(int axis, int index, std::vector<short>& slice);
+
+  std::size_t GetCompressedBytes() const;
+  std::size_t GetUniformBricks() const;
+  std::size_t GetCachedBytes() const
+  {
+    return this->CachedBytes;
+  }
+  void ClearCache();
+  void ResetStatistics()
+  {
+    this->Hits = 0;
+    this->Misses = 0;
+  }
+  std::size_t GetHits() const
+  {
+    return this->Hits;
+  }
+  std::size_t GetMisses() const
+  {
+    return this->Misses;
+  }
+
+private:
+  struct Compressed
+  {
+    int Size[3];
+    bool Uniform;
+    short Value; // The value of a uniform brick, which stores no data.
+    std::vector<unsigned char> Data;
+  };
+
+  int BrickId(const int b[3]) const
+  {
+    return b[0] +
+        this->NumberOfBricks[0] * (b[1] + this->NumberOfBricks[1] * b[2]);
+  }
+  BrickPointer Decompress(int id);
+
+  int Dimensions[3];
+  int BrickSize;
+  int NumberOfBricks[3];
+  std::vector<Compressed> Bricks;
+  vtkSMPThreadLocalObject<vtkLZ4DataCompressor> Compressors;
+
+  // The cache: the front of the list is the most recently used brick.
+  std::size_t CacheBytes;
+  std::size_t CachedBytes = 0;
+  std::list<std::pair<int, BrickPointer>> LeastRecentlyUsed;
+  std::unordered_map<int, std::list<std::pair<int, BrickPointer>>::iterator>
+      Cached;
+  std::mutex CacheMutex;
+  std::atomic<std::size_t> Hits{0};
+  std::atomic<std::size_t> Misses{0};
+};
+
+// A synthetic micro-CT scan of a porous sample in a cylindrical field of
+// view: zero outside, material with pores and noise inside.
+short Phantom(int i, int j, int k, int n);
+void FillSlices(int n, int first, int last, std::ifstream* raw,
+                std::vector<short>& slices);
+void RenderMaximumIntensity(BrickedVolume* bricked,
+                            std::vector<short> const* contiguous, int n,
+                            int size, std::vector<float>& image);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [dimension [brickSize [cacheMegabytes [volume.raw]]]]. The
+  // volume is dimension^3 voxels, synthetic unless a raw file of 16-bit
+  // voxels in native byte order is given.
+  int n = argc > 1 ? std::stoi(argv[1]) : 256;
+  int brickSize = argc > 2 ? std::stoi(argv[2]) : 64;
+  double cacheMegabytes = argc > 3 ? std::stod(argv[3]) : 16.0;
+  std::unique_ptr<std::ifstream> raw;
+  if (argc > 4)
+  {
+    raw.reset(new std::ifstream(argv[4], std::ios::binary));
+    if (!*raw)
+    {
+      std::cout << "Cannot open " << argv[4] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  int dimensions[3] = {n, n, n};
+  BrickedVolume bricked(
+      dimensions, brickSize,
+      static_cast<std::size_t>(cacheMegabytes * 1024.0 * 1024.0));
+  double rawMegabytes = 2.0 * n * n * static_cast<double>(n) / 1048576.0;
+  std::cout << "Volume: " << n << "^3 16-bit, " << rawMegabytes
+            << " MB, bricks: " << brickSize << "^3, cache: " << cacheMegabytes
+            << " MB" << std::endl;
+
+  // Build the bricks one layer at a time, so that the whole volume is
+  // never in memory.
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  std::vector<short> slices;
+  for (int layer = 0; layer < bricked.GetNumberOfLayers(); ++layer)
+  {
+    FillSlices(n, bricked.GetLayerFirstSlice(layer),
+               bricked.GetLayerLastSlice(layer), raw.get(), slices);
+    bricked.CompressLayer(layer, slices);
+  }
+  timer->StopTimer();
+  double compressedMegabytes = bricked.GetCompressedBytes() / 1048576.0;
+  std::cout << "Compressed in " << timer->GetElapsedTime() << " s to "
+            << compressedMegabytes << " MB, ratio "
+            << rawMegabytes / compressedMegabytes << ", "
+            << bricked.GetUniformBricks() << " uniform bricks" << std::endl;
+
+  // A contiguous copy to check against, when it fits comfortably.
+  std::vector<short> contiguous;
+  if (n <= 512)
+  {
+    FillSlices(n, 0, n - 1, raw.get(), contiguous);
+  }
+
+  // Slicers: axial, coronal and sagittal slices through the middle, from a
+  // cold cache and then again from a warm one.
+  bool correct = true;
+  const char* axisNames[] = {"Sagittal", "Coronal", "Axial"};
+  std::vector<short> slice;
+  for (int axis = 2; axis >= 0; --axis)
+  {
+    bricked.ClearCache();
+    timer->StartTimer();
+    bricked.ExtractSlice(axis, n / 2, slice);
+    timer->StopTimer();
+    double cold = timer->GetElapsedTime();
+    timer->StartTimer();
+    bricked.ExtractSlice(axis, n / 2, slice);
+    timer->StopTimer();
+    std::cout << axisNames[axis] << " slice: cold " << 1000.0 * cold
+              << " ms, warm " << 1000.0 * timer->GetElapsedTime() << " ms"
+              << std::endl;
+    if (!contiguous.empty())
+    {
+      int increments[3] = {1, n, n * n};
+      int u = axis == 0 ? 1 : 0;
+      int v = axis == 2 ? 1 : 2;
+      for (int b = 0; b < n && correct; ++b)
+      {
+        for (int a = 0; a < n; ++a)
+        {
+          std::size_t id = static_cast<std::size_t>(n / 2) * increments[axis] +
+              static_cast<std::size_t>(a) * increments[u] +
+              static_cast<std::size_t>(b) * increments[v];
+          if (slice[a + static_cast<std::size_t>(b) * n] != contiguous[id])
+          {
+            correct = false;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // The ray caster: a maximum intensity projection, which touches every
+  // brick, through the cache and then from the contiguous volume.
+  std::vector<float> image;
+  bricked.ClearCache();
+  bricked.ResetStatistics();
+  timer->StartTimer();
+  RenderMaximumIntensity(&bricked, nullptr, n, 256, image);
+  timer->StopTimer();
+  std::cout << "Maximum intensity projection: " << timer->GetElapsedTime()
+            << " s, cache hits " << bricked.GetHits() << ", misses "
+            << bricked.GetMisses() << std::endl;
+  std::cout << "Resident: " << compressedMegabytes << " MB compressed + "
+            << bricked.GetCachedBytes() / 1048576.0 << " MB cached, "
+            << "versus " << rawMegabytes << " MB contiguous" << std::endl;
+  if (!contiguous.empty())
+  {
+    std::vector<float> reference;
+    timer->StartTimer();
+    RenderMaximumIntensity(nullptr, &contiguous, n, 256, reference);
+    timer->StopTimer();
+    std::cout << "Maximum intensity projection, contiguous: "
+              << timer->GetElapsedTime() << " s" << std::endl;
+    correct = correct && image == reference;
+  }
+
+  if (!correct)
+  {
+    std::cout << "Error: the bricked volume differs from the contiguous one."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+BrickedVolume::BrickedVolume(const int dimensions[3], int brickSize,
+                             std::size_t cacheBytes)
+  : BrickSize(brickSize), CacheBytes(cacheBytes)
+{
+  for (int a = 0; a < 3; ++a)
+  {
+    this->Dimensions[a] = dimensions[a];
+    this->NumberOfBricks[a] =
+        std::max((dimensions[a] - 2) / brickSize + 1, 1);
+  }
+  this->Bricks.resize(static_cast<std::size_t>(this->NumberOfBricks[0]) *
+                      this->NumberOfBricks[1] * this->NumberOfBricks[2]);
+}
+
+void BrickedVolume::CompressLayer(int layer, std::vector<short> const& slices)
+{
+  int nx = this->NumberOfBricks[0];
+  int ny = this->NumberOfBricks[1];
+  vtkSMPTools::For(0, nx * ny, [&](vtkIdType begin, vtkIdType end) {
+    auto& compressor = this->Compressors.Local();
+    std::vector<short> voxels;
+    std::vector<unsigned char> shuffled;
+    for (vtkIdType id = begin; id < end; ++id)
+    {
+      int b[3] = {static_cast<int>(id % nx), static_cast<int>(id / nx), layer};
+      Compressed& brick = this->Bricks[this->BrickId(b)];
+      int first[3];
+      for (int a = 0; a < 3; ++a)
+      {
+        first[a] = b[a] * this->BrickSize;
+        brick.Size[a] =
+            std::min(first[a] + this->BrickSize, this->Dimensions[a] - 1) -
+            first[a] + 1;
+      }
+      voxels.clear();
+      for (int k = 0; k < brick.Size[2]; ++k)
+      {
+        for (int j = 0; j < brick.Size[1]; ++j)
+        {
+          auto row = slices.begin() +
+              (static_cast<std::size_t>(k) * this->Dimensions[1] + first[1] +
+               j) *
+                  this->Dimensions[0] +
+              first[0];
+          voxels.insert(voxels.end(), row, row + brick.Size[0]);
+        }
+      }
+      brick.Value = voxels[0];
+      brick.Uniform = std::all_of(voxels.begin(), voxels.end(),
+                                  [&](short v) { return v == brick.Value; });
+      if (brick.Uniform)
+      {
+        continue;
+      }
+
+      // Group the low and the high bytes, which compresses better since
+      // the high bytes vary slowly.
+      std::size_t count = voxels.size();
+      shuffled.resize(2 * count);
+      for (std::size_t v = 0; v < count; ++v)
+      {
+        auto value = static_cast<std::uint16_t>(voxels[v]);
+        shuffled[v] = static_cast<unsigned char>(value & 0xff);
+        shuffled[count + v] = static_cast<unsigned char>(value >> 8);
+      }
+      brick.Data.resize(compressor->GetMaximumCompressionSpace(2 * count));
+      std::size_t bytes =
+          compressor->Compress(shuffled.data(), 2 * count, brick.Data.data(),
+                               brick.Data.size());
+      brick.Data.resize(bytes);
+      brick.Data.shrink_to_fit();
+    }
+  });
+}
+
+BrickPointer BrickedVolume::Decompress(int id)
+{
+  Compressed const& brick = this->Bricks[id];
+  std::size_t count = static_cast<std::size_t>(brick.Size[0]) *
+      brick.Size[1] * brick.Size[2];
+  auto voxels = std::make_shared<Brick>(count, brick.Value);
+  if (!brick.Uniform)
+  {
+    std::vector<unsigned char> shuffled(2 * count);
+    this->Compressors.Local()->Uncompress(brick.Data.data(), brick.Data.size(),
+                                          shuffled.data(), 2 * count);
+    for (std::size_t v = 0; v < count; ++v)
+    {
+      (*voxels)[v] = static_cast<short>(
+          static_cast<std::uint16_t>(shuffled[v] | (shuffled[count + v] << 8)));
+    }
+  }
+  return voxels;
+}
+
+BrickPointer BrickedVolume::GetBrick(const double p[3], int origin[3],
+                                     int size[3])
+{
+  int b[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    b[a] = std::min(static_cast<int>(p[a]) / this->BrickSize,
+                    this->NumberOfBricks[a] - 1);
+    origin[a] = b[a] * this->BrickSize;
+  }
+  int id = this->BrickId(b);
+  std::copy(this->Bricks[id].Size, this->Bricks[id].Size + 3, size);
+  {
+    std::lock_guard<std::mutex> lock(this->CacheMutex);
+    auto cached = this->Cached.find(id);
+    if (cached != this->Cached.end())
+    {
+      ++this->Hits;
+      this->LeastRecentlyUsed.splice(this->LeastRecentlyUsed.begin(),
+                                     this->LeastRecentlyUsed,
+                                     cached->second);
+      return cached->second->second;
+    }
+  }
+
+  // Decompress outside the lock so that other threads are not held up. Two
+  // threads may decompress the same brick, the second one to finish uses
+  // the first one's.
+  ++this->Misses;
+  BrickPointer voxels = this->Decompress(id);
+  std::lock_guard<std::mutex> lock(this->CacheMutex);
+  auto cached = this->Cached.find(id);
+  if (cached != this->Cached.end())
+  {
+    return cached->second->second;
+  }
+  this->LeastRecentlyUsed.emplace_front(id, voxels);
+  this->Cached[id] = this->LeastRecentlyUsed.begin();
+  this->CachedBytes += voxels->size() * sizeof(short);
+  // Bricks still in use stay alive through their shared pointers.
+  while (this->CachedBytes > this->CacheBytes &&
+         this->LeastRecentlyUsed.size() > 1)
+  {
+    auto& oldest = this->LeastRecentlyUsed.back();
+    this->CachedBytes -= oldest.second->size() * sizeof(short);
+    this->Cached.erase(oldest.first);
+    this->LeastRecentlyUsed.pop_back();
+  }
+  return voxels;
+}
+
+double BrickedVolume::Sample(const double p[3], BrickPointer& brick,
+                             int origin[3], int size[3])
+{
+  double local[3];
+  bool inside = brick != nullptr;
+  for (int a = 0; a < 3 && inside; ++a)
+  {
+    local[a] = p[a] - origin[a];
+    // The last brick along an axis also holds the last voxel.
+    bool last = origin[a] + size[a] == this->Dimensions[a];
+    inside = local[a] >= 0.0 &&
+        (local[a] < this->BrickSize || (last && local[a] <= size[a] - 1));
+  }
+  if (!inside)
+  {
+    brick = this->GetBrick(p, origin, size);
+    for (int a = 0; a < 3; ++a)
+    {
+      local[a] = p[a] - origin[a];
+    }
+  }
+
+  int i[3];
+  double f[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    i[a] = std::min(static_cast<int>(local[a]), size[a] - 2);
+    f[a] = local[a] - i[a];
+  }
+  Brick const& v = *brick;
+  auto at = [&](int di, int dj, int dk) {
+    return static_cast<double>(
+        v[(i[0] + di) +
+          size[0] * ((i[1] + dj) + static_cast<std::size_t>(i[2] + dk) *
+                                       size[1])]);
+  };
+  double c00 = at(0, 0, 0) * (1.0 - f[0]) + at(1, 0, 0) * f[0];
+  double c10 = at(0, 1, 0) * (1.0 - f[0]) + at(1, 1, 0) * f[0];
+  double c01 = at(0, 0, 1) * (1.0 - f[0]) + at(1, 0, 1) * f[0];
+  double c11 = at(0, 1, 1) * (1.0 - f[0]) + at(1, 1, 1) * f[0];
+  double c0 = c00 * (1.0 - f[1]) + c10 * f[1];
+  double c1 = c01 * (1.0 - f[1]) + c11 * f[1];
+  return c0 * (1.0 - f[2]) + c1 * f[2];
+}
+
+void BrickedVolume::ExtractSlice(int axis, int index,
+                                 std::vector<short>& slice)
+{
+  // The slice spans the two other axes, u fastest.
+  int u = axis == 0 ? 1 : 0;
+  int v = axis == 2 ? 1 : 2;
+  int nu = this->Dimensions[u];
+  int nv = this->Dimensions[v];
+  slice.resize(static_cast<std::size_t>(nu) * nv);
+
+  // One brick per task: each decompresses at most once.
+  int bricksU = this->NumberOfBricks[u];
+  int bricksV = this->NumberOfBricks[v];
+  vtkSMPTools::For(0, bricksU * bricksV, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType id = begin; id < end; ++id)
+    {
+      double p[3];
+      p[axis] = index;
+      p[u] = static_cast<double>((id % bricksU) * this->BrickSize);
+      p[v] = static_cast<double>((id / bricksU) * this->BrickSize);
+      int origin[3], size[3];
+      BrickPointer brick = this->GetBrick(p, origin, size);
+      // Do not repeat the overlap, except for the last brick.
+      int lastU = std::min(origin[u] + this->BrickSize, nu) - origin[u];
+      int lastV = std::min(origin[v] + this->BrickSize, nv) - origin[v];
+      if (origin[u] + size[u] == nu)
+      {
+        lastU = size[u];
+      }
+      if (origin[v] + size[v] == nv)
+      {
+        lastV = size[v];
+      }
+      int ijk[3];
+      ijk[axis] = index - origin[axis];
+      for (int b = 0; b < lastV; ++b)
+      {
+        for (int a = 0; a < lastU; ++a)
+        {
+          ijk[u] = a;
+          ijk[v] = b;
+          slice[origin[u] + a + static_cast<std::size_t>(origin[v] + b) * nu] =
+              (*brick)[ijk[0] +
+                       size[0] *
+                           (ijk[1] + static_cast<std::size_t>(ijk[2]) *
+                                         size[1])];
+        }
+      }
+    }
+  });
+}
+
+std::size_t BrickedVolume::GetCompressedBytes() const
+{
+  std::size_t bytes = 0;
+  for (auto const& brick : this->Bricks)
+  {
+    bytes += sizeof(Compressed) + brick.Data.size();
+  }
+  return bytes;
+}
+
+std::size_t BrickedVolume::GetUniformBricks() const
+{
+  return std::count_if(this->Bricks.begin(), this->Bricks.end(),
+                       [](Compressed const& brick) { return brick.Uniform; });
+}
+
+void BrickedVolume::ClearCache()
+{
+  std::lock_guard<std::mutex> lock(this->CacheMutex);
+  this->LeastRecentlyUsed.clear();
+  this->Cached.clear();
+  this->CachedBytes = 0;
+}
+
+unsigned int Hash(unsigned int x, unsigned int y, unsigned int z)
+{
+  unsigned int h = (x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u);
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+short Phantom(int i, int j, int k, int n)
+{
+  double c = 0.5 * (n - 1);
+  double x = i - c;
+  double y = j - c;
+  if (x * x + y * y > 0.2 * n * n)
+  {
+    return 0;
+  }
+  // One pore in each cell of 32^3 voxels, at a random place and size.
+  const int cell = 32;
+  int ci = i / cell;
+  int cj = j / cell;
+  int ck = k / cell;
+  unsigned int h = Hash(ci, cj, ck);
+  double pi = ci * cell + 8 + (h & 15);
+  double pj = cj * cell + 8 + ((h >> 4) & 15);
+  double pk = ck * cell + 8 + ((h >> 8) & 15);
+  double r = 4 + ((h >> 12) & 7);
+  double d2 = (i - pi) * (i - pi) + (j - pj) * (j - pj) + (k - pk) * (k - pk);
+  short value = d2 < r * r ? 200 : 2000;
+  return static_cast<short>(value + static_cast<int>(Hash(i, j, k) & 63) - 32);
+}
+
+void FillSlices(int n, int first, int last, std::ifstream* raw,
+                std::vector<short>& slices)
+{
+  std::size_t sliceSize = static_cast<std::size_t>(n) * n;
+  slices.resize(sliceSize * (last - first + 1));
+  if (raw)
+  {
+    raw->clear();
+    raw->seekg(static_cast<std::streamoff>(2 * sliceSize * first));
+    raw->read(reinterpret_cast<char*>(slices.data()),
+              static_cast<std::streamsize>(2 * slices.size()));
+    return;
+  }
+  vtkSMPTools::For(first, last + 1, [&](vtkIdType begin, vtkIdType end) {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      short* slice = &slices[(k - first) * sliceSize];
+      for (int j = 0; j < n; ++j)
+      {
+        for (int i = 0; i < n; ++i)
+        {
+          slice[i + static_cast<std::size_t>(j) * n] =
+              Phantom(i, j, static_cast<int>(k), n);
+        }
+      }
+    }
+  });
+}
+
+// Orthographic maximum intensity projection, one sample per voxel, from
+// either the bricked or the contiguous volume.
+void RenderMaximumIntensity(BrickedVolume* bricked,
+                            std::vector<short> const* contiguous, int n,
+                            int size, std::vector<float>& image)
+{
+  const double pi = 3.14159265358979323846;
+  double azimuth = 30.0 * pi / 180.0;
+  double elevation = 20.0 * pi / 180.0;
+  double direction[3] = {std::cos(azimuth) * std::cos(elevation),
+                         std::sin(azimuth) * std::cos(elevation),
+                         std::sin(elevation)};
+  double right[3] = {-std::sin(azimuth), std::cos(azimuth), 0.0};
+  double up[3] = {right[1] * direction[2] - right[2] * direction[1],
+                  right[2] * direction[0] - right[0] * direction[2],
+                  right[0] * direction[1] - right[1] * direction[0]};
+  double last = n - 1;
+  double center = 0.5 * last;
+  double diagonal = std::sqrt(3.0) * last;
+  double pixel = diagonal / size;
+
+  image.assign(static_cast<std::size_t>(size) * size, 0.0f);
+  vtkSMPTools::For(0, size, [&](vtkIdType begin, vtkIdType end) {
+    BrickPointer brick;
+    int origin[3], brickSize[3];
+    for (int y = static_cast<int>(begin); y < end; ++y)
+    {
+      for (int x = 0; x < size; ++x)
+      {
+        double start[3];
+        double tNear = 0.0;
+        double tFar = VTK_DOUBLE_MAX;
+        for (int a = 0; a < 3; ++a)
+        {
+          start[a] = center + (x + 0.5 - 0.5 * size) * pixel * right[a] +
+              (y + 0.5 - 0.5 * size) * pixel * up[a] -
+              0.5 * diagonal * direction[a];
+          if (direction[a] == 0.0)
+          {
+            if (start[a] < 0.0 || start[a] > last)
+            {
+              tFar = -1.0;
+            }
+            continue;
+          }
+          double t0 = -start[a] / direction[a];
+          double t1 = (last - start[a]) / direction[a];
+          tNear = std::max(tNear, std::min(t0, t1));
+          tFar = std::min(tFar, std::max(t0, t1));
+        }
+        double maximum = 0.0;
+        for (double t = tNear; t <= tFar; t += 1.0)
+        {
+          double p[3];
+          for (int a = 0; a < 3; ++a)
+          {
+            p[a] = std::min(std::max(start[a] + t * direction[a], 0.0), last);
+          }
+          double value;
+          if (bricked)
+          {
+            value = bricked->Sample(p, brick, origin, brickSize);
+          }
+          else
+          {
+            // The same interpolation as BrickedVolume::Sample().
+            int i[3];
+            double f[3];
+            for (int a = 0; a < 3; ++a)
+            {
+              i[a] = std::min(static_cast<int>(p[a]), n - 2);
+              f[a] = p[a] - i[a];
+            }
+            auto at = [&](int di, int dj, int dk) {
+              return static_cast<double>(
+                  (*contiguous)[(i[0] + di) +
+                                n * ((i[1] + dj) +
+                                     static_cast<std::size_t>(i[2] + dk) *
+                                         n)]);
+            };
+            double c00 = at(0, 0, 0) * (1.0 - f[0]) + at(1, 0, 0) * f[0];
+            double c10 = at(0, 1, 0) * (1.0 - f[0]) + at(1, 1, 0) * f[0];
+            double c01 = at(0, 0, 1) * (1.0 - f[0]) + at(1, 0, 1) * f[0];
+            double c11 = at(0, 1, 1) * (1.0 - f[0]) + at(1, 1, 1) * f[0];
+            double c0 = c00 * (1.0 - f[1]) + c10 * f[1];
+            double c1 = c01 * (1.0 - f[1]) + c11 * f[1];
+            value = c0 * (1.0 - f[2]) + c1 * f[2];
+          }
+          maximum = std::max(maximum, value);
+        }
+        image[x + static_cast<std::size_t>(y) * size] =
+            static_cast<float>(maximum);
+      }
+    }
+  });
+}
+} // namespace
@@ -15,10 +15,13 @@
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
 #include <vtkRenderer.h>
+#include <vtkTimerLog.h>
 #include <vtkVolume.h>
 #include <vtkVolumeProperty.h>
 #include <vtkXMLImageDataReader.h>
 
+#include <algorithm>
+
 #define VTI_FILETYPE 1
 #define MHA_FILETYPE 2
 
@@ -44,6 +47,7 @@ void PrintUsage()
   cout << "  -CT_Muscle" << endl;
   cout << "  -FrameRate <rate>" << endl;
   cout << "  -DataReduction <factor>" << endl;
+  cout << "  -Benchmark <frames>" << endl;
   cout << endl;
   cout << "You must use either the -DICOM option to specify the directory where"
        << endl;
@@ -69,6 +73,11 @@ void PrintUsage()
           "zero and"
        << endl;
   cout << "less than one) to reduce the data before rendering." << endl;
+  cout << "Use the -Benchmark option to render offscreen, orbiting the camera"
+       << endl;
+  cout << "through the given number of frames for each thread count, and print"
+       << endl;
+  cout << "the time taken by each frame." << endl;
   cout << "Use one of the remaining options to specify the blend function"
        << endl;
   cout << "and transfer functions. The -MIP option utilizes a maximum intensity"
@@ -90,6 +99,45 @@ void PrintUsage()
       << endl;
   cout << endl;
 }
+
+// Orbit the camera once around the volume for 1, 2, 4, ... threads and
+// report the time taken by each frame.
+void Benchmark(vtkRenderWindow* renWin, vtkRenderer* renderer,
+               vtkFixedPointVolumeRayCastMapper* mapper, int numberOfFrames)
+{
+  // Render every frame at full quality.
+  mapper->AutoAdjustSampleDistancesOff();
+  auto camera = renderer->GetActiveCamera();
+  vtkNew<vtkTimerLog> timer;
+  int maximumThreads = mapper->GetNumberOfThreads();
+  for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+  {
+    mapper->SetNumberOfThreads(threads);
+    renWin->Render(); // Warm up.
+    double total = 0.0;
+    double worst = 0.0;
+    cout << threads << " threads, ms per frame:";
+    for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+      camera->Azimuth(360.0 / numberOfFrames);
+      renderer->ResetCameraClippingRange();
+      timer->StartTimer();
+      renWin->Render();
+      timer->StopTimer();
+      double ms = 1000.0 * timer->GetElapsedTime();
+      total += ms;
+      worst = std::max(worst, ms);
+      cout << " " << ms;
+    }
+    cout << endl;
+    cout << "  mean " << total / numberOfFrames << " ms, worst " << worst
+         << " ms" << endl;
+    if (threads == maximumThreads)
+    {
+      break;
+    }
+  }
+}
 } // namespace
 
 int main(int argc, char* argv[])
@@ -106,6 +154,7 @@ int main(int argc, char* argv[])
   double frameRate = 10.0;
   char* fileName = 0;
   int fileType = 0;
+  int benchmarkFrames = 0;
 
   bool independentComponents = true;
 
@@ -210,6 +259,18 @@ int main(int argc, char* argv[])
       }
       count += 2;
     }
+    else if (!strcmp(argv[count], "-Benchmark"))
+    {
+      benchmarkFrames = atoi(argv[count + 1]);
+      if (benchmarkFrames < 1)
+      {
+        cout << "Invalid number of frames - use a number greater than 0"
+             << endl;
+        cout << "Using the default of 36 frames." << endl;
+        benchmarkFrames = 36;
+      }
+      count += 2;
+    }
     else if (!strcmp(argv[count], "-DependentComponents"))
     {
       independentComponents = false;
@@ -239,6 +300,10 @@ int main(int argc, char* argv[])
   vtkNew<vtkRenderer> renderer;
   vtkNew<vtkRenderWindow> renWin;
   renWin->AddRenderer(renderer);
+  if (benchmarkFrames > 0)
+  {
+    renWin->OffScreenRenderingOn();
+  }
 
   // Connect it all. Note that funny arithematic on the
   // SetDesiredUpdateRate - the vtkRenderWindow divides it
@@ -496,6 +561,12 @@ int main(int argc, char* argv[])
   camera->SetDistance(421.227);
   camera->SetClippingRange(146.564, 767.987);
 
+  if (benchmarkFrames > 0)
+  {
+    Benchmark(renWin, renderer, mapper, benchmarkFrames);
+    return EXIT_SUCCESS;
+  }
+
   // interact with data
   renWin->Render();
 
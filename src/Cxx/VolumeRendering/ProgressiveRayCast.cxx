@@ -0,0 +1,670 @@
+#include <vtkColorTransferFunction.h>
+#include <vtkImageCast.h>
+#include <vtkImageData.h>
+#include <vtkMetaImageReader.h>
+#include <vtkNew.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+struct Volume
+{
+  int Dimensions[3];
+  double Origin[3];
+  double Spacing[3];
+  std::vector<float> Scalars;
+
+  float At(int i, int j, int k) const
+  {
+    return this->Scalars[i +
+                         this->Dimensions[0] *
+                             (j + static_cast<std::size_t>(k) *
+                                      this->Dimensions[1])];
+  }
+  double Sample(const double p[3]) const;
+};
+
+// Opacity and color tables, with the opacity corrected for the sample
+// distance.
+struct TransferFunction
+{
+  void Build(vtkColorTransferFunction* color, vtkPiecewiseFunction* opacity,
+             const double range[2], double sampleDistance,
+             double unitDistance);
+
+  int Index(double scalar) const
+  {
+    int i = static_cast<int>((scalar - this->Minimum) * this->Scale);
+    return std::min(std::max(i, 0), TableSize - 1);
+  }
+
+  static const int TableSize = 4096;
+  double Minimum;
+  double Scale;
+  double SampleDistance;
+  std::vector<float> Opacity;
+  std::vector<float> Color;
+};
+
+struct Camera
+{
+  double Azimuth;
+  double Elevation;
+};
+
+// Renders an image in short slices of work. The first slice after a camera
+// change renders one ray in stride x stride pixels, with the stride chosen
+// to fit the latency budget. Later slices fill in the pixels between them,
+// halving the stride until every pixel has a ray, then add jittered samples
+// that are accumulated until the image converges. Changing the camera only
+// resets a few counters, so it cancels the refinement at once.
+class ProgressiveRayCaster
+{
+public:
+  ProgressiveRayCaster(Volume const& volume, TransferFunction const& transfer,
+                       int size, int maximumSamples);
+
+  void SetLatencyBudget(double seconds)
+  {
+    this->LatencyBudget = seconds;
+  }
+  void SetCamera(Camera const& camera);
+
+  // Refine for about the given time. The first call after SetCamera()
+  // renders only the coarse pass, whatever the time. Returns false once the
+  // image has converged.
+  bool Refine(double seconds);
+
+  bool IsFullResolution() const
+  {
+    return this->Pass >= this->NumberOfStridePasses;
+  }
+  int GetFirstStride() const
+  {
+    return this->FirstStride;
+  }
+  int GetPass() const
+  {
+    return this->Pass;
+  }
+  void GetImage(std::vector<float>& image) const;
+
+private:
+  int GetStride() const
+  {
+    return this->IsFullResolution() ? 1 : this->FirstStride >> this->Pass;
+  }
+  void RenderRow(int y, int stride);
+  void CastRay(int x, int y, unsigned int sample, float rgba[4]) const;
+
+  Volume const& Data;
+  TransferFunction const& Transfer;
+  int Size;
+  int MaximumSamples;
+  double LatencyBudget = 0.05;
+  double SecondsPerRay = 0.0; // Per thread, measured as we go.
+
+  // The view.
+  double Center[3];
+  double Diagonal;
+  double Direction[3];
+  double Right[3];
+  double Up[3];
+
+  // Progress.
+  int FirstStride = 4;
+  int NumberOfStridePasses = 3;
+  int Pass = 0;
+  int NextRow = 0;
+  std::vector<float> Accumulated;
+  std::vector<unsigned int> Samples;
+};
+
+void MakePhantom(int size, Volume& volume);
+void SetBonePreset(vtkColorTransferFunction* color,
+                   vtkPiecewiseFunction* opacity);
+double RootMeanSquare(std::vector<float> const& a, std::vector<float> const& b);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [volume.mhd|volume.vti [imageSize [budgetMs
+  // [scalarOffset]]]]. The preset assumes Hounsfield units, the offset is
+  // added to the scalars to get there.
+  int imageSize = argc > 2 ? std::stoi(argv[2]) : 256;
+  double budget = argc > 3 ? std::stod(argv[3]) / 1000.0 : 0.05;
+  double offset = argc > 4 ? std::stod(argv[4]) : 0.0;
+
+  Volume volume;
+  if (argc > 1)
+  {
+    vtkSmartPointer<vtkAlgorithm> reader;
+    std::string extension =
+        vtksys::SystemTools::GetFilenameLastExtension(std::string(argv[1]));
+    if (extension == ".vti")
+    {
+      vtkNew<vtkXMLImageDataReader> xmlReader;
+      xmlReader->SetFileName(argv[1]);
+      reader = xmlReader;
+    }
+    else
+    {
+      vtkNew<vtkMetaImageReader> metaReader;
+      metaReader->SetFileName(argv[1]);
+      reader = metaReader;
+    }
+    vtkNew<vtkImageCast> cast;
+    cast->SetInputConnection(reader->GetOutputPort());
+    cast->SetOutputScalarTypeToFloat();
+    cast->Update();
+    auto image = cast->GetOutput();
+    image->GetDimensions(volume.Dimensions);
+    image->GetOrigin(volume.Origin);
+    image->GetSpacing(volume.Spacing);
+    if (volume.Dimensions[0] < 2 || volume.Dimensions[1] < 2 ||
+        volume.Dimensions[2] < 2)
+    {
+      std::cout << "Error loading " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto scalars = static_cast<float*>(
+        image->GetPointData()->GetScalars()->GetVoidPointer(0));
+    volume.Scalars.assign(scalars, scalars + image->GetNumberOfPoints());
+    for (auto& s : volume.Scalars)
+    {
+      s += static_cast<float>(offset);
+    }
+  }
+  else
+  {
+    MakePhantom(128, volume);
+  }
+  auto range = std::minmax_element(volume.Scalars.begin(),
+                                   volume.Scalars.end());
+  double scalarRange[2] = {*range.first, *range.second};
+
+  // One sample per voxel leaves wood grain artifacts, which the jittered
+  // samples average out.
+  double sampleDistance = std::min(
+      volume.Spacing[0], std::min(volume.Spacing[1], volume.Spacing[2]));
+  vtkNew<vtkColorTransferFunction> colorFun;
+  vtkNew<vtkPiecewiseFunction> opacityFun;
+  SetBonePreset(colorFun, opacityFun);
+  TransferFunction transfer;
+  transfer.Build(colorFun, opacityFun, scalarRange, sampleDistance, 0.8919);
+
+  std::cout << "Volume: " << volume.Dimensions[0] << " x "
+            << volume.Dimensions[1] << " x " << volume.Dimensions[2]
+            << ", image: " << imageSize << " x " << imageSize
+            << ", budget: " << 1000.0 * budget << " ms"
+            << ", threads: " << vtkSMPTools::GetEstimatedNumberOfThreads()
+            << std::endl;
+
+  const int maximumSamples = 8;
+  ProgressiveRayCaster caster(volume, transfer, imageSize, maximumSamples);
+  caster.SetLatencyBudget(budget);
+
+  // What a non-progressive renderer does on each frame: one ray for every
+  // pixel.
+  Camera home{0.0, 15.0};
+  double start = vtkTimerLog::GetUniversalTime();
+  {
+    ProgressiveRayCaster single(volume, transfer, imageSize, 1);
+    single.SetCamera(home);
+    while (single.Refine(VTK_DOUBLE_MAX))
+    {
+    }
+  }
+  std::cout << "Full resolution frame: "
+            << 1000.0 * (vtkTimerLog::GetUniversalTime() - start) << " ms"
+            << std::endl;
+
+  // A converged reference for the view the interaction ends on.
+  Camera last{40.0, 15.0};
+  std::vector<float> reference;
+  {
+    ProgressiveRayCaster converged(volume, transfer, imageSize,
+                                   4 * maximumSamples);
+    converged.SetCamera(last);
+    while (converged.Refine(VTK_DOUBLE_MAX))
+    {
+    }
+    converged.GetImage(reference);
+  }
+
+  // The user drags the camera: every motion restarts the image and only the
+  // coarse pass is rendered before the next one arrives.
+  const int numberOfMotions = 20;
+  double total = 0.0;
+  double worst = 0.0;
+  for (int i = 1; i <= numberOfMotions; ++i)
+  {
+    Camera camera{last.Azimuth * i / numberOfMotions, 15.0};
+    start = vtkTimerLog::GetUniversalTime();
+    caster.SetCamera(camera);
+    caster.Refine(budget);
+    double seconds = vtkTimerLog::GetUniversalTime() - start;
+    total += seconds;
+    worst = std::max(worst, seconds);
+  }
+  std::cout << "Camera motion, stride " << caster.GetFirstStride()
+            << ": mean " << 1000.0 * total / numberOfMotions << " ms, worst "
+            << 1000.0 * worst << " ms" << std::endl;
+
+  // The user stops: idle frames refine the image.
+  std::cout << "Idle refinement" << std::endl;
+  std::cout << "  Slice  Elapsed (ms)  Pass  RMS error" << std::endl;
+  start = vtkTimerLog::GetUniversalTime();
+  std::vector<float> image;
+  caster.GetImage(image);
+  std::cout << "  0  0  0  " << RootMeanSquare(image, reference) << std::endl;
+  double firstFullError = -1.0;
+  double elapsed = 0.0;
+  for (int slice = 1; caster.Refine(budget); ++slice)
+  {
+    elapsed = vtkTimerLog::GetUniversalTime() - start;
+    caster.GetImage(image);
+    double error = RootMeanSquare(image, reference);
+    if (firstFullError < 0.0 && caster.IsFullResolution())
+    {
+      firstFullError = error;
+    }
+    std::cout << "  " << slice << "  " << 1000.0 * elapsed << "  "
+              << caster.GetPass() << "  " << error << std::endl;
+  }
+  caster.GetImage(image);
+  double finalError = RootMeanSquare(image, reference);
+  std::cout << "  Converged after "
+            << 1000.0 * (vtkTimerLog::GetUniversalTime() - start)
+            << " ms, RMS error " << finalError << std::endl;
+
+  // The user moves again in the middle of the refinement.
+  caster.SetCamera(home);
+  caster.Refine(budget);
+  caster.Refine(budget);
+  start = vtkTimerLog::GetUniversalTime();
+  caster.SetCamera(last);
+  caster.Refine(budget);
+  std::cout << "Camera motion during refinement: "
+            << 1000.0 * (vtkTimerLog::GetUniversalTime() - start) << " ms"
+            << std::endl;
+
+  // Accumulating the jittered samples must not make the image worse.
+  if (firstFullError >= 0.0 && finalError > firstFullError)
+  {
+    std::cout << "Error: accumulation increased the error." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+double Volume::Sample(const double p[3]) const
+{
+  int i[3];
+  double f[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    i[a] = std::min(static_cast<int>(p[a]), this->Dimensions[a] - 2);
+    f[a] = p[a] - i[a];
+  }
+  double c00 = this->At(i[0], i[1], i[2]) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1], i[2]) * f[0];
+  double c10 = this->At(i[0], i[1] + 1, i[2]) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1] + 1, i[2]) * f[0];
+  double c01 = this->At(i[0], i[1], i[2] + 1) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1], i[2] + 1) * f[0];
+  double c11 = this->At(i[0], i[1] + 1, i[2] + 1) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1] + 1, i[2] + 1) * f[0];
+  double c0 = c00 * (1.0 - f[1]) + c10 * f[1];
+  double c1 = c01 * (1.0 - f[1]) + c11 * f[1];
+  return c0 * (1.0 - f[2]) + c1 * f[2];
+}
+
+void TransferFunction::Build(vtkColorTransferFunction* color,
+                             vtkPiecewiseFunction* opacity,
+                             const double range[2], double sampleDistance,
+                             double unitDistance)
+{
+  this->Minimum = range[0];
+  this->Scale = (TableSize - 1) / std::max(range[1] - range[0], 1.0e-6);
+  this->SampleDistance = sampleDistance;
+  this->Opacity.resize(TableSize);
+  this->Color.resize(3 * TableSize);
+  opacity->GetTable(range[0], range[1], TableSize, this->Opacity.data());
+  color->GetTable(range[0], range[1], TableSize, this->Color.data());
+  for (auto& alpha : this->Opacity)
+  {
+    double a = std::min(std::max(alpha, 0.0f), 1.0f);
+    alpha = static_cast<float>(
+        1.0 - std::pow(1.0 - a, sampleDistance / unitDistance));
+  }
+}
+
+// A hash of the pixel and sample number, mapped to [0, 1).
+double Jitter(unsigned int x, unsigned int y, unsigned int sample)
+{
+  unsigned int h = (x * 73856093u) ^ (y * 19349663u) ^ (sample * 83492791u);
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return (h >> 8) / 16777216.0;
+}
+
+ProgressiveRayCaster::ProgressiveRayCaster(Volume const& volume,
+                                           TransferFunction const& transfer,
+                                           int size, int maximumSamples)
+  : Data(volume), Transfer(transfer), Size(size),
+    MaximumSamples(maximumSamples)
+{
+  this->Diagonal = 0.0;
+  for (int a = 0; a < 3; ++a)
+  {
+    double length = (volume.Dimensions[a] - 1) * volume.Spacing[a];
+    this->Center[a] = volume.Origin[a] + 0.5 * length;
+    this->Diagonal += length * length;
+  }
+  this->Diagonal = std::sqrt(this->Diagonal);
+  this->Accumulated.resize(4 * static_cast<std::size_t>(size) * size);
+  this->Samples.resize(static_cast<std::size_t>(size) * size);
+}
+
+void ProgressiveRayCaster::SetCamera(Camera const& camera)
+{
+  const double pi = 3.14159265358979323846;
+  double azimuth = camera.Azimuth * pi / 180.0;
+  double elevation = camera.Elevation * pi / 180.0;
+  this->Direction[0] = std::cos(azimuth) * std::cos(elevation);
+  this->Direction[1] = std::sin(azimuth) * std::cos(elevation);
+  this->Direction[2] = std::sin(elevation);
+  this->Right[0] = -std::sin(azimuth);
+  this->Right[1] = std::cos(azimuth);
+  this->Right[2] = 0.0;
+  for (int a = 0; a < 3; ++a)
+  {
+    int b = (a + 1) % 3;
+    int c = (a + 2) % 3;
+    this->Up[a] = this->Right[b] * this->Direction[c] -
+        this->Right[c] * this->Direction[b];
+  }
+
+  // The coarsest stride is 4, or more if 4 would not fit the budget.
+  int threads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  this->FirstStride = 4;
+  while (this->FirstStride < 16)
+  {
+    double rays = std::pow(std::ceil(1.0 * this->Size / this->FirstStride), 2);
+    if (rays * this->SecondsPerRay / threads <= this->LatencyBudget)
+    {
+      break;
+    }
+    this->FirstStride *= 2;
+  }
+  this->NumberOfStridePasses = 1;
+  for (int s = this->FirstStride; s > 1; s /= 2)
+  {
+    ++this->NumberOfStridePasses;
+  }
+
+  // Samples are counted per pixel, so the accumulation does not need to be
+  // cleared here: the first sample of a pixel overwrites it.
+  std::fill(this->Samples.begin(), this->Samples.end(), 0u);
+  this->Pass = 0;
+  this->NextRow = 0;
+}
+
+bool ProgressiveRayCaster::Refine(double seconds)
+{
+  int numberOfPasses = this->NumberOfStridePasses + this->MaximumSamples - 1;
+  int threads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  double start = vtkTimerLog::GetUniversalTime();
+  while (this->Pass < numberOfPasses)
+  {
+    int stride = this->GetStride();
+    int rows = (this->Size + stride - 1) / stride;
+    if (this->NextRow == rows)
+    {
+      ++this->Pass;
+      this->NextRow = 0;
+      continue;
+    }
+    double remaining = seconds - (vtkTimerLog::GetUniversalTime() - start);
+    if (remaining <= 0.0 && this->Pass > 0)
+    {
+      break;
+    }
+
+    // As many rows as fit in the remaining time, but all of the coarse
+    // pass, so that there is always an image to show.
+    int raysPerRow = rows;
+    int batch = rows - this->NextRow;
+    if (this->Pass > 0)
+    {
+      double fit = this->SecondsPerRay > 0.0
+          ? remaining * threads / (this->SecondsPerRay * raysPerRow)
+          : rows / 8.0;
+      fit = std::min(fit, static_cast<double>(batch));
+      batch = std::max(static_cast<int>(fit), 1);
+    }
+    double batchStart = vtkTimerLog::GetUniversalTime();
+    int first = this->NextRow;
+    vtkSMPTools::For(first, first + batch,
+                     [&](vtkIdType begin, vtkIdType end) {
+                       for (vtkIdType r = begin; r < end; ++r)
+                       {
+                         this->RenderRow(static_cast<int>(r) * stride,
+                                         stride);
+                       }
+                     });
+    double perRay = (vtkTimerLog::GetUniversalTime() - batchStart) *
+        threads / (static_cast<double>(batch) * raysPerRow);
+    this->SecondsPerRay = this->SecondsPerRay > 0.0
+        ? 0.5 * (this->SecondsPerRay + perRay)
+        : perRay;
+    this->NextRow += batch;
+    if (this->Pass == 0)
+    {
+      break; // Show the coarse image as soon as it is done.
+    }
+  }
+  return this->Pass < numberOfPasses;
+}
+
+void ProgressiveRayCaster::RenderRow(int y, int stride)
+{
+  // A fill pass skips the pixels that the coarser passes rendered.
+  bool fill = !this->IsFullResolution() && this->Pass > 0;
+  for (int x = 0; x < this->Size; x += stride)
+  {
+    if (fill && x % (2 * stride) == 0 && y % (2 * stride) == 0)
+    {
+      continue;
+    }
+    std::size_t pixel = static_cast<std::size_t>(y) * this->Size + x;
+    float rgba[4];
+    this->CastRay(x, y, this->Samples[pixel], rgba);
+    float* accumulated = &this->Accumulated[4 * pixel];
+    for (int c = 0; c < 4; ++c)
+    {
+      accumulated[c] =
+          this->Samples[pixel] == 0 ? rgba[c] : accumulated[c] + rgba[c];
+    }
+    ++this->Samples[pixel];
+  }
+}
+
+// Orthographic front-to-back compositing without shading. The samples along
+// the ray start at a jittered fraction of the sample distance.
+void ProgressiveRayCaster::CastRay(int x, int y, unsigned int sample,
+                                   float rgba[4]) const
+{
+  Volume const& volume = this->Data;
+  double pixel = this->Diagonal / this->Size;
+  double origin[3], step[3];
+  double tNear = 0.0;
+  double tFar = VTK_DOUBLE_MAX;
+  for (int a = 0; a < 3; ++a)
+  {
+    double world = this->Center[a] +
+        (x + 0.5 - 0.5 * this->Size) * pixel * this->Right[a] +
+        (y + 0.5 - 0.5 * this->Size) * pixel * this->Up[a] -
+        0.5 * this->Diagonal * this->Direction[a];
+    origin[a] = (world - volume.Origin[a]) / volume.Spacing[a];
+    step[a] = this->Direction[a] / volume.Spacing[a];
+    double last = volume.Dimensions[a] - 1;
+    if (step[a] == 0.0)
+    {
+      if (origin[a] < 0.0 || origin[a] > last)
+      {
+        tFar = -1.0;
+      }
+      continue;
+    }
+    double t0 = -origin[a] / step[a];
+    double t1 = (last - origin[a]) / step[a];
+    tNear = std::max(tNear, std::min(t0, t1));
+    tFar = std::min(tFar, std::max(t0, t1));
+  }
+
+  double rgb[3] = {0.0, 0.0, 0.0};
+  double alpha = 0.0;
+  double dt = this->Transfer.SampleDistance;
+  for (double t = tNear + Jitter(x, y, sample) * dt; t <= tFar && alpha < 0.99;
+       t += dt)
+  {
+    double p[3];
+    for (int a = 0; a < 3; ++a)
+    {
+      p[a] = std::min(std::max(origin[a] + t * step[a], 0.0),
+                      volume.Dimensions[a] - 1.0);
+    }
+    int index = this->Transfer.Index(volume.Sample(p));
+    double opacity = this->Transfer.Opacity[index];
+    if (opacity > 0.0)
+    {
+      double weight = (1.0 - alpha) * opacity;
+      for (int c = 0; c < 3; ++c)
+      {
+        rgb[c] += weight * this->Transfer.Color[3 * index + c];
+      }
+      alpha += weight;
+    }
+  }
+  rgba[0] = static_cast<float>(rgb[0]);
+  rgba[1] = static_cast<float>(rgb[1]);
+  rgba[2] = static_cast<float>(rgb[2]);
+  rgba[3] = static_cast<float>(alpha);
+}
+
+void ProgressiveRayCaster::GetImage(std::vector<float>& image) const
+{
+  // Pixels without a ray yet take the value of the nearest coarser pixel
+  // above and to the left that has one.
+  image.resize(this->Accumulated.size());
+  vtkSMPTools::For(0, this->Size, [&](vtkIdType begin, vtkIdType end) {
+    for (int y = static_cast<int>(begin); y < end; ++y)
+    {
+      for (int x = 0; x < this->Size; ++x)
+      {
+        std::size_t source = 0;
+        unsigned int samples = 0;
+        for (int s = 1; s <= this->FirstStride && samples == 0; s *= 2)
+        {
+          source =
+              static_cast<std::size_t>(y - y % s) * this->Size + x - x % s;
+          samples = this->Samples[source];
+        }
+        float* rgba = &image[4 * (static_cast<std::size_t>(y) * this->Size +
+                                  x)];
+        for (int c = 0; c < 4; ++c)
+        {
+          rgba[c] =
+              samples ? this->Accumulated[4 * source + c] / samples : 0.0f;
+        }
+      }
+    }
+  });
+}
+
+// A head-like phantom in Hounsfield units: air, skin and soft tissue, a
+// skull, and brain.
+void MakePhantom(int size, Volume& volume)
+{
+  for (int a = 0; a < 3; ++a)
+  {
+    volume.Dimensions[a] = size;
+    volume.Origin[a] = 0.0;
+    volume.Spacing[a] = 1.0;
+  }
+  volume.Scalars.resize(static_cast<std::size_t>(size) * size * size);
+  double c = 0.5 * (size - 1);
+  vtkSMPTools::For(0, size, [&](vtkIdType begin, vtkIdType end) {
+    for (int k = static_cast<int>(begin); k < end; ++k)
+    {
+      for (int j = 0; j < size; ++j)
+      {
+        for (int i = 0; i < size; ++i)
+        {
+          double x = (i - c) / (0.40 * size);
+          double y = (j - c) / (0.35 * size);
+          double z = (k - c) / (0.45 * size);
+          double r = std::sqrt(x * x + y * y + z * z);
+          float value = -1000.0f; // Air
+          if (r < 0.80)
+          {
+            value = 35.0f; // Brain
+          }
+          else if (r < 0.90)
+          {
+            value = 1200.0f; // Skull
+          }
+          else if (r < 1.0)
+          {
+            value = 40.0f; // Skin and soft tissue
+          }
+          volume.Scalars[i + size * (j + static_cast<std::size_t>(k) * size)] =
+              value;
+        }
+      }
+    }
+  });
+}
+
+// CT_Bone from FixedPointVolumeRayCastMapperCT.
+void SetBonePreset(vtkColorTransferFunction* colorFun,
+                   vtkPiecewiseFunction* opacityFun)
+{
+  colorFun->AddRGBPoint(-3024, 0, 0, 0, 0.5, 0.0);
+  colorFun->AddRGBPoint(-16, 0.73, 0.25, 0.30, 0.49, .61);
+  colorFun->AddRGBPoint(641, .90, .82, .56, .5, 0.0);
+  colorFun->AddRGBPoint(3071, 1, 1, 1, .5, 0.0);
+
+  opacityFun->AddPoint(-3024, 0, 0.5, 0.0);
+  opacityFun->AddPoint(-16, 0, .49, .61);
+  opacityFun->AddPoint(641, .72, .5, 0.0);
+  opacityFun->AddPoint(3071, .71, 0.5, 0.0);
+}
+
+double RootMeanSquare(std::vector<float> const& a, std::vector<float> const& b)
+{
+  double sum = 0.0;
+  for (std::size_t i = 0; i < a.size(); ++i)
+  {
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return std::sqrt(sum / a.size());
+}
+} // namespace
@@ -0,0 +1,657 @@
+#include <vtkColorTransferFunction.h>
+#include <vtkImageCast.h>
+#include <vtkImageData.h>
+#include <vtkMetaImageReader.h>
+#include <vtkNew.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+struct Volume
+{
+  int Dimensions[3];
+  double Origin[3];
+  double Spacing[3];
+  std::vector<float> Scalars;
+
+  float At(int i, int j, int k) const
+  {
+    return this->Scalars[i +
+                         this->Dimensions[0] *
+                             (j + static_cast<std::size_t>(k) *
+                                      this->Dimensions[1])];
+  }
+  double Sample(const double p[3]) const;
+};
+
+// Opacity and color tables for one transfer function, with the opacity
+// corrected for the sample distance.
+class TransferFunction
+{
+public:
+  void Build(vtkColorTransferFunction* color, vtkPiecewiseFunction* opacity,
+             const double range[2], double sampleDistance,
+             double unitDistance);
+
+  int Index(double scalar) const
+  {
+    int i = static_cast<int>((scalar - this->Minimum) * this->Scale);
+    return std::min(std::max(i, 0), TableSize - 1);
+  }
+
+  // True if any scalar in [low, high] has a non-zero opacity.
+  bool IsVisible(double low, double high) const
+  {
+    // Widen the range a little so that rounding in the interpolation can
+    // not reach an entry that the range misses.
+    double margin = 1.0e-6 / this->Scale;
+    int first = this->Index(low - margin);
+    int last = this->Index(high + margin);
+    return this->Visible[last + 1] > this->Visible[first];
+  }
+
+  static const int TableSize = 4096;
+  double Minimum;
+  double Scale;
+  std::vector<float> Opacity;
+  std::vector<float> Color;
+  std::vector<int> Visible; // Running count of the visible entries.
+};
+
+// Two levels of macro cells holding the scalar range of the voxels they
+// touch. Classifying a transfer function marks the cells in which every
+// sample is transparent, so rays can leap over them.
+class MacroCellGrid
+{
+public:
+  void Build(Volume const& volume);
+  void Classify(TransferFunction const& transferFunction);
+
+  // Returns true if the cell of the given level containing p is empty, and
+  // its bounds in continuous index coordinates.
+  bool IsEmpty(int level, const double p[3], double low[3],
+               double high[3]) const;
+
+  double EmptyFraction(int level) const;
+
+private:
+  struct Level
+  {
+    int CellSize;
+    int Dimensions[3];
+    std::vector<float> Minimum;
+    std::vector<float> Maximum;
+    std::vector<unsigned char> Empty;
+  };
+  Level Levels[2];
+};
+
+struct Camera
+{
+  double Azimuth;
+  double Elevation;
+  int Size;
+};
+
+void RenderImage(Volume const& volume, TransferFunction const& transfer,
+                 MacroCellGrid const* grid, Camera const& camera,
+                 double sampleDistance, std::vector<float>& image);
+void MakePhantom(int size, Volume& volume);
+void SetPreset(int preset, vtkColorTransferFunction* color,
+               vtkPiecewiseFunction* opacity);
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  // Arguments: [volume.mhd|volume.vti [numberOfFrames [imageSize
+  // [scalarOffset]]]]. The presets assume Hounsfield units, the offset is
+  // added to the scalars to get there.
+  int numberOfFrames = argc > 2 ? std::stoi(argv[2]) : 6;
+  int imageSize = argc > 3 ? std::stoi(argv[3]) : 200;
+  double offset = argc > 4 ? std::stod(argv[4]) : 0.0;
+
+  Volume volume;
+  if (argc > 1)
+  {
+    vtkSmartPointer<vtkAlgorithm> reader;
+    std::string extension =
+        vtksys::SystemTools::GetFilenameLastExtension(std::string(argv[1]));
+    if (extension == ".vti")
+    {
+      vtkNew<vtkXMLImageDataReader> xmlReader;
+      xmlReader->SetFileName(argv[1]);
+      reader = xmlReader;
+    }
+    else
+    {
+      vtkNew<vtkMetaImageReader> metaReader;
+      metaReader->SetFileName(argv[1]);
+      reader = metaReader;
+    }
+    vtkNew<vtkImageCast> cast;
+    cast->SetInputConnection(reader->GetOutputPort());
+    cast->SetOutputScalarTypeToFloat();
+    cast->Update();
+    auto image = cast->GetOutput();
+    image->GetDimensions(volume.Dimensions);
+    image->GetOrigin(volume.Origin);
+    image->GetSpacing(volume.Spacing);
+    if (volume.Dimensions[0] < 2 || volume.Dimensions[1] < 2 ||
+        volume.Dimensions[2] < 2)
+    {
+      std::cout << "Error loading " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto scalars = static_cast<float*>(
+        image->GetPointData()->GetScalars()->GetVoidPointer(0));
+    volume.Scalars.assign(scalars, scalars + image->GetNumberOfPoints());
+    for (auto& s : volume.Scalars)
+    {
+      s += static_cast<float>(offset);
+    }
+  }
+  else
+  {
+    MakePhantom(160, volume);
+  }
+  auto range = std::minmax_element(volume.Scalars.begin(),
+                                   volume.Scalars.end());
+  double scalarRange[2] = {*range.first, *range.second};
+  double sampleDistance = 0.5 *
+      std::min(volume.Spacing[0],
+               std::min(volume.Spacing[1], volume.Spacing[2]));
+
+  std::cout << "Volume: " << volume.Dimensions[0] << " x "
+            << volume.Dimensions[1] << " x " << volume.Dimensions[2]
+            << ", image: " << imageSize << " x " << imageSize
+            << ", frames: " << numberOfFrames
+            << ", threads: " << vtkSMPTools::GetEstimatedNumberOfThreads()
+            << std::endl;
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  MacroCellGrid grid;
+  grid.Build(volume);
+  timer->StopTimer();
+  std::cout << "Macro cell ranges (once per volume): "
+            << 1000.0 * timer->GetElapsedTime() << " ms" << std::endl;
+
+  const char* presetNames[] = {"CT_Skin", "CT_Bone", "CT_Muscle"};
+  std::vector<float> full;
+  std::vector<float> leaped;
+  TransferFunction transfer;
+  bool identical = true;
+  for (int preset = 0; preset < 3; ++preset)
+  {
+    vtkNew<vtkColorTransferFunction> colorFun;
+    vtkNew<vtkPiecewiseFunction> opacityFun;
+    SetPreset(preset, colorFun, opacityFun);
+
+    // Only this part is redone when the transfer function changes.
+    timer->StartTimer();
+    transfer.Build(colorFun, opacityFun, scalarRange, sampleDistance, 0.8919);
+    grid.Classify(transfer);
+    timer->StopTimer();
+    std::cout << presetNames[preset] << ": classify "
+              << 1000.0 * timer->GetElapsedTime() << " ms, empty cells "
+              << 100.0 * grid.EmptyFraction(0) << "% (8^3), "
+              << 100.0 * grid.EmptyFraction(1) << "% (64^3)" << std::endl;
+
+    double fullTime = 0.0;
+    double leapedTime = 0.0;
+    for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+      Camera camera{360.0 * frame / numberOfFrames, 15.0, imageSize};
+      timer->StartTimer();
+      RenderImage(volume, transfer, nullptr, camera, sampleDistance, full);
+      timer->StopTimer();
+      fullTime += timer->GetElapsedTime();
+
+      timer->StartTimer();
+      RenderImage(volume, transfer, &grid, camera, sampleDistance, leaped);
+      timer->StopTimer();
+      leapedTime += timer->GetElapsedTime();
+
+      // Leaping only skips transparent samples, the images must match.
+      identical = identical && full == leaped;
+    }
+    std::cout << "  ms per frame, every sample: "
+              << 1000.0 * fullTime / numberOfFrames
+              << ", empty space skipped: "
+              << 1000.0 * leapedTime / numberOfFrames
+              << ", speedup: " << fullTime / leapedTime << std::endl;
+  }
+
+  // Thread count sweep with the last preset.
+  int maximumThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  for (int threads = 1;; threads = std::min(2 * threads, maximumThreads))
+  {
+    vtkSMPTools::Initialize(threads);
+    timer->StartTimer();
+    for (int frame = 0; frame < numberOfFrames; ++frame)
+    {
+      Camera camera{360.0 * frame / numberOfFrames, 15.0, imageSize};
+      RenderImage(volume, transfer, &grid, camera, sampleDistance, leaped);
+    }
+    timer->StopTimer();
+    std::cout << threads << " threads: "
+              << 1000.0 * timer->GetElapsedTime() / numberOfFrames
+              << " ms per frame" << std::endl;
+    if (threads == maximumThreads)
+    {
+      break;
+    }
+  }
+
+  if (!identical)
+  {
+    std::cout << "Error: the images differ when empty space is skipped."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+double Volume::Sample(const double p[3]) const
+{
+  int i[3];
+  double f[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    i[a] = std::min(static_cast<int>(p[a]), this->Dimensions[a] - 2);
+    f[a] = p[a] - i[a];
+  }
+  double c00 = this->At(i[0], i[1], i[2]) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1], i[2]) * f[0];
+  double c10 = this->At(i[0], i[1] + 1, i[2]) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1] + 1, i[2]) * f[0];
+  double c01 = this->At(i[0], i[1], i[2] + 1) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1], i[2] + 1) * f[0];
+  double c11 = this->At(i[0], i[1] + 1, i[2] + 1) * (1.0 - f[0]) +
+      this->At(i[0] + 1, i[1] + 1, i[2] + 1) * f[0];
+  double c0 = c00 * (1.0 - f[1]) + c10 * f[1];
+  double c1 = c01 * (1.0 - f[1]) + c11 * f[1];
+  return c0 * (1.0 - f[2]) + c1 * f[2];
+}
+
+void TransferFunction::Build(vtkColorTransferFunction* color,
+                             vtkPiecewiseFunction* opacity,
+                             const double range[2], double sampleDistance,
+                             double unitDistance)
+{
+  this->Minimum = range[0];
+  this->Scale = (TableSize - 1) / std::max(range[1] - range[0], 1.0e-6);
+  this->Opacity.resize(TableSize);
+  this->Color.resize(3 * TableSize);
+  opacity->GetTable(range[0], range[1], TableSize, this->Opacity.data());
+  color->GetTable(range[0], range[1], TableSize, this->Color.data());
+  this->Visible.resize(TableSize + 1);
+  this->Visible[0] = 0;
+  for (int i = 0; i < TableSize; ++i)
+  {
+    double alpha = std::min(std::max(this->Opacity[i], 0.0f), 1.0f);
+    alpha = 1.0 - std::pow(1.0 - alpha, sampleDistance / unitDistance);
+    this->Opacity[i] = static_cast<float>(alpha);
+    this->Visible[i + 1] = this->Visible[i] + (this->Opacity[i] > 0.0f);
+  }
+}
+
+void MacroCellGrid::Build(Volume const& volume)
+{
+  // Level 0: 8^3 voxels per cell. A cell covers the voxels up to and
+  // including the first voxel of its neighbour, since samples inside the
+  // cell interpolate them.
+  Level& fine = this->Levels[0];
+  fine.CellSize = 8;
+  for (int a = 0; a < 3; ++a)
+  {
+    fine.Dimensions[a] =
+        std::max((volume.Dimensions[a] - 2) / fine.CellSize + 1, 1);
+  }
+  std::size_t numberOfCells = static_cast<std::size_t>(fine.Dimensions[0]) *
+      fine.Dimensions[1] * fine.Dimensions[2];
+  fine.Minimum.resize(numberOfCells);
+  fine.Maximum.resize(numberOfCells);
+  vtkSMPTools::For(0, fine.Dimensions[2], [&](vtkIdType begin, vtkIdType end) {
+    for (int ck = static_cast<int>(begin); ck < end; ++ck)
+    {
+      for (int cj = 0; cj < fine.Dimensions[1]; ++cj)
+      {
+        for (int ci = 0; ci < fine.Dimensions[0]; ++ci)
+        {
+          int c[3] = {ci, cj, ck};
+          int first[3], last[3];
+          for (int a = 0; a < 3; ++a)
+          {
+            first[a] = c[a] * fine.CellSize;
+            last[a] =
+                std::min(first[a] + fine.CellSize, volume.Dimensions[a] - 1);
+          }
+          float low = volume.At(first[0], first[1], first[2]);
+          float high = low;
+          for (int k = first[2]; k <= last[2]; ++k)
+          {
+            for (int j = first[1]; j <= last[1]; ++j)
+            {
+              for (int i = first[0]; i <= last[0]; ++i)
+              {
+                float s = volume.At(i, j, k);
+                low = std::min(low, s);
+                high = std::max(high, s);
+              }
+            }
+          }
+          std::size_t id = ci +
+              fine.Dimensions[0] *
+                  (cj + static_cast<std::size_t>(ck) * fine.Dimensions[1]);
+          fine.Minimum[id] = low;
+          fine.Maximum[id] = high;
+        }
+      }
+    }
+  });
+
+  // Level 1: 8^3 cells of level 0 per cell.
+  Level& coarse = this->Levels[1];
+  coarse.CellSize = 8 * fine.CellSize;
+  for (int a = 0; a < 3; ++a)
+  {
+    coarse.Dimensions[a] = (fine.Dimensions[a] + 7) / 8;
+  }
+  numberOfCells = static_cast<std::size_t>(coarse.Dimensions[0]) *
+      coarse.Dimensions[1] * coarse.Dimensions[2];
+  coarse.Minimum.assign(numberOfCells, VTK_FLOAT_MAX);
+  coarse.Maximum.assign(numberOfCells, -VTK_FLOAT_MAX);
+  for (int ck = 0; ck < fine.Dimensions[2]; ++ck)
+  {
+    for (int cj = 0; cj < fine.Dimensions[1]; ++cj)
+    {
+      for (int ci = 0; ci < fine.Dimensions[0]; ++ci)
+      {
+        std::size_t id = ci +
+            fine.Dimensions[0] *
+                (cj + static_cast<std::size_t>(ck) * fine.Dimensions[1]);
+        std::size_t parent = ci / 8 +
+            coarse.Dimensions[0] *
+                (cj / 8 + static_cast<std::size_t>(ck / 8) *
+                         coarse.Dimensions[1]);
+        coarse.Minimum[parent] =
+            std::min(coarse.Minimum[parent], fine.Minimum[id]);
+        coarse.Maximum[parent] =
+            std::max(coarse.Maximum[parent], fine.Maximum[id]);
+      }
+    }
+  }
+}
+
+void MacroCellGrid::Classify(TransferFunction const& transferFunction)
+{
+  for (auto& level : this->Levels)
+  {
+    level.Empty.resize(level.Minimum.size());
+    for (std::size_t i = 0; i < level.Minimum.size(); ++i)
+    {
+      level.Empty[i] =
+          !transferFunction.IsVisible(level.Minimum[i], level.Maximum[i]);
+    }
+  }
+}
+
+bool MacroCellGrid::IsEmpty(int level, const double p[3], double low[3],
+                            double high[3]) const
+{
+  Level const& cells = this->Levels[level];
+  int c[3];
+  for (int a = 0; a < 3; ++a)
+  {
+    c[a] = std::min(static_cast<int>(p[a]) / cells.CellSize,
+                    cells.Dimensions[a] - 1);
+    low[a] = c[a] * cells.CellSize;
+    high[a] = low[a] + cells.CellSize;
+  }
+  return cells.Empty[c[0] +
+                     cells.Dimensions[0] *
+                         (c[1] + static_cast<std::size_t>(c[2]) *
+                                     cells.Dimensions[1])] != 0;
+}
+
+double MacroCellGrid::EmptyFraction(int level) const
+{
+  auto const& empty = this->Levels[level].Empty;
+  return static_cast<double>(std::count(empty.begin(), empty.end(), 1)) /
+      empty.size();
+}
+
+// Orthographic front-to-back compositing, without shading. The samples are
+// at fixed multiples of the sample distance along each ray, with or without
+// leaping, so both give the same image.
+void RenderImage(Volume const& volume, TransferFunction const& transfer,
+                 MacroCellGrid const* grid, Camera const& camera,
+                 double sampleDistance, std::vector<float>& image)
+{
+  const double pi = 3.14159265358979323846;
+  double azimuth = camera.Azimuth * pi / 180.0;
+  double elevation = camera.Elevation * pi / 180.0;
+  double direction[3] = {std::cos(azimuth) * std::cos(elevation),
+                         std::sin(azimuth) * std::cos(elevation),
+                         std::sin(elevation)};
+  double right[3] = {-std::sin(azimuth), std::cos(azimuth), 0.0};
+  double up[3] = {right[1] * direction[2] - right[2] * direction[1],
+                  right[2] * direction[0] - right[0] * direction[2],
+                  right[0] * direction[1] - right[1] * direction[0]};
+
+  double center[3];
+  double diagonal = 0.0;
+  for (int a = 0; a < 3; ++a)
+  {
+    double length = (volume.Dimensions[a] - 1) * volume.Spacing[a];
+    center[a] = volume.Origin[a] + 0.5 * length;
+    diagonal += length * length;
+  }
+  diagonal = std::sqrt(diagonal);
+  int size = camera.Size;
+  double pixel = diagonal / size;
+
+  image.assign(4 * static_cast<std::size_t>(size) * size, 0.0f);
+  vtkSMPTools::For(0, size, [&](vtkIdType begin, vtkIdType end) {
+    for (int y = static_cast<int>(begin); y < end; ++y)
+    {
+      for (int x = 0; x < size; ++x)
+      {
+        // The ray in continuous index coordinates, with t in world units.
+        double origin[3], step[3];
+        double tNear = 0.0;
+        double tFar = VTK_DOUBLE_MAX;
+        for (int a = 0; a < 3; ++a)
+        {
+          double world = center[a] + (x + 0.5 - 0.5 * size) * pixel * right[a] +
+              (y + 0.5 - 0.5 * size) * pixel * up[a] -
+              0.5 * diagonal * direction[a];
+          origin[a] = (world - volume.Origin[a]) / volume.Spacing[a];
+          step[a] = direction[a] / volume.Spacing[a];
+          double last = volume.Dimensions[a] - 1;
+          if (step[a] == 0.0)
+          {
+            if (origin[a] < 0.0 || origin[a] > last)
+            {
+              tFar = -1.0;
+            }
+            continue;
+          }
+          double t0 = -origin[a] / step[a];
+          double t1 = (last - origin[a]) / step[a];
+          tNear = std::max(tNear, std::min(t0, t1));
+          tFar = std::min(tFar, std::max(t0, t1));
+        }
+        if (tNear > tFar)
+        {
+          continue;
+        }
+
+        double rgb[3] = {0.0, 0.0, 0.0};
+        double alpha = 0.0;
+        int count = static_cast<int>((tFar - tNear) / sampleDistance);
+        for (int n = 0; n <= count && alpha < 0.99; ++n)
+        {
+          double t = tNear + n * sampleDistance;
+          double p[3] = {origin[0] + t * step[0], origin[1] + t * step[1],
+                         origin[2] + t * step[2]};
+          for (int a = 0; a < 3; ++a)
+          {
+            p[a] = std::min(std::max(p[a], 0.0),
+                            volume.Dimensions[a] - 1.0);
+          }
+          if (grid)
+          {
+            double low[3], high[3];
+            if (grid->IsEmpty(1, p, low, high) ||
+                grid->IsEmpty(0, p, low, high))
+            {
+              // Leap to the first sample past the cell.
+              double tExit = VTK_DOUBLE_MAX;
+              for (int a = 0; a < 3; ++a)
+              {
+                if (step[a] > 0.0)
+                {
+                  tExit = std::min(tExit, (high[a] - origin[a]) / step[a]);
+                }
+                else if (step[a] < 0.0)
+                {
+                  tExit = std::min(tExit, (low[a] - origin[a]) / step[a]);
+                }
+              }
+              int next = static_cast<int>(
+                             std::floor((tExit - tNear) / sampleDistance)) +
+                  1;
+              n = std::max(n, next - 1); // The loop increments n.
+              continue;
+            }
+          }
+          int index = transfer.Index(volume.Sample(p));
+          double opacity = transfer.Opacity[index];
+          if (opacity > 0.0)
+          {
+            double weight = (1.0 - alpha) * opacity;
+            for (int c = 0; c < 3; ++c)
+            {
+              rgb[c] += weight * transfer.Color[3 * index + c];
+            }
+            alpha += weight;
+          }
+        }
+        float* rgba = &image[4 * (static_cast<std::size_t>(y) * size + x)];
+        rgba[0] = static_cast<float>(rgb[0]);
+        rgba[1] = static_cast<float>(rgb[1]);
+        rgba[2] = static_cast<float>(rgb[2]);
+        rgba[3] = static_cast<float>(alpha);
+      }
+    }
+  });
+}
+
+// A head-like phantom in Hounsfield units: air, skin and soft tissue, a
+// skull, and brain.
+void MakePhantom(int size, Volume& volume)
+{
+  for (int a = 0; a < 3; ++a)
+  {
+    volume.Dimensions[a] = size;
+    volume.Origin[a] = 0.0;
+    volume.Spacing[a] = 1.0;
+  }
+  volume.Scalars.resize(static_cast<std::size_t>(size) * size * size);
+  double c = 0.5 * (size - 1);
+  vtkSMPTools::For(0, size, [&](vtkIdType begin, vtkIdType end) {
+    for (int k = static_cast<int>(begin); k < end; ++k)
+    {
+      for (int j = 0; j < size; ++j)
+      {
+        for (int i = 0; i < size; ++i)
+        {
+          double x = (i - c) / (0.40 * size);
+          double y = (j - c) / (0.35 * size);
+          double z = (k - c) / (0.45 * size);
+          double r = std::sqrt(x * x + y * y + z * z);
+          float value = -1000.0f; // Air
+          if (r < 0.80)
+          {
+            value = 35.0f; // Brain
+          }
+          else if (r < 0.90)
+          {
+            value = 1200.0f; // Skull
+          }
+          else if (r < 1.0)
+          {
+            value = 40.0f; // Skin and soft tissue
+          }
+          volume.Scalars[i + size * (j + static_cast<std::size_t>(k) * size)] =
+              value;
+        }
+      }
+    }
+  });
+}
+
+// The CT presets of FixedPointVolumeRayCastMapperCT.
+void SetPreset(int preset, vtkColorTransferFunction* colorFun,
+               vtkPiecewiseFunction* opacityFun)
+{
+  switch (preset)
+  {
+  // CT_Skin
+  case 0:
+    colorFun->AddRGBPoint(-3024, 0, 0, 0, 0.5, 0.0);
+    colorFun->AddRGBPoint(-1000, .62, .36, .18, 0.5, 0.0);
+    colorFun->AddRGBPoint(-500, .88, .60, .29, 0.33, 0.45);
+    colorFun->AddRGBPoint(3071, .83, .66, 1, 0.5, 0.0);
+
+    opacityFun->AddPoint(-3024, 0, 0.5, 0.0);
+    opacityFun->AddPoint(-1000, 0, 0.5, 0.0);
+    opacityFun->AddPoint(-500, 1.0, 0.33, 0.45);
+    opacityFun->AddPoint(3071, 1.0, 0.5, 0.0);
+    break;
+
+  // CT_Bone
+  case 1:
+    colorFun->AddRGBPoint(-3024, 0, 0, 0, 0.5, 0.0);
+    colorFun->AddRGBPoint(-16, 0.73, 0.25, 0.30, 0.49, .61);
+    colorFun->AddRGBPoint(641, .90, .82, .56, .5, 0.0);
+    colorFun->AddRGBPoint(3071, 1, 1, 1, .5, 0.0);
+
+    opacityFun->AddPoint(-3024, 0, 0.5, 0.0);
+    opacityFun->AddPoint(-16, 0, .49, .61);
+    opacityFun->AddPoint(641, .72, .5, 0.0);
+    opacityFun->AddPoint(3071, .71, 0.5, 0.0);
+    break;
+
+  // CT_Muscle
+  default:
+    colorFun->AddRGBPoint(-3024, 0, 0, 0, 0.5, 0.0);
+    colorFun->AddRGBPoint(-155, .55, .25, .15, 0.5, .92);
+    colorFun->AddRGBPoint(217, .88, .60, .29, 0.33, 0.45);
+    colorFun->AddRGBPoint(420, 1, .94, .95, 0.5, 0.0);
+    colorFun->AddRGBPoint(3071, .83, .66, 1, 0.5, 0.0);
+
+    opacityFun->AddPoint(-3024, 0, 0.5, 0.0);
+    opacityFun->AddPoint(-155, 0, 0.5, 0.92);
+    opacityFun->AddPoint(217, .68, 0.33, 0.45);
+    opacityFun->AddPoint(420, .83, 0.5, 0.0);
+    opacityFun->AddPoint(3071, .80, 0.5, 0.0);
+    break;
+  }
+}
+} // namespace